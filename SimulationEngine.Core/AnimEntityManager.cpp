@@ -1,67 +1,163 @@
 #include "AnimEntityManager.h"
+#include "ThreadPool.h"
+#include "TransformPool.h"
+
+#include <cstring>
+#include <algorithm>
 
 AnimEntityManager::AnimEntityManager(std::shared_ptr<Shader> a_pShader)
 {
 	m_pShader = a_pShader;
-
-	// Creating the CBuffer mappers.
-	m_pVertexCBuffer = std::make_shared<CBufferMapper<AnimCBufferVS>>(
-		ANIM_CBUFFER_REGISTER,
-		ShaderType::VertexShader);
-	m_pPixelCBuffer = std::make_shared<CBufferMapper<MaterialCBufferData>>(
-		ANIM_CBUFFER_REGISTER,
-		ShaderType::PixelShader);
 }
 
 AnimEntityManager::~AnimEntityManager(void) { }
 AnimEntityManager::AnimEntityManager(const AnimEntityManager& a_other)
 {
-	m_pVertexCBuffer = a_other.m_pVertexCBuffer;
-	m_pPixelCBuffer = a_other.m_pPixelCBuffer;
+	m_pShader = a_other.m_pShader;
 	m_lEntities = a_other.m_lEntities;
-
-	for (unsigned int i = 0; i < MAX_LIGHT_COUNT; i++)
-	{
-		m_Lights[i] = a_other.m_Lights[i];
-	}
 }
 AnimEntityManager& AnimEntityManager::operator=(const AnimEntityManager& a_other)
 {
-	m_pVertexCBuffer = a_other.m_pVertexCBuffer;
-	m_pPixelCBuffer = a_other.m_pPixelCBuffer;
+	m_pShader = a_other.m_pShader;
 	m_lEntities = a_other.m_lEntities;
+	m_bBVHDirty = true;
 
-	for (unsigned int i = 0; i < MAX_LIGHT_COUNT; i++)
+	return *this;
+}
+
+void AnimEntityManager::AddAnimEntity(std::shared_ptr<AnimatedEntity> a_pAnimEntity)
+{
+	m_lEntities.push_back(a_pAnimEntity);
+	m_bBVHDirty = true;
+}
+
+void AnimEntityManager::RemoveAnimEntity(std::shared_ptr<AnimatedEntity> a_pAnimEntity)
+{
+	auto found = std::find(m_lEntities.begin(), m_lEntities.end(), a_pAnimEntity);
+	if (found == m_lEntities.end())
 	{
-		m_Lights[i] = a_other.m_Lights[i];
+		return;
 	}
 
-	return *this;
+	// Ray casts before the next Submit would otherwise index past the end.
+	m_lEntities.erase(found);
+	m_bBVHDirty = true;
+	UpdateBVH();
 }
 
-void AnimEntityManager::AddLight(Light a_LightDesc, LightIndex a_LightIndex)
+
+CullStats AnimEntityManager::GetCullStats(void) const { return m_CullStats; }
+const SceneBVH& AnimEntityManager::GetBVH(void) const { return m_BVH; }
+unsigned int AnimEntityManager::GetBVHEntityIndex(unsigned int a_uObject) const { return m_lReady[a_uObject]; }
+
+bool AnimEntityManager::Raycast(const Ray& a_Ray, RayHit& a_Hit) const
 {
-	// Adds the light description to the passed in index.
-	m_Lights[a_LightIndex] = a_LightDesc;
+	a_Hit = RayHit();
+	a_Hit.Distance = a_Ray.MaxDistance;
+
+	// The hierarchy hands out entities closest box first, and every hit shortens how far the rest is searched.
+	m_BVH.QueryRay(a_Ray.Origin, a_Ray.Direction, a_Ray.MaxDistance, [&](unsigned int a_uObject, float a_fMaxDistance)
+		{
+			if (m_lEntities[m_lReady[a_uObject]]->Raycast(a_Ray, a_Hit))
+			{
+				a_Hit.Entity = m_lReady[a_uObject];
+			}
+			return a_Hit.Distance;
+		});
+
+	return a_Hit.Hit;
 }
 
-void AnimEntityManager::AddAnimEntity(std::shared_ptr<AnimatedEntity> a_pAnimEntity)
+bool AnimEntityManager::IsOccluded(const Ray& a_Ray) const
 {
-	m_lEntities.push_back(a_pAnimEntity);
+	bool bOccluded = false;
+	m_BVH.QueryRay(a_Ray.Origin, a_Ray.Direction, a_Ray.MaxDistance, [&](unsigned int a_uObject, float a_fMaxDistance)
+		{
+			RayHit hit;
+			hit.Distance = a_fMaxDistance;
+			bOccluded = m_lEntities[m_lReady[a_uObject]]->Raycast(a_Ray, hit, true);
+
+			// Stopping the whole walk at the first hit.
+			return bOccluded ? -1.0f : a_fMaxDistance;
+		});
+
+	return bOccluded;
 }
 
+void AnimEntityManager::Raycast(const Ray* a_pRays, unsigned int a_uCount, RayHit* a_pHits) const
+{
+	// Transforms moved since the last update would otherwise be resolved, and written, by several workers at once.
+	TransformPool::GetInstance()->Update();
+
+	ThreadPool::GetInstance()->ParallelFor(a_uCount, RAYCAST_MIN_BATCH, [&](unsigned int a_uBegin, unsigned int a_uEnd)
+		{
+			for (unsigned int i = a_uBegin; i < a_uEnd; i++)
+			{
+				Raycast(a_pRays[i], a_pHits[i]);
+			}
+		});
+}
 
-void AnimEntityManager::Draw(std::shared_ptr<Camera> a_pCamera)
+void AnimEntityManager::UpdateBVH(void)
 {
-	m_pShader->SetShader();
+	// Models still loading have no bounds, and would not draw anything anyway.
+	// Entities only ever finish loading, so between adds and removes a different count means the set changed.
+	unsigned int uReadyCount = 0;
 	for (unsigned int i = 0; i < m_lEntities.size(); i++)
 	{
-		m_lEntities[i]->Draw(
-			m_pVertexCBuffer, 
-			m_pPixelCBuffer, 
-			a_pCamera, 
-			m_Lights);
+		uReadyCount += m_lEntities[i]->IsReady() ? 1 : 0;
+	}
+
+	bool bRebuild = m_bBVHDirty || uReadyCount != m_BVH.GetObjectCount();
+	m_bBVHDirty = false;
+	if (bRebuild)
+	{
+		m_lReady.clear();
+		for (unsigned int i = 0; i < m_lEntities.size(); i++)
+		{
+			if (m_lEntities[i]->IsReady())
+			{
+				m_lReady.push_back(i);
+			}
+		}
+		m_lBounds.resize(uReadyCount);
+	}
+
+	for (unsigned int i = 0; i < uReadyCount; i++)
+	{
+		const CullBounds& bounds = m_lEntities[m_lReady[i]]->GetWorldBounds();
+		if (std::memcmp(&bounds, &m_lBounds[i], sizeof(CullBounds)) == 0)
+		{
+			continue;
+		}
+
+		m_lBounds[i] = bounds;
+		if (!bRebuild)
+		{
+			m_BVH.Refit(i, bounds);
+		}
+	}
+
+	if (bRebuild || m_BVH.NeedsRebuild())
+	{
+		m_BVH.Build(m_lBounds.data(), uReadyCount);
+	}
+}
+
+void AnimEntityManager::Submit(SceneRenderer& a_Renderer, std::shared_ptr<Camera> a_pCamera)
+{
+	// Culling against the frustum first, whole subtrees of the hierarchy are rejected or accepted at once.
+	UpdateBVH();
+	m_BVH.QueryFrustum(a_pCamera->GetFrustumPlanes(), m_lVisible);
+	m_CullStats.Visible = (unsigned int)m_lVisible.size();
+	m_CullStats.Culled = (unsigned int)m_lReady.size() - m_CullStats.Visible;
+	std::sort(m_lVisible.begin(), m_lVisible.end());
+
+	for (unsigned int uVisible : m_lVisible)
+	{
+		unsigned int i = m_lReady[uVisible];
+		m_lEntities[i]->Submit(a_Renderer, m_pShader, a_pCamera);
 	}
 }
 
-std::vector<std::shared_ptr<AnimatedEntity>> AnimEntityManager::GetEntities(void) { return m_lEntities; }
+const std::vector<std::shared_ptr<AnimatedEntity>>& AnimEntityManager::GetEntities(void) const { return m_lEntities; }
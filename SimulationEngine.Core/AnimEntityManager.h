@@ -8,10 +8,6 @@
 #include "CBufferMapper.h"
 #include "AnimatedEntity.h"
 #include "Camera.h"
-#include "Lights.h"
-
-// Setting the register location for the AnimEntity Shader program.
-#define ANIM_CBUFFER_REGISTER 4
 
 /// <summary>
 /// Manages the Animated Entities within the simulation.
@@ -19,15 +15,26 @@
 class AnimEntityManager
 {
 private:
-	Light m_Lights[MAX_LIGHT_COUNT] = {};
-	
 	std::shared_ptr<Shader> m_pShader;
 
-	std::shared_ptr<CBufferMapper<AnimCBufferVS>> m_pVertexCBuffer;
-	std::shared_ptr<CBufferMapper<MaterialCBufferData>> m_pPixelCBuffer;
-
 	std::vector<std::shared_ptr<AnimatedEntity>> m_lEntities;
 
+	// The hierarchy over the world box of every loaded entity, refitted as entities move.
+	SceneBVH m_BVH;
+	// The entity behind every object of the hierarchy, and the box it was last fitted to.
+	std::vector<unsigned int> m_lReady;
+	std::vector<CullBounds> m_lBounds;
+	// Set whenever entities are added or removed, since the hierarchy's objects map to indices into m_lEntities.
+	bool m_bBVHDirty = true;
+	std::vector<unsigned int> m_lVisible;
+	CullStats m_CullStats;
+
+	/// <summary>
+	/// Brings the hierarchy up to date with the loaded entities, refitting the ones that moved
+	/// and rebuilding it when entities were added, removed or finished loading, or refitting degraded it too far.
+	/// </summary>
+	void UpdateBVH(void);
+
 public:
 	/// <summary>
 	/// Constructs the Animated Entity Manager.
@@ -50,24 +57,62 @@ public:
 	AnimEntityManager& operator=(const AnimEntityManager& a_other);
 
 	/// <summary>
-	/// Adds the light to the array of lights at the specified enum index.
+	/// Adds the passed in AnimEntity to the manager's collection.
+	/// </summary>
+	void AddAnimEntity(std::shared_ptr<AnimatedEntity> a_pAnimEntity);
+
+	/// <summary>
+	/// Removes an AnimEntity from the manager's collection.  Does nothing if it was never added.
+	/// The hierarchy is rebuilt right away, since queries index into the entities with it.
 	/// </summary>
-	void AddLight(Light a_LightDesc, LightIndex a_LightIndex);
+	void RemoveAnimEntity(std::shared_ptr<AnimatedEntity> a_pAnimEntity);
 
 	/// <summary>
-	/// Adds the passed in AnimEntity to the manager's collection.
+	/// Gets how many of the loaded Animated Entities the last Submit culled.
 	/// </summary>
-	void AddAnimEntity(std::shared_ptr<AnimatedEntity> a_pAnimEntity);
+	CullStats GetCullStats(void) const;
+
+	/// <summary>
+	/// Gets the hierarchy over the loaded Animated Entities, as of the last Submit.
+	/// Its objects are turned into indices into GetEntities with GetBVHEntityIndex.
+	/// </summary>
+	const SceneBVH& GetBVH(void) const;
+
+	/// <summary>
+	/// Gets the index into GetEntities of one of the hierarchy's objects.
+	/// </summary>
+	unsigned int GetBVHEntityIndex(unsigned int a_uObject) const;
+
+	/// <summary>
+	/// Finds the closest triangle of the loaded Animated Entities, in their bind pose, a ray hits.  Uses the hierarchy as of the last Submit,
+	/// so only entities it knows about can be hit.
+	/// </summary>
+	/// <param name="a_Hit">Filled in with the closest hit, its entity being an index into GetEntities.</param>
+	/// <returns>Whether anything was hit before the ray's max distance.</returns>
+	bool Raycast(const Ray& a_Ray, RayHit& a_Hit) const;
+
+	/// <summary>
+	/// Checks whether anything blocks a ray before its max distance.  Cheaper than Raycast,
+	/// since it stops at the first triangle hit instead of looking for the closest one.
+	/// </summary>
+	bool IsOccluded(const Ray& a_Ray) const;
+
+	/// <summary>
+	/// Casts many rays at once, split across the worker threads.  Main thread only, since every
+	/// transform is brought up to date first so the workers only read.  Transforms must not change until it returns.
+	/// </summary>
+	/// <param name="a_pHits">Filled in with one hit per ray.</param>
+	void Raycast(const Ray* a_pRays, unsigned int a_uCount, RayHit* a_pHits) const;
 
 	/// <summary>
-	/// Renders all of the Animated Entities.
+	/// Submits a draw for every loaded Animated Entity that is inside of the camera's frustum.
 	/// </summary>
-	void Draw(std::shared_ptr<Camera> a_pCamera);
+	void Submit(SceneRenderer& a_Renderer, std::shared_ptr<Camera> a_pCamera);
 
 	/// <summary>
-	/// Gets the collection of Animated Entities.
+	/// Gets the collection of Animated Entities.  Entities are only added and removed through the manager.
 	/// </summary>
-	std::vector<std::shared_ptr<AnimatedEntity>> GetEntities(void);
+	const std::vector<std::shared_ptr<AnimatedEntity>>& GetEntities(void) const;
 
 };
 
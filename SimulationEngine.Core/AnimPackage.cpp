@@ -0,0 +1,386 @@
+#include "AnimPackage.h"
+#include "VertexPacker.h"
+
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+// Blobs and tables are aligned so that the mapped data can be read directly.
+#define ANIM_PACKAGE_ALIGNMENT 16
+
+namespace
+{
+	/// <summary>
+	/// Appends a blob to the end of a package that is being written, aligned.
+	/// </summary>
+	/// <returns>Where the blob starts.</returns>
+	uint64_t Append(std::vector<unsigned char>& a_lBytes, const void* a_pData, size_t a_uSize)
+	{
+		size_t uOffset = (a_lBytes.size() + ANIM_PACKAGE_ALIGNMENT - 1) & ~(size_t)(ANIM_PACKAGE_ALIGNMENT - 1);
+		a_lBytes.resize(uOffset + a_uSize, 0);
+		if (a_uSize > 0)
+		{
+			std::memcpy(&a_lBytes[uOffset], a_pData, a_uSize);
+		}
+		return uOffset;
+	}
+
+	/// <summary>
+	/// Appends a whole table to the end of a package that is being written.
+	/// </summary>
+	template <typename T>
+	uint64_t AppendTable(std::vector<unsigned char>& a_lBytes, const std::vector<T>& a_lTable)
+	{
+		return Append(a_lBytes, a_lTable.data(), a_lTable.size() * sizeof(T));
+	}
+
+	/// <summary>
+	/// Checks that a range of a mapped package actually lies inside of it.
+	/// </summary>
+	bool InFile(uint64_t a_uOffset, uint64_t a_uCount, uint64_t a_uStride, uint64_t a_uFileSize)
+	{
+		return a_uOffset <= a_uFileSize && a_uCount * a_uStride <= a_uFileSize - a_uOffset;
+	}
+
+	/// <summary>
+	/// Gets the first byte of a cooked texture, wherever it lives.
+	/// </summary>
+	const unsigned char* GetTextureData(const CookedTexture& a_Texture)
+	{
+		return a_Texture.Mapping != nullptr ? a_Texture.MappedData : a_Texture.Data.data();
+	}
+
+	/// <summary>
+	/// Gets the amount of bytes a cooked texture's mips span.
+	/// </summary>
+	size_t GetTextureSize(const CookedTexture& a_Texture)
+	{
+		size_t uSize = 0;
+		for (const CookedMip& mip : a_Texture.Mips)
+		{
+			uSize = std::max(uSize, mip.Offset + mip.Size);
+		}
+		return uSize;
+	}
+}
+
+bool AnimPackage::Load(const std::string& a_sSourceFile, AnimatedModelData& a_Result)
+{
+	std::shared_ptr<MappedFile> pFile = std::make_shared<MappedFile>();
+	if (!pFile->Open(a_sSourceFile + ANIM_PACKAGE_EXTENSION))
+	{
+		return false;
+	}
+
+	// Making sure that the file is actually a cooked model of this version.
+	const unsigned char* pData = pFile->GetData();
+	uint64_t uFileSize = pFile->GetSize();
+	const AnimPackageHeader* pHeader = reinterpret_cast<const AnimPackageHeader*>(pData);
+	if (uFileSize < sizeof(AnimPackageHeader) ||
+		pHeader->Magic != ANIM_PACKAGE_MAGIC ||
+		pHeader->Version != ANIM_PACKAGE_VERSION)
+	{
+		return false;
+	}
+
+	// Making sure that the tables are actually inside of the file.
+	if (!InFile(pHeader->JointOffset, pHeader->JointCount, sizeof(AnimPackageJoint), uFileSize) ||
+		!InFile(pHeader->MaterialOffset, pHeader->MaterialCount, sizeof(AnimPackageMaterial), uFileSize) ||
+		!InFile(pHeader->TextureOffset, pHeader->TextureCount, sizeof(AnimPackageTexture), uFileSize) ||
+		!InFile(pHeader->MipOffset, pHeader->MipCount, sizeof(AnimPackageMip), uFileSize) ||
+		!InFile(pHeader->MeshOffset, pHeader->MeshCount, sizeof(AnimPackageMesh), uFileSize) ||
+		!InFile(pHeader->NameOffset, pHeader->NameSize, 1, uFileSize))
+	{
+		return false;
+	}
+
+	// Stale packages are rejected so that they get rebuilt from the source.
+	if (!IsSourceUnchanged(a_sSourceFile, *pHeader))
+	{
+		return false;
+	}
+
+	AnimatedModelData data;
+
+	// Rebuilding the skeleton.  The joints were stored in skeleton order.
+	const AnimPackageJoint* pJoints = reinterpret_cast<const AnimPackageJoint*>(pData + pHeader->JointOffset);
+	const char* pNames = reinterpret_cast<const char*>(pData + pHeader->NameOffset);
+	std::vector<Joint> lJoints(pHeader->JointCount);
+	for (unsigned int i = 0; i < pHeader->JointCount; i++)
+	{
+		const AnimPackageJoint& stored = pJoints[i];
+		if (!InFile(stored.NameOffset, stored.NameLength, 1, pHeader->NameSize) ||
+			stored.ParentIndex >= (int32_t)pHeader->JointCount)
+		{
+			return false;
+		}
+
+		Joint& joint = lJoints[i];
+		joint.Name.assign(pNames + stored.NameOffset, stored.NameLength);
+		joint.ParentIndex = stored.ParentIndex;
+		std::memcpy(&joint.InvBindPose, stored.InvBindPose, sizeof(stored.InvBindPose));
+	}
+	data.RootSkeleton = std::make_shared<Skeleton>(lJoints);
+
+	// Pointing the textures of every material into the mapping.
+	const AnimPackageMaterial* pMaterials = reinterpret_cast<const AnimPackageMaterial*>(pData + pHeader->MaterialOffset);
+	const AnimPackageTexture* pTextures = reinterpret_cast<const AnimPackageTexture*>(pData + pHeader->TextureOffset);
+	const AnimPackageMip* pMips = reinterpret_cast<const AnimPackageMip*>(pData + pHeader->MipOffset);
+	data.Materials.resize(pHeader->MaterialCount);
+	for (unsigned int i = 0; i < pHeader->MaterialCount; i++)
+	{
+		const AnimPackageMaterial& stored = pMaterials[i];
+		if (!InFile(stored.FirstTexture, stored.TextureCount, 1, pHeader->TextureCount))
+		{
+			return false;
+		}
+
+		AnimatedMaterialData& material = data.Materials[i];
+		material.Color = Vector4(stored.Color[0], stored.Color[1], stored.Color[2], stored.Color[3]);
+
+		for (unsigned int t = stored.FirstTexture; t < stored.FirstTexture + stored.TextureCount; t++)
+		{
+			const AnimPackageTexture& storedTexture = pTextures[t];
+			if (TextureCooker::GetBlockBytes((TextureFormat)storedTexture.Format) == 0 ||
+				!InFile(storedTexture.FirstMip, storedTexture.MipCount, 1, pHeader->MipCount) ||
+				!InFile(storedTexture.DataOffset, storedTexture.DataSize, 1, uFileSize))
+			{
+				return false;
+			}
+
+			CookedTexture texture;
+			texture.Format = (TextureFormat)storedTexture.Format;
+			texture.Width = storedTexture.Width;
+			texture.Height = storedTexture.Height;
+			for (unsigned int m = storedTexture.FirstMip; m < storedTexture.FirstMip + storedTexture.MipCount; m++)
+			{
+				const AnimPackageMip& storedMip = pMips[m];
+				if (!InFile(storedMip.Offset, storedMip.Size, 1, storedTexture.DataSize))
+				{
+					return false;
+				}
+
+				CookedMip mip;
+				mip.Width = storedMip.Width;
+				mip.Height = storedMip.Height;
+				mip.RowPitch = storedMip.RowPitch;
+				mip.Offset = storedMip.Offset;
+				mip.Size = storedMip.Size;
+				texture.Mips.push_back(mip);
+			}
+			texture.Mapping = pFile;
+			texture.MappedData = pData + storedTexture.DataOffset;
+
+			material.Textures.insert({ storedTexture.Register, std::move(texture) });
+		}
+	}
+
+	// Pointing the meshes into the mapping as well.
+	const AnimPackageMesh* pMeshes = reinterpret_cast<const AnimPackageMesh*>(pData + pHeader->MeshOffset);
+	data.Meshes.resize(pHeader->MeshCount);
+	for (unsigned int i = 0; i < pHeader->MeshCount; i++)
+	{
+		const AnimPackageMesh& stored = pMeshes[i];
+		if (stored.Format >= VERTEX_FORMAT_COUNT ||
+			stored.LodCount == 0 ||
+			!InFile(stored.VertexOffset, stored.VertexCount, VertexPacker::GetVertexStride((VertexFormat)stored.Format), uFileSize) ||
+			!InFile(stored.IndexOffset, stored.IndexCount, VertexPacker::GetIndexStride(stored.VertexCount), uFileSize) ||
+			!InFile(stored.LodOffset, stored.LodCount, sizeof(MeshLod), uFileSize))
+		{
+			return false;
+		}
+
+		AnimatedMeshData& mesh = data.Meshes[i];
+		mesh.MaterialIndex = stored.MaterialIndex;
+
+		PackedMesh& packed = mesh.Packed;
+		packed.Format = (VertexFormat)stored.Format;
+		packed.VertexCount = stored.VertexCount;
+		packed.IndexCount = stored.IndexCount;
+		packed.Mapping = pFile;
+		packed.MappedVertices = pData + stored.VertexOffset;
+		packed.MappedIndices = pData + stored.IndexOffset;
+
+		const MeshLod* pLods = reinterpret_cast<const MeshLod*>(pData + stored.LodOffset);
+		packed.Lods.assign(pLods, pLods + stored.LodCount);
+		for (const MeshLod& lod : packed.Lods)
+		{
+			if (!InFile(lod.IndexOffset, lod.IndexCount, 1, stored.IndexCount))
+			{
+				return false;
+			}
+		}
+
+		packed.BoundsCenter = Vector3(stored.BoundsCenter[0], stored.BoundsCenter[1], stored.BoundsCenter[2]);
+		packed.BoundsRadius = stored.BoundsRadius;
+		packed.BoundsMin = Vector3(stored.BoundsMin[0], stored.BoundsMin[1], stored.BoundsMin[2]);
+		packed.BoundsMax = Vector3(stored.BoundsMax[0], stored.BoundsMax[1], stored.BoundsMax[2]);
+	}
+
+	a_Result = std::move(data);
+	return true;
+}
+
+bool AnimPackage::Write(const std::string& a_sSourceFile, const AnimatedModelData& a_Data)
+{
+	AnimPackageHeader header{};
+	uint64_t uStampSize = 0;
+	if (a_Data.RootSkeleton == nullptr ||
+		!HashSource(a_sSourceFile, header.SourceHash, header.SourceSize) ||
+		!MappedFile::GetFileStamp(a_sSourceFile, uStampSize, header.SourceWriteTime))
+	{
+		return false;
+	}
+
+	header.Magic = ANIM_PACKAGE_MAGIC;
+	header.Version = ANIM_PACKAGE_VERSION;
+
+	// Laying out the file: header, every blob, then the tables pointing at them.
+	std::vector<unsigned char> lBytes(sizeof(AnimPackageHeader), 0);
+
+	// The skeleton, along with its names.
+	std::string sNames;
+	std::vector<AnimPackageJoint> lJoints(a_Data.RootSkeleton->GetJointCount());
+	const Joint* pJoints = a_Data.RootSkeleton->GetJoints();
+	for (size_t i = 0; i < lJoints.size(); i++)
+	{
+		AnimPackageJoint& stored = lJoints[i];
+		stored.ParentIndex = pJoints[i].ParentIndex;
+		stored.NameOffset = (uint32_t)sNames.size();
+		stored.NameLength = (uint32_t)pJoints[i].Name.size();
+		std::memcpy(stored.InvBindPose, &pJoints[i].InvBindPose, sizeof(stored.InvBindPose));
+		sNames += pJoints[i].Name;
+	}
+
+	// The materials, with their textures and every texture's mips.
+	std::vector<AnimPackageMaterial> lMaterials(a_Data.Materials.size());
+	std::vector<AnimPackageTexture> lTextures;
+	std::vector<AnimPackageMip> lMips;
+	for (size_t i = 0; i < a_Data.Materials.size(); i++)
+	{
+		const AnimatedMaterialData& material = a_Data.Materials[i];
+		AnimPackageMaterial& stored = lMaterials[i];
+		stored.Color[0] = material.Color.x;
+		stored.Color[1] = material.Color.y;
+		stored.Color[2] = material.Color.z;
+		stored.Color[3] = material.Color.w;
+		stored.FirstTexture = (uint32_t)lTextures.size();
+		stored.TextureCount = (uint32_t)material.Textures.size();
+
+		for (const auto& texture : material.Textures)
+		{
+			const CookedTexture& cooked = texture.second;
+			size_t uDataSize = GetTextureSize(cooked);
+
+			AnimPackageTexture storedTexture{};
+			storedTexture.Register = texture.first;
+			storedTexture.Format = (uint32_t)cooked.Format;
+			storedTexture.Width = cooked.Width;
+			storedTexture.Height = cooked.Height;
+			storedTexture.FirstMip = (uint32_t)lMips.size();
+			storedTexture.MipCount = (uint32_t)cooked.Mips.size();
+			storedTexture.DataSize = (uint32_t)uDataSize;
+			storedTexture.DataOffset = (uint32_t)Append(lBytes, GetTextureData(cooked), uDataSize);
+			lTextures.push_back(storedTexture);
+
+			for (const CookedMip& mip : cooked.Mips)
+			{
+				AnimPackageMip storedMip{};
+				storedMip.Width = mip.Width;
+				storedMip.Height = mip.Height;
+				storedMip.RowPitch = mip.RowPitch;
+				storedMip.Offset = (uint32_t)mip.Offset;
+				storedMip.Size = (uint32_t)mip.Size;
+				lMips.push_back(storedMip);
+			}
+		}
+	}
+
+	// The meshes, with their vertices, indices and LODs.
+	std::vector<AnimPackageMesh> lMeshes(a_Data.Meshes.size());
+	for (size_t i = 0; i < a_Data.Meshes.size(); i++)
+	{
+		const PackedMesh& packed = a_Data.Meshes[i].Packed;
+		AnimPackageMesh& stored = lMeshes[i];
+		stored.MaterialIndex = a_Data.Meshes[i].MaterialIndex;
+		stored.Format = (uint32_t)packed.Format;
+		stored.VertexCount = packed.VertexCount;
+		stored.IndexCount = packed.IndexCount;
+		stored.LodCount = (uint32_t)packed.Lods.size();
+		stored.BoundsCenter[0] = packed.BoundsCenter.x;
+		stored.BoundsCenter[1] = packed.BoundsCenter.y;
+		stored.BoundsCenter[2] = packed.BoundsCenter.z;
+		stored.BoundsRadius = packed.BoundsRadius;
+		stored.BoundsMin[0] = packed.BoundsMin.x;
+		stored.BoundsMin[1] = packed.BoundsMin.y;
+		stored.BoundsMin[2] = packed.BoundsMin.z;
+		stored.BoundsMax[0] = packed.BoundsMax.x;
+		stored.BoundsMax[1] = packed.BoundsMax.y;
+		stored.BoundsMax[2] = packed.BoundsMax.z;
+
+		stored.VertexOffset = (uint32_t)Append(lBytes, packed.GetVertexData(), (size_t)packed.VertexCount * VertexPacker::GetVertexStride(packed.Format));
+		stored.IndexOffset = (uint32_t)Append(lBytes, packed.GetIndexData(), (size_t)packed.IndexCount * VertexPacker::GetIndexStride(packed.VertexCount));
+		stored.LodOffset = (uint32_t)AppendTable(lBytes, packed.Lods);
+	}
+
+	// The tables themselves.
+	header.JointCount = (uint32_t)lJoints.size();
+	header.JointOffset = (uint32_t)AppendTable(lBytes, lJoints);
+	header.MaterialCount = (uint32_t)lMaterials.size();
+	header.MaterialOffset = (uint32_t)AppendTable(lBytes, lMaterials);
+	header.TextureCount = (uint32_t)lTextures.size();
+	header.TextureOffset = (uint32_t)AppendTable(lBytes, lTextures);
+	header.MipCount = (uint32_t)lMips.size();
+	header.MipOffset = (uint32_t)AppendTable(lBytes, lMips);
+	header.MeshCount = (uint32_t)lMeshes.size();
+	header.MeshOffset = (uint32_t)AppendTable(lBytes, lMeshes);
+	header.NameSize = (uint32_t)sNames.size();
+	header.NameOffset = (uint32_t)Append(lBytes, sNames.data(), sNames.size());
+
+	// Every offset is stored in 32 bits, so models past 4GB can not be packaged.
+	if (lBytes.size() > std::numeric_limits<uint32_t>::max())
+	{
+		return false;
+	}
+
+	std::memcpy(&lBytes[0], &header, sizeof(AnimPackageHeader));
+	return MappedFile::WriteToDisk(a_sSourceFile + ANIM_PACKAGE_EXTENSION, lBytes.data(), lBytes.size());
+}
+
+bool AnimPackage::HashSource(const std::string& a_sSourceFile, uint64_t& a_uHash, uint64_t& a_uSize)
+{
+	MappedFile source(a_sSourceFile);
+	if (!source.IsOpen())
+	{
+		return false;
+	}
+
+	a_uHash = source.HashContents();
+	a_uSize = source.GetSize();
+	return true;
+}
+
+bool AnimPackage::IsSourceUnchanged(const std::string& a_sSourceFile, const AnimPackageHeader& a_Header)
+{
+	// Without a source there is nothing to rebuild from, so the package is all there is.
+	uint64_t uSize = 0;
+	uint64_t uWriteTime = 0;
+	if (!MappedFile::GetFileStamp(a_sSourceFile, uSize, uWriteTime))
+	{
+		return true;
+	}
+
+	if (uSize != a_Header.SourceSize)
+	{
+		return false;
+	}
+
+	// Only a source touched since cooking is hashed, the same as the mesh cache does.
+	if (uWriteTime == a_Header.SourceWriteTime)
+	{
+		return true;
+	}
+
+	uint64_t uHash = 0;
+	return HashSource(a_sSourceFile, uHash, uSize) && uHash == a_Header.SourceHash && uSize == a_Header.SourceSize;
+}
@@ -0,0 +1,186 @@
+#ifndef __ANIMPACKAGE_H_
+#define __ANIMPACKAGE_H_
+
+#include <string>
+#include <memory>
+#include <map>
+#include <vector>
+#include <cstdint>
+
+#include "Vectors.h"
+#include "Skeleton.h"
+#include "VertexFormat.h"
+#include "TextureCooker.h"
+#include "TriangleBVH.h"
+
+// Cooked models are written next to their source file with this ending.
+#define ANIM_PACKAGE_EXTENSION ".animpkg"
+
+// "DXAP" in little endian.
+#define ANIM_PACKAGE_MAGIC 0x50415844
+// Bump whenever the cooked layout or the import pipeline changes.
+#define ANIM_PACKAGE_VERSION 4
+
+/// <summary>
+/// A material read out of a model file, with its textures cooked but not uploaded.
+/// </summary>
+struct AnimatedMaterialData
+{
+	Vector4 Color = Vector4(0.0f, 0.0f, 0.0f, 1.0f);
+	// Maps the material register to the cooked texture.
+	std::map<unsigned int, CookedTexture> Textures;
+};
+
+/// <summary>
+/// A single mesh of a model file, fully built in system memory.
+/// </summary>
+struct AnimatedMeshData
+{
+	PackedMesh Packed;
+	unsigned int MaterialIndex = 0;
+	// The bind pose triangles for ray casts.
+	std::shared_ptr<TriangleBVH> Triangles = nullptr;
+};
+
+/// <summary>
+/// Everything imported from a model file before anything touches the device.
+/// </summary>
+struct AnimatedModelData
+{
+	std::shared_ptr<Skeleton> RootSkeleton = nullptr;
+	std::vector<AnimatedMaterialData> Materials;
+	std::vector<AnimatedMeshData> Meshes;
+};
+
+/// <summary>
+/// The header at the very start of a cooked model file.  Every table follows at its
+/// stored byte offset, and all of the offsets inside of the tables are from the start of the file.
+/// </summary>
+struct AnimPackageHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t SourceHash;
+	uint64_t SourceSize;
+	uint64_t SourceWriteTime;
+	uint32_t JointCount;
+	uint32_t JointOffset;
+	uint32_t MaterialCount;
+	uint32_t MaterialOffset;
+	uint32_t TextureCount;
+	uint32_t TextureOffset;
+	uint32_t MipCount;
+	uint32_t MipOffset;
+	uint32_t MeshCount;
+	uint32_t MeshOffset;
+	// Reserved for animation clips once they are imported.  Always empty for now.
+	uint32_t ClipCount;
+	uint32_t ClipOffset;
+	// The joint names, back to back without terminators.
+	uint32_t NameOffset;
+	uint32_t NameSize;
+};
+
+/// <summary>
+/// A joint of the skeleton, in skeleton order.
+/// </summary>
+struct AnimPackageJoint
+{
+	float InvBindPose[16];
+	int32_t ParentIndex;
+	uint32_t NameOffset;
+	uint32_t NameLength;
+	uint32_t Padding;
+};
+
+/// <summary>
+/// A material and the range of the texture table that belongs to it.
+/// </summary>
+struct AnimPackageMaterial
+{
+	float Color[4];
+	uint32_t FirstTexture;
+	uint32_t TextureCount;
+	uint32_t Padding[2];
+};
+
+/// <summary>
+/// A cooked texture and the range of the mip table that belongs to it.
+/// </summary>
+struct AnimPackageTexture
+{
+	uint32_t Register;
+	uint32_t Format;
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t FirstMip;
+	uint32_t MipCount;
+	uint32_t DataOffset;
+	uint32_t DataSize;
+};
+
+/// <summary>
+/// A single mip level.  The offset is from the start of its texture's data.
+/// </summary>
+struct AnimPackageMip
+{
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t RowPitch;
+	uint32_t Offset;
+	uint32_t Size;
+};
+
+/// <summary>
+/// A packed mesh along with where its vertex, index and LOD blobs live.
+/// </summary>
+struct AnimPackageMesh
+{
+	uint32_t MaterialIndex;
+	uint32_t Format;
+	uint32_t VertexCount;
+	uint32_t IndexCount;
+	uint32_t VertexOffset;
+	uint32_t IndexOffset;
+	uint32_t LodCount;
+	uint32_t LodOffset;
+	float BoundsCenter[3];
+	float BoundsRadius;
+	float BoundsMin[3];
+	float BoundsMax[3];
+};
+
+/// <summary>
+/// Reads and writes the cooked binary form of an animated model, so loading one skips the
+/// model importer entirely.  Loaded packages are memory-mapped and their meshes and textures
+/// point straight into the mapping.  Nothing in here touches the device.
+/// </summary>
+class AnimPackage
+{
+public:
+	/// <summary>
+	/// Maps the package belonging to the passed in source file.  Returns false if the package does
+	/// not exist, is corrupt, or was cooked from a different source.  Packages whose source file
+	/// is missing are trusted as they are, so that the source does not need to ship.
+	/// </summary>
+	static bool Load(const std::string& a_sSourceFile, AnimatedModelData& a_Result);
+
+	/// <summary>
+	/// Cooks the passed in model data into a package next to the source file.
+	/// </summary>
+	static bool Write(const std::string& a_sSourceFile, const AnimatedModelData& a_Data);
+
+private:
+	/// <summary>
+	/// Hashes the source file the package is validated against.
+	/// </summary>
+	static bool HashSource(const std::string& a_sSourceFile, uint64_t& a_uHash, uint64_t& a_uSize);
+
+	/// <summary>
+	/// Checks the source file against the size, write time and hash it was cooked from.
+	/// A missing source counts as unchanged, since there is nothing to rebuild the package from.
+	/// </summary>
+	static bool IsSourceUnchanged(const std::string& a_sSourceFile, const AnimPackageHeader& a_Header);
+};
+
+#endif //__ANIMPACKAGE_H_
@@ -1,9 +1,18 @@
 #include "AnimatedEntity.h"
 #include "SimulationUtils.h"
+#include "MeshOptimizer.h"
+#include "VertexPacker.h"
+#include "MeshSimplifier.h"
+#include "Logger.h"
+#include "MappedIOSystem.h"
 
 #include <queue>
+#include <algorithm>
 
-typedef std::map<unsigned int, std::shared_ptr<Material>> ModelMaterials;
+AnimatedEntity::AnimatedEntity(void)
+{
+	m_pTransform = std::make_shared<Transform>();
+}
 
 AnimatedEntity::AnimatedEntity(
 	std::string a_sFbxFile, 
@@ -11,8 +20,28 @@ AnimatedEntity::AnimatedEntity(
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> a_pSampler)
 {
 	m_pTransform = std::make_shared<Transform>();
+	Upload(Import(a_sFbxFile), a_pShader, a_pSampler);
+}
+
+AnimatedModelData AnimatedEntity::Import(const std::string& a_sFbxFile)
+{
+	// Cooked packages skip the importer entirely.
+	AnimatedModelData data;
+	if (AnimPackage::Load(a_sFbxFile, data))
+	{
+		for (AnimatedMeshData& mesh : data.Meshes)
+		{
+			mesh.Triangles = TriangleBVH::Create(mesh.Packed);
+		}
+		return data;
+	}
+
+	// Importers are not shared between threads, so every import gets its own.
 	Assimp::Importer importer;
 
+	// Reading the model through mapped files.  The importer takes ownership of the IOSystem.
+	importer.SetIOHandler(new MappedIOSystem());
+
 	// Ignoring line and point mesh.  Only Triangles should make it through.
 	importer.SetPropertyInteger(
 		AI_CONFIG_PP_SBP_REMOVE,
@@ -22,12 +51,70 @@ AnimatedEntity::AnimatedEntity(
 	const aiScene* scene = importer.ReadFile(a_sFbxFile,
 		aiProcess_CalcTangentSpace |
 		aiProcess_Triangulate |
+		aiProcess_JoinIdenticalVertices |
 		aiProcess_SortByPType |
 		aiProcess_EmbedTextures);
 
-	ProcessAssimpScene(scene, a_pShader, a_pSampler);
+	if (scene == nullptr)
+	{
+		throw std::invalid_argument(
+			"Error opening file: " + std::string(importer.GetErrorString())
+		);
+	}
+
+	ProcessAssimpScene(scene, data);
+
+	// Cooking the processed data so that the next load can skip the importer.
+	if (!AnimPackage::Write(a_sFbxFile, data))
+	{
+		Logger::GetInstance()->Log("AnimatedEntity.cpp", "Failed to cook a package for " + a_sFbxFile, INFO_LOG);
+	}
+
+	return data;
 }
 
+void AnimatedEntity::Upload(
+	const AnimatedModelData& a_Data,
+	std::shared_ptr<Shader> a_pShader,
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> a_pSampler)
+{
+	m_pRootSkeleton = a_Data.RootSkeleton;
+
+	// Creating the materials and uploading their textures.
+	std::vector<std::shared_ptr<Material>> lMaterials;
+	for (const AnimatedMaterialData& materialData : a_Data.Materials)
+	{
+		// Creating the material and inserting the sampler.
+		std::shared_ptr<Material> mat = std::make_shared<Material>(
+			a_pShader,
+			materialData.Color,
+			0.5f);
+		mat->AddSampler(SAMPLER_REGISTER, a_pSampler);
+
+		for (const auto& texture : materialData.Textures)
+		{
+			mat->AddTexturesSRV(texture.first, Utils::CreateTexture(texture.second));
+		}
+
+		lMaterials.push_back(mat);
+	}
+
+	// Creating the meshes.
+	for (const AnimatedMeshData& meshData : a_Data.Meshes)
+	{
+		if (meshData.MaterialIndex >= lMaterials.size())
+		{
+			continue;
+		}
+
+		std::shared_ptr<AnimatedMesh> pMesh = std::make_shared<AnimatedMesh>(meshData.Packed, meshData.Triangles);
+
+		m_mSubEntities.insert({ lMaterials[meshData.MaterialIndex], pMesh });
+	}
+}
+
+bool AnimatedEntity::IsReady(void) const { return m_pRootSkeleton != nullptr; }
+
 AnimatedEntity::~AnimatedEntity(void)
 {
 	m_pRootSkeleton.reset();
@@ -40,6 +127,7 @@ AnimatedEntity& AnimatedEntity::operator=(const AnimatedEntity& a_Other)
 	m_pRootSkeleton = a_Other.m_pRootSkeleton;
 	m_mSubEntities = a_Other.m_mSubEntities;
 	m_pTransform = a_Other.m_pTransform;
+	m_bBoundsValid = false;
 
 	return *this;
 }
@@ -51,18 +139,26 @@ AnimatedEntity::AnimatedEntity(const AnimatedEntity& a_Other)
 	m_pTransform = a_Other.m_pTransform;
 }
 
-void AnimatedEntity::Draw(
-	std::shared_ptr<CBufferMapper<AnimCBufferVS>> a_pVertexCBufferMapper,
-	std::shared_ptr<CBufferMapper<MaterialCBufferData>> a_pPixelCBufferMapper,
-	std::shared_ptr<Camera> a_pCamera,
-	Light a_Lights[MAX_LIGHT_COUNT])
+void AnimatedEntity::Submit(
+	SceneRenderer& a_Renderer,
+	std::shared_ptr<Shader> a_pShader,
+	std::shared_ptr<Camera> a_pCamera)
 {
+	// Still waiting on the model to finish loading.
+	if (!IsReady())
+	{
+		return;
+	}
+
+	if (m_pVertexCBuffer == nullptr)
+	{
+		m_pVertexCBuffer = std::make_shared<CBufferMapper<AnimCBufferVS>>(ANIM_CBUFFER_REGISTER, ShaderType::VertexShader);
+	}
+
 	// Setting constant buffer data.
 	AnimCBufferVS cbuffer{};
 	cbuffer.World = m_pTransform->GetWorld();
 	cbuffer.WorldInvTranspose = m_pTransform->GetWorldInvTra();
-	cbuffer.View = a_pCamera->GetView();
-	cbuffer.Projection = a_pCamera->GetProjection();
 	
 	// TODO: Figure out the best way to send this data to the GPU.
 	Joint* joints = m_pRootSkeleton->GetJoints();
@@ -72,68 +168,130 @@ void AnimatedEntity::Draw(
 	}
 
 	// Sending constant buffer data to GPU.
-	a_pVertexCBufferMapper->MapBufferData(cbuffer);
+	m_pVertexCBuffer->MapBufferData(cbuffer);
+
+	uint32_t uShader = a_Renderer.GetShaderId(a_pShader.get());
+	uint32_t uObject = a_Renderer.AddObject(*m_pVertexCBuffer);
+	float fDepth = a_Renderer.GetDepth(GetWorldBounds().Center);
 
 	for (auto& submesh : m_mSubEntities)
 	{
-		// Applying materials.
-		submesh.first->PrepMaterialForDraw(
-			a_pPixelCBufferMapper,
-			a_pCamera->GetTransform().GetPosition(),
-			&a_Lights[0]);
-
-		// Rendering the mesh.
-		submesh.second->Draw();
+		a_Renderer.Submit(
+			submesh.first->IsTranslucent() ? RenderLayer::Translucent : RenderLayer::Opaque,
+			uShader,
+			a_Renderer.GetMaterialId(submesh.first.get()),
+			a_Renderer.GetMeshId(submesh.second.get()),
+			uObject,
+			// Drawing the mesh at the detail its size on screen calls for.
+			submesh.second->SelectLod(cbuffer.World, a_pCamera),
+			fDepth);
 	}
 }
 
 std::shared_ptr<Transform> AnimatedEntity::GetTransform(void) { return m_pTransform; }
+
+const CullBounds& AnimatedEntity::GetWorldBounds(void)
+{
+	uint32_t uGeneration = m_pTransform->GetGeneration();
+	if (m_bBoundsValid && uGeneration == m_uBoundsGeneration)
+	{
+		return m_WorldBounds;
+	}
+
+	// Animations can reach a little past the bind pose, which is accepted in exchange for never skinning on the CPU.
+	Vector3 v3Min = Vector3(0.0f, 0.0f, 0.0f);
+	Vector3 v3Max = Vector3(0.0f, 0.0f, 0.0f);
+	for (auto it = m_mSubEntities.begin(); it != m_mSubEntities.end(); it++)
+	{
+		if (it == m_mSubEntities.begin())
+		{
+			v3Min = it->second->GetBoundsMin();
+			v3Max = it->second->GetBoundsMax();
+			continue;
+		}
+
+		FrustumCuller::Merge(v3Min, v3Max, it->second->GetBoundsMin(), it->second->GetBoundsMax());
+	}
+
+	m_WorldBounds = FrustumCuller::TransformBounds(v3Min, v3Max, m_pTransform->GetWorld());
+	m_uBoundsGeneration = uGeneration;
+	m_bBoundsValid = IsReady();
+	return m_WorldBounds;
+}
+
+bool AnimatedEntity::Raycast(const Ray& a_Ray, RayHit& a_Hit, bool a_bAnyHit) const
+{
+	// Casting in object space instead of moving every triangle into the world.
+	Matrix4 m4World = m_pTransform->GetWorld();
+	XMMatrix m4InverseWorld = DirectX::XMMatrixInverse(nullptr, DirectX::XMLoadFloat4x4(&m4World));
+	Vector3 v3Origin;
+	Vector3 v3Direction;
+	TriangleBVH::ToObjectSpace(a_Ray, m4InverseWorld, v3Origin, v3Direction);
+
+	bool bHit = false;
+	for (auto it = m_mSubEntities.begin(); it != m_mSubEntities.end(); it++)
+	{
+		// Meshes still loading have nothing to hit yet.
+		std::shared_ptr<TriangleBVH> pTriangles = it->second->GetTriangles();
+		if (pTriangles == nullptr || !pTriangles->Raycast(v3Origin, v3Direction, a_Hit, a_bAnyHit))
+		{
+			continue;
+		}
+
+		bHit = true;
+		if (a_bAnyHit)
+		{
+			break;
+		}
+	}
+
+	if (bHit)
+	{
+		TriangleBVH::ToWorldSpace(a_Ray, m4InverseWorld, a_Hit);
+	}
+	return bHit;
+}
+void AnimatedEntity::Attach(std::shared_ptr<Transform> a_pChild) { a_pChild->SetParent(m_pTransform.get()); }
 std::shared_ptr<Skeleton> AnimatedEntity::GetSkeleton(void) { return m_pRootSkeleton; }
 
-Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> AnimatedEntity::ProcessAssimpTexture(const aiTexture* texture)
+bool AnimatedEntity::ProcessAssimpTexture(const aiTexture* texture, ImageData& a_Result)
 {
-	D3D11_TEXTURE2D_DESC desc = {};
-	desc.Width = texture->mWidth;
-	desc.Height = texture->mHeight;
-	desc.MipLevels = 1;
-	desc.ArraySize = 1;
-	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	desc.SampleDesc.Count = 1;
-	desc.SampleDesc.Quality = 0;
-	desc.Usage = D3D11_USAGE_DEFAULT;
-	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-	desc.CPUAccessFlags = 0;
-	desc.MiscFlags = 0;
-
-	D3D11_SUBRESOURCE_DATA initData;
-	initData.pSysMem = texture->pcData;
-	initData.SysMemPitch = texture->mWidth * sizeof(uint32_t);
-	initData.SysMemSlicePitch = 0;
-
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> tex = nullptr;
-	Graphics::GetDevice()->CreateTexture2D(&desc, &initData, &tex);
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv = nullptr;
-	Graphics::GetDevice()->CreateShaderResourceView(tex.Get(), nullptr, &srv);
-
-	return srv;
+	// A height of zero means the texture is still in its compressed file format.
+	if (texture->mHeight == 0)
+	{
+		return Utils::DecodeImage(texture->pcData, texture->mWidth, a_Result);
+	}
+
+	// Otherwise the texels are raw BGRA and only need to be swizzled.
+	a_Result.Width = texture->mWidth;
+	a_Result.Height = texture->mHeight;
+	a_Result.Pixels.resize((size_t)texture->mWidth * texture->mHeight * 4);
+
+	for (size_t i = 0; i < (size_t)texture->mWidth * texture->mHeight; i++)
+	{
+		const aiTexel& texel = texture->pcData[i];
+		a_Result.Pixels[i * 4 + 0] = texel.r;
+		a_Result.Pixels[i * 4 + 1] = texel.g;
+		a_Result.Pixels[i * 4 + 2] = texel.b;
+		a_Result.Pixels[i * 4 + 3] = texel.a;
+	}
+
+	return true;
 }
 
-void AnimatedEntity::ProcessAssimpScene(
-	const aiScene* scene,
-	std::shared_ptr<Shader> a_pShader,
-	Microsoft::WRL::ComPtr<ID3D11SamplerState> a_pSampler)
+void AnimatedEntity::ProcessAssimpScene(const aiScene* scene, AnimatedModelData& a_Data)
 {
-	ProcessAssimpSkeleton(scene);
-	ProcessAssimpAnimations(scene);
-	ModelMaterials materials = ProcessAssimpMaterials(scene, a_pShader, a_pSampler);
-	ProcessAssimpVertices(scene, materials);
+	ProcessAssimpSkeleton(scene, a_Data);
+	ProcessAssimpAnimations(scene, a_Data);
+	ProcessAssimpMaterials(scene, a_Data);
+	ProcessAssimpVertices(scene, a_Data);
 }
 
-void AnimatedEntity::ProcessAssimpSkeleton(const aiScene* scene)
+void AnimatedEntity::ProcessAssimpSkeleton(const aiScene* scene, AnimatedModelData& a_Data)
 {
 	unsigned int uCounter = 0;
-	m_pRootSkeleton = std::make_shared<Skeleton>();
+	a_Data.RootSkeleton = std::make_shared<Skeleton>();
+	std::shared_ptr<Skeleton> pSkeleton = a_Data.RootSkeleton;
 	std::queue<LoadedBone> bones;
 
 	// Setting the starting (root) node.
@@ -154,7 +312,7 @@ void AnimatedEntity::ProcessAssimpSkeleton(const aiScene* scene)
 		joint.Name = current.Bone->mName.C_Str();
 		joint.ParentIndex = current.ParentIndex;
 		joint.InvBindPose = Utils::ConvertFromAssimpMatrix(current.Bone->mTransformation);
-		m_pRootSkeleton->AddJoint(joint);
+		pSkeleton->AddJoint(joint);
 
 		// Pushing the child bones to the queue.
 		for (unsigned int i = 0; i < current.Bone->mNumChildren; i++)
@@ -167,23 +325,24 @@ void AnimatedEntity::ProcessAssimpSkeleton(const aiScene* scene)
 		uCounter++;
 	}
 }
-void AnimatedEntity::ProcessAssimpVertices(const aiScene* scene, std::map<unsigned int, std::shared_ptr<Material>> a_mMaterials)
+void AnimatedEntity::ProcessAssimpVertices(const aiScene* scene, AnimatedModelData& a_Data)
 {
+	std::shared_ptr<Skeleton> pSkeleton = a_Data.RootSkeleton;
 	unsigned int uMeshCount = scene->mNumMeshes;
 	for (unsigned int i = 0; i < uMeshCount; i++)
 	{
-		std::shared_ptr<AnimatedMesh> pMesh;
 		aiMesh* mesh = scene->mMeshes[i];
-		unsigned int matIndex = mesh->mMaterialIndex;
+		AnimatedMeshData meshData;
+		meshData.MaterialIndex = mesh->mMaterialIndex;
 
 		// Vertex Count.
 		unsigned int uVertexCount = mesh->mNumVertices;
-		// Index Count.
-		unsigned int uIndexCount = mesh->mNumFaces * 3;
 		// Vertices.
-		SkinnedVertex* pVertices = new SkinnedVertex[uVertexCount];
+		std::vector<SkinnedVertex> lVertices(uVertexCount);
+		SkinnedVertex* pVertices = lVertices.data();
 		// Indices.  Always uses trianglese so num of faces times three.
-		unsigned int* pIndices = new unsigned int[mesh->mNumFaces * 3];
+		std::vector<unsigned int> lIndices(mesh->mNumFaces * 3);
+		unsigned int* pIndices = lIndices.data();
 
 		// Populating the Index array.
 		int nTotalIndices = 0;
@@ -244,130 +403,200 @@ void AnimatedEntity::ProcessAssimpVertices(const aiScene* scene, std::map<unsign
 			pVertices[j] = vertex;
 		}
 
-		// Putting together the mini bone structure for this mesh.
-		unsigned int uBoneCount = mesh->mNumBones;
-		for (unsigned int j = 0; j < uBoneCount; j++)
+		// Binding the vertices to the joints that move them.
+		SkinningStats stats = ProcessAssimpWeights(mesh, *pSkeleton, lVertices);
+		Logger::GetInstance()->Log(
+			"AnimatedEntity.cpp",
+			"Skinned " + std::string(mesh->mName.C_Str()) + " with " + std::to_string(stats.InfluencesRead) +
+			" influences, dropped " + std::to_string(stats.InfluencesDropped) +
+			" across " + std::to_string(stats.VerticesAffected) +
+			" vertices (at most " + std::to_string(stats.MaxDroppedWeight * 100.0f) + "% of a vertex's weight), " +
+			std::to_string(stats.UnknownBones) + " unknown bones",
+			DEBUG_LOG);
+
+		// Ordering the triangles and vertices for the GPU's caches while still on the worker.
+		MeshOptimizer::Optimize(lVertices, lIndices);
+
+		// Appending the simplified versions of the mesh to its indices, keeping joints apart.
+		std::vector<MeshLod> lLods = MeshSimplifier::GenerateLods(lVertices, lIndices);
+
+		// Shrinking the vertices and indices down to what the GPU actually needs.
+		VertexFormat format = VertexPacker::ChooseFormat(lVertices.data(), (unsigned int)lVertices.size());
+		VertexPacker::Pack(
+			lVertices.data(),
+			(unsigned int)lVertices.size(),
+			lIndices.data(),
+			(unsigned int)lIndices.size(),
+			format,
+			meshData.Packed);
+		meshData.Packed.Lods = lLods;
+		meshData.Triangles = TriangleBVH::Create(meshData.Packed);
+
+		a_Data.Meshes.push_back(std::move(meshData));
+	}
+}
+SkinningStats AnimatedEntity::ProcessAssimpWeights(
+	const aiMesh* mesh,
+	const Skeleton& a_Skeleton,
+	std::vector<SkinnedVertex>& a_lVertices)
+{
+	SkinningStats stats;
+
+	// Gathering the strongest influences of every vertex, along with how much weight got dropped.
+	std::vector<JointInfluence> lInfluences(a_lVertices.size());
+	std::vector<float> lDropped(a_lVertices.size(), 0.0f);
+	for (JointInfluence& influence : lInfluences)
+	{
+		std::fill(influence.Joints, influence.Joints + MAX_JOINT_INFLUENCES, -1);
+		std::fill(influence.Weights, influence.Weights + MAX_JOINT_INFLUENCES, 0.0f);
+	}
+
+	for (unsigned int i = 0; i < mesh->mNumBones; i++)
+	{
+		const aiBone* bone = mesh->mBones[i];
+		int dJoint = a_Skeleton.FindJoint(bone->mName.C_Str());
+		if (dJoint < 0)
 		{
-			aiBone* bone = mesh->mBones[j];
-			unsigned int uWeightCount = bone->mNumWeights;
-			unsigned int uBoneIdx = 0;
+			stats.UnknownBones++;
+			continue;
+		}
 
-			// Getting the current bones index in the skeleton.
-			Joint* joints = m_pRootSkeleton->GetJoints();
-			for (unsigned int i = 0; i < m_pRootSkeleton->GetJointCount(); i++)
+		for (unsigned int j = 0; j < bone->mNumWeights; j++)
+		{
+			const aiVertexWeight& weight = bone->mWeights[j];
+			if (weight.mVertexId >= a_lVertices.size() || !(weight.mWeight > 0.0f))
 			{
-				if (strcmp(joints[i].Name.c_str(), bone->mName.C_Str()) == 0)
+				continue;
+			}
+			stats.InfluencesRead++;
+
+			// Either adding onto the joint's existing slot, taking an empty one or pushing out the weakest.
+			JointInfluence& influence = lInfluences[weight.mVertexId];
+			unsigned int uSlot = 0;
+			for (unsigned int k = 1; k < MAX_JOINT_INFLUENCES && influence.Joints[uSlot] != dJoint; k++)
+			{
+				if (influence.Joints[k] == dJoint || influence.Weights[k] < influence.Weights[uSlot])
 				{
-					uBoneIdx = i;
+					uSlot = k;
 				}
 			}
 
-			for (unsigned int k = 0; k < uWeightCount; k++)
+			if (influence.Joints[uSlot] == dJoint)
 			{
-				// Extracting the weight and actual weight values.
-				aiVertexWeight weight = bone->mWeights[k];
-				float weightValue = weight.mWeight;
-
-				SkinnedVertex& vertex = pVertices[weight.mVertexId];
-
-				// Setting the data in that vertex,
-				vertex.JointWeights = Vector3(weightValue, weightValue, weightValue);
-				for (int boneIndex = 0; boneIndex < MAX_JOINT_COUNT; boneIndex++)
+				influence.Weights[uSlot] += weight.mWeight;
+			}
+			else if (influence.Joints[uSlot] < 0)
+			{
+				influence.Joints[uSlot] = dJoint;
+				influence.Weights[uSlot] = weight.mWeight;
+			}
+			else
+			{
+				stats.InfluencesDropped++;
+				lDropped[weight.mVertexId] += std::min(weight.mWeight, influence.Weights[uSlot]);
+				if (weight.mWeight > influence.Weights[uSlot])
 				{
-					// Only setting indices that have not been used yet.
-					if (vertex.JointIndices[boneIndex] == -1)
-					{
-						vertex.JointIndices[boneIndex] = uBoneIdx;
-						break;
-					}
+					influence.Joints[uSlot] = dJoint;
+					influence.Weights[uSlot] = weight.mWeight;
 				}
 			}
 		}
+	}
 
-		// Creating the mesh.
-		pMesh = std::make_shared<AnimatedMesh>(
-			pVertices,
-			uVertexCount,
-			pIndices,
-			uIndexCount);
+	// Ordering every vertex's influences strongest first and scaling them back up to a sum of 1.
+	for (size_t i = 0; i < a_lVertices.size(); i++)
+	{
+		JointInfluence& influence = lInfluences[i];
+		for (unsigned int j = 1; j < MAX_JOINT_INFLUENCES; j++)
+		{
+			for (unsigned int k = j; k > 0 && influence.Weights[k] > influence.Weights[k - 1]; k--)
+			{
+				std::swap(influence.Weights[k], influence.Weights[k - 1]);
+				std::swap(influence.Joints[k], influence.Joints[k - 1]);
+			}
+		}
+
+		float fTotal = 0.0f;
+		for (unsigned int j = 0; j < MAX_JOINT_INFLUENCES; j++)
+		{
+			fTotal += influence.Weights[j];
+		}
+		if (lDropped[i] > 0.0f)
+		{
+			stats.VerticesAffected++;
+			stats.MaxDroppedWeight = std::max(stats.MaxDroppedWeight, lDropped[i] / (fTotal + lDropped[i]));
+		}
 
-		m_mSubEntities.insert({ a_mMaterials[matIndex], pMesh });
+		SkinnedVertex& vertex = a_lVertices[i];
+		float fScale = fTotal > 0.0f ? 1.0f / fTotal : 0.0f;
+		for (unsigned int j = 0; j < MAX_JOINT_INFLUENCES; j++)
+		{
+			vertex.JointIndices[j] = influence.Joints[j];
+		}
+		vertex.JointWeights = Vector3(
+			influence.Weights[0] * fScale,
+			influence.Weights[1] * fScale,
+			influence.Weights[2] * fScale);
 	}
+
+	return stats;
 }
-ModelMaterials AnimatedEntity::ProcessAssimpMaterials(const aiScene* scene, std::shared_ptr<Shader> a_pShader, Microsoft::WRL::ComPtr<ID3D11SamplerState> a_pSampler)
+
+void AnimatedEntity::ProcessAssimpMaterials(const aiScene* scene, AnimatedModelData& a_Data)
 {
-	ModelMaterials modelMats;
+	// The texture types read from each material and the registers they are bound to.
+	const std::pair<aiTextureType, unsigned int> lTextureTypes[] =
+	{
+		{ aiTextureType_DIFFUSE, DIFFUSE_REGISTER },
+		{ aiTextureType_NORMALS, NORMAL_REGISTER },
+		{ aiTextureType_SHININESS, ROUGHNESS_REGISTER },
+		{ aiTextureType_METALNESS, METAL_REGISTER }
+	};
+
 	unsigned int uMaterialCount = scene->mNumMaterials;
+	a_Data.Materials.resize(uMaterialCount);
 	for (unsigned int i = 0; i < uMaterialCount; i++)
 	{
 		aiString str;
 		aiMaterial* material = scene->mMaterials[i];
-
-		// Creating the material and inserting the sampler.
-		std::shared_ptr<Material> mat = std::make_shared<Material>(
-			a_pShader,
-			Vector4(0.0f, 0.0f, 0.0f, 1.0f),
-			0.5f);
-		mat->AddSampler(SAMPLER_REGISTER, a_pSampler);
+		AnimatedMaterialData& mat = a_Data.Materials[i];
 
 		// TODO: Allow the AnimatedEntity to select its shader program according to the material types.
 		// Getting a base material color if textures are not present.
 		aiColor3D color = aiColor3D(0.0f, 0.0f, 0.0f);
 		material->Get(AI_MATKEY_COLOR_DIFFUSE, color);
-		mat->SetColor(Vector4(color.r, color.g, color.b, 1.0f));
+		mat.Color = Vector4(color.r, color.g, color.b, 1.0f);
 
-		// Getting the diffuse texture map.
-		if (material->GetTexture(aiTextureType_DIFFUSE, 0, &str) == AI_SUCCESS)
-		{
-			// TODO: load none embedded textures.
-			if (str.C_Str()[0] == '*')
-			{
-				int index = atoi(str.C_Str() + 1);
-				mat->AddTexturesSRV(
-					DIFFUSE_REGISTER,
-					ProcessAssimpTexture(scene->mTextures[index]));
-			}
-		}
-		// Getting the Normal texture map.
-		if (material->GetTexture(aiTextureType_NORMALS, 0, &str) == AI_SUCCESS)
+		for (const auto& textureType : lTextureTypes)
 		{
-			if (str.C_Str()[0] == '*')
-			{
-				int index = atoi(str.C_Str() + 1);
-				mat->AddTexturesSRV(
-					NORMAL_REGISTER,
-					ProcessAssimpTexture(scene->mTextures[index]));
-			}
-		}
-		// Getting the Shininess texture.
-		if (material->GetTexture(aiTextureType_SHININESS, 0, &str) == AI_SUCCESS)
-		{
-			if (str.C_Str()[0] == '*')
+			if (material->GetTexture(textureType.first, 0, &str) != AI_SUCCESS)
 			{
-				int index = atoi(str.C_Str() + 1);
-				mat->AddTexturesSRV(
-					ROUGHNESS_REGISTER,
-					ProcessAssimpTexture(scene->mTextures[index]));
+				continue;
 			}
-		}
-		// Getting the Metalness texture.
-		if (material->GetTexture(aiTextureType_METALNESS, 0, &str) == AI_SUCCESS)
-		{
+
+			// TODO: load none embedded textures.
 			if (str.C_Str()[0] == '*')
 			{
 				int index = atoi(str.C_Str() + 1);
-				mat->AddTexturesSRV(
-					METAL_REGISTER,
-					ProcessAssimpTexture(scene->mTextures[index]));
+				ImageData image;
+				if (!ProcessAssimpTexture(scene->mTextures[index], image))
+				{
+					continue;
+				}
+
+				// Embedded textures have no file of their own to cache, so they are cooked on every import.
+				TextureCookOptions options;
+				options.Usage = Utils::GetTextureUsage(textureType.second);
+				CookedTexture texture;
+				if (TextureCooker::Cook(image, options, texture))
+				{
+					mat.Textures.insert({ textureType.second, std::move(texture) });
+				}
 			}
 		}
-
-		modelMats.insert({ i, mat });
 	}
-
-	return modelMats;
 }
-void AnimatedEntity::ProcessAssimpAnimations(const aiScene* scene)
+void AnimatedEntity::ProcessAssimpAnimations(const aiScene* scene, AnimatedModelData& a_Data)
 {
 
 }
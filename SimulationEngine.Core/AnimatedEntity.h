@@ -4,6 +4,7 @@
 #include <string>
 #include <memory>
 #include <map>
+#include <vector>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -15,13 +16,19 @@
 #include "CBufferMapper.h"
 #include "Camera.h"
 #include "CBuffers.h"
+#include "ImageData.h"
+#include "TextureCooker.h"
+#include "AnimPackage.h"
+#include "FrustumCuller.h"
+#include "SceneRenderer.h"
+
+// Setting the register location for the AnimEntity Shader program.
+#define ANIM_CBUFFER_REGISTER 4
 
 struct AnimCBufferVS
 {
 	Matrix4 World;
 	Matrix4 WorldInvTranspose;
-	Matrix4 View;
-	Matrix4 Projection;
 	Joint Joints[MAX_JOINT_COUNT] = {};
 };
 
@@ -32,6 +39,20 @@ struct LoadedBone
 	unsigned int ParentIndex;
 };
 
+/// <summary>
+/// Reports how a mesh's joint influences were squeezed into MAX_JOINT_INFLUENCES per vertex.
+/// </summary>
+struct SkinningStats
+{
+	unsigned int InfluencesRead = 0;
+	unsigned int InfluencesDropped = 0;
+	unsigned int VerticesAffected = 0;
+	// The largest fraction of a single vertex's total weight that was dropped.
+	float MaxDroppedWeight = 0.0f;
+	// Bones that did not match any joint of the skeleton by name.
+	unsigned int UnknownBones = 0;
+};
+
 /// <summary>
 /// Contains all of the AnimatedEntity data.
 /// </summary>
@@ -42,7 +63,20 @@ private:
 	std::shared_ptr<Transform> m_pTransform = nullptr;
 	std::map<std::shared_ptr<Material>, std::shared_ptr<AnimatedMesh>> m_mSubEntities;
 
+	// The Animated Entity's own vertex CBuffer, joints change every frame so it is always re-uploaded.
+	std::shared_ptr<CBufferMapper<AnimCBufferVS>> m_pVertexCBuffer = nullptr;
+
+	// The world space box around every mesh, only recomputed once the transform changed.
+	CullBounds m_WorldBounds;
+	uint32_t m_uBoundsGeneration = 0;
+	bool m_bBoundsValid = false;
+
 public:
+	/// <summary>
+	/// Constructs an AnimatedEntity with no model that draws nothing until data is uploaded to it.
+	/// </summary>
+	AnimatedEntity(void);
+
 	/// <summary>
 	/// Loads and constructs a model from any file ending that can contain animations.
 	/// </summary>
@@ -65,19 +99,59 @@ public:
 	AnimatedEntity(const AnimatedEntity& a_Other);
 
 	/// <summary>
-	/// Renders the Animated Entity.
+	/// Reads a model file and builds all of its data without touching the device,
+	/// so it is safe to call from worker threads.  An up to date package of the model
+	/// is loaded instead when there is one, and otherwise one is cooked for the next load.
+	/// </summary>
+	static AnimatedModelData Import(const std::string& a_sFbxFile);
+
+	/// <summary>
+	/// Creates the materials, textures and meshes out of imported data.
+	/// Must be called from the thread that owns the device.
+	/// </summary>
+	void Upload(
+		const AnimatedModelData& a_Data,
+		std::shared_ptr<Shader> a_pShader,
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> a_pSampler);
+
+	/// <summary>
+	/// Gets whether or not the model has been uploaded yet.
 	/// </summary>
-	void Draw(
-		std::shared_ptr<CBufferMapper<AnimCBufferVS>> a_pVertexCBufferMapper,
-		std::shared_ptr<CBufferMapper<MaterialCBufferData>> a_pPixelCBufferMapper,
-		std::shared_ptr<Camera> a_pCamera,
-		Light a_Lights[MAX_LIGHT_COUNT] = {});
+	bool IsReady(void) const;
+
+	/// <summary>
+	/// Uploads the Animated Entity's constants and submits a draw for every mesh.  Nothing is submitted until the model is ready.
+	/// </summary>
+	/// <param name="a_pShader">The shader every mesh is drawn with.</param>
+	void Submit(
+		SceneRenderer& a_Renderer,
+		std::shared_ptr<Shader> a_pShader,
+		std::shared_ptr<Camera> a_pCamera);
 
 	/// <summary>
 	/// Gets this Entity's Transform.
 	/// </summary>
 	std::shared_ptr<Transform> GetTransform(void);
 
+	/// <summary>
+	/// Gets the world space box around every mesh in its bind pose.  Only valid once the model is ready.
+	/// </summary>
+	const CullBounds& GetWorldBounds(void);
+
+	/// <summary>
+	/// Casts a world space ray against the triangles of every mesh, in their bind pose.
+	/// Only reads, so any amount of threads can cast at once while nothing moves.
+	/// </summary>
+	/// <param name="a_Hit">Its distance is the furthest a hit counts.  Filled in when a closer hit was found.</param>
+	/// <param name="a_bAnyHit">Stops at the first hit instead of looking for the closest one.</param>
+	/// <returns>Whether a closer hit was found.</returns>
+	bool Raycast(const Ray& a_Ray, RayHit& a_Hit, bool a_bAnyHit = false) const;
+
+	/// <summary>
+	/// Attaches another transform (a child entity's, an outliner's) to this Entity, so it follows it around.
+	/// </summary>
+	void Attach(std::shared_ptr<Transform> a_pChild);
+
 	/// <summary>
 	/// Gets this Entity's Skeleton.
 	/// </summary>
@@ -87,40 +161,41 @@ private:
 	/// <summary>
 	/// Processes the loaded Assimp scene into SimulationEngine data structures.
 	/// </summary>
-	void ProcessAssimpScene(
-		const aiScene* scene,
-		std::shared_ptr<Shader> a_pShader,
-		Microsoft::WRL::ComPtr<ID3D11SamplerState> a_pSampler);
+	static void ProcessAssimpScene(const aiScene* scene, AnimatedModelData& a_Data);
 
 	/// <summary>
 	/// Processes the Assimp scene's skeleton data.
 	/// </summary>
-	void ProcessAssimpSkeleton(const aiScene* scene);
+	static void ProcessAssimpSkeleton(const aiScene* scene, AnimatedModelData& a_Data);
 
 	/// <summary>
 	/// Processes the Assimp scene's vertex/index data.
 	/// </summary>
-	void ProcessAssimpVertices(
-		const aiScene* scene, 
-		std::map<unsigned int, std::shared_ptr<Material>> a_mMaterials);
+	static void ProcessAssimpVertices(const aiScene* scene, AnimatedModelData& a_Data);
 	
+	/// <summary>
+	/// Gathers the bone weights of a mesh per vertex, keeps the strongest MAX_JOINT_INFLUENCES
+	/// of every vertex and renormalizes them into the vertices.
+	/// </summary>
+	static SkinningStats ProcessAssimpWeights(
+		const aiMesh* mesh,
+		const Skeleton& a_Skeleton,
+		std::vector<SkinnedVertex>& a_lVertices);
+
 	/// <summary>
 	/// Processes the Assimp scene's material data.
 	/// </summary>
-	std::map<unsigned int, std::shared_ptr<Material>> ProcessAssimpMaterials(
-		const aiScene* scene,
-		std::shared_ptr<Shader> a_pShader,
-		Microsoft::WRL::ComPtr<ID3D11SamplerState> a_pSampler);
+	static void ProcessAssimpMaterials(const aiScene* scene, AnimatedModelData& a_Data);
 
 	/// <summary>
 	/// Processes the Assimp animation data.
 	/// </summary>
-	void ProcessAssimpAnimations(const aiScene* scene);
+	static void ProcessAssimpAnimations(const aiScene* scene, AnimatedModelData& a_Data);
 
 	/// <summary>
-	/// Constructs a D3D11 Shader Resource View out of an Assimp aiTexture.
+	/// Decodes an Assimp aiTexture into RGBA pixels.
 	/// </summary>
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> ProcessAssimpTexture(const aiTexture* texture);
+	static bool ProcessAssimpTexture(const aiTexture* texture, ImageData& a_Result);
 };
 
 #endif //__ANIMATEDENTITY_H_
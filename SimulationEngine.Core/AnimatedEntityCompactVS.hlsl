@@ -0,0 +1,3 @@
+// AnimatedEntityVS reading the CompactVertex layout instead of the full precision one.
+#define COMPACT_VERTEX
+#include "AnimatedEntityVS.hlsl"
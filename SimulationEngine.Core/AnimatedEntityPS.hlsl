@@ -1,5 +1,5 @@
 #include "VertexToPixel.hlsli"
-#include "Lighting.hlsli"
+#include "FrameConstants.hlsli"
 #include "PhysicsTextureRender.hlsli"
 
 Texture2D Albedo : register(t0);
@@ -9,18 +9,13 @@ Texture2D Metal : register(t3);
 
 SamplerState Sampler : register(s0);
 
-cbuffer ExternalData : register(b4)
+cbuffer MaterialData : register(b1)
 {
     // 16 byte memory padding rules applied:
     // - -
     float2 Offset;
     float2 Scale;
     // - -
-    float3 CameraPosition;
-    float padding;
-    // - -
-    Light Lights[MAX_LIGHT_COUNT];
-    // - -
     float4 Color;
 }
 
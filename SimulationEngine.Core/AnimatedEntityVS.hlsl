@@ -1,6 +1,7 @@
 #include "VertexToPixel.hlsli"
 #include "VertexInput.hlsli"
 #include "AnimJoint.hlsli"
+#include "FrameConstants.hlsli"
 
 cbuffer ExternalData : register(b4)
 {
@@ -8,16 +9,13 @@ cbuffer ExternalData : register(b4)
     matrix world;
 	// - -
     matrix worldInvTranspose;
-	// - -
-    matrix view;
-	// - -
-    matrix projection;
     // - -
     Joint joints[MAX_JOINT_COUNT];
 }
 
-VertexToPixel main(VertexShaderInput input)
+VertexToPixel main(RawVertexShaderInput raw)
 {
+    VertexShaderInput input = DecodeVertexInput(raw);
     VertexToPixel output;
     
     matrix wvp = mul(projection, mul(view, world));
@@ -1,34 +1,34 @@
 #include "AnimatedMesh.h"
+#include "StateCache.h"
 #include "SimulationUtils.h"
 #include "Material.h"
 #include "Shader.h"
+#include "VertexPacker.h"
 
-AnimatedMesh::AnimatedMesh(
-	SkinnedVertex* a_pVertices,
-	unsigned int a_uVertexCount,
-	unsigned int* a_pIndices,
-	unsigned int a_uIndexCount,
-	TangentType a_TangentType)
+AnimatedMesh::AnimatedMesh(const PackedMesh& a_Mesh, std::shared_ptr<TriangleBVH> a_pTriangles)
 {
 	// Saving the passed in values to the member fields.
 	m_pVertexBuffer = nullptr;
 	m_pIndexBuffer = nullptr;
 
-	m_dVertexCount = a_uVertexCount;
-	m_dIndexCount = a_uIndexCount;
+	m_dVertexCount = a_Mesh.VertexCount;
+	m_dIndexCount = a_Mesh.IndexCount;
+	m_VertexFormat = a_Mesh.Format;
+	m_lLods = a_Mesh.Lods;
+	m_v3BoundsCenter = a_Mesh.BoundsCenter;
+	m_fBoundsRadius = a_Mesh.BoundsRadius;
+	m_v3BoundsMin = a_Mesh.BoundsMin;
+	m_v3BoundsMax = a_Mesh.BoundsMax;
+	m_pTriangles = a_pTriangles != nullptr ? a_pTriangles : TriangleBVH::Create(a_Mesh);
 
-	// Calculating vertex tangents.
-	/*Mesh::CalculateTangents(
-		a_pVertices,
-		m_dVertexCount,
-		a_pIndices,
-		m_dIndexCount,
-		a_TangentType);*/
+	// Small meshes get away with 16 bit indices.
+	unsigned int uIndexStride = VertexPacker::GetIndexStride(a_Mesh.VertexCount);
+	m_IndexFormat = uIndexStride == sizeof(uint16_t) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
 
 	// Setting up the vertex buffer setup struct object.
 	D3D11_BUFFER_DESC vbd = {};
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(SkinnedVertex) * m_dVertexCount;
+	vbd.ByteWidth = VertexPacker::GetVertexStride(m_VertexFormat) * m_dVertexCount;
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
@@ -37,7 +37,7 @@ AnimatedMesh::AnimatedMesh(
 	// Setting up the index buffer setup struct object.
 	D3D11_BUFFER_DESC ibd = {};
 	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(unsigned int) * m_dIndexCount;
+	ibd.ByteWidth = uIndexStride * m_dIndexCount;
 	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	ibd.CPUAccessFlags = 0;
 	ibd.MiscFlags = 0;
@@ -48,8 +48,8 @@ AnimatedMesh::AnimatedMesh(
 	D3D11_SUBRESOURCE_DATA initialIndexData = {};
 
 	// Setting the system memory to hold the buffer data.
-	initialVertexData.pSysMem = a_pVertices;
-	initialIndexData.pSysMem = a_pIndices;
+	initialVertexData.pSysMem = a_Mesh.GetVertexData();
+	initialIndexData.pSysMem = a_Mesh.GetIndexData();
 
 	// Creating the buffers.
 	Graphics::GetDevice()->CreateBuffer(&vbd, &initialVertexData, m_pVertexBuffer.GetAddressOf());
@@ -60,22 +60,50 @@ BufferPtr AnimatedMesh::GetVertexBuffer(void) { return m_pVertexBuffer; }
 BufferPtr AnimatedMesh::GetIndexBuffer(void) { return m_pIndexBuffer; }
 int AnimatedMesh::GetIndexCount(void) { return m_dIndexCount; }
 int AnimatedMesh::GetVertexCount(void) { return m_dVertexCount; }
+unsigned int AnimatedMesh::GetLodCount(void) const { return (unsigned int)m_lLods.size(); }
+Vector3 AnimatedMesh::GetBoundsMin(void) const { return m_v3BoundsMin; }
+Vector3 AnimatedMesh::GetBoundsMax(void) const { return m_v3BoundsMax; }
+std::shared_ptr<TriangleBVH> AnimatedMesh::GetTriangles(void) const { return m_pTriangles; }
 
-void AnimatedMesh::Draw(void)
+unsigned int AnimatedMesh::SelectLod(const Matrix4& a_m4World, std::shared_ptr<Camera> a_pCamera) const
 {
-	// Setting the stride to be the memory size of a Vertex
-	UINT stride = sizeof(SkinnedVertex);
+	return Mesh::SelectLod(m_lLods, m_v3BoundsCenter, m_fBoundsRadius, a_m4World, a_pCamera);
+}
+
+bool AnimatedMesh::Bind(void)
+{
+	// The bound shader has to read the vertices the way they were packed.
+	if (!Shader::SetVertexFormat(m_VertexFormat))
+	{
+		return false;
+	}
+
+	// Setting the stride to be the memory size of a packed vertex.
+	UINT stride = VertexPacker::GetVertexStride(m_VertexFormat);
 
 	// The offset starts at the first piece of data.
 	UINT offset = 0;
 
 	// Setting this Mesh's buffers as the next thing to draw.
-	Graphics::GetContext()->IASetVertexBuffers(0, 1, m_pVertexBuffer.GetAddressOf(), &stride, &offset);
-	Graphics::GetContext()->IASetIndexBuffer(m_pIndexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	StateCache::GetInstance()->IASetVertexBuffers(0, 1, m_pVertexBuffer.GetAddressOf(), &stride, &offset);
+	StateCache::GetInstance()->IASetIndexBuffer(m_pIndexBuffer.Get(), m_IndexFormat, 0);
+	return true;
+}
 
+void AnimatedMesh::DrawIndexed(unsigned int a_uLod)
+{
 	// Starting up the render pipeline and drawing the currently set Index and Vertex buffers.
+	const MeshLod& lod = m_lLods[a_uLod < m_lLods.size() ? a_uLod : m_lLods.size() - 1];
 	Graphics::GetContext()->DrawIndexed(
-		m_dIndexCount,		// The number of indices to use.
-		0,					// Offset from the first index to use.
+		lod.IndexCount,		// The number of indices to use.
+		lod.IndexOffset,	// Offset from the first index to use.
 		0);					// Offset to add to each index.
+}
+
+void AnimatedMesh::Draw(unsigned int a_uLod)
+{
+	if (Bind())
+	{
+		DrawIndexed(a_uLod);
+	}
 }
\ No newline at end of file
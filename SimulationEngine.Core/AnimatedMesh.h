@@ -3,11 +3,12 @@
 
 #include "Vectors.h"
 #include "SkinnedVertex.h"
+#include "VertexFormat.h"
 #include "Mesh.h"
 
 /// <summary>
 /// Defines a Mesh that uses SkinnedVertices as opposed to the normal Vertex.
-/// Essentially a hard copy of the Mesh object except using the SkinnedVertex.
+/// Essentially a hard copy of the Mesh object except using one of the skinned vertex formats.
 /// </summary>
 class AnimatedMesh
 {
@@ -16,17 +17,23 @@ private:
 	BufferPtr m_pIndexBuffer;
 	int m_dIndexCount;
 	int m_dVertexCount;
+	VertexFormat m_VertexFormat;
+	DXGI_FORMAT m_IndexFormat;
+	std::vector<MeshLod> m_lLods;
+	Vector3 m_v3BoundsCenter;
+	float m_fBoundsRadius;
+	Vector3 m_v3BoundsMin;
+	Vector3 m_v3BoundsMax;
+	// The bind pose triangles kept in system memory for ray casts.
+	std::shared_ptr<TriangleBVH> m_pTriangles;
 
 public:
 	/// <summary>
-	/// Constructs the AnimatedMesh with preexisting vertices/indices.
+	/// Constructs the AnimatedMesh with preexisting vertices/indices,
+	/// already packed into the Skinned or CompactSkinned format.
 	/// </summary>
-	AnimatedMesh(
-		SkinnedVertex* a_pVertices, 
-		unsigned int a_uVertexCount, 
-		unsigned int* a_pIndices, 
-		unsigned int a_uIndexCount,
-		TangentType a_TangentType = TangentType::Normal);
+	/// <param name="a_pTriangles">The triangles for ray casts when they were already built, otherwise they are built here.</param>
+	AnimatedMesh(const PackedMesh& a_Mesh, std::shared_ptr<TriangleBVH> a_pTriangles = nullptr);
 
 	// Accessors:
 	/// <summary>
@@ -53,10 +60,52 @@ public:
 	/// <returns>The amount of vertices in the Vertex Buffer.</returns>
 	int GetVertexCount(void);
 
+	/// <summary>
+	/// Retrieves the amount of levels of detail, counting the full resolution one.
+	/// </summary>
+	/// <returns>The amount of LODs.</returns>
+	unsigned int GetLodCount(void) const;
+
+	/// <summary>
+	/// Gets the smallest corner of the box around every vertex in its bind pose.
+	/// </summary>
+	Vector3 GetBoundsMin(void) const;
+
+	/// <summary>
+	/// Gets the largest corner of the box around every vertex in its bind pose.
+	/// </summary>
+	Vector3 GetBoundsMax(void) const;
+
+	/// <summary>
+	/// Gets the hierarchy over the triangles of the full resolution bind pose.
+	/// </summary>
+	std::shared_ptr<TriangleBVH> GetTriangles(void) const;
+
+	/// <summary>
+	/// Picks the coarsest LOD whose error stays below LOD_SCREEN_ERROR of the screen's height.
+	/// </summary>
+	/// <param name="a_m4World">The world matrix the AnimatedMesh is drawn with.</param>
+	/// <param name="a_pCamera">The camera the AnimatedMesh is seen through.</param>
+	/// <returns>The LOD to draw.</returns>
+	unsigned int SelectLod(const Matrix4& a_m4World, std::shared_ptr<Camera> a_pCamera) const;
+
+	/// <summary>
+	/// Sets the buffers as the next thing to draw, switching the active Shader over to this AnimatedMesh's vertex format first.
+	/// </summary>
+	/// <returns>False if the active Shader cannot read its vertices.</returns>
+	bool Bind(void);
+
+	/// <summary>
+	/// Draws a level of detail out of the buffers set by Bind.
+	/// </summary>
+	/// <param name="a_uLod">The level of detail to draw, 0 being full resolution.</param>
+	void DrawIndexed(unsigned int a_uLod = 0);
+
 	/// <summary>
 	/// Renders the AnimatedMesh to the simulation window.
 	/// </summary>
-	void Draw(void);
+	/// <param name="a_uLod">The level of detail to draw, 0 being full resolution.</param>
+	void Draw(unsigned int a_uLod = 0);
 };
 
 #endif //__ANIMATEDMesh<>_H_
@@ -0,0 +1,272 @@
+#include "AssetLoader.h"
+#include "ThreadPool.h"
+#include "SimulationUtils.h"
+#include "Logger.h"
+#include "ResourceRegistry.h"
+#include "TextureCooker.h"
+
+#include <stdexcept>
+
+AssetLoader* AssetLoader::m_pInstance = nullptr;
+
+namespace
+{
+	/// <summary>
+	/// Narrows a wide path for logging.
+	/// </summary>
+	std::string ToLogString(const std::wstring& a_sString)
+	{
+		std::string result;
+		result.reserve(a_sString.size());
+		for (wchar_t c : a_sString)
+		{
+			result += static_cast<char>(c);
+		}
+		return result;
+	}
+}
+
+AssetLoader* AssetLoader::GetInstance(void)
+{
+	if (m_pInstance == nullptr)
+	{
+		m_pInstance = new AssetLoader();
+	}
+
+	return m_pInstance;
+}
+
+void AssetLoader::Release(void)
+{
+	if (m_pInstance == nullptr)
+	{
+		return;
+	}
+
+	delete m_pInstance;
+	m_pInstance = nullptr;
+}
+
+std::shared_ptr<Mesh> AssetLoader::LoadMesh(const std::string& a_sObjDirectory, const std::string& a_sObjName)
+{
+	std::string sObjPath = a_sObjDirectory + a_sObjName;
+
+	// Meshes that are already loaded, or still loading, are handed out again as is.
+	return ResourceRegistry::GetInstance()->GetMesh(sObjPath, 0, [&]()
+		{
+			std::shared_ptr<Mesh> pMesh = std::make_shared<Mesh>();
+
+			Dispatch(sObjPath, [pMesh, sObjPath]()
+				{
+					std::shared_ptr<MeshData> pData = std::make_shared<MeshData>();
+					Mesh::ImportObj(sObjPath, *pData);
+
+					return [pMesh, pData]()
+						{
+							// Empty files or failed buffer creation leave nothing to draw either.
+							pMesh->Upload(*pData);
+							if (!pMesh->IsReady())
+							{
+								pMesh->MarkFailed();
+							}
+						};
+				},
+				// Entities stop waiting on the bounds of a mesh that is never going to arrive.
+				[pMesh]() { pMesh->MarkFailed(); });
+
+			return pMesh;
+		});
+}
+
+void AssetLoader::LoadTexture(std::shared_ptr<Material> a_pMaterial, unsigned int a_uRegister, const std::wstring& a_sFileName)
+{
+	a_pMaterial->SetTextureSRV(a_uRegister, GetPlaceholder(a_uRegister));
+
+	// The register decides how the texture is cooked, so it is part of what makes the texture unique.
+	TextureCookOptions options;
+	options.Usage = Utils::GetTextureUsage(a_uRegister);
+	unsigned int uOptions = TextureCooker::PackOptions(options);
+
+	// Loaded textures are bound right away and ones already in flight are simply waited on.
+	if (!ResourceRegistry::GetInstance()->RequestTexture(a_sFileName, uOptions, a_pMaterial, a_uRegister))
+	{
+		return;
+	}
+
+	std::wstring sFileName = a_sFileName;
+	Dispatch(ToLogString(sFileName), [sFileName, options, uOptions]()
+		{
+			std::shared_ptr<CookedTexture> pTexture = std::make_shared<CookedTexture>();
+			if (!Utils::LoadCookedTexture(sFileName, options, *pTexture))
+			{
+				// Letting go of the waiting materials so they keep their placeholders.
+				Logger::GetInstance()->Log("AssetLoader.cpp", "Failed to decode " + ToLogString(sFileName), INFO_LOG);
+				return std::function<void()>([sFileName, uOptions]()
+					{
+						ResourceRegistry::GetInstance()->ResolveTexture(sFileName, uOptions, nullptr);
+					});
+			}
+
+			return std::function<void()>([sFileName, uOptions, pTexture]()
+				{
+					ResourceRegistry::GetInstance()->ResolveTexture(sFileName, uOptions, Utils::CreateTexture(*pTexture));
+				});
+		});
+}
+
+void AssetLoader::LoadTextureSet(std::shared_ptr<Material> a_pMaterial, const std::wstring& a_sTextureName)
+{
+	LoadTexture(a_pMaterial, ALBEDO_REGISTER, Utils::GetTextureSetFile(a_sTextureName, ALBEDO_REGISTER));
+	LoadTexture(a_pMaterial, NORMAL_REGISTER, Utils::GetTextureSetFile(a_sTextureName, NORMAL_REGISTER));
+	LoadTexture(a_pMaterial, ROUGHNESS_REGISTER, Utils::GetTextureSetFile(a_sTextureName, ROUGHNESS_REGISTER));
+	LoadTexture(a_pMaterial, METAL_REGISTER, Utils::GetTextureSetFile(a_sTextureName, METAL_REGISTER));
+}
+
+std::shared_ptr<AnimatedEntity> AssetLoader::LoadAnimatedEntity(
+	const std::string& a_sFbxFile,
+	std::shared_ptr<Shader> a_pShader,
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> a_pSampler)
+{
+	std::shared_ptr<AnimatedEntity> pEntity = std::make_shared<AnimatedEntity>();
+
+	Dispatch(a_sFbxFile, [pEntity, a_sFbxFile, a_pShader, a_pSampler]()
+		{
+			std::shared_ptr<AnimatedModelData> pData =
+				std::make_shared<AnimatedModelData>(AnimatedEntity::Import(a_sFbxFile));
+
+			return [pEntity, pData, a_pShader, a_pSampler]()
+				{
+					pEntity->Upload(*pData, a_pShader, a_pSampler);
+				};
+		});
+
+	return pEntity;
+}
+
+void AssetLoader::LoadCubemap(
+	std::shared_ptr<Sky> a_pSky,
+	const std::wstring& right,
+	const std::wstring& left,
+	const std::wstring& up,
+	const std::wstring& down,
+	const std::wstring& front,
+	const std::wstring& back)
+{
+	std::vector<std::wstring> lFiles = { right, left, up, down, front, back };
+
+	Dispatch("Skybox " + ToLogString(right), [a_pSky, lFiles]()
+		{
+			std::shared_ptr<std::vector<CookedTexture>> pFaces = std::make_shared<std::vector<CookedTexture>>(lFiles.size());
+
+			// Skies are opaque and cover the whole screen, so the smaller BC1 is plenty.
+			TextureCookOptions options;
+			options.Fast = true;
+
+			// The faces are independent of each other, so they cook side by side.
+			std::atomic<bool> bFailed{ false };
+			ThreadPool::GetInstance()->ParallelFor((unsigned int)lFiles.size(), 1, [&](unsigned int a_uBegin, unsigned int a_uEnd)
+				{
+					for (unsigned int i = a_uBegin; i < a_uEnd; i++)
+					{
+						if (!Utils::LoadCookedTexture(lFiles[i], options, (*pFaces)[i]))
+						{
+							bFailed = true;
+						}
+					}
+				});
+
+			if (bFailed)
+			{
+				throw std::invalid_argument("Error decoding image: Invalid file path or unsupported format.");
+			}
+
+			return [a_pSky, pFaces]() { a_pSky->CreateCubemap(pFaces->data()); };
+		});
+}
+
+void AssetLoader::ProcessUploads(void)
+{
+	// Taking the finished work so the workers are never blocked on the uploads themselves.
+	std::vector<std::function<void()>> lUploads;
+	{
+		std::lock_guard<std::mutex> lock(m_UploadMutex);
+		lUploads.swap(m_lUploads);
+	}
+
+	if (lUploads.empty())
+	{
+		return;
+	}
+
+	for (std::function<void()>& upload : lUploads)
+	{
+		// Failed loads hand back nothing to run.
+		if (upload)
+		{
+			upload();
+		}
+		m_uPendingCount--;
+	}
+
+	if (m_uPendingCount == 0)
+	{
+		Logger::GetInstance()->Log("AssetLoader.cpp", "All pending assets have been loaded.", DEBUG_LOG);
+	}
+}
+
+unsigned int AssetLoader::GetPendingCount(void) const { return m_uPendingCount; }
+
+ShaderResourcePtr AssetLoader::GetPlaceholder(unsigned int a_uRegister)
+{
+	auto found = m_mPlaceholders.find(a_uRegister);
+	if (found != m_mPlaceholders.end())
+	{
+		return found->second;
+	}
+
+	// Neutral values so unloaded materials still shade sensibly:
+	// white albedo (the tint shows through), a flat normal, mid roughness and no metal.
+	ImageData image;
+	image.Width = 1;
+	image.Height = 1;
+	switch (a_uRegister)
+	{
+	case NORMAL_REGISTER: image.Pixels = { 128, 128, 255, 255 }; break;
+	case ROUGHNESS_REGISTER: image.Pixels = { 128, 128, 128, 255 }; break;
+	case METAL_REGISTER: image.Pixels = { 0, 0, 0, 255 }; break;
+	default: image.Pixels = { 255, 255, 255, 255 }; break;
+	}
+
+	ShaderResourcePtr pPlaceholder = Utils::CreateTexture(image);
+	m_mPlaceholders[a_uRegister] = pPlaceholder;
+	return pPlaceholder;
+}
+
+void AssetLoader::Dispatch(
+	const std::string& a_sAsset,
+	std::function<std::function<void()>()> a_Work,
+	std::function<void()> a_Failed)
+{
+	m_uPendingCount++;
+
+	ThreadPool::GetInstance()->Submit([this, a_sAsset, a_Work, a_Failed]()
+		{
+			std::function<void()> upload;
+			try
+			{
+				upload = a_Work();
+			}
+			catch (const std::exception& e)
+			{
+				Logger::GetInstance()->Log(
+					"AssetLoader.cpp",
+					"Failed to load " + a_sAsset + ": " + e.what(),
+					INFO_LOG);
+				upload = a_Failed;
+			}
+
+			// Failures are still handed back so that the pending count drains.
+			std::lock_guard<std::mutex> lock(m_UploadMutex);
+			m_lUploads.push_back(upload);
+		});
+}
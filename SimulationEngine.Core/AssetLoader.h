@@ -0,0 +1,125 @@
+#ifndef __ASSETLOADER_H_
+#define __ASSETLOADER_H_
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+
+#include "Mesh.h"
+#include "Material.h"
+#include "Sky.h"
+#include "AnimatedEntity.h"
+
+/// <summary>
+/// Loads assets in the background.  Every load returns a usable handle right away
+/// while the file reading, parsing and decoding happens on the ThreadPool.  Only the
+/// final buffer/texture creation is handed back to the device thread, which runs
+/// it whenever ProcessUploads is called.
+/// </summary>
+class AssetLoader
+{
+private:
+	static AssetLoader* m_pInstance;
+
+	// Device work finished by the workers, waiting for the device thread.
+	std::mutex m_UploadMutex;
+	std::vector<std::function<void()>> m_lUploads;
+
+	// Loads that have been started but not uploaded yet.
+	std::atomic<unsigned int> m_uPendingCount{ 0 };
+
+	// Maps a material register to the texture shown until the real one loads.
+	std::unordered_map<unsigned int, ShaderResourcePtr> m_mPlaceholders;
+
+public:
+	/// <summary>
+	/// Gets the single instance of the AssetLoader.
+	/// </summary>
+	static AssetLoader* GetInstance(void);
+
+	/// <summary>
+	/// Frees the AssetLoader singleton.  The ThreadPool must be released
+	/// first so that no worker is still handing work back to the loader.
+	/// </summary>
+	static void Release(void);
+
+	/// <summary>
+	/// Starts loading an obj file.  The returned Mesh draws nothing until it is uploaded,
+	/// and is marked as failed with empty bounds if the file cannot be loaded.
+	/// </summary>
+	std::shared_ptr<Mesh> LoadMesh(const std::string& a_sObjDirectory, const std::string& a_sObjName);
+
+	/// <summary>
+	/// Starts loading a texture into a register of the passed in material.
+	/// A placeholder texture is bound to that register until the load finishes.
+	/// </summary>
+	void LoadTexture(std::shared_ptr<Material> a_pMaterial, unsigned int a_uRegister, const std::wstring& a_sFileName);
+
+	/// <summary>
+	/// Starts loading the albedo, normal, roughness and metal textures of a texture set into a material.
+	/// </summary>
+	void LoadTextureSet(std::shared_ptr<Material> a_pMaterial, const std::wstring& a_sTextureName);
+
+	/// <summary>
+	/// Starts loading a model that can contain animations.
+	/// The returned AnimatedEntity draws nothing until it is uploaded.
+	/// </summary>
+	std::shared_ptr<AnimatedEntity> LoadAnimatedEntity(
+		const std::string& a_sFbxFile,
+		std::shared_ptr<Shader> a_pShader,
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> a_pSampler);
+
+	/// <summary>
+	/// Starts loading the six faces of a skybox's cube map.
+	/// </summary>
+	void LoadCubemap(
+		std::shared_ptr<Sky> a_pSky,
+		const std::wstring& right,
+		const std::wstring& left,
+		const std::wstring& up,
+		const std::wstring& down,
+		const std::wstring& front,
+		const std::wstring& back);
+
+	/// <summary>
+	/// Runs every upload that the workers have finished preparing.
+	/// Must be called from the thread that owns the device, once per frame.
+	/// </summary>
+	void ProcessUploads(void);
+
+	/// <summary>
+	/// Gets the amount of loads that have not been uploaded yet.
+	/// </summary>
+	unsigned int GetPendingCount(void) const;
+
+	/// <summary>
+	/// Gets the 1x1 texture shown in a material register while its real texture loads.
+	/// </summary>
+	ShaderResourcePtr GetPlaceholder(unsigned int a_uRegister);
+
+private:
+	AssetLoader(void) = default;
+	~AssetLoader(void) = default;
+
+	// Removing the copy constructor and operator.
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	/// <summary>
+	/// Runs a load on the ThreadPool.  The work function does all of the CPU side
+	/// processing and returns the device work that finishes the asset off.
+	/// Failed loads are logged and leave the asset in its placeholder state.
+	/// </summary>
+	/// <param name="a_sAsset">The name of the asset for logging.</param>
+	/// <param name="a_Failed">Device work run instead of the upload when the load fails, if any.</param>
+	void Dispatch(
+		const std::string& a_sAsset,
+		std::function<std::function<void()>()> a_Work,
+		std::function<void()> a_Failed = nullptr);
+};
+
+#endif //__ASSETLOADER_H_
@@ -2,6 +2,7 @@
 #define __CBUFFERMAPPER_H_
 
 #include "Graphics.h"
+#include "StateCache.h"
 
 #define MAIN_VERTEX_CBUFFER 0
 #define SKY_VERTEX_CBUFFER 1
@@ -26,11 +27,12 @@ class CBufferMapper
 private:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> m_pConstantBuffer = nullptr;
 	unsigned int m_uRegisterIndex;
+	ShaderType m_uTargetShader;
 
 	/// <summary>
 	/// Initializes the Constant Buffer pointer for later use.
 	/// </summary>
-	void InitBuffer(ShaderType a_uTargetShader)
+	void InitBuffer(void)
 	{
 		// Calculating the memory size in multiples of 
 		// 16 by taking advantage of int division.
@@ -48,14 +50,32 @@ private:
 
 		// Creating the buffer with the description struct.
 		Graphics::GetDevice()->CreateBuffer(&cbDesc, 0, m_pConstantBuffer.GetAddressOf());
+		Bind();
+	}
+
+public:
+	/// <summary>
+	/// Constructs and initializes the CBufferMapper.
+	/// </summary>
+	CBufferMapper(unsigned int a_uRegisterIndex, ShaderType a_uTargetShader = ShaderType::VertexShader)
+	{
+		m_uRegisterIndex = a_uRegisterIndex;
+		m_uTargetShader = a_uTargetShader;
+		InitBuffer();
+	}
 
+	/// <summary>
+	/// Binds the buffer to its register again.  Only needed when several buffers share the same register.
+	/// </summary>
+	void Bind(void)
+	{
 		// Creating the correct type of constant buffer.
-		switch (a_uTargetShader)
+		switch (m_uTargetShader)
 		{
 		case ShaderType::PixelShader:
 
 			// Binding the buffer to the correct register.
-			Graphics::GetContext()->PSSetConstantBuffers(
+			StateCache::GetInstance()->PSSetConstantBuffers(
 				m_uRegisterIndex,
 				1,
 				m_pConstantBuffer.GetAddressOf());
@@ -65,7 +85,7 @@ private:
 		case ShaderType::VertexShader:
 
 			// Binding the buffer to the b0 slot for use.
-			Graphics::GetContext()->VSSetConstantBuffers(
+			StateCache::GetInstance()->VSSetConstantBuffers(
 				m_uRegisterIndex,
 				1,
 				m_pConstantBuffer.GetAddressOf());
@@ -74,16 +94,6 @@ private:
 		}
 	}
 
-public:
-	/// <summary>
-	/// Constructs and initializes the CBufferMapper.
-	/// </summary>
-	CBufferMapper(unsigned int a_uRegisterIndex, ShaderType a_uTargetShader = ShaderType::VertexShader)
-	{
-		m_uRegisterIndex = a_uRegisterIndex;
-		InitBuffer(a_uTargetShader);
-	}
-
 	/// <summary>
 	/// Destructs instances of the CBufferMapper.
 	/// </summary>
@@ -103,6 +113,7 @@ public:
 		}
 
 		m_uRegisterIndex = other.m_uRegisterIndex;
+		m_uTargetShader = other.m_uTargetShader;
 		m_pConstantBuffer = other.m_pConstantBuffer;
 
 		return *this;
@@ -114,33 +125,34 @@ public:
 	CBufferMapper(const CBufferMapper& other)
 	{
 		m_uRegisterIndex = other.m_uRegisterIndex;
+		m_uTargetShader = other.m_uTargetShader;
 		m_pConstantBuffer = other.m_pConstantBuffer;
 	}
 
+	/// <summary>
+	/// Gets the buffer on the GPU.
+	/// </summary>
+	ID3D11Buffer* GetBuffer(void) const { return m_pConstantBuffer.Get(); }
+
+	/// <summary>
+	/// Gets the register the buffer is bound to.
+	/// </summary>
+	unsigned int GetRegisterIndex(void) const { return m_uRegisterIndex; }
+
+	/// <summary>
+	/// Gets the type of shader the buffer is bound to.
+	/// </summary>
+	ShaderType GetTargetShader(void) const { return m_uTargetShader; }
+
 	/// <summary>
 	/// Pulls out the memory address of the CBuffer
 	/// and maps the passed in data to the buffer.
 	/// </summary>
 	/// <param name="a_CBufferData">The data being passed to the CBuffer.</param>
-	void MapBufferData(T a_CBufferData)
+	void MapBufferData(const T& a_CBufferData)
 	{
-		// Creating a mapped subresource struct to hold the cbuffer GPU address.
-		D3D11_MAPPED_SUBRESOURCE mapped{};
-
-		// Actually grabbing the CBuffer's address.
-		Graphics::GetContext()->Map(
-			m_pConstantBuffer.Get(),
-			0,
-			D3D11_MAP_WRITE_DISCARD,
-			0,
-			&mapped
-		);
-
-		// Copying the data to the GPU.
-		memcpy(mapped.pData, &a_CBufferData, sizeof(T));
-
-		// Unmapping from the memory address.
-		Graphics::GetContext()->Unmap(m_pConstantBuffer.Get(), 0);
+		// Going through the state cache, which counts every byte sent to the GPU.
+		StateCache::GetInstance()->WriteBuffer(m_pConstantBuffer.Get(), &a_CBufferData, sizeof(T));
 	}
 };
 
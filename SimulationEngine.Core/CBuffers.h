@@ -2,16 +2,37 @@
 #define __CBUFFERS_H_
 
 #include "Vectors.h"
+#include "Lights.h"
+
+// The register the per-frame constants are bound to, in both the vertex and the pixel shader.
+#define FRAME_CBUFFER_REGISTER 5
 
 /// <summary>
-/// Constant Buffer vertex for entities in the sim world.
+/// Constant Buffer vertex for entities in the sim world.  Only holds what differs between
+/// entities, the camera comes from the FrameCBufferData.
 /// </summary>
 struct VertexCBufferData
 {
 	Matrix4 World;
 	Matrix4 WorldInvTranspose;
+};
+
+/// <summary>
+/// Constant Buffer holding everything shared by every draw of a frame, uploaded once per frame.
+/// Matches FrameConstants.hlsli.
+/// </summary>
+struct FrameCBufferData
+{
+	// 16 byte memory padding rules applied:
+	// - -
 	Matrix4 View;
+	// - -
 	Matrix4 Projection;
+	// - -
+	Vector3 CameraPosition;
+	float padding;
+	// - -
+	Light Lights[MAX_LIGHT_COUNT];
 };
 
 #endif //__CBUFFERS_H_
\ No newline at end of file
@@ -27,11 +27,36 @@ Matrix4 Camera::GetProjection()
 	return m_m4Projection;
 }
 
-Transform Camera::GetTransform()
+Transform& Camera::GetTransform()
 {
 	return m_tTransform;
 }
 
+const Vector4* Camera::GetFrustumPlanes() const
+{
+	return m_lFrustumPlanes;
+}
+
+Ray Camera::GetPickRay(float a_fX, float a_fY, float a_fWidth, float a_fHeight) const
+{
+	// Pixels go down the screen while clip space goes up.
+	float fClipX = a_fX / a_fWidth * 2.0f - 1.0f;
+	float fClipY = 1.0f - a_fY / a_fHeight * 2.0f;
+
+	// Taking the pixel back out of clip space on both the near and the far plane.
+	XMMatrix m4InverseViewProjection = XMMatrixInverse(nullptr, XMMatrixMultiply(
+		XMLoadFloat4x4(&m_m4View),
+		XMLoadFloat4x4(&m_m4Projection)));
+	XMVector vNear = XMVector3TransformCoord(XMVectorSet(fClipX, fClipY, 0.0f, 1.0f), m4InverseViewProjection);
+	XMVector vFar = XMVector3TransformCoord(XMVectorSet(fClipX, fClipY, 1.0f, 1.0f), m4InverseViewProjection);
+
+	Ray ray;
+	XMStoreFloat3(&ray.Origin, vNear);
+	XMStoreFloat3(&ray.Direction, XMVector3Normalize(vFar - vNear));
+	ray.MaxDistance = XMVectorGetX(XMVector3Length(vFar - vNear));
+	return ray;
+}
+
 void Camera::UpdateProjection(float a_fAspectRatio)
 {
 	// Creating the Projection matrix.
@@ -45,6 +70,8 @@ void Camera::UpdateProjection(float a_fAspectRatio)
 	XMStoreFloat4x4(
 		&m_m4Projection,
 		m4);
+
+	UpdateFrustum();
 }
 
 void Camera::UpdateView()
@@ -67,6 +94,33 @@ void Camera::UpdateView()
 	XMStoreFloat4x4(
 		&m_m4View,
 		m4);
+
+	UpdateFrustum();
+}
+
+void Camera::UpdateFrustum()
+{
+	// With row vectors the clip coordinates are dot products with the columns of view * projection,
+	// so transposing turns every column into a row that can be combined into a plane directly.
+	XMMatrix m4Columns = XMMatrixTranspose(XMMatrixMultiply(
+		XMLoadFloat4x4(&m_m4View),
+		XMLoadFloat4x4(&m_m4Projection)));
+
+	// -w <= x <= w, -w <= y <= w and 0 <= z <= w.
+	XMVector lPlanes[6] =
+	{
+		m4Columns.r[3] + m4Columns.r[0],
+		m4Columns.r[3] - m4Columns.r[0],
+		m4Columns.r[3] + m4Columns.r[1],
+		m4Columns.r[3] - m4Columns.r[1],
+		m4Columns.r[2],
+		m4Columns.r[3] - m4Columns.r[2]
+	};
+
+	for (unsigned int i = 0; i < 6; i++)
+	{
+		XMStoreFloat4(&m_lFrustumPlanes[i], XMPlaneNormalize(lPlanes[i]));
+	}
 }
 
 void Camera::UpdateMovement(float a_fDeltaTime)
@@ -1,6 +1,7 @@
 #ifndef __CAMERA_H_
 #define __CAMERA_H_
 
+#include "Ray.h"
 #include "Vectors.h"
 #include "Transform.h"
 
@@ -13,8 +14,11 @@ class Camera
 private:
 	float m_fFOV;
 	Transform m_tTransform;
-	Matrix4 m_m4View;
-	Matrix4 m_m4Projection;
+	Matrix4 m_m4View = {};
+	Matrix4 m_m4Projection = {};
+
+	// Left, right, bottom, top, near and far, in world space with the normals pointing inwards.
+	Vector4 m_lFrustumPlanes[6];
 
 public:
 	/// <summary>
@@ -38,7 +42,20 @@ public:
 	/// <summary>
 	/// Gets the Transform of the camera.
 	/// </summary>
-	Transform GetTransform(void);
+	Transform& GetTransform(void);
+
+	/// <summary>
+	/// Gets the six planes of the view frustum as (normal, distance), in world space with the
+	/// normals pointing inwards.  A point p is inside of a plane when dot(normal, p) + distance >= 0.
+	/// </summary>
+	const Vector4* GetFrustumPlanes(void) const;
+
+	/// <summary>
+	/// Gets the world space ray through a pixel of the window, from the near plane out to the far plane.
+	/// </summary>
+	/// <param name="a_fWidth">The window's width in pixels.</param>
+	/// <param name="a_fHeight">The window's height in pixels.</param>
+	Ray GetPickRay(float a_fX, float a_fY, float a_fWidth, float a_fHeight) const;
 
 	/// <summary>
 	/// Updates the projection matrix as needed.  Only needs to be done on window resizing.
@@ -56,6 +73,12 @@ public:
 	/// </summary>
 	/// <param name="a_fDeltaTime">The change in time between frames of the simulation.</param>
 	void UpdateMovement(float a_fDeltaTime);
+
+private:
+	/// <summary>
+	/// Extracts the frustum planes out of the view and projection matrices.
+	/// </summary>
+	void UpdateFrustum(void);
 };
 
 #endif //__CAMERA_H_
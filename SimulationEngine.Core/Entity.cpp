@@ -1,19 +1,73 @@
 #include "Entity.h"
 #include "SimulationUtils.h"
+#include "ResourceRegistry.h"
+#include "ThreadPool.h"
+#include "Logger.h"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "TinyObjLoader/tiny_obj_loader.h"
 
+#include <fstream>
+
 // Temp macro directory for testing this class.
 #define TEXTURE_DIRECTORY L"../SimulationEngine.Assets/TexturedModels/"
 
+namespace
+{
+	/// <summary>
+	/// A face of a tinyobj shape and where its corners go in the flat corner array.
+	/// </summary>
+	struct ObjFaceTarget
+	{
+		const tinyobj::index_t* Indices;
+		unsigned int Count;
+		unsigned int Target;
+	};
+
+	/// <summary>
+	/// Finds the mtl file an obj pulls its materials from.  Only the lines before the
+	/// first face or "usemtl" are read since the library has to be named before either.
+	/// </summary>
+	/// <returns>The path of the mtl file, or the obj file itself when it names none.</returns>
+	std::string FindMaterialLibrary(const std::string& a_sObjFile)
+	{
+		std::string sDirectory = a_sObjFile.substr(0, a_sObjFile.find_last_of("/\\") + 1);
+		std::ifstream file(a_sObjFile);
+		std::string sLine;
+		while (std::getline(file, sLine))
+		{
+			size_t uStart = sLine.find_first_not_of(" \t");
+			if (uStart == std::string::npos)
+			{
+				continue;
+			}
+
+			if (sLine.compare(uStart, 7, "mtllib ") == 0 || sLine.compare(uStart, 7, "mtllib\t") == 0)
+			{
+				size_t uName = sLine.find_first_not_of(" \t", uStart + 7);
+				size_t uEnd = sLine.find_last_not_of(" \t\r");
+				if (uName != std::string::npos && uEnd >= uName)
+				{
+					return sDirectory + sLine.substr(uName, uEnd - uName + 1);
+				}
+			}
+			else if (sLine.compare(uStart, 2, "f ") == 0 || sLine.compare(uStart, 6, "usemtl") == 0)
+			{
+				break;
+			}
+		}
+
+		return a_sObjFile;
+	}
+}
+
 Entity::Entity(std::shared_ptr<Mesh> a_pMesh, std::shared_ptr<Material> a_pMaterial)
 {
 	m_mSubEntities.insert({a_pMesh, a_pMaterial});
 	m_pTransform = std::make_shared<Transform>();
 }
 
-Entity::Entity(std::map<std::shared_ptr<Mesh>, std::shared_ptr<Material>> a_mSubEntities)
+Entity::Entity(SubEntityMap a_mSubEntities)
 {
 	m_mSubEntities = a_mSubEntities;
 	m_pTransform = std::make_shared<Transform>();
@@ -22,6 +76,18 @@ Entity::Entity(std::map<std::shared_ptr<Mesh>, std::shared_ptr<Material>> a_mSub
 Entity::Entity(std::shared_ptr<Shader> a_pShader, Microsoft::WRL::ComPtr<ID3D11SamplerState> a_pSampler, std::string a_sObjFile)
 {
 	m_pTransform = std::make_shared<Transform>();
+	m_mSubEntities = ResourceRegistry::GetInstance()->GetModel(a_sObjFile, a_pShader, a_pSampler, [&]()
+		{
+			return ImportObj(a_pShader, a_pSampler, a_sObjFile);
+		});
+}
+
+SubEntityMap Entity::ImportObj(std::shared_ptr<Shader> a_pShader, Microsoft::WRL::ComPtr<ID3D11SamplerState> a_pSampler, std::string a_sObjFile)
+{
+	SubEntityMap mSubEntities;
+
+	// Materials are shared by every obj that uses the same mtl file, material name, shader and sampler.
+	std::string sMaterialLibrary = FindMaterialLibrary(a_sObjFile);
 
 	// Parsing the obj/mtl files.
 	tinyobj::ObjReaderConfig config{};
@@ -44,131 +110,203 @@ Entity::Entity(std::shared_ptr<Shader> a_pShader, Microsoft::WRL::ComPtr<ID3D11S
 		// Saving the roughness from the loaded shininess value.
 		float roughness = 1.0f - min(mat.shininess / 1000.0f, 1.0f);
 
-		// Instantiating a blank material.
-		std::shared_ptr<Material> material = std::make_shared<Material>(a_pShader, colorTint, roughness);
+		std::shared_ptr<Material> pMaterial = ResourceRegistry::GetInstance()->GetMaterial(sMaterialLibrary, mat.name, a_pShader, a_pSampler, [&]()
+			{
+				// Instantiating a blank material.
+				std::shared_ptr<Material> material = std::make_shared<Material>(a_pShader, colorTint, roughness);
+				material->SetTranslucent(mat.dissolve < 1.0f);
 
-		// Saving specific textures if provided:
-		// Albedo textures.
-		if (!mat.diffuse_texname.empty())
-		{
-			std::wstring sTexturePath = Utils::SanitizeFileName(mat.diffuse_texname);
-			ShaderResourcePtr albedoTex = Utils::LoadTexture(TEXTURE_DIRECTORY + sTexturePath);
-			material->AddTexturesSRV(0, albedoTex);
-		}
-		// Normal textures.
-		if (!mat.normal_texname.empty())
-		{
-			std::wstring sTexturePath = Utils::SanitizeFileName(mat.normal_texname);
-			ShaderResourcePtr normalTex = Utils::LoadTexture(TEXTURE_DIRECTORY + sTexturePath);
-			material->AddTexturesSRV(1, normalTex);
-		}
-		// Roughness textures.
-		if (!mat.roughness_texname.empty())
-		{
-			std::wstring sTexturePath = Utils::SanitizeFileName(mat.roughness_texname);
-			ShaderResourcePtr roughTex = Utils::LoadTexture(TEXTURE_DIRECTORY + sTexturePath);
-			material->AddTexturesSRV(2, roughTex);
-		}
-		// Metallic textures.
-		if (!mat.metallic_texname.empty())
-		{
-			std::wstring sTexturePath = Utils::SanitizeFileName(mat.metallic_texname);
-			ShaderResourcePtr metalTex = Utils::LoadTexture(TEXTURE_DIRECTORY + sTexturePath);
-			material->AddTexturesSRV(3, metalTex);
-		}
+				// Saving specific textures if provided:
+				// Albedo textures.
+				if (!mat.diffuse_texname.empty())
+				{
+					std::wstring sTexturePath = Utils::SanitizeFileName(mat.diffuse_texname);
+					ShaderResourcePtr albedoTex = Utils::LoadTexture(TEXTURE_DIRECTORY + sTexturePath, ALBEDO_REGISTER);
+					material->AddTexturesSRV(ALBEDO_REGISTER, albedoTex);
+				}
+				// Normal textures.
+				if (!mat.normal_texname.empty())
+				{
+					std::wstring sTexturePath = Utils::SanitizeFileName(mat.normal_texname);
+					ShaderResourcePtr normalTex = Utils::LoadTexture(TEXTURE_DIRECTORY + sTexturePath, NORMAL_REGISTER);
+					material->AddTexturesSRV(NORMAL_REGISTER, normalTex);
+				}
+				// Roughness textures.
+				if (!mat.roughness_texname.empty())
+				{
+					std::wstring sTexturePath = Utils::SanitizeFileName(mat.roughness_texname);
+					ShaderResourcePtr roughTex = Utils::LoadTexture(TEXTURE_DIRECTORY + sTexturePath, ROUGHNESS_REGISTER);
+					material->AddTexturesSRV(ROUGHNESS_REGISTER, roughTex);
+				}
+				// Metallic textures.
+				if (!mat.metallic_texname.empty())
+				{
+					std::wstring sTexturePath = Utils::SanitizeFileName(mat.metallic_texname);
+					ShaderResourcePtr metalTex = Utils::LoadTexture(TEXTURE_DIRECTORY + sTexturePath, METAL_REGISTER);
+					material->AddTexturesSRV(METAL_REGISTER, metalTex);
+				}
+
+				// Adding the base sampler to the material.
+				material->AddSampler(0, a_pSampler);
 
-		// Adding the base sampler to the material.
-		material->AddSampler(0, a_pSampler);
+				return material;
+			});
 
 		// Adding the new material to this Mesh's collection of materials.
-		lMeshMaterials.push_back(material);
+		lMeshMaterials.push_back(pMaterial);
 	}
 
-	// Collecting all of the submesh data together.
-	std::map<int, SubMesh> mMeshData;
 	const tinyobj::attrib_t& attrib = reader.GetAttrib();
 	const std::vector<tinyobj::shape_t>& lShapes = reader.GetShapes();
+	unsigned int uMaterialCount = (unsigned int)lMeshMaterials.size();
 
-	// For every shape in the loaded collection:
+	// Counting how many face corners every material ends up with.
+	std::vector<unsigned int> lCornerCounts(uMaterialCount, 0);
+	unsigned int uFaceCount = 0;
+	unsigned int uSkippedFaces = 0;
 	for (const auto& shape : lShapes)
 	{
-		int nIndexOffset = 0;
-
-		// For every face in the loaded collection:
-		for (int f = 0; f < shape.mesh.num_face_vertices.size(); f++)
+		for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++)
 		{
 			int nMaterialId = shape.mesh.material_ids[f];
-
-			// If this material hasn't been seen before, create a new entry with this material.
-			if (mMeshData.find(nMaterialId) == mMeshData.end())
+			if (nMaterialId < 0 || nMaterialId >= (int)uMaterialCount)
 			{
-				SubMesh subset;
-				subset.Material = lMeshMaterials[nMaterialId];
-				mMeshData[nMaterialId] = subset;
+				uSkippedFaces++;
+				continue;
 			}
 
+			lCornerCounts[nMaterialId] += shape.mesh.num_face_vertices[f];
+			uFaceCount++;
+		}
+	}
+
+	if (uSkippedFaces > 0)
+	{
+		Logger::GetInstance()->Log(
+			"Entity.cpp",
+			"Skipped " + std::to_string(uSkippedFaces) + " faces without a material in " + a_sObjFile,
+			INFO_LOG);
+	}
+
+	// Every material's corners live back to back in one flat array, starting at its prefix sum.
+	std::vector<unsigned int> lMaterialOffsets(uMaterialCount + 1, 0);
+	for (unsigned int m = 0; m < uMaterialCount; m++)
+	{
+		lMaterialOffsets[m + 1] = lMaterialOffsets[m] + lCornerCounts[m];
+	}
+
+	// Handing every face the spot its corners are written to.
+	std::vector<ObjFaceTarget> lFaces;
+	lFaces.reserve(uFaceCount);
+	std::vector<unsigned int> lCursors(lMaterialOffsets.begin(), lMaterialOffsets.end() - 1);
+	for (const auto& shape : lShapes)
+	{
+		unsigned int uIndexOffset = 0;
+		for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++)
+		{
+			int nMaterialId = shape.mesh.material_ids[f];
 			unsigned int uVertexFaceCount = shape.mesh.num_face_vertices[f];
-			SubMesh& subset = mMeshData[nMaterialId];
+			if (nMaterialId >= 0 && nMaterialId < (int)uMaterialCount)
+			{
+				ObjFaceTarget face;
+				face.Indices = &shape.mesh.indices[uIndexOffset];
+				face.Count = uVertexFaceCount;
+				face.Target = lCursors[nMaterialId];
+				lFaces.push_back(face);
+				lCursors[nMaterialId] += uVertexFaceCount;
+			}
 
-			// For each vertex in the face:
-			for (int v = uVertexFaceCount - 1; v >= 0; v--)
+			uIndexOffset += uVertexFaceCount;
+		}
+	}
+
+	// Filling in the corners across the workers, every face writes to its own range.
+	std::vector<Vertex> lCorners(lMaterialOffsets[uMaterialCount]);
+	ThreadPool::GetInstance()->ParallelFor(uFaceCount, 4096, [&](unsigned int a_uBegin, unsigned int a_uEnd)
+		{
+			for (unsigned int f = a_uBegin; f < a_uEnd; f++)
 			{
-				Vertex vertex{};
-				tinyobj::index_t index = shape.mesh.indices[nIndexOffset + v];
+				const ObjFaceTarget& face = lFaces[f];
 
-				// Vertex Positions:
-				if (index.vertex_index >= 0)
+				// Walking the face backwards to flip its winding order.
+				for (unsigned int v = 0; v < face.Count; v++)
 				{
-					vertex.Position.x = attrib.vertices[3 * index.vertex_index + 0];
-					vertex.Position.y = attrib.vertices[3 * index.vertex_index + 1];
-					vertex.Position.z = attrib.vertices[3 * index.vertex_index + 2] * -1.0f;
+					Vertex& vertex = lCorners[face.Target + v];
+					vertex = Vertex{};
+					tinyobj::index_t index = face.Indices[face.Count - 1 - v];
+
+					// Vertex Positions:
+					if (index.vertex_index >= 0)
+					{
+						vertex.Position.x = attrib.vertices[3 * index.vertex_index + 0];
+						vertex.Position.y = attrib.vertices[3 * index.vertex_index + 1];
+						vertex.Position.z = attrib.vertices[3 * index.vertex_index + 2] * -1.0f;
+					}
+
+					// Vertex Normals:
+					if (index.normal_index >= 0)
+					{
+						vertex.Normal.x = attrib.normals[3 * index.normal_index + 0];
+						vertex.Normal.y = attrib.normals[3 * index.normal_index + 1];
+						vertex.Normal.z = attrib.normals[3 * index.normal_index + 2] * -1.0f;
+					}
+
+					// Vertex UVs:
+					if (index.texcoord_index >= 0)
+					{
+						vertex.UV.x = attrib.texcoords[2 * index.texcoord_index + 0];
+						vertex.UV.y = 1.0f - attrib.texcoords[2 * index.texcoord_index + 1];
+					}
 				}
+			}
+		});
 
-				// Vertex Normals:
-				if (index.normal_index >= 0)
+	// Welding, generating tangents and optimizing every material's submesh on the workers.
+	std::vector<PackedMesh> lPacked(uMaterialCount);
+	std::vector<std::shared_ptr<TriangleBVH>> lTriangles(uMaterialCount);
+	ThreadPool::GetInstance()->ParallelFor(uMaterialCount, 1, [&](unsigned int a_uBegin, unsigned int a_uEnd)
+		{
+			for (unsigned int m = a_uBegin; m < a_uEnd; m++)
+			{
+				if (lCornerCounts[m] == 0)
 				{
-					vertex.Normal.x = attrib.normals[3 * index.normal_index + 0];
-					vertex.Normal.y = attrib.normals[3 * index.normal_index + 1];
-					vertex.Normal.z = attrib.normals[3 * index.normal_index + 2] * -1.0f;
+					continue;
 				}
 
-				// Vertex UVs:
-				if (index.texcoord_index >= 0)
+				std::vector<Vertex> lVertices(
+					lCorners.begin() + lMaterialOffsets[m],
+					lCorners.begin() + lMaterialOffsets[m + 1]);
+				std::vector<unsigned int> lIndices(lVertices.size());
+				for (unsigned int i = 0; i < (unsigned int)lIndices.size(); i++)
 				{
-					vertex.UV.x = attrib.texcoords[2 * index.texcoord_index + 0];
-					vertex.UV.y = 1.0f - attrib.texcoords[2 * index.texcoord_index + 1];
+					lIndices[i] = i;
 				}
 
-				// Tangents will be computed but the existing Mesh object.
-				vertex.Tangent = Vector3{ 0.0f, 0.0f, 0.0f };
+				// Sharing the vertices between faces of this submesh.
+				Mesh::WeldVertices(lVertices, lIndices);
 
-				// Adding the Vertex and setting the index.
-				subset.Vertices.push_back(vertex);
-				subset.Indices.push_back((unsigned int)subset.Vertices.size() - 1);
+				// Inverted tangents, optimized since imported models tend to be large.
+				Mesh::Prepare(lVertices, lIndices, TangentType::Inverted, lPacked[m]);
+				lTriangles[m] = TriangleBVH::Create(lPacked[m]);
 			}
+		});
 
-			nIndexOffset += uVertexFaceCount;
-		}
-	}
-
-	// Creating the actual Meshes and their DirectX buffer objects.
-	for (auto& submesh : mMeshData)
+	// Only creating the DirectX buffers happens one mesh at a time.
+	for (unsigned int m = 0; m < uMaterialCount; m++)
 	{
-		VertexPack VertexPack{};
-		IndexPack indexPack{};
-
-		// Initializing the Vertex and Index packs.
-		VertexPack.Vertices = &submesh.second.Vertices[0];
-		VertexPack.VertexCount = (int)submesh.second.Vertices.size();
-		indexPack.Indices = &submesh.second.Indices[0];
-		indexPack.IndexCount = (int)submesh.second.Indices.size();
+		if (lCornerCounts[m] == 0)
+		{
+			continue;
+		}
 
-		// Creating the mesh with inverted tangents.
-		std::shared_ptr<Mesh> pNewMesh = std::make_shared<Mesh>(VertexPack, indexPack, TangentType::Inverted);
+		std::shared_ptr<Mesh> pNewMesh = std::make_shared<Mesh>();
+		pNewMesh->Upload(lPacked[m], lTriangles[m]);
 
-		// Assigning the Mesh to its correct material.1
-		m_mSubEntities[pNewMesh] = submesh.second.Material;
+		// Assigning the Mesh to its correct material.
+		mSubEntities[pNewMesh] = lMeshMaterials[m];
 	}
+
+	return mSubEntities;
 }
 
 Entity::~Entity()
@@ -181,6 +319,10 @@ Entity& Entity::operator=(const Entity& a_eOther)
 	m_pTransform = a_eOther.m_pTransform;
 	m_mSubEntities = a_eOther.m_mSubEntities;
 
+	// Forcing an upload on the next draw, the cached data belonged to the old transform.
+	m_pVertexCBuffer.reset();
+	m_bBoundsValid = false;
+
 	return *this;
 }
 
@@ -195,6 +337,11 @@ std::shared_ptr<Transform> Entity::GetTransform(void)
 	return m_pTransform;
 }
 
+void Entity::Attach(std::shared_ptr<Transform> a_pChild)
+{
+	a_pChild->SetParent(m_pTransform.get());
+}
+
 std::vector<std::shared_ptr<Mesh>> Entity::GetMeshes(void)
 {
 	std::vector<std::shared_ptr<Mesh>> lMesh;
@@ -217,32 +364,116 @@ std::vector<std::shared_ptr<Material>> Entity::GetMaterials(void)
 	return lMaterial;
 }
 
-void Entity::Draw(
-	std::shared_ptr<CBufferMapper<VertexCBufferData>> a_pVertexCBufferMapper,
-	std::shared_ptr<CBufferMapper<MaterialCBufferData>> a_pPixelCBufferMapper,
-	std::shared_ptr<Camera> a_pCamera,
-	Light a_Lights[MAX_LIGHT_COUNT])
+const CullBounds& Entity::GetWorldBounds(void)
 {
-	// Setting constant buffer data.
-	VertexCBufferData cbuffer{};
-	cbuffer.World = m_pTransform->GetWorld();
-	cbuffer.WorldInvTranspose = m_pTransform->GetWorldInvTra();
-	cbuffer.View = a_pCamera->GetView();
-	cbuffer.Projection = a_pCamera->GetProjection();
+	uint32_t uGeneration = m_pTransform->GetGeneration();
+	if (m_bBoundsValid && uGeneration == m_uBoundsGeneration)
+	{
+		return m_WorldBounds;
+	}
 
-	// Sending constant buffer data to GPU.
-	a_pVertexCBufferMapper->MapBufferData(cbuffer);
+	// Meshes still uploading have no bounds yet, so the box is kept up to date until they are all in.
+	// Meshes that failed to load are never coming in, so their empty bounds are final.
+	bool bReady = true;
+	Vector3 v3Min = Vector3(0.0f, 0.0f, 0.0f);
+	Vector3 v3Max = Vector3(0.0f, 0.0f, 0.0f);
+	for (auto it = m_mSubEntities.begin(); it != m_mSubEntities.end(); it++)
+	{
+		bReady = bReady && (it->first->IsReady() || it->first->IsFailed());
+		if (it == m_mSubEntities.begin())
+		{
+			v3Min = it->first->GetBoundsMin();
+			v3Max = it->first->GetBoundsMax();
+			continue;
+		}
+
+		FrustumCuller::Merge(v3Min, v3Max, it->first->GetBoundsMin(), it->first->GetBoundsMax());
+	}
+
+	m_WorldBounds = FrustumCuller::TransformBounds(v3Min, v3Max, m_pTransform->GetWorld());
+	m_uBoundsGeneration = uGeneration;
+	m_bBoundsValid = bReady;
+	return m_WorldBounds;
+}
+
+bool Entity::Raycast(const Ray& a_Ray, RayHit& a_Hit, bool a_bAnyHit) const
+{
+	// Casting in object space instead of moving every triangle into the world.
+	Matrix4 m4World = m_pTransform->GetWorld();
+	XMMatrix m4InverseWorld = DirectX::XMMatrixInverse(nullptr, DirectX::XMLoadFloat4x4(&m4World));
+	Vector3 v3Origin;
+	Vector3 v3Direction;
+	TriangleBVH::ToObjectSpace(a_Ray, m4InverseWorld, v3Origin, v3Direction);
+
+	bool bHit = false;
+	for (auto it = m_mSubEntities.begin(); it != m_mSubEntities.end(); it++)
+	{
+		// Meshes still loading have nothing to hit yet.
+		std::shared_ptr<TriangleBVH> pTriangles = it->first->GetTriangles();
+		if (pTriangles == nullptr || !pTriangles->Raycast(v3Origin, v3Direction, a_Hit, a_bAnyHit))
+		{
+			continue;
+		}
+
+		bHit = true;
+		if (a_bAnyHit)
+		{
+			break;
+		}
+	}
+
+	if (bHit)
+	{
+		TriangleBVH::ToWorldSpace(a_Ray, m4InverseWorld, a_Hit);
+	}
+	return bHit;
+}
+
+void Entity::Submit(SceneRenderer& a_Renderer, std::shared_ptr<Camera> a_pCamera)
+{
+	bool bUpload = false;
+	if (m_pVertexCBuffer == nullptr)
+	{
+		m_pVertexCBuffer = std::make_shared<CBufferMapper<VertexCBufferData>>(DEFAULT_REGISTER, ShaderType::VertexShader);
+		bUpload = true;
+	}
+
+	// Static entities keep what is already on the GPU, the camera lives in the renderer's frame constants.
+	// Only asking for the matrices when they are needed, so unchanged transforms are never recalculated.
+	uint32_t uGeneration = m_pTransform->GetGeneration();
+	if (bUpload || uGeneration != m_uTransformGeneration)
+	{
+		m_CBufferData.World = m_pTransform->GetWorld();
+		m_CBufferData.WorldInvTranspose = m_pTransform->GetWorldInvTra();
+		m_uTransformGeneration = uGeneration;
+
+		// Sending constant buffer data to GPU.
+		m_pVertexCBuffer->MapBufferData(m_CBufferData);
+	}
+
+	// Every entity has its own buffer in the same register, bound by the renderer right before its draws.
+	// Entities sharing a mesh and material are drawn as instances instead, out of the copy of the constants.
+	uint32_t uObject = a_Renderer.AddObject(*m_pVertexCBuffer, m_CBufferData);
+	float fDepth = a_Renderer.GetDepth(GetWorldBounds().Center);
 
 	for (auto& submesh : m_mSubEntities)
 	{
-		// Applying materials.
-		submesh.second->PrepMaterialForDraw(
-			a_pPixelCBufferMapper,
-			a_pCamera->GetTransform().GetPosition(),
-			a_Lights
-		);
+		// Nothing to draw until the mesh finished loading, and nothing to draw it with without a shader.
+		const std::shared_ptr<Material>& pMaterial = submesh.second;
+		std::shared_ptr<Shader> pShader = pMaterial->GetShader();
+		if (!submesh.first->IsReady() || pShader == nullptr)
+		{
+			continue;
+		}
 
-		// Rendering the mesh.
-		submesh.first->Draw();
+		a_Renderer.Submit(
+			pMaterial->IsTranslucent() ? RenderLayer::Translucent : RenderLayer::Opaque,
+			a_Renderer.GetShaderId(pShader.get()),
+			a_Renderer.GetMaterialId(pMaterial.get()),
+			a_Renderer.GetMeshId(submesh.first.get()),
+			uObject,
+			// Drawing the mesh at the detail its size on screen calls for.
+			submesh.first->SelectLod(m_CBufferData.World, a_pCamera),
+			fDepth);
 	}
 }
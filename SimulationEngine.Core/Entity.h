@@ -10,18 +10,13 @@
 #include "Transform.h"
 #include "Camera.h"
 #include "CBuffers.h"
+#include "FrustumCuller.h"
+#include "SceneRenderer.h"
 
 #define DEFAULT_REGISTER 0
 
-/// <summary>
-/// Pairs a collection of vertices and indices with a material.
-/// </summary>
-struct SubMesh
-{
-	std::vector<Vertex> Vertices;
-	std::vector<unsigned int> Indices;
-	std::shared_ptr<Material> Material;
-};
+// Every mesh of an entity paired with the material it is drawn with.
+typedef std::map<std::shared_ptr<Mesh>, std::shared_ptr<Material>> SubEntityMap;
 
 /// <summary>
 /// Container for Meshes, Materials and Transforms.  Defines a true object in the simulation.
@@ -29,9 +24,20 @@ struct SubMesh
 class Entity
 {
 private:
-	std::map<std::shared_ptr<Mesh>, std::shared_ptr<Material>> m_mSubEntities;
+	SubEntityMap m_mSubEntities;
 	std::shared_ptr<Transform> m_pTransform = nullptr;
 
+	// The Entity's own vertex CBuffer and what was last uploaded to it, so it is only
+	// re-uploaded once the transform actually changed.
+	std::shared_ptr<CBufferMapper<VertexCBufferData>> m_pVertexCBuffer = nullptr;
+	VertexCBufferData m_CBufferData{};
+	uint32_t m_uTransformGeneration = 0;
+
+	// The world space box around every mesh, only recomputed once the transform changed.
+	CullBounds m_WorldBounds;
+	uint32_t m_uBoundsGeneration = 0;
+	bool m_bBoundsValid = false;
+
 public:
 	/// <summary>
 	/// Most basic constructor for the Entity class.
@@ -42,8 +48,12 @@ public:
 	/// <summary>
 	/// Contructs the Entity with the collection of mesh and materials.
 	/// </summary>
-	Entity(std::map<std::shared_ptr<Mesh>, std::shared_ptr<Material>> a_mSubEntities);
+	Entity(SubEntityMap a_mSubEntities);
 
+	/// <summary>
+	/// Loads an obj file along with its mtl materials and textures.  Every file is only
+	/// read once, later entities of the same file share its meshes and materials.
+	/// </summary>
 	Entity(
 		std::shared_ptr<Shader> a_pShader,
 		Microsoft::WRL::ComPtr<ID3D11SamplerState> a_pSampler,
@@ -69,6 +79,11 @@ public:
 	/// </summary>
 	std::shared_ptr<Transform> GetTransform(void);
 
+	/// <summary>
+	/// Attaches another transform (a child entity's, an outliner's) to this Entity, so it follows it around.
+	/// </summary>
+	void Attach(std::shared_ptr<Transform> a_pChild);
+
 	/// <summary>
 	/// Gets a reference to the Entity's mesh.
 	/// </summary>
@@ -80,13 +95,32 @@ public:
 	std::vector<std::shared_ptr<Material>> GetMaterials(void);
 
 	/// <summary>
-	/// Renders the Entity to the simulation window.
+	/// Gets the world space box around every mesh of this Entity.
+	/// </summary>
+	const CullBounds& GetWorldBounds(void);
+
+	/// <summary>
+	/// Casts a world space ray against the triangles of every mesh.
+	/// Only reads, so any amount of threads can cast at once while nothing moves.
+	/// </summary>
+	/// <param name="a_Hit">Its distance is the furthest a hit counts.  Filled in when a closer hit was found.</param>
+	/// <param name="a_bAnyHit">Stops at the first hit instead of looking for the closest one.</param>
+	/// <returns>Whether a closer hit was found.</returns>
+	bool Raycast(const Ray& a_Ray, RayHit& a_Hit, bool a_bAnyHit = false) const;
+
+	/// <summary>
+	/// Uploads the Entity's constants and submits a draw for every mesh that is ready.
+	/// </summary>
+	void Submit(SceneRenderer& a_Renderer, std::shared_ptr<Camera> a_pCamera);
+
+private:
+	/// <summary>
+	/// Parses an obj/mtl pair with tinyobj and builds a mesh for every material used.
 	/// </summary>
-	void Draw(
-		std::shared_ptr<CBufferMapper<VertexCBufferData>> a_pVertexCBufferMapper,
-		std::shared_ptr<CBufferMapper<MaterialCBufferData>> a_pPixelCBufferMapper,
-		std::shared_ptr<Camera> a_pCamera,
-		Light a_Lights[MAX_LIGHT_COUNT] = {});
+	static SubEntityMap ImportObj(
+		std::shared_ptr<Shader> a_pShader,
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> a_pSampler,
+		std::string a_sObjFile);
 };
 
 #endif //__ENTITY_H_
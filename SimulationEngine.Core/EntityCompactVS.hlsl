@@ -0,0 +1,3 @@
+// EntityVS reading the CompactVertex layout instead of the full precision one.
+#define COMPACT_VERTEX
+#include "EntityVS.hlsl"
@@ -0,0 +1,4 @@
+// EntityInstancedVS reading the CompactVertex layout instead of the full precision one.
+#define COMPACT_VERTEX
+#define INSTANCED_VERTEX
+#include "EntityVS.hlsl"
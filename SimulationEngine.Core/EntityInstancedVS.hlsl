@@ -0,0 +1,3 @@
+// EntityVS reading its world matrices per instance instead of from a constant buffer.
+#define INSTANCED_VERTEX
+#include "EntityVS.hlsl"
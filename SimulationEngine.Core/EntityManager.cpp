@@ -1,14 +1,12 @@
 #include "EntityManager.h"
+#include "ThreadPool.h"
+#include "TransformPool.h"
+
+#include <cstring>
+#include <algorithm>
 
 EntityManager::EntityManager()
 {
-	// Creating the CBuffer mappers.
-	m_pVertexCBufferMapper = std::make_shared<CBufferMapper<VertexCBufferData>>(
-		DEFAULT_REGISTER,
-		ShaderType::VertexShader);
-	m_pPixelCBufferMapper = std::make_shared<CBufferMapper<MaterialCBufferData>>(
-		DEFAULT_REGISTER,
-		ShaderType::PixelShader);
 }
 
 EntityManager::~EntityManager(void)
@@ -22,12 +20,8 @@ EntityManager& EntityManager::operator=(const EntityManager& a_emOther)
 		m_Lights[i] = a_emOther.m_Lights[i];
 	}
 
-	m_pVertexCBufferMapper.reset();
-	m_pPixelCBufferMapper.reset();
-
-	m_pVertexCBufferMapper = a_emOther.m_pVertexCBufferMapper;
-	m_pPixelCBufferMapper = a_emOther.m_pPixelCBufferMapper;
 	m_lEntities = a_emOther.m_lEntities;
+	m_bBVHDirty = true;
 
 	return *this;
 }
@@ -39,8 +33,6 @@ EntityManager::EntityManager(const EntityManager& a_emOther)
 		m_Lights[i] = a_emOther.m_Lights[i];
 	}
 
-	m_pVertexCBufferMapper = a_emOther.m_pVertexCBufferMapper;
-	m_pPixelCBufferMapper = a_emOther.m_pPixelCBufferMapper;
 	m_lEntities = a_emOther.m_lEntities;
 }
 
@@ -57,14 +49,31 @@ void EntityManager::AddEntity(std::shared_ptr<Mesh> a_pMesh, std::shared_ptr<Mat
 
 	// Adding the new entity to the vector of Entities.
 	m_lEntities.push_back(entity);
+	m_bBVHDirty = true;
 }
 
 void EntityManager::AddEntity(std::shared_ptr<Entity> a_pEntity)
 {
 	m_lEntities.push_back(a_pEntity);
+	m_bBVHDirty = true;
+}
+
+void EntityManager::RemoveEntity(std::shared_ptr<Entity> a_pEntity)
+{
+	auto found = std::find(m_lEntities.begin(), m_lEntities.end(), a_pEntity);
+	if (found == m_lEntities.end())
+	{
+		return;
+	}
+
+	// Keeping the order, the hierarchy is rebuilt over the new indices anyway.
+	// That has to happen now, ray casts before the next Submit would otherwise index past the end.
+	m_lEntities.erase(found);
+	m_bBVHDirty = true;
+	UpdateBVH();
 }
 
-EntityPtrCollection& EntityManager::GetEntities(void)
+const EntityPtrCollection& EntityManager::GetEntities(void) const
 {
 	return m_lEntities;
 }
@@ -74,24 +83,107 @@ Light* EntityManager::GetLights(void)
 	return &m_Lights[0];
 }
 
-std::shared_ptr<CBufferMapper<VertexCBufferData>> EntityManager::GetVertexCBufferMapper()
+CullStats EntityManager::GetCullStats(void) const
+{
+	return m_CullStats;
+}
+
+const SceneBVH& EntityManager::GetBVH(void) const
+{
+	return m_BVH;
+}
+
+bool EntityManager::Raycast(const Ray& a_Ray, RayHit& a_Hit) const
 {
-	return m_pVertexCBufferMapper;
+	a_Hit = RayHit();
+	a_Hit.Distance = a_Ray.MaxDistance;
+
+	// The hierarchy hands out entities closest box first, and every hit shortens how far the rest is searched.
+	m_BVH.QueryRay(a_Ray.Origin, a_Ray.Direction, a_Ray.MaxDistance, [&](unsigned int a_uObject, float a_fMaxDistance)
+		{
+			if (m_lEntities[a_uObject]->Raycast(a_Ray, a_Hit))
+			{
+				a_Hit.Entity = a_uObject;
+			}
+			return a_Hit.Distance;
+		});
+
+	return a_Hit.Hit;
 }
 
-std::shared_ptr<CBufferMapper<MaterialCBufferData>> EntityManager::GetPixelCBufferMapper()
+bool EntityManager::IsOccluded(const Ray& a_Ray) const
 {
-	return m_pPixelCBufferMapper;
+	bool bOccluded = false;
+	m_BVH.QueryRay(a_Ray.Origin, a_Ray.Direction, a_Ray.MaxDistance, [&](unsigned int a_uObject, float a_fMaxDistance)
+		{
+			RayHit hit;
+			hit.Distance = a_fMaxDistance;
+			bOccluded = m_lEntities[a_uObject]->Raycast(a_Ray, hit, true);
+
+			// Stopping the whole walk at the first hit.
+			return bOccluded ? -1.0f : a_fMaxDistance;
+		});
+
+	return bOccluded;
 }
 
-void EntityManager::Draw(std::shared_ptr<Camera> a_pCamera)
+void EntityManager::Raycast(const Ray* a_pRays, unsigned int a_uCount, RayHit* a_pHits) const
 {
-	for (UINT i = 0; i < m_lEntities.size(); i++)
+	// Transforms moved since the last update would otherwise be resolved, and written, by several workers at once.
+	TransformPool::GetInstance()->Update();
+
+	ThreadPool::GetInstance()->ParallelFor(a_uCount, RAYCAST_MIN_BATCH, [&](unsigned int a_uBegin, unsigned int a_uEnd)
+		{
+			for (unsigned int i = a_uBegin; i < a_uEnd; i++)
+			{
+				Raycast(a_pRays[i], a_pHits[i]);
+			}
+		});
+}
+
+void EntityManager::UpdateBVH(void)
+{
+	// Entities were added or removed, so the whole hierarchy has to be rebuilt anyway.
+	unsigned int uCount = (unsigned int)m_lEntities.size();
+	bool bRebuild = m_bBVHDirty;
+	m_bBVHDirty = false;
+	m_lBounds.resize(uCount);
+
+	// The boxes of unmoved entities are cached by the entities, so this is a cheap pass over the scene.
+	for (unsigned int i = 0; i < uCount; i++)
+	{
+		const CullBounds& bounds = m_lEntities[i]->GetWorldBounds();
+		if (std::memcmp(&bounds, &m_lBounds[i], sizeof(CullBounds)) == 0)
+		{
+			continue;
+		}
+
+		m_lBounds[i] = bounds;
+		if (!bRebuild)
+		{
+			m_BVH.Refit(i, bounds);
+		}
+	}
+
+	if (bRebuild || m_BVH.NeedsRebuild())
+	{
+		m_BVH.Build(m_lBounds.data(), uCount);
+	}
+}
+
+void EntityManager::Submit(SceneRenderer& a_Renderer, std::shared_ptr<Camera> a_pCamera)
+{
+	// Culling against the frustum first, whole subtrees of the hierarchy are rejected or accepted at once.
+	UpdateBVH();
+	m_BVH.QueryFrustum(a_pCamera->GetFrustumPlanes(), m_lVisible);
+	m_CullStats.Visible = (unsigned int)m_lVisible.size();
+	m_CullStats.Culled = (unsigned int)m_lEntities.size() - m_CullStats.Visible;
+
+	// The hierarchy hands entities out in its own order, submitting them in the order they were added keeps ties consistent between frames.
+	std::sort(m_lVisible.begin(), m_lVisible.end());
+
+	for (unsigned int i : m_lVisible)
 	{
-		m_lEntities[i]->Draw(
-			m_pVertexCBufferMapper,
-			m_pPixelCBufferMapper,
-			a_pCamera,
-			m_Lights);
+		m_lEntities[i]->Submit(a_Renderer, a_pCamera);
 	}
 }
@@ -5,10 +5,14 @@
 
 #include "Lights.h"
 #include "Entity.h"
+#include "SceneBVH.h"
 #include "CBufferMapper.h"
 
 typedef std::vector<std::shared_ptr<Entity>> EntityPtrCollection;
 
+// The smallest amount of rays worth handing to a worker in a batched cast.
+#define RAYCAST_MIN_BATCH 64
+
 /// <summary>
 /// Properly manages the index for Lights in the simulation.
 /// </summary>
@@ -30,8 +34,20 @@ private:
 	Light m_Lights[MAX_LIGHT_COUNT] = {};
 	EntityPtrCollection m_lEntities;
 
-	std::shared_ptr<CBufferMapper<VertexCBufferData>> m_pVertexCBufferMapper = nullptr;
-	std::shared_ptr<CBufferMapper<MaterialCBufferData>> m_pPixelCBufferMapper = nullptr;
+	// The hierarchy over every entity's world box, refitted as entities move.
+	SceneBVH m_BVH;
+	// The boxes the hierarchy was last fitted to, one per entity.
+	std::vector<CullBounds> m_lBounds;
+	// Set whenever entities are added or removed, since the hierarchy's objects are indices into m_lEntities.
+	bool m_bBVHDirty = true;
+	std::vector<unsigned int> m_lVisible;
+	CullStats m_CullStats;
+
+	/// <summary>
+	/// Brings the hierarchy up to date with the entities, refitting the ones that moved
+	/// and rebuilding it when entities were added or removed or refitting degraded it too far.
+	/// </summary>
+	void UpdateBVH(void);
 
 public:
 	/// <summary>
@@ -70,9 +86,15 @@ public:
 	void AddEntity(std::shared_ptr<Entity> a_pEntity);
 
 	/// <summary>
-	/// Gets the collection of Entities.
+	/// Removes an entity from the manager.  Does nothing if it was never added.
+	/// The hierarchy is rebuilt right away, since queries index into the entities with it.
 	/// </summary>
-	EntityPtrCollection& GetEntities(void);
+	void RemoveEntity(std::shared_ptr<Entity> a_pEntity);
+
+	/// <summary>
+	/// Gets the collection of Entities.  Entities are only added and removed through the manager.
+	/// </summary>
+	const EntityPtrCollection& GetEntities(void) const;
 
 	/// <summary>
 	/// Gets the lights in the simulation.
@@ -80,20 +102,41 @@ public:
 	Light* GetLights(void);
 
 	/// <summary>
-	/// Gets the CBuffer mapper used for vertex shader data.
+	/// Gets how many Entities the last Submit culled.
 	/// </summary>
-	std::shared_ptr<CBufferMapper<VertexCBufferData>> GetVertexCBufferMapper(void);
-	
+	CullStats GetCullStats(void) const;
+
+	/// <summary>
+	/// Gets the hierarchy over the Entities, as of the last Submit.  Its objects are indices into GetEntities.
+	/// </summary>
+	const SceneBVH& GetBVH(void) const;
+
+	/// <summary>
+	/// Finds the closest triangle of the Entities a ray hits.  Uses the hierarchy as of the last Submit,
+	/// so only entities it knows about can be hit.
+	/// </summary>
+	/// <param name="a_Hit">Filled in with the closest hit, its entity being an index into GetEntities.</param>
+	/// <returns>Whether anything was hit before the ray's max distance.</returns>
+	bool Raycast(const Ray& a_Ray, RayHit& a_Hit) const;
+
+	/// <summary>
+	/// Checks whether anything blocks a ray before its max distance.  Cheaper than Raycast,
+	/// since it stops at the first triangle hit instead of looking for the closest one.
+	/// </summary>
+	bool IsOccluded(const Ray& a_Ray) const;
+
 	/// <summary>
-	/// Gets the CBuffer mapper used for pixel shader data.
+	/// Casts many rays at once, split across the worker threads.  Main thread only, since every
+	/// transform is brought up to date first so the workers only read.  Transforms must not change until it returns.
 	/// </summary>
-	std::shared_ptr<CBufferMapper<MaterialCBufferData>> GetPixelCBufferMapper(void);
+	/// <param name="a_pHits">Filled in with one hit per ray.</param>
+	void Raycast(const Ray* a_pRays, unsigned int a_uCount, RayHit* a_pHits) const;
 
 	/// <summary>
-	/// Renders the Entities of the EntityManager.
+	/// Submits a draw for every Entity of the EntityManager that is inside of the camera's frustum.
 	/// </summary>
 	/// <param name="a_pCamera">Provided primarily for View and Projection matrices.</param>
-	void Draw(std::shared_ptr<Camera> a_pCamera);
+	void Submit(SceneRenderer& a_Renderer, std::shared_ptr<Camera> a_pCamera);
 };
 
 #endif //__ENTITYMANAGER_H_
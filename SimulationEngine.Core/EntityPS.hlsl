@@ -1,5 +1,5 @@
 #include "VertexToPixel.hlsli"
-#include "Lighting.hlsli"
+#include "FrameConstants.hlsli"
 #include "PhysicsTextureRender.hlsli"
 
 Texture2D Albedo : register(t0);
@@ -9,18 +9,13 @@ Texture2D Metal : register(t3);
 
 SamplerState Sampler : register(s0);
 
-cbuffer ExternalData : register(b0)
+cbuffer MaterialData : register(b1)
 {
     // 16 byte memory padding rules applied:
     // - -
     float2 Offset;
     float2 Scale;
     // - -
-    float3 CameraPosition;
-    float padding;
-    // - -
-    Light Lights[MAX_LIGHT_COUNT];
-    // - -
     float4 Color;
 }
 
@@ -33,7 +28,9 @@ float4 main( VertexToPixel input ) : SV_TARGET
     float3 albedoColor = pow(Albedo.Sample(Sampler, input.uv * Scale + Offset).xyz, 2.2f);
     
     // unpacking the normal map and setting its value.
-    float3 unpackedNormal = Normal.Sample(Sampler, input.uv * Scale + Offset).rgb * 2 - 1;
+    // Cooked normal maps only store X and Y (BC5), so Z is rebuilt from the unit length.
+    float2 normalXY = Normal.Sample(Sampler, input.uv * Scale + Offset).rg * 2 - 1;
+    float3 unpackedNormal = float3(normalXY, sqrt(saturate(1 - dot(normalXY, normalXY))));
     unpackedNormal = normalize(unpackedNormal);
     float3 N = normalize(input.normal);
     float3 T = normalize(input.tangent);
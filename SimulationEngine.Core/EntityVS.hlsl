@@ -1,5 +1,23 @@
 #include "VertexToPixel.hlsli"
 #include "VertexInput.hlsli"
+#include "FrameConstants.hlsli"
+
+#ifdef INSTANCED_VERTEX
+
+// The same matrices as ExternalData, read per instance from INSTANCE_VERTEX_SLOT instead.
+// Left column major like the constant buffer, so the same bytes read as the same matrices.
+struct InstanceInput
+{
+    float4x4 world : WORLD;
+    float4x4 worldInvTranspose : WORLDINVTRANSPOSE;
+};
+
+VertexToPixel main(RawVertexShaderInput raw, InstanceInput instance)
+{
+    matrix world = instance.world;
+    matrix worldInvTranspose = instance.worldInvTranspose;
+
+#else
 
 cbuffer ExternalData : register(b0)
 {
@@ -7,14 +25,14 @@ cbuffer ExternalData : register(b0)
     matrix world;
 	// - -
     matrix worldInvTranspose;
-	// - -
-    matrix view;
-	// - -
-    matrix projection;
 }
 
-VertexToPixel main( VertexShaderInput input )
+VertexToPixel main(RawVertexShaderInput raw)
 {
+
+#endif //INSTANCED_VERTEX
+
+    VertexShaderInput input = DecodeVertexInput(raw);
     VertexToPixel output;
     
     matrix wvp = mul(projection, mul(view, world));
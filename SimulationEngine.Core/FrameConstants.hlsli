@@ -0,0 +1,21 @@
+#ifndef __FRAMECONSTANTS_H_
+#define __FRAMECONSTANTS_H_
+
+#include "Lighting.hlsli"
+
+// Uploaded once per frame and bound to both the vertex and the pixel shader.
+cbuffer FrameData : register(b5)
+{
+    // 16 byte memory padding rules applied:
+    // - -
+    matrix view;
+    // - -
+    matrix projection;
+    // - -
+    float3 CameraPosition;
+    float framePadding;
+    // - -
+    Light Lights[MAX_LIGHT_COUNT];
+}
+
+#endif //__FRAMECONSTANTS_H_
\ No newline at end of file
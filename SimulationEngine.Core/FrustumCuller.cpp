@@ -0,0 +1,137 @@
+#include "FrustumCuller.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+CullBounds FrustumCuller::TransformBounds(const Vector3& a_v3Min, const Vector3& a_v3Max, const Matrix4& a_m4World)
+{
+	XMVector vMin = XMLoadFloat3(&a_v3Min);
+	XMVector vMax = XMLoadFloat3(&a_v3Max);
+	XMVector vHalf = XMVectorReplicate(0.5f);
+	XMVector vCenter = (vMin + vMax) * vHalf;
+	XMVector vExtents = (vMax - vMin) * vHalf;
+
+	// Every world axis reaches as far as the absolute rotated and scaled extents add up to.
+	XMMatrix m4World = XMLoadFloat4x4(&a_m4World);
+	XMVector vWorldExtents =
+		XMVectorAbs(m4World.r[0]) * XMVectorSplatX(vExtents) +
+		XMVectorAbs(m4World.r[1]) * XMVectorSplatY(vExtents) +
+		XMVectorAbs(m4World.r[2]) * XMVectorSplatZ(vExtents);
+
+	CullBounds result;
+	XMStoreFloat3(&result.Center, XMVector3TransformCoord(vCenter, m4World));
+	XMStoreFloat3(&result.Extents, vWorldExtents);
+	return result;
+}
+
+void FrustumCuller::Merge(Vector3& a_v3Min, Vector3& a_v3Max, const Vector3& a_v3OtherMin, const Vector3& a_v3OtherMax)
+{
+	XMStoreFloat3(&a_v3Min, XMVectorMin(XMLoadFloat3(&a_v3Min), XMLoadFloat3(&a_v3OtherMin)));
+	XMStoreFloat3(&a_v3Max, XMVectorMax(XMLoadFloat3(&a_v3Max), XMLoadFloat3(&a_v3OtherMax)));
+}
+
+CullResult FrustumCuller::Classify(const Vector4* a_pPlanes, const CullBounds& a_Bounds)
+{
+	CullResult result = CullResult::Inside;
+	for (unsigned int p = 0; p < 6; p++)
+	{
+		const Vector4& v4Plane = a_pPlanes[p];
+		float fDistance =
+			v4Plane.x * a_Bounds.Center.x +
+			v4Plane.y * a_Bounds.Center.y +
+			v4Plane.z * a_Bounds.Center.z +
+			v4Plane.w;
+		float fReach =
+			fabsf(v4Plane.x) * a_Bounds.Extents.x +
+			fabsf(v4Plane.y) * a_Bounds.Extents.y +
+			fabsf(v4Plane.z) * a_Bounds.Extents.z;
+
+		if (fDistance + fReach < 0.0f)
+		{
+			return CullResult::Outside;
+		}
+		if (fDistance - fReach < 0.0f)
+		{
+			result = CullResult::Intersecting;
+		}
+	}
+
+	return result;
+}
+
+CullStats FrustumCuller::Cull(
+	const Vector4* a_pPlanes,
+	const CullBounds* a_pBounds,
+	unsigned int a_uCount,
+	std::vector<unsigned int>& a_lVisible)
+{
+	a_lVisible.clear();
+
+	// Splatting every plane once up front, so the loop below is nothing but multiply-adds.
+	XMVector lPlaneX[6], lPlaneY[6], lPlaneZ[6], lPlaneW[6];
+	XMVector lAbsX[6], lAbsY[6], lAbsZ[6];
+	for (unsigned int p = 0; p < 6; p++)
+	{
+		XMVector vPlane = XMLoadFloat4(&a_pPlanes[p]);
+		lPlaneX[p] = XMVectorSplatX(vPlane);
+		lPlaneY[p] = XMVectorSplatY(vPlane);
+		lPlaneZ[p] = XMVectorSplatZ(vPlane);
+		lPlaneW[p] = XMVectorSplatW(vPlane);
+		lAbsX[p] = XMVectorAbs(lPlaneX[p]);
+		lAbsY[p] = XMVectorAbs(lPlaneY[p]);
+		lAbsZ[p] = XMVectorAbs(lPlaneZ[p]);
+	}
+
+	XMVector vZero = XMVectorZero();
+	for (unsigned int i = 0; i < a_uCount; i += 4)
+	{
+		// A short batch repeats its last box, only the real ones are read back.
+		unsigned int uLast = a_uCount - 1;
+		const CullBounds& b0 = a_pBounds[i];
+		const CullBounds& b1 = a_pBounds[std::min(i + 1, uLast)];
+		const CullBounds& b2 = a_pBounds[std::min(i + 2, uLast)];
+		const CullBounds& b3 = a_pBounds[std::min(i + 3, uLast)];
+
+		// Transposing so that every vector holds one axis of all four boxes.
+		XMMatrix centers = XMMatrixTranspose(XMMatrix(
+			XMLoadFloat3(&b0.Center),
+			XMLoadFloat3(&b1.Center),
+			XMLoadFloat3(&b2.Center),
+			XMLoadFloat3(&b3.Center)));
+		XMMatrix extents = XMMatrixTranspose(XMMatrix(
+			XMLoadFloat3(&b0.Extents),
+			XMLoadFloat3(&b1.Extents),
+			XMLoadFloat3(&b2.Extents),
+			XMLoadFloat3(&b3.Extents)));
+
+		// A box is behind a plane when even its corner furthest along the normal is.
+		XMVector vOutside = XMVectorFalseInt();
+		for (unsigned int p = 0; p < 6; p++)
+		{
+			XMVector vDistance = XMVectorMultiplyAdd(centers.r[0], lPlaneX[p],
+				XMVectorMultiplyAdd(centers.r[1], lPlaneY[p],
+				XMVectorMultiplyAdd(centers.r[2], lPlaneZ[p], lPlaneW[p])));
+			XMVector vReach = XMVectorMultiplyAdd(extents.r[0], lAbsX[p],
+				XMVectorMultiplyAdd(extents.r[1], lAbsY[p], extents.r[2] * lAbsZ[p]));
+			vOutside = XMVectorOrInt(vOutside, XMVectorLess(vDistance + vReach, vZero));
+		}
+
+		uint32_t lOutside[4];
+		XMStoreInt4(lOutside, vOutside);
+		unsigned int uCount = std::min(4u, a_uCount - i);
+		for (unsigned int j = 0; j < uCount; j++)
+		{
+			if (lOutside[j] == 0)
+			{
+				a_lVisible.push_back(i + j);
+			}
+		}
+	}
+
+	CullStats stats;
+	stats.Visible = (unsigned int)a_lVisible.size();
+	stats.Culled = a_uCount - stats.Visible;
+	return stats;
+}
@@ -0,0 +1,74 @@
+#ifndef __FRUSTUMCULLER_H_
+#define __FRUSTUMCULLER_H_
+
+#include <vector>
+
+#include "Vectors.h"
+
+/// <summary>
+/// A world space box, kept as its center and half its size so a plane test is a single dot product.
+/// </summary>
+struct CullBounds
+{
+	Vector3 Center = Vector3(0.0f, 0.0f, 0.0f);
+	Vector3 Extents = Vector3(0.0f, 0.0f, 0.0f);
+};
+
+/// <summary>
+/// Where a box lies relative to a frustum.
+/// </summary>
+enum class CullResult
+{
+	Outside,
+	Intersecting,
+	Inside
+};
+
+/// <summary>
+/// How many objects the last culling pass let through.
+/// </summary>
+struct CullStats
+{
+	unsigned int Visible = 0;
+	unsigned int Culled = 0;
+};
+
+/// <summary>
+/// Tests world space boxes against the planes of a view frustum.  Boxes are tested four at a
+/// time, with every plane checked against all four of them in a handful of SIMD instructions.
+/// A box is only culled when it is completely behind one of the planes, so boxes near the
+/// corners of the frustum are sometimes let through.  Nothing in here touches the device.
+/// </summary>
+class FrustumCuller
+{
+public:
+	/// <summary>
+	/// Moves an object space box into world space.  The result is the box around the transformed box.
+	/// </summary>
+	static CullBounds TransformBounds(const Vector3& a_v3Min, const Vector3& a_v3Max, const Matrix4& a_m4World);
+
+	/// <summary>
+	/// Grows a box to also fit another one.
+	/// </summary>
+	static void Merge(Vector3& a_v3Min, Vector3& a_v3Max, const Vector3& a_v3OtherMin, const Vector3& a_v3OtherMax);
+
+	/// <summary>
+	/// Tests a single box against the frustum, telling apart boxes that are completely inside of it.
+	/// </summary>
+	/// <param name="a_pPlanes">The six frustum planes, as handed out by the Camera.</param>
+	static CullResult Classify(const Vector4* a_pPlanes, const CullBounds& a_Bounds);
+
+	/// <summary>
+	/// Finds every box that is at least partially inside of the frustum.
+	/// </summary>
+	/// <param name="a_pPlanes">The six frustum planes, as handed out by the Camera.</param>
+	/// <param name="a_lVisible">Filled with the indices of the visible boxes, in order.</param>
+	/// <returns>How many boxes were visible and how many were culled.</returns>
+	static CullStats Cull(
+		const Vector4* a_pPlanes,
+		const CullBounds* a_pBounds,
+		unsigned int a_uCount,
+		std::vector<unsigned int>& a_lVisible);
+};
+
+#endif //__FRUSTUMCULLER_H_
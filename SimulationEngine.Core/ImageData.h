@@ -0,0 +1,17 @@
+#ifndef __IMAGEDATA_H_
+#define __IMAGEDATA_H_
+
+#include <vector>
+
+/// <summary>
+/// A decoded image held in system memory, ready to be uploaded as a texture.
+/// Pixels are always stored as tightly packed 8 bit RGBA.
+/// </summary>
+struct ImageData
+{
+	unsigned int Width = 0;
+	unsigned int Height = 0;
+	std::vector<unsigned char> Pixels;
+};
+
+#endif //__IMAGEDATA_H_
@@ -9,12 +9,11 @@ LineManager::LineManager()
 		L"LinePS.cso",
 		ShaderTopology::LineList
 	);
-	m_pCBufferMapper = std::make_shared<CBufferMapper<LineCBufferData>>(LINE_VERTEX_CBUFFER);
 }
 
 LineManager::~LineManager()
 {
-	m_pCBufferMapper.reset();
+	m_lCBufferMappers.clear();
 	m_pShader.reset();
 	m_mOutliners.clear();
 }
@@ -39,26 +38,26 @@ void LineManager::Release(void)
 
 LineManager& LineManager::operator=(const LineManager& a_Other)
 {
-	m_pCBufferMapper.reset();
+	m_lCBufferMappers.clear();
 	m_pShader.reset();
 	m_mOutliners.clear();
 
 	m_pShader = a_Other.m_pShader;
 	m_mOutliners = a_Other.m_mOutliners;
-	m_pCBufferMapper = a_Other.m_pCBufferMapper;
+	m_lCBufferMappers = a_Other.m_lCBufferMappers;
 
 	return *this;
 }
 
 LineManager::LineManager(const LineManager& a_Other)
 {
-	m_pCBufferMapper.reset();
+	m_lCBufferMappers.clear();
 	m_pShader.reset();
 	m_mOutliners.clear();
 
 	m_pShader = a_Other.m_pShader;
 	m_mOutliners = a_Other.m_mOutliners;
-	m_pCBufferMapper = a_Other.m_pCBufferMapper;
+	m_lCBufferMappers = a_Other.m_lCBufferMappers;
 }
 
 void LineManager::AddOutliner(std::shared_ptr<Mesh> a_pMesh, std::shared_ptr<Outliner> a_pOutliner)
@@ -72,22 +71,36 @@ void LineManager::AddOutliner(std::shared_ptr<Mesh> a_pMesh, std::shared_ptr<Out
 	m_mOutliners.insert({ a_pMesh, a_pOutliner });
 }
 
-void LineManager::Draw(std::shared_ptr<Camera> a_pCamera, Vector4 a_v4Color)
+void LineManager::Submit(SceneRenderer& a_Renderer, std::shared_ptr<Camera> a_pCamera, Vector4 a_v4Color)
 {
-	// Setting the line shader.
-	m_pShader->SetShader(); 
+	uint32_t uShader = a_Renderer.GetShaderId(m_pShader.get());
+	unsigned int uOutliner = 0;
 	for (const auto& kvp : m_mOutliners)
 	{
+		// Every outliner needs its own buffer, since all of them are uploaded before any is drawn.
+		if (uOutliner == m_lCBufferMappers.size())
+		{
+			m_lCBufferMappers.push_back(std::make_shared<CBufferMapper<LineCBufferData>>(LINE_VERTEX_CBUFFER));
+		}
+		std::shared_ptr<CBufferMapper<LineCBufferData>> pCBufferMapper = m_lCBufferMappers[uOutliner++];
+
 		// Setting the constant buffer values.
 		LineCBufferData cbuffer{};
 		cbuffer.World = kvp.second->GetTransform()->GetWorld();
 		cbuffer.View = a_pCamera->GetView();
 		cbuffer.Projection = a_pCamera->GetProjection();
 		cbuffer.Color = a_v4Color;
-		m_pCBufferMapper->MapBufferData(cbuffer);
-
-		// Rendering the lines.
-		kvp.second->Draw();
+		pCBufferMapper->MapBufferData(cbuffer);
+
+		// Lines have no material, only a color.
+		a_Renderer.Submit(
+			RenderLayer::Opaque,
+			uShader,
+			RENDER_NO_MATERIAL,
+			a_Renderer.GetMeshId(kvp.second.get()),
+			a_Renderer.AddObject(*pCBufferMapper),
+			0,
+			a_Renderer.GetDepth(kvp.second->GetTransform()->GetPosition()));
 	}
 }
 
@@ -6,8 +6,10 @@
 #include "Outliner.h"
 #include "Camera.h"
 #include "Mesh.h"
+#include "SceneRenderer.h"
 
 #include <map>
+#include <vector>
 
 /// <summary>
 /// Manages lines rendered throughout the simulation.
@@ -16,7 +18,8 @@ class LineManager
 {
 private:
 	static LineManager* m_pInstance;
-	std::shared_ptr<CBufferMapper<LineCBufferData>> m_pCBufferMapper = nullptr;
+	// One buffer per outliner, grown as outliners are added.
+	std::vector<std::shared_ptr<CBufferMapper<LineCBufferData>>> m_lCBufferMappers;
 	std::map<std::shared_ptr<Mesh>, std::shared_ptr<Outliner>> m_mOutliners;
 	std::shared_ptr<Shader> m_pShader = nullptr;
 
@@ -37,9 +40,9 @@ public:
 	void AddOutliner(std::shared_ptr<Mesh> a_pMesh, std::shared_ptr<Outliner> a_pOutliner);
 
 	/// <summary>
-	/// Renders all Outliners.
+	/// Submits a draw for every Outliner.
 	/// </summary>
-	void Draw(std::shared_ptr<Camera> a_pCamera, Vector4 a_v4Color);
+	void Submit(SceneRenderer& a_Renderer, std::shared_ptr<Camera> a_pCamera, Vector4 a_v4Color);
 
 	/// <summary>
 	/// Get Accessor for the collection of Outliners.
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <time.h>
+#include <mutex>
 
 Logger* Logger::m_pInstance = nullptr;
 
@@ -17,6 +18,10 @@ Logger* Logger::GetInstance()
 
 void Logger::Log(std::string a_sFile, std::string a_sMessage, unsigned int a_uLogFlag)
 {
+	// Worker threads log too, so lines are written one at a time.
+	static std::mutex s_Mutex;
+	std::lock_guard<std::mutex> lock(s_Mutex);
+
 	if (a_uLogFlag == DEBUG_LOG)
 	{
 		std::cout << "<DEBUG> ";
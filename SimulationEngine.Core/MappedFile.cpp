@@ -0,0 +1,184 @@
+#include "MappedFile.h"
+
+#include <fstream>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile(void) { }
+
+MappedFile::MappedFile(const std::string& a_sFilePath)
+{
+	Open(a_sFilePath);
+}
+
+MappedFile::~MappedFile(void)
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& a_sFilePath)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE hFile = CreateFileA(
+		a_sFilePath.c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	// Empty files cannot be mapped.
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(hFile, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+
+	HANDLE hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (hMapping == nullptr)
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+
+	void* pView = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (pView == nullptr)
+	{
+		CloseHandle(hMapping);
+		CloseHandle(hFile);
+		return false;
+	}
+
+	m_hFile = hFile;
+	m_hMapping = hMapping;
+	m_pData = static_cast<const unsigned char*>(pView);
+	m_uSize = static_cast<size_t>(size.QuadPart);
+#else
+	int nFile = open(a_sFilePath.c_str(), O_RDONLY);
+	if (nFile < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStat{};
+	if (fstat(nFile, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close(nFile);
+		return false;
+	}
+
+	void* pView = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, nFile, 0);
+
+	// The mapping keeps its own reference to the file.
+	close(nFile);
+	if (pView == MAP_FAILED)
+	{
+		return false;
+	}
+
+	// Same hint as FILE_FLAG_SEQUENTIAL_SCAN, files are almost always read front to back.
+	madvise(pView, static_cast<size_t>(fileStat.st_size), MADV_SEQUENTIAL);
+
+	m_pData = static_cast<const unsigned char*>(pView);
+	m_uSize = static_cast<size_t>(fileStat.st_size);
+#endif
+
+	return true;
+}
+
+void MappedFile::Close(void)
+{
+	if (m_pData == nullptr)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(m_pData);
+	CloseHandle(m_hMapping);
+	CloseHandle(m_hFile);
+	m_hMapping = nullptr;
+	m_hFile = nullptr;
+#else
+	munmap(const_cast<unsigned char*>(m_pData), m_uSize);
+#endif
+
+	m_pData = nullptr;
+	m_uSize = 0;
+}
+
+bool MappedFile::IsOpen(void) const { return m_pData != nullptr; }
+const unsigned char* MappedFile::GetData(void) const { return m_pData; }
+size_t MappedFile::GetSize(void) const { return m_uSize; }
+
+uint64_t MappedFile::HashContents(void) const
+{
+	return Hash(m_pData, m_uSize);
+}
+
+uint64_t MappedFile::Hash(const void* a_pData, size_t a_uSize, uint64_t a_uSeed)
+{
+	const uint64_t uPrime = 1099511628211ull;
+	const unsigned char* pBytes = static_cast<const unsigned char*>(a_pData);
+
+	uint64_t uHash = a_uSeed;
+	for (size_t i = 0; i < a_uSize; i++)
+	{
+		uHash ^= pBytes[i];
+		uHash *= uPrime;
+	}
+
+	return uHash;
+}
+
+bool MappedFile::GetFileStamp(const std::string& a_sFilePath, uint64_t& a_uSize, uint64_t& a_uWriteTime)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA attributes{};
+	if (!GetFileAttributesExA(a_sFilePath.c_str(), GetFileExInfoStandard, &attributes))
+	{
+		return false;
+	}
+
+	a_uSize = ((uint64_t)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+	a_uWriteTime = ((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+#else
+	struct stat fileStat{};
+	if (stat(a_sFilePath.c_str(), &fileStat) != 0)
+	{
+		return false;
+	}
+
+	a_uSize = static_cast<uint64_t>(fileStat.st_size);
+	a_uWriteTime = static_cast<uint64_t>(fileStat.st_mtime);
+#endif
+
+	return true;
+}
+
+bool MappedFile::WriteToDisk(const std::string& a_sFilePath, const void* a_pData, size_t a_uSize)
+{
+	std::ofstream file(a_sFilePath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	file.write(static_cast<const char*>(a_pData), static_cast<std::streamsize>(a_uSize));
+	return file.good();
+}
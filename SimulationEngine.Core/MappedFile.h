@@ -0,0 +1,90 @@
+#ifndef __MAPPEDFILE_H_
+#define __MAPPEDFILE_H_
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+/// <summary>
+/// Read-only memory mapping of a file on disk.  The mapped bytes can be handed
+/// directly to the GPU or a parser without copying them into a separate buffer.
+/// </summary>
+class MappedFile
+{
+private:
+	const unsigned char* m_pData = nullptr;
+	size_t m_uSize = 0;
+
+#ifdef _WIN32
+	void* m_hFile = nullptr;
+	void* m_hMapping = nullptr;
+#endif
+
+public:
+	/// <summary>
+	/// Constructs an empty (unmapped) MappedFile.
+	/// </summary>
+	MappedFile(void);
+
+	/// <summary>
+	/// Constructs the MappedFile and immediately maps the passed in file.
+	/// </summary>
+	MappedFile(const std::string& a_sFilePath);
+
+	/// <summary>
+	/// Unmaps the file if one is mapped.
+	/// </summary>
+	~MappedFile(void);
+
+	// Mappings own OS handles so they cannot be copied.
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/// <summary>
+	/// Maps the passed in file.  Returns false if the file could not be opened or is empty.
+	/// </summary>
+	bool Open(const std::string& a_sFilePath);
+
+	/// <summary>
+	/// Unmaps the currently mapped file.
+	/// </summary>
+	void Close(void);
+
+	/// <summary>
+	/// Whether or not a file is currently mapped.
+	/// </summary>
+	bool IsOpen(void) const;
+
+	/// <summary>
+	/// Gets the first byte of the mapped file.
+	/// </summary>
+	const unsigned char* GetData(void) const;
+
+	/// <summary>
+	/// Gets the size of the mapped file in bytes.
+	/// </summary>
+	size_t GetSize(void) const;
+
+	/// <summary>
+	/// Hashes the entire contents of the mapped file.
+	/// </summary>
+	uint64_t HashContents(void) const;
+
+	/// <summary>
+	/// 64 bit FNV-1a hash of a block of memory.
+	/// </summary>
+	static uint64_t Hash(const void* a_pData, size_t a_uSize, uint64_t a_uSeed = 14695981039346656037ull);
+
+	/// <summary>
+	/// Reads the size and last write time of a file without touching its contents.
+	/// </summary>
+	/// <returns>False if the file does not exist.</returns>
+	static bool GetFileStamp(const std::string& a_sFilePath, uint64_t& a_uSize, uint64_t& a_uWriteTime);
+
+	/// <summary>
+	/// Writes a block of memory out to a file, replacing whatever was there before.
+	/// </summary>
+	static bool WriteToDisk(const std::string& a_sFilePath, const void* a_pData, size_t a_uSize);
+};
+
+#endif //__MAPPEDFILE_H_
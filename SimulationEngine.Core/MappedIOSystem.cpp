@@ -0,0 +1,281 @@
+#include "MappedIOSystem.h"
+#include "ResourceRegistry.h"
+
+#include <mutex>
+#include <cstring>
+#include <algorithm>
+
+// Files inside of an archive are aligned so that their mapped data can be read directly.
+#define MAPPED_ARCHIVE_ALIGNMENT 16
+
+namespace
+{
+	/// <summary>
+	/// A read-only Assimp stream over a mapped view.
+	/// </summary>
+	class MappedIOStream : public Assimp::IOStream
+	{
+	private:
+		MappedView m_View;
+		size_t m_uPosition = 0;
+
+	public:
+		MappedIOStream(const MappedView& a_View) : m_View(a_View) { }
+
+		size_t Read(void* a_pBuffer, size_t a_uSize, size_t a_uCount) override
+		{
+			if (a_uSize == 0)
+			{
+				return 0;
+			}
+
+			// Only whole elements are read, just like fread.
+			size_t uCount = std::min(a_uCount, (m_View.Size - m_uPosition) / a_uSize);
+			std::memcpy(a_pBuffer, m_View.Data + m_uPosition, uCount * a_uSize);
+			m_uPosition += uCount * a_uSize;
+			return uCount;
+		}
+
+		size_t Write(const void* a_pBuffer, size_t a_uSize, size_t a_uCount) override
+		{
+			return 0;
+		}
+
+		aiReturn Seek(size_t a_uOffset, aiOrigin a_Origin) override
+		{
+			// The offset from the end is passed in as a positive distance.
+			size_t uBase = a_Origin == aiOrigin_CUR ? m_uPosition : 0;
+			if (a_Origin == aiOrigin_END)
+			{
+				if (a_uOffset > m_View.Size)
+				{
+					return aiReturn_FAILURE;
+				}
+				m_uPosition = m_View.Size - a_uOffset;
+				return aiReturn_SUCCESS;
+			}
+
+			if (a_uOffset > m_View.Size - uBase)
+			{
+				return aiReturn_FAILURE;
+			}
+			m_uPosition = uBase + a_uOffset;
+			return aiReturn_SUCCESS;
+		}
+
+		size_t Tell(void) const override { return m_uPosition; }
+		size_t FileSize(void) const override { return m_View.Size; }
+		void Flush(void) override { }
+	};
+
+	/// <summary>
+	/// The mounted archive and where every file lives inside of it.
+	/// </summary>
+	struct MountedArchive
+	{
+		std::shared_ptr<MappedFile> File;
+		std::unordered_map<std::string, const MappedArchiveEntry*> Entries;
+	};
+
+	std::mutex g_ArchiveMutex;
+	std::shared_ptr<MountedArchive> g_pArchive = nullptr;
+
+	/// <summary>
+	/// Grabs the mounted archive, if there is one.
+	/// </summary>
+	std::shared_ptr<MountedArchive> GetArchive(void)
+	{
+		std::lock_guard<std::mutex> lock(g_ArchiveMutex);
+		return g_pArchive;
+	}
+}
+
+MappedIOSystem::MappedIOSystem(void) { }
+
+MappedIOSystem::~MappedIOSystem(void)
+{
+	m_mFiles.clear();
+}
+
+bool MappedIOSystem::Exists(const char* a_sFile) const
+{
+	std::string sKey = ResourceRegistry::NormalizePath(a_sFile);
+	if (m_mFiles.count(sKey) > 0)
+	{
+		return true;
+	}
+
+	MappedView view;
+	if (!MapFile(a_sFile, view))
+	{
+		return false;
+	}
+
+	m_mFiles.emplace(sKey, view);
+	return true;
+}
+
+char MappedIOSystem::getOsSeparator(void) const
+{
+#ifdef _WIN32
+	return '\\';
+#else
+	return '/';
+#endif
+}
+
+Assimp::IOStream* MappedIOSystem::Open(const char* a_sFile, const char* a_sMode)
+{
+	// Mapped files are read-only.
+	if (a_sMode != nullptr && (std::strchr(a_sMode, 'w') != nullptr || std::strchr(a_sMode, 'a') != nullptr))
+	{
+		return nullptr;
+	}
+
+	if (!Exists(a_sFile))
+	{
+		return nullptr;
+	}
+
+	return new MappedIOStream(m_mFiles[ResourceRegistry::NormalizePath(a_sFile)]);
+}
+
+void MappedIOSystem::Close(Assimp::IOStream* a_pStream)
+{
+	delete a_pStream;
+}
+
+bool MappedIOSystem::MapFile(const std::string& a_sFile, MappedView& a_Result)
+{
+	// Files inside of the archive share its mapping.
+	std::shared_ptr<MountedArchive> pArchive = GetArchive();
+	if (pArchive != nullptr)
+	{
+		auto entry = pArchive->Entries.find(ResourceRegistry::NormalizePath(a_sFile));
+		if (entry != pArchive->Entries.end())
+		{
+			a_Result.File = pArchive->File;
+			a_Result.Data = pArchive->File->GetData() + entry->second->DataOffset;
+			a_Result.Size = (size_t)entry->second->DataSize;
+			return true;
+		}
+	}
+
+	std::shared_ptr<MappedFile> pFile = std::make_shared<MappedFile>();
+	if (!pFile->Open(a_sFile))
+	{
+		return false;
+	}
+
+	a_Result.File = pFile;
+	a_Result.Data = pFile->GetData();
+	a_Result.Size = pFile->GetSize();
+	return true;
+}
+
+bool MappedIOSystem::MountArchive(const std::string& a_sArchiveFile)
+{
+	std::shared_ptr<MountedArchive> pArchive = std::make_shared<MountedArchive>();
+	pArchive->File = std::make_shared<MappedFile>();
+	if (!pArchive->File->Open(a_sArchiveFile))
+	{
+		return false;
+	}
+
+	// Making sure that the file is actually an archive of this version.
+	const unsigned char* pData = pArchive->File->GetData();
+	uint64_t uFileSize = pArchive->File->GetSize();
+	const MappedArchiveHeader* pHeader = reinterpret_cast<const MappedArchiveHeader*>(pData);
+	if (uFileSize < sizeof(MappedArchiveHeader) ||
+		pHeader->Magic != MAPPED_ARCHIVE_MAGIC ||
+		pHeader->Version != MAPPED_ARCHIVE_VERSION ||
+		pHeader->EntryOffset > uFileSize ||
+		(uint64_t)pHeader->EntryCount * sizeof(MappedArchiveEntry) > uFileSize - pHeader->EntryOffset ||
+		pHeader->NameOffset > uFileSize ||
+		pHeader->NameSize > uFileSize - pHeader->NameOffset)
+	{
+		return false;
+	}
+
+	// Indexing every entry, as long as it is actually inside of the file.
+	const MappedArchiveEntry* pEntries = reinterpret_cast<const MappedArchiveEntry*>(pData + pHeader->EntryOffset);
+	const char* pNames = reinterpret_cast<const char*>(pData + pHeader->NameOffset);
+	for (unsigned int i = 0; i < pHeader->EntryCount; i++)
+	{
+		const MappedArchiveEntry& entry = pEntries[i];
+		if (entry.DataOffset > uFileSize ||
+			entry.DataSize > uFileSize - entry.DataOffset ||
+			entry.NameOffset > pHeader->NameSize ||
+			entry.NameLength > pHeader->NameSize - entry.NameOffset)
+		{
+			return false;
+		}
+
+		pArchive->Entries.emplace(std::string(pNames + entry.NameOffset, entry.NameLength), &entry);
+	}
+
+	std::lock_guard<std::mutex> lock(g_ArchiveMutex);
+	g_pArchive = pArchive;
+	return true;
+}
+
+void MappedIOSystem::UnmountArchive(void)
+{
+	std::lock_guard<std::mutex> lock(g_ArchiveMutex);
+	g_pArchive = nullptr;
+}
+
+bool MappedIOSystem::WriteArchive(const std::string& a_sArchiveFile, const std::vector<std::string>& a_lFiles)
+{
+	// Laying out the file: header, every file's contents, the entry table and then the names.
+	std::vector<unsigned char> lBytes(sizeof(MappedArchiveHeader), 0);
+	std::vector<MappedArchiveEntry> lEntries;
+	std::string sNames;
+
+	for (const std::string& sFile : a_lFiles)
+	{
+		MappedView view;
+		if (!MapFile(sFile, view))
+		{
+			return false;
+		}
+
+		std::string sName = ResourceRegistry::NormalizePath(sFile);
+		size_t uOffset = (lBytes.size() + MAPPED_ARCHIVE_ALIGNMENT - 1) & ~(size_t)(MAPPED_ARCHIVE_ALIGNMENT - 1);
+		lBytes.resize(uOffset + view.Size, 0);
+		std::memcpy(&lBytes[uOffset], view.Data, view.Size);
+
+		MappedArchiveEntry entry{};
+		entry.DataOffset = uOffset;
+		entry.DataSize = view.Size;
+		entry.NameOffset = (uint32_t)sNames.size();
+		entry.NameLength = (uint32_t)sName.size();
+		lEntries.push_back(entry);
+		sNames += sName;
+	}
+
+	MappedArchiveHeader header{};
+	header.Magic = MAPPED_ARCHIVE_MAGIC;
+	header.Version = MAPPED_ARCHIVE_VERSION;
+	header.EntryCount = (uint32_t)lEntries.size();
+	header.EntryOffset = (uint32_t)((lBytes.size() + MAPPED_ARCHIVE_ALIGNMENT - 1) & ~(size_t)(MAPPED_ARCHIVE_ALIGNMENT - 1));
+	header.NameOffset = header.EntryOffset + (uint32_t)(lEntries.size() * sizeof(MappedArchiveEntry));
+	header.NameSize = (uint32_t)sNames.size();
+
+	// The tables are found through 32 bit offsets, so they have to start within the first 4GB.
+	if ((uint64_t)header.EntryOffset + lEntries.size() * sizeof(MappedArchiveEntry) + sNames.size() > UINT32_MAX ||
+		lBytes.size() > UINT32_MAX)
+	{
+		return false;
+	}
+
+	lBytes.resize(header.NameOffset + sNames.size(), 0);
+	std::memcpy(&lBytes[0], &header, sizeof(MappedArchiveHeader));
+	if (!lEntries.empty())
+	{
+		std::memcpy(&lBytes[header.EntryOffset], lEntries.data(), lEntries.size() * sizeof(MappedArchiveEntry));
+	}
+	std::memcpy(lBytes.data() + header.NameOffset, sNames.data(), sNames.size());
+
+	return MappedFile::WriteToDisk(a_sArchiveFile, lBytes.data(), lBytes.size());
+}
@@ -0,0 +1,123 @@
+#ifndef __MAPPEDIOSYSTEM_H_
+#define __MAPPEDIOSYSTEM_H_
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <assimp/IOSystem.hpp>
+#include <assimp/IOStream.hpp>
+
+#include "MappedFile.h"
+
+// "DXAR" in little endian.
+#define MAPPED_ARCHIVE_MAGIC 0x52415844
+// Bump whenever the archive layout changes.
+#define MAPPED_ARCHIVE_VERSION 1
+
+/// <summary>
+/// The header at the very start of an archive.  The entry table and the
+/// names follow at the stored byte offsets, the file contents anywhere after.
+/// </summary>
+struct MappedArchiveHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t EntryCount;
+	uint32_t EntryOffset;
+	uint32_t NameOffset;
+	uint32_t NameSize;
+};
+
+/// <summary>
+/// A single file inside of an archive, stored under its normalized path.
+/// </summary>
+struct MappedArchiveEntry
+{
+	uint64_t DataOffset;
+	uint64_t DataSize;
+	uint32_t NameOffset;
+	uint32_t NameLength;
+};
+
+/// <summary>
+/// A mapped file, or a part of one, that stays mapped for as long as the view is around.
+/// </summary>
+struct MappedView
+{
+	std::shared_ptr<MappedFile> File = nullptr;
+	const unsigned char* Data = nullptr;
+	size_t Size = 0;
+};
+
+/// <summary>
+/// Hands Assimp memory-mapped files instead of letting it buffer its own reads, so the
+/// file goes from the page cache straight into the importer.  Files Assimp opens more than
+/// once are only mapped once.  When an archive is mounted, every file inside of it is read
+/// out of the one mapping of the archive instead of the disk.
+/// Importers take ownership of their IOSystem, so every import creates its own.
+/// </summary>
+class MappedIOSystem : public Assimp::IOSystem
+{
+private:
+	// Every file this importer touched, by normalized path.
+	mutable std::unordered_map<std::string, MappedView> m_mFiles;
+
+public:
+	/// <summary>
+	/// Constructs a MappedIOSystem with nothing mapped yet.
+	/// </summary>
+	MappedIOSystem(void);
+
+	/// <summary>
+	/// Unmaps every file that is no longer in use elsewhere.
+	/// </summary>
+	~MappedIOSystem(void) override;
+
+	/// <summary>
+	/// Checks whether a file exists, mapping it for the Open that usually follows.
+	/// </summary>
+	bool Exists(const char* a_sFile) const override;
+
+	/// <summary>
+	/// Gets the path separator of the platform.
+	/// </summary>
+	char getOsSeparator(void) const override;
+
+	/// <summary>
+	/// Opens a read-only stream over a mapped file.  Writing is not supported.
+	/// </summary>
+	/// <returns>The stream, or nullptr if the file could not be mapped.</returns>
+	Assimp::IOStream* Open(const char* a_sFile, const char* a_sMode = "rb") override;
+
+	/// <summary>
+	/// Closes a stream that was opened by this IOSystem.
+	/// </summary>
+	void Close(Assimp::IOStream* a_pStream) override;
+
+	/// <summary>
+	/// Maps a file out of the mounted archive, or off of the disk if it is not in there.
+	/// Safe to call from any thread.
+	/// </summary>
+	static bool MapFile(const std::string& a_sFile, MappedView& a_Result);
+
+	/// <summary>
+	/// Mounts an archive so that the files inside of it are read from it from now on.
+	/// Replaces the previously mounted archive.
+	/// </summary>
+	/// <returns>False if the archive does not exist or is corrupt.</returns>
+	static bool MountArchive(const std::string& a_sArchiveFile);
+
+	/// <summary>
+	/// Goes back to reading every file off of the disk.  Files already mapped out of the archive stay valid.
+	/// </summary>
+	static void UnmountArchive(void);
+
+	/// <summary>
+	/// Packs files into an archive, each stored under the path it is passed in as.
+	/// </summary>
+	static bool WriteArchive(const std::string& a_sArchiveFile, const std::vector<std::string>& a_lFiles);
+};
+
+#endif //__MAPPEDIOSYSTEM_H_
@@ -1,4 +1,5 @@
 #include "Material.h"
+#include "StateCache.h"
 
 Material::Material(
 	std::shared_ptr<Shader> a_pShader,
@@ -27,6 +28,7 @@ Material::Material(const Material& a_mOther)
 	m_fRoughness = a_mOther.m_fRoughness;
 	m_v2Scale = a_mOther.m_v2Scale;
 	m_v2Offset = a_mOther.m_v2Offset;
+	m_bTranslucent = a_mOther.m_bTranslucent;
 }
 
 Material& Material::operator=(const Material& a_mOther)
@@ -41,67 +43,80 @@ Material& Material::operator=(const Material& a_mOther)
 	m_mSamplers = a_mOther.m_mSamplers;
 	m_v2Scale = a_mOther.m_v2Scale;
 	m_v2Offset = a_mOther.m_v2Offset;
+	m_bTranslucent = a_mOther.m_bTranslucent;
+	m_bCBufferDirty = true;
 
 	return *this;
 }
 
 std::shared_ptr<Shader> Material::GetShader() { return m_pShader; }
 Vector4 Material::GetColor() const { return m_v4ColorTint; }
+bool Material::IsTranslucent() const { return m_bTranslucent; }
 float Material::GetRoughness() const { return m_fRoughness; }
 Vector2 Material::GetScale() const { return m_v2Scale; }
 Vector2 Material::GetOffset() { return m_v2Offset; }
 std::unordered_map<unsigned int, ShaderResourcePtr> Material::GetTextures() { return m_mTextureSRVs; }
 
-void Material::SetScale(Vector2 a_fScale) { m_v2Scale = a_fScale; }
-void Material::SetOffset(Vector2 a_fOffset) { m_v2Offset = a_fOffset; }
+void Material::SetScale(Vector2 a_fScale) { m_v2Scale = a_fScale; m_bCBufferDirty = true; }
+void Material::SetOffset(Vector2 a_fOffset) { m_v2Offset = a_fOffset; m_bCBufferDirty = true; }
 void Material::SetShader(std::shared_ptr<Shader> a_pShader) { m_pShader = a_pShader; }
-void Material::SetColor(Vector4 a_v4ColorTint) { m_v4ColorTint = a_v4ColorTint; }
+void Material::SetColor(Vector4 a_v4ColorTint) { m_v4ColorTint = a_v4ColorTint; m_bCBufferDirty = true; }
+void Material::SetTranslucent(bool a_bTranslucent) { m_bTranslucent = a_bTranslucent; }
 
 void Material::AddTexturesSRV(unsigned int a_nRegister, ShaderResourcePtr a_pSRV)
 {
 	m_mTextureSRVs.insert({ a_nRegister, a_pSRV });
 }
 
+void Material::SetTextureSRV(unsigned int a_nRegister, ShaderResourcePtr a_pSRV)
+{
+	m_mTextureSRVs[a_nRegister] = a_pSRV;
+}
+
 void Material::AddSampler(unsigned int a_nRegister, SamplerPtr a_pSampler)
 {
 	m_mSamplers.insert({ a_nRegister, a_pSampler });
 }
 
-void Material::PrepMaterialForDraw(
-	std::shared_ptr<CBufferMapper<MaterialCBufferData>> a_pCBufferMapper,
-	Vector3 a_v3CameraPosition,
-	Light a_Lights[MAX_LIGHT_COUNT])
+void Material::PrepMaterialForDraw(void)
 {
-	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context = Graphics::GetContext();
-
-	// Setting the data of the cbuffer.
-	MaterialCBufferData cbuffer{};
-	cbuffer.Offset = m_v2Offset;
-	cbuffer.Scale = m_v2Scale;
-	cbuffer.Color = m_v4ColorTint;
-	cbuffer.CameraPosition = a_v3CameraPosition;
-	for (unsigned int i = 0; i < MAX_LIGHT_COUNT; i++)
+	StateCache* pStateCache = StateCache::GetInstance();
+
+	if (m_pCBuffer == nullptr)
 	{
-		cbuffer.Lights[i] = a_Lights[i];
+		m_pCBuffer = std::make_shared<CBufferMapper<MaterialCBufferData>>(
+			MATERIAL_CBUFFER_REGISTER,
+			ShaderType::PixelShader);
+		m_bCBufferDirty = true;
 	}
 
-	// Sending the data to the GPU.
-	a_pCBufferMapper->MapBufferData(cbuffer);
+	// Sending the data to the GPU, only when something was edited since the last upload.
+	if (m_bCBufferDirty)
+	{
+		MaterialCBufferData cbuffer{};
+		cbuffer.Offset = m_v2Offset;
+		cbuffer.Scale = m_v2Scale;
+		cbuffer.Color = m_v4ColorTint;
+		m_pCBuffer->MapBufferData(cbuffer);
+		m_bCBufferDirty = false;
+	}
+	m_pCBuffer->Bind();
 
-	// Resetting the set SRVs.
-	ID3D11ShaderResourceView* nullSRVs[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT] = { nullptr };
-	context->PSSetShaderResources(
+	// Every register this material has no texture for is reset, all of them set in a single
+	// call so the state cache only passes on the registers that differ from the last material.
+	ID3D11ShaderResourceView* srvs[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT] = { nullptr };
+	for (const auto& t : m_mTextureSRVs) 
+	{
+		srvs[t.first] = t.second.Get();
+	}
+	pStateCache->PSSetShaderResources(
 		0, 
 		D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT, 
-		nullSRVs);
+		srvs);
 
 	// Sending the resources to the GPU.
-	for (const auto& t : m_mTextureSRVs) 
-	{
-		context->PSSetShaderResources(t.first, 1, t.second.GetAddressOf());
-	}
 	for (const auto& s : m_mSamplers) 
 	{ 
-		context->PSSetSamplers(s.first, 1, s.second.GetAddressOf()); 
+		pStateCache->PSSetSamplers(s.first, 1, s.second.GetAddressOf()); 
 	}
 }
@@ -20,6 +20,13 @@ typedef Microsoft::WRL::ComPtr<ID3D11SamplerState> SamplerPtr;
 
 #define SAMPLER_REGISTER 0
 
+// The pixel shader register every material's own constants are bound to.
+#define MATERIAL_CBUFFER_REGISTER 1
+
+/// <summary>
+/// The constants of a single material, only uploaded again once one of them changed.
+/// Camera and lights are per frame, see FrameCBufferData.
+/// </summary>
 struct MaterialCBufferData
 {
 	// 16 byte memory padding rules applied:
@@ -27,11 +34,6 @@ struct MaterialCBufferData
 	Vector2 Offset;
 	Vector2 Scale;
 	// - -
-	Vector3 CameraPosition;
-	float padding;
-	// - -
-	Light Lights[MAX_LIGHT_COUNT];
-	// - -
 	Vector4 Color;
 };
 
@@ -53,6 +55,11 @@ private:
 	Vector2 m_v2Scale = Vector2(1.0f, 1.0f);
 	Vector2 m_v2Offset = Vector2(0.0f, 0.0f);
 	float m_fRoughness;
+	bool m_bTranslucent = false;
+
+	// The material's own constants on the GPU, created on first use and re-uploaded only when marked dirty.
+	std::shared_ptr<CBufferMapper<MaterialCBufferData>> m_pCBuffer = nullptr;
+	bool m_bCBufferDirty = true;
 
 public:
 	/// <summary>
@@ -88,6 +95,11 @@ public:
 	/// </summary>
 	Vector4 GetColor(void) const;
 
+	/// <summary>
+	/// Gets whether anything behind the material shows through it, which has it drawn after everything opaque, back to front.
+	/// </summary>
+	bool IsTranslucent(void) const;
+
 	/// <summary>
 	/// Gets the roughness of the material.
 	/// </summary>
@@ -128,12 +140,23 @@ public:
 	/// </summary>
 	void SetColor(Vector4 a_v4ColorTint);
 
+	/// <summary>
+	/// Sets whether anything behind the material shows through it.
+	/// </summary>
+	void SetTranslucent(bool a_bTranslucent);
+
 	/// <summary>
 	/// Adds a key value pair to the unordered map of texture SRVs.
 	/// </summary>
 	/// <param name="a_pSRV">The Shader Resource View object pointer.</param>
 	void AddTexturesSRV(unsigned int a_nRegister, ShaderResourcePtr a_pSRV);
 
+	/// <summary>
+	/// Sets the texture SRV of a register, replacing whatever was there before.
+	/// Used to swap placeholder textures out once the real ones are loaded.
+	/// </summary>
+	void SetTextureSRV(unsigned int a_nRegister, ShaderResourcePtr a_pSRV);
+
 	/// <summary>
 	/// Adds a key value pair to the unordered map of sampler states.
 	/// </summary>
@@ -141,12 +164,10 @@ public:
 	void AddSampler(unsigned int a_nRegister, SamplerPtr a_pSampler);
 
 	/// <summary>
-	/// Sets all members from the unordered_maps for texture rendering.
+	/// Binds the material's constants along with everything from the unordered_maps for texture rendering.
+	/// The constants are only uploaded when they changed since the last time.
 	/// </summary>
-	void PrepMaterialForDraw(
-		std::shared_ptr<CBufferMapper<MaterialCBufferData>> a_pCBufferMapper,
-		Vector3 a_v3CameraPosition,
-		Light a_Lights[MAX_LIGHT_COUNT] = {});
+	void PrepMaterialForDraw(void);
 };
 
 #endif //__MATERIAL_H_
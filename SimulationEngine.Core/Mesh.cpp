@@ -1,15 +1,31 @@
 #include "Mesh.h"
+#include "StateCache.h"
 #include "Graphics.h"
 #include "Vectors.h"
 #include "LineManager.h"
-
-#include <fstream>
+#include "MeshCache.h"
+#include "Logger.h"
+#include "ObjParser.h"
+#include "ThreadPool.h"
+#include "MeshOptimizer.h"
+#include "VertexPacker.h"
+#include "MeshSimplifier.h"
+#include "TangentGenerator.h"
+
+#include <unordered_map>
+#include <cstring>
 
 #define VECTOR3_ZERO Vector3(0.0f, 0.0f, 0.0f)
 
 using namespace DirectX;
 
-Mesh::Mesh(VertexPack a_VertexData, IndexPack a_IndexData, TangentType a_TangentType)
+Mesh::Mesh(void)
+{
+	m_pVertexBuffer = nullptr;
+	m_pIndexBuffer = nullptr;
+}
+
+Mesh::Mesh(VertexPack a_VertexData, IndexPack a_IndexData, TangentType a_TangentType, bool a_bOptimize)
 {
 	// Saving the passed in values to the member fields.
 	m_pVertexBuffer = nullptr;
@@ -18,6 +34,17 @@ Mesh::Mesh(VertexPack a_VertexData, IndexPack a_IndexData, TangentType a_Tangent
 	m_dVertexCount = a_VertexData.VertexCount;
 	m_dIndexCount = a_IndexData.IndexCount;
 
+	PackedMesh packed;
+	if (a_bOptimize)
+	{
+		// Optimizing changes how many vertices there are, so it works on its own copy.
+		std::vector<Vertex> lVertices(a_VertexData.Vertices, a_VertexData.Vertices + m_dVertexCount);
+		std::vector<unsigned int> lIndices(a_IndexData.Indices, a_IndexData.Indices + m_dIndexCount);
+		Prepare(lVertices, lIndices, a_TangentType, packed);
+		Upload(packed);
+		return;
+	}
+
 	// Calculating vertex tangents.
 	CalculateTangents(
 		a_VertexData.Vertices, 
@@ -26,40 +53,17 @@ Mesh::Mesh(VertexPack a_VertexData, IndexPack a_IndexData, TangentType a_Tangent
 		m_dIndexCount,
 		a_TangentType);
 
-	// Setting up the vertex buffer setup struct object.
-	D3D11_BUFFER_DESC vbd = {};
-	vbd.Usage = D3D11_USAGE_IMMUTABLE;				
-	vbd.ByteWidth = sizeof(Vertex) * m_dVertexCount;
-	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;		
-	vbd.CPUAccessFlags = 0;							
-	vbd.MiscFlags = 0;
-	vbd.StructureByteStride = 0;
-
-	// Setting up the index buffer setup struct object.
-	D3D11_BUFFER_DESC ibd = {};
-	ibd.Usage = D3D11_USAGE_IMMUTABLE;					
-	ibd.ByteWidth = sizeof(UINT) * m_dIndexCount;
-	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;			
-	ibd.CPUAccessFlags = 0;								
-	ibd.MiscFlags = 0;
-	ibd.StructureByteStride = 0;
-
-	// Creating the structs that actually hold the buffer data
-	D3D11_SUBRESOURCE_DATA initialVertexData = {};
-	D3D11_SUBRESOURCE_DATA initialIndexData = {};
-
-	// Setting the system memory to hold the buffer data.
-	initialVertexData.pSysMem = a_VertexData.Vertices;
-	initialIndexData.pSysMem = a_IndexData.Indices;
-
-	// Creating the buffers.
-	Graphics::GetDevice()->CreateBuffer(&vbd, &initialVertexData, m_pVertexBuffer.GetAddressOf());
-	Graphics::GetDevice()->CreateBuffer(&ibd, &initialIndexData, m_pIndexBuffer.GetAddressOf());
+	// Creating the DirectX buffers from the passed in data.
+	VertexFormat format = VertexPacker::ChooseFormat(a_VertexData.Vertices, m_dVertexCount);
+	VertexPacker::Pack(a_VertexData.Vertices, m_dVertexCount, a_IndexData.Indices, m_dIndexCount, format, packed);
+	Upload(packed);
 }
 
 Mesh::Mesh(std::string a_sObjDirectory, std::string a_sObjName)
 {
-	LoadObj(a_sObjDirectory, a_sObjName);
+	MeshData data;
+	ImportObj(a_sObjDirectory + a_sObjName, data);
+	Upload(data);
 }
 
 Mesh::~Mesh()
@@ -75,6 +79,15 @@ Mesh::Mesh(const Mesh& a_pOther)
 	m_dVertexCount = a_pOther.m_dVertexCount;
 	m_pIndexBuffer = a_pOther.m_pIndexBuffer;
 	m_dIndexCount = a_pOther.m_dIndexCount;
+	m_VertexFormat = a_pOther.m_VertexFormat;
+	m_IndexFormat = a_pOther.m_IndexFormat;
+	m_lLods = a_pOther.m_lLods;
+	m_v3BoundsCenter = a_pOther.m_v3BoundsCenter;
+	m_fBoundsRadius = a_pOther.m_fBoundsRadius;
+	m_v3BoundsMin = a_pOther.m_v3BoundsMin;
+	m_v3BoundsMax = a_pOther.m_v3BoundsMax;
+	m_pTriangles = a_pOther.m_pTriangles;
+	m_bFailed = a_pOther.m_bFailed;
 }
 
 Mesh& Mesh::operator=(const Mesh& a_pOther)
@@ -88,38 +101,141 @@ Mesh& Mesh::operator=(const Mesh& a_pOther)
 	m_dVertexCount = a_pOther.m_dVertexCount;
 	m_pIndexBuffer = a_pOther.m_pIndexBuffer;
 	m_dIndexCount = a_pOther.m_dIndexCount;
+	m_VertexFormat = a_pOther.m_VertexFormat;
+	m_IndexFormat = a_pOther.m_IndexFormat;
+	m_lLods = a_pOther.m_lLods;
+	m_v3BoundsCenter = a_pOther.m_v3BoundsCenter;
+	m_fBoundsRadius = a_pOther.m_fBoundsRadius;
+	m_v3BoundsMin = a_pOther.m_v3BoundsMin;
+	m_v3BoundsMax = a_pOther.m_v3BoundsMax;
+	m_pTriangles = a_pOther.m_pTriangles;
+	m_bFailed = a_pOther.m_bFailed;
 
 	return *this;
 }
 
-void Mesh::Draw(void)
+bool Mesh::IsReady(void) const { return m_pIndexBuffer != nullptr; }
+
+bool Mesh::IsFailed(void) const { return m_bFailed; }
+
+void Mesh::MarkFailed(void) { m_bFailed = true; }
+
+unsigned int Mesh::SelectLod(const Matrix4& a_m4World, std::shared_ptr<Camera> a_pCamera) const
+{
+	return SelectLod(m_lLods, m_v3BoundsCenter, m_fBoundsRadius, a_m4World, a_pCamera);
+}
+
+unsigned int Mesh::SelectLod(
+	const std::vector<MeshLod>& a_lLods,
+	const Vector3& a_v3BoundsCenter,
+	float a_fBoundsRadius,
+	const Matrix4& a_m4World,
+	std::shared_ptr<Camera> a_pCamera)
+{
+	if (a_lLods.size() <= 1)
+	{
+		return 0;
+	}
+
+	// Object space errors grow with the largest scale of the world matrix.
+	XMMatrix m4World = XMLoadFloat4x4(&a_m4World);
+	float fScale = XMVectorGetX(XMVectorMax(
+		XMVector3Length(m4World.r[0]),
+		XMVectorMax(XMVector3Length(m4World.r[1]), XMVector3Length(m4World.r[2]))));
+
+	// Measuring from the closest the mesh can get to the camera.
+	Vector3 v3Camera = a_pCamera->GetTransform().GetPosition();
+	XMVector vCenter = XMVector3Transform(XMLoadFloat3(&a_v3BoundsCenter), m4World);
+	float fDistance = XMVectorGetX(XMVector3Length(XMVectorSubtract(vCenter, XMLoadFloat3(&v3Camera))));
+	fDistance -= a_fBoundsRadius * fScale;
+	if (fDistance <= 0.0f)
+	{
+		return 0;
+	}
+
+	// How much of the screen's height a single unit covers at that distance.
+	float fScreenPerUnit = a_pCamera->GetProjection()._22 * 0.5f * fScale / fDistance;
+
+	unsigned int uLod = 0;
+	while (uLod + 1 < a_lLods.size() && a_lLods[uLod + 1].Error * fScreenPerUnit <= LOD_SCREEN_ERROR)
+	{
+		uLod++;
+	}
+	return uLod;
+}
+
+bool Mesh::Bind(void)
 {
-	// Setting the stride to be the memory size of a Vertex
-	UINT stride = sizeof(Vertex);
+	// Still waiting on its data to finish loading.
+	if (!IsReady())
+	{
+		return false;
+	}
+
+	// The bound shader has to read the vertices the way they were packed.
+	if (!Shader::SetVertexFormat(m_VertexFormat))
+	{
+		return false;
+	}
+
+	// Setting the stride to be the memory size of a packed vertex.
+	UINT stride = VertexPacker::GetVertexStride(m_VertexFormat);
 
 	// The offset starts at the first piece of data.
 	UINT offset = 0;
 
 	// Setting this Mesh's buffers as the next thing to draw.
-	Graphics::GetContext()->IASetVertexBuffers(0, 1, m_pVertexBuffer.GetAddressOf(), &stride, &offset);
-	Graphics::GetContext()->IASetIndexBuffer(m_pIndexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	StateCache::GetInstance()->IASetVertexBuffers(0, 1, m_pVertexBuffer.GetAddressOf(), &stride, &offset);
+	StateCache::GetInstance()->IASetIndexBuffer(m_pIndexBuffer.Get(), m_IndexFormat, 0);
+	return true;
+}
 
+void Mesh::DrawIndexed(unsigned int a_uLod)
+{
 	// Starting up the render pipeline and drawing the currently set Index and Vertex buffers.
+	const MeshLod& lod = m_lLods[a_uLod < m_lLods.size() ? a_uLod : m_lLods.size() - 1];
 	Graphics::GetContext()->DrawIndexed(
-		m_dIndexCount,		// The number of indices to use.
-		0,					// Offset from the first index to use.
+		lod.IndexCount,		// The number of indices to use.
+		lod.IndexOffset,	// Offset from the first index to use.
 		0);					// Offset to add to each index.
 }
 
+void Mesh::DrawIndexedInstanced(unsigned int a_uLod, unsigned int a_uInstanceCount, unsigned int a_uStartInstance)
+{
+	const MeshLod& lod = m_lLods[a_uLod < m_lLods.size() ? a_uLod : m_lLods.size() - 1];
+	Graphics::GetContext()->DrawIndexedInstanced(
+		lod.IndexCount,
+		a_uInstanceCount,
+		lod.IndexOffset,
+		0,
+		a_uStartInstance);
+}
+
+void Mesh::Draw(unsigned int a_uLod)
+{
+	if (Bind())
+	{
+		DrawIndexed(a_uLod);
+	}
+}
+
 BufferPtr Mesh::GetVertexBuffer(void) { return m_pVertexBuffer; }
 BufferPtr Mesh::GetIndexBuffer(void) { return m_pIndexBuffer; }
 int Mesh::GetIndexCount(void) { return m_dIndexCount; }
 int Mesh::GetVertexCount(void) { return m_dVertexCount; }
+VertexFormat Mesh::GetVertexFormat(void) const { return m_VertexFormat; }
+unsigned int Mesh::GetLodCount(void) const { return (unsigned int)m_lLods.size(); }
+Vector3 Mesh::GetBoundsMin(void) const { return m_v3BoundsMin; }
+Vector3 Mesh::GetBoundsMax(void) const { return m_v3BoundsMax; }
+Vector3 Mesh::GetBoundsCenter(void) const { return m_v3BoundsCenter; }
+float Mesh::GetBoundsRadius(void) const { return m_fBoundsRadius; }
+std::shared_ptr<TriangleBVH> Mesh::GetTriangles(void) const { return m_pTriangles; }
 
 // --------------------------------------------------------
 // Calculates the tangents of the vertices in a mesh
 // - Code originally adapted from: http://www.terathon.com/code/tangent.html
 // - Updated version found here: http://foundationsofgameenginedev.com/FGED2-sample.pdf
+// - The work is split across the ThreadPool by the TangentGenerator
 // --------------------------------------------------------
 void Mesh::CalculateTangents(
 	Vertex* a_lVertices, 
@@ -128,318 +244,264 @@ void Mesh::CalculateTangents(
 	int a_dIndexCount,
 	TangentType a_TangentType)
 {
-	// Reset tangents
-	for (int i = 0; i < a_dVertexCount; i++)
+	TangentGenerator::Generate(
+		a_lVertices,
+		(unsigned int)a_dVertexCount,
+		a_lIndices,
+		(unsigned int)a_dIndexCount,
+		a_TangentType == TangentType::Inverted);
+}
+
+namespace
+{
+	/// <summary>
+	/// The attributes that make two vertices interchangeable, stored as raw bits.
+	/// </summary>
+	struct WeldKey
 	{
-		a_lVertices[i].Tangent = Vector3(0, 0, 0);
-	}
-	// Calculate tangents one whole triangle at a time
-	for (int i = 0; i < a_dIndexCount;)
+		uint32_t Bits[8];
+
+		bool operator==(const WeldKey& a_Other) const
+		{
+			return std::memcmp(Bits, a_Other.Bits, sizeof(Bits)) == 0;
+		}
+	};
+
+	struct WeldKeyHasher
 	{
-		// Grab indices and vertices of first triangle
-		unsigned int i1 = a_lIndices[i++];
-		unsigned int i2 = a_lIndices[i++];
-		unsigned int i3 = a_lIndices[i++];
-		Vertex* v1 = &a_lVertices[i1];
-		Vertex* v2 = &a_lVertices[i2];
-		Vertex* v3 = &a_lVertices[i3];
-		// Calculate vectors relative to triangle positions
-		float x1 = v2->Position.x - v1->Position.x;
-		float y1 = v2->Position.y - v1->Position.y;
-		float z1 = v2->Position.z - v1->Position.z;
-		float x2 = v3->Position.x - v1->Position.x;
-		float y2 = v3->Position.y - v1->Position.y;
-		float z2 = v3->Position.z - v1->Position.z;
-		// Do the same for vectors relative to triangle uv's
-		float s1 = v2->UV.x - v1->UV.x;
-		float t1 = v2->UV.y - v1->UV.y;
-		float s2 = v3->UV.x - v1->UV.x;
-		float t2 = v3->UV.y - v1->UV.y;
-		// Create vectors for tangent calculation
-		float r = 1.0f / (s1 * t2 - s2 * t1);
-		float tx = (t2 * x1 - t1 * x2) * r;
-		float ty = (t2 * y1 - t1 * y2) * r;
-		float tz = (t2 * z1 - t1 * z2) * r;
-		// Adjust tangents of each vert of the triangle
-		v1->Tangent.x += tx;
-		v1->Tangent.y += ty;
-		v1->Tangent.z += tz;
-		v2->Tangent.x += tx;
-		v2->Tangent.y += ty;
-		v2->Tangent.z += tz;
-		v3->Tangent.x += tx;
-		v3->Tangent.y += ty;
-		v3->Tangent.z += tz;
+		size_t operator()(const WeldKey& a_Key) const
+		{
+			// FNV-1a over the eight attribute words.
+			uint64_t uHash = 14695981039346656037ull;
+			for (int i = 0; i < 8; i++)
+			{
+				uHash ^= a_Key.Bits[i];
+				uHash *= 1099511628211ull;
+			}
+			return (size_t)(uHash ^ (uHash >> 32));
+		}
+	};
+
+	uint32_t FloatBits(float a_fValue)
+	{
+		// Treating -0.0f and 0.0f as the same value.
+		if (a_fValue == 0.0f)
+		{
+			a_fValue = 0.0f;
+		}
+
+		uint32_t uBits;
+		std::memcpy(&uBits, &a_fValue, sizeof(float));
+		return uBits;
 	}
-	// Ensure all of the tangents are orthogonal to the normals
-	for (int i = 0; i < a_dVertexCount; i++)
+}
+
+WeldStats Mesh::WeldVertices(
+	std::vector<Vertex>& a_lVertices,
+	std::vector<unsigned int>& a_lIndices)
+{
+	WeldStats stats{};
+	stats.VerticesBefore = (unsigned int)a_lVertices.size();
+
+	std::unordered_map<WeldKey, unsigned int, WeldKeyHasher> mUnique;
+	mUnique.reserve(a_lVertices.size());
+
+	std::vector<unsigned int> lRemap(a_lVertices.size());
+	std::vector<Vertex> lWelded;
+	lWelded.reserve(a_lVertices.size());
+
+	// Finding the first occurrence of every unique vertex.
+	for (size_t i = 0; i < a_lVertices.size(); i++)
 	{
-		// Grab the two vectors
-		XMVector tangent = XMLoadFloat3(&a_lVertices[i].Tangent);
-		XMVector normal = XMLoadFloat3(&a_lVertices[i].Normal);
-		// Use Gram-Schmidt orthonormalize to ensure
-		// the normal and tangent are exactly 90 degrees apart
-		tangent = XMVector3Normalize(
-			tangent - normal * XMVector3Dot(normal, tangent));
-		
-		if (a_TangentType == TangentType::Inverted)
+		const Vertex& vertex = a_lVertices[i];
+		WeldKey key{ {
+			FloatBits(vertex.Position.x), FloatBits(vertex.Position.y), FloatBits(vertex.Position.z),
+			FloatBits(vertex.Normal.x), FloatBits(vertex.Normal.y), FloatBits(vertex.Normal.z),
+			FloatBits(vertex.UV.x), FloatBits(vertex.UV.y) } };
+
+		auto result = mUnique.insert({ key, (unsigned int)lWelded.size() });
+		if (result.second)
 		{
-			tangent = -tangent;
+			lWelded.push_back(vertex);
 		}
-		
-		// Store the tangent
-		XMStoreFloat3(&a_lVertices[i].Tangent, tangent);
+		lRemap[i] = result.first->second;
 	}
+
+	// Pointing the indices at the shared vertices.
+	for (unsigned int& index : a_lIndices)
+	{
+		index = lRemap[index];
+	}
+
+	a_lVertices.swap(lWelded);
+	stats.VerticesAfter = (unsigned int)a_lVertices.size();
+
+	Logger::GetInstance()->Log(
+		"Mesh.cpp",
+		"Welded " + std::to_string(stats.VerticesBefore) + " vertices into " + std::to_string(stats.VerticesAfter),
+		DEBUG_LOG);
+
+	return stats;
+}
+
+void Mesh::Prepare(
+	std::vector<Vertex>& a_lVertices,
+	std::vector<unsigned int>& a_lIndices,
+	TangentType a_TangentType,
+	PackedMesh& a_Result)
+{
+	CalculateTangents(a_lVertices.data(), (int)a_lVertices.size(), a_lIndices.data(), (int)a_lIndices.size(), a_TangentType);
+
+	MeshOptimizer::Optimize(a_lVertices, a_lIndices);
+	std::vector<MeshLod> lLods = MeshSimplifier::GenerateLods(a_lVertices, a_lIndices);
+
+	VertexFormat format = VertexPacker::ChooseFormat(a_lVertices.data(), (unsigned int)a_lVertices.size());
+	VertexPacker::Pack(
+		a_lVertices.data(),
+		(unsigned int)a_lVertices.size(),
+		a_lIndices.data(),
+		(unsigned int)a_lIndices.size(),
+		format,
+		a_Result);
+	a_Result.Lods = lLods;
 }
 
-void Mesh::LoadObj(std::string a_sObjDirectory, std::string a_sObjName)
+void Mesh::ImportObj(const std::string& a_sObjPath, MeshData& a_Result)
 {
 	// ---------------------------------------
 	//	 	This method takes parts of 
 	//	 Professor Chris Cascioli's code of
 	//	 Rochester Institute of Technology.
 	// ---------------------------------------
-	std::ifstream obj(a_sObjDirectory + a_sObjName);
 
-	// Ensure that the file was properly found.
-	if (!obj.is_open())
+	// Using the cooked version of the mesh when it is still up to date.
+	// The mapped data goes straight to the GPU with no parsing or copying.
+	std::shared_ptr<MeshCache> pCache = std::make_shared<MeshCache>();
+	if (pCache->Load(a_sObjPath))
+	{
+		a_Result.Cache = pCache;
+		a_Result.Triangles = TriangleBVH::Create(
+			pCache->GetVertexFormat(),
+			pCache->GetVertexData(),
+			(unsigned int)pCache->GetVertexCount(),
+			pCache->GetIndexData(),
+			(unsigned int)pCache->GetIndexCount(),
+			pCache->GetLods(),
+			(unsigned int)pCache->GetLodCount());
+		return;
+	}
+
+	// Parsing the file across the worker threads.
+	ObjData obj;
+	if (!ObjParser::Parse(a_sObjPath, obj))
 	{
 		throw std::invalid_argument(
 			"Error opening file: Invalid file path or file is inaccessible due to access levels."
 		);
 	}
 
-	// Collected data for loading each individual vertex.
-	std::vector<Vector3> positions;
-	std::vector<Vector3> normals;
-	std::vector<Vector2> uvs;
+	// One vertex per face corner, welded together further down.
 	std::vector<Vertex> verts;
-
-	// Defines the index buffer for the vertices.
 	std::vector<unsigned int> indices;
+	verts.resize(obj.Corners.size());
+	indices.resize(obj.Corners.size());
 
-	// Count of each index and vertex.
-	int vertCounter = 0;
-	int indexCounter = 0;
-
-	// For loading lines of the obj files.
-	char chars[256];
+	unsigned int uTriangleCount = (unsigned int)(obj.Corners.size() / 3);
+	ThreadPool::GetInstance()->ParallelFor(uTriangleCount, 4096, [&](unsigned int a_uBegin, unsigned int a_uEnd)
+		{
+			for (unsigned int t = a_uBegin; t < a_uEnd; t++)
+			{
+				// ---------------------------------------------------------
+				// Professor Chris Cascioli:
+				// 
+				// The model is most likely in a right-handed space,
+				// especially if it came from Maya.  We want to convert
+				// to a left-handed space for DirectX.  This means we 
+				// need to:
+				//  - Invert the Z position
+				//  - Invert the normal's Z
+				//  - Flip the winding order
+				// We also need to flip the UV coordinate since DirectX
+				// defines (0,0) as the top left of the texture, and many
+				// 3D modeling packages use the bottom left as (0,0)
+				// 
+				// ---------------------------------------------------------
+				const unsigned int lOrder[3] = { 0, 2, 1 };
+				for (unsigned int c = 0; c < 3; c++)
+				{
+					const ObjCorner& corner = obj.Corners[t * 3 + lOrder[c]];
+					Vertex& vertex = verts[t * 3 + c];
 
-	while (obj.good())
-	{
-		// Getting a line from the file.
-		obj.getline(chars, 256);
+					vertex.Position = obj.Positions[corner.Position];
+					vertex.Position.z *= -1.0f;
 
-		std::string line = chars;
-		if (strstr(chars, "mtllib"))
-		{
-			std::string matFileName = "";
+					// Objs without UVs or normals still load, just with zeroed values.
+					vertex.UV = corner.UV >= 0 ? obj.UVs[corner.UV] : Vector2(0.0f, 0.0f);
+					vertex.UV.y = 1.0f - vertex.UV.y;
 
-			// Loading the mtl filename.
-			int i = 7;
-			while (chars[i] != '\0')
-			{
-				matFileName += chars[i];
-				i++;
-			}
-		}
+					vertex.Normal = corner.Normal >= 0 ? obj.Normals[corner.Normal] : VECTOR3_ZERO;
+					vertex.Normal.z *= -1.0f;
 
-		// Check the type of line within the obj file.
-		if (chars[0] == 'v' && chars[1] == 'n')
-		{
-			// Read the 3 numbers directly into an Vector3
-			Vector3 normal;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&normal.x,
-				&normal.y,
-				&normal.z
-			);
-
-			// Add the loaded normal to the list of normals.
-			normals.push_back(normal);
-		}
-		else if (chars[0] == 'v' && chars[1] == 't')
-		{
-			// Reading the uv values into an Vector2.
-			Vector2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x,
-				&uv.y
-			);
-
-			// Add to the list of UVs.
-			uvs.push_back(uv);
-		}
-		else if (chars[0] == 'v')
-		{
-			// Read the 3 numbers directly into an Vector3
-			Vector3 position;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&position.x,
-				&position.y,
-				&position.z
-			);
-
-			// Add to the collection of positions.
-			positions.push_back(position);
-		}
-		else if (chars[0] == 'f')
-		{
-			// Reading the indices from the obj file.
-			// This assumes the obj contains vertex positions/UVs/normals.
-			unsigned int i[12];
-			int numbersRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// If there was only one number then the obj has no UV coords.
-			// Continue loading without crashing so re-reading in a different way.
-			if (numbersRead == 1)
-			{
-				// Re-read with a different pattern.
-				numbersRead = sscanf_s(
-					chars,
-					"f %d//%d %d//%d %d//%d %d//%d",
-					&i[0], &i[2],
-					&i[3], &i[5],
-					&i[6], &i[8],
-					&i[9], &i[11]);
-
-				// The following indices are where the UVs coords should 
-				// have been, so giving them a valid value.
-				i[1] = 1;
-				i[4] = 1;
-				i[7] = 1;
-				i[10] = 1;
-
-				// If we have no UVs, create a single UV coordinate
-				// that will be used for all vertices.
-				if (uvs.size() == 0)
-				{
-					uvs.push_back(Vector2(0, 0));
+					vertex.Tangent = VECTOR3_ZERO;
+					indices[t * 3 + c] = t * 3 + c;
 				}
 			}
+		});
 
-			// Constructing the Vertex models.
-			Vertex v1;
-			v1.Position = positions[i[0] - 1];
-			v1.UV = uvs[i[1] - 1];
-			v1.Normal = normals[i[2] - 1];
-
-			Vertex v2;
-			v2.Position = positions[i[3] - 1];
-			v2.UV = uvs[i[4] - 1];
-			v2.Normal = normals[i[5] - 1];
-
-			Vertex v3;
-			v3.Position = positions[i[6] - 1];
-			v3.UV = uvs[i[7] - 1];
-			v3.Normal = normals[i[8] - 1];
-
-			// ---------------------------------------------------------
-			// Professor Chris Cascioli:
-			// 
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-			// 
-			// ---------------------------------------------------------
-
-			// Flip the UV's since they're probably "upside down"
-			v1.UV.y = 1.0f - v1.UV.y;
-			v2.UV.y = 1.0f - v2.UV.y;
-			v3.UV.y = 1.0f - v3.UV.y;
-
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
-
-			// Flip normal's Z
-			v1.Normal.z *= -1.0f;
-			v2.Normal.z *= -1.0f;
-			v3.Normal.z *= -1.0f;
-
-			// Collecting the vertices into the vertex collection.
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-			vertCounter += 3;
-
-			// Adding more indices according to the new Vertex additions.
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-
-			// Follow Professor Chris Cascioli's explanation:
-			// Was there a 4th face?
-			// - 12 numbers read means 4 faces WITH uv's
-			// - 8 numbers read means 4 faces WITHOUT uv's
-			if (numbersRead == 12 || numbersRead == 8)
-			{
-				// Make the last vertex
-				Vertex v4;
-				v4.Position = positions[i[9] - 1];
-				v4.UV = uvs[i[10] - 1];
-				v4.Normal = normals[i[11] - 1];
-
-				// Flip the UV, Z pos and normal's Z
-				v4.UV.y = 1.0f - v4.UV.y;
-				v4.Position.z *= -1.0f;
-				v4.Normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-				vertCounter += 3;
-
-				// Add three more indices
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-			}
-		}
-	}
-	
-	// Close the file and creating the actual buffers.
-	obj.close();
+	// Sharing vertices between faces instead of keeping one per face corner.
+	WeldVertices(verts, indices);
 
-	m_dVertexCount = (int)verts.size();
-	m_dIndexCount = (int)indices.size();
+	// Tangents, ordering for the GPU's caches, LODs and packing, the same as every other mesh.
+	Prepare(verts, indices, TangentType::Normal, a_Result.Packed);
+	a_Result.Triangles = TriangleBVH::Create(a_Result.Packed);
 
-	// Copying the data into a heap allocated array for the tangent function.
-	Vertex* lTempVertArr = new Vertex[verts.size()];
-	unsigned int* lTempIndexArr = new unsigned int[indices.size()];
+	// Cooking the processed data so that the next load can skip parsing entirely.
+	MeshCache::Write(a_sObjPath, a_Result.Packed);
+}
 
-	// Copying the data from the vectors.
-	std::memcpy(lTempVertArr, verts.data(), verts.size() * sizeof(Vertex));
-	std::memcpy(lTempIndexArr, indices.data(), indices.size() * sizeof(unsigned int));
+void Mesh::Upload(const MeshData& a_Data)
+{
+	if (a_Data.Cache != nullptr)
+	{
+		m_dVertexCount = a_Data.Cache->GetVertexCount();
+		m_dIndexCount = a_Data.Cache->GetIndexCount();
+		m_lLods.assign(a_Data.Cache->GetLods(), a_Data.Cache->GetLods() + a_Data.Cache->GetLodCount());
+		m_v3BoundsCenter = a_Data.Cache->GetBoundsCenter();
+		m_fBoundsRadius = a_Data.Cache->GetBoundsRadius();
+		m_v3BoundsMin = a_Data.Cache->GetBoundsMin();
+		m_v3BoundsMax = a_Data.Cache->GetBoundsMax();
+		m_pTriangles = a_Data.Triangles;
+		CreateBuffers(a_Data.Cache->GetVertexFormat(), a_Data.Cache->GetVertexData(), a_Data.Cache->GetIndexData());
+		return;
+	}
 
-	// Calculate vertex tangents.
-	CalculateTangents(lTempVertArr, m_dVertexCount, lTempIndexArr, m_dIndexCount);
+	Upload(a_Data.Packed, a_Data.Triangles);
+}
+
+void Mesh::Upload(const PackedMesh& a_Mesh, std::shared_ptr<TriangleBVH> a_pTriangles)
+{
+	m_dVertexCount = (int)a_Mesh.VertexCount;
+	m_dIndexCount = (int)a_Mesh.IndexCount;
+	m_lLods = a_Mesh.Lods;
+	m_v3BoundsCenter = a_Mesh.BoundsCenter;
+	m_fBoundsRadius = a_Mesh.BoundsRadius;
+	m_v3BoundsMin = a_Mesh.BoundsMin;
+	m_v3BoundsMax = a_Mesh.BoundsMax;
+	m_pTriangles = a_pTriangles != nullptr ? a_pTriangles : TriangleBVH::Create(a_Mesh);
+	CreateBuffers(a_Mesh.Format, a_Mesh.GetVertexData(), a_Mesh.GetIndexData());
+}
+
+void Mesh::CreateBuffers(VertexFormat a_Format, const void* a_pVertices, const void* a_pIndices)
+{
+	// Small meshes get away with 16 bit indices.
+	unsigned int uIndexStride = VertexPacker::GetIndexStride(m_dVertexCount);
+	m_VertexFormat = a_Format;
+	m_IndexFormat = uIndexStride == sizeof(uint16_t) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
 
 	// Setting up the vertex buffer description struct object.
 	D3D11_BUFFER_DESC vbd = {};
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex) * m_dVertexCount;
+	vbd.ByteWidth = VertexPacker::GetVertexStride(a_Format) * m_dVertexCount;
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
@@ -448,7 +510,7 @@ void Mesh::LoadObj(std::string a_sObjDirectory, std::string a_sObjName)
 	// Setting up the index buffer description struct object.
 	D3D11_BUFFER_DESC ibd = {};
 	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(unsigned int) * m_dIndexCount;
+	ibd.ByteWidth = uIndexStride * m_dIndexCount;
 	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	ibd.CPUAccessFlags = 0;
 	ibd.MiscFlags = 0;
@@ -459,75 +521,23 @@ void Mesh::LoadObj(std::string a_sObjDirectory, std::string a_sObjName)
 	D3D11_SUBRESOURCE_DATA initialIndexData = {};
 
 	// Setting the system memory to hold the buffer data.
-	initialVertexData.pSysMem = &lTempVertArr[0];
-	initialIndexData.pSysMem = &lTempIndexArr[0];
+	initialVertexData.pSysMem = a_pVertices;
+	initialIndexData.pSysMem = a_pIndices;
 
 	// Creating the buffers.
 	Graphics::GetDevice()->CreateBuffer(&vbd, &initialVertexData, m_pVertexBuffer.GetAddressOf());
 	Graphics::GetDevice()->CreateBuffer(&ibd, &initialIndexData, m_pIndexBuffer.GetAddressOf());
-
-	// Deleting the temporary arrays.
-	delete[] lTempIndexArr;
-	delete[] lTempVertArr;
 }
 
-void Mesh::CreateOutliner(std::shared_ptr<Mesh> a_pMesh, std::vector<Vector3> a_lPositions)
+void Mesh::CreateOutliner(std::shared_ptr<Mesh> a_pMesh)
 {
-	// X Values.
-	Vector3 v3Leftmost = VECTOR3_ZERO;
-	Vector3 v3Rightmost = VECTOR3_ZERO;
-
-	// Y Values.
-	Vector3 v3Lowest = VECTOR3_ZERO;
-	Vector3 v3Highest = VECTOR3_ZERO;
-
-	// Z Values.
-	Vector3 v3Backmost = VECTOR3_ZERO;
-	Vector3 v3Forwardmost = VECTOR3_ZERO;
-
-	// Looping and getting the furthest vertices for each mesh.
-	// Should be relatively efficient since it is mostly int comparisons.
-	for (int i = 0; i < a_lPositions.size(); i++)
-	{
-		Vector3 v3Current = a_lPositions[i];
-
-		if (v3Current.x < v3Leftmost.x)
-		{
-			v3Leftmost = v3Current;
-		}
-
-		if (v3Current.x > v3Rightmost.x)
-		{
-			v3Rightmost = v3Current;
-		}
-
-		if (v3Current.y > v3Highest.y)
-		{
-			v3Highest = v3Current;
-		}
-
-		if (v3Current.y < v3Lowest.y)
-		{
-			v3Lowest = v3Current;
-		}
-
-		if (v3Current.z > v3Backmost.z)
-		{
-			v3Backmost = v3Current;
-		}
-
-		if (v3Current.z < v3Forwardmost.z)
-		{
-			v3Forwardmost = v3Current;
-		}
-	}
-
-	float uWidth = v3Rightmost.x - v3Leftmost.x;
-	float uHeight = v3Highest.y - v3Lowest.y;
-	float uLength = v3Backmost.z - v3Forwardmost.z;
+	// The box computed when the mesh was packed, so meshes away from the origin are outlined correctly.
+	Vector3 v3BottomLeft = a_pMesh->GetBoundsMin();
+	Vector3 v3TopRight = a_pMesh->GetBoundsMax();
 
-	Vector3 v3BottomLeft = Vector3(v3Leftmost.x, v3Lowest.y, v3Forwardmost.z);
-	Vector3 v3TopRight = Vector3(v3Rightmost.x, v3Highest.y, v3Backmost.z);
+	float uWidth = v3TopRight.x - v3BottomLeft.x;
+	float uHeight = v3TopRight.y - v3BottomLeft.y;
+	float uLength = v3TopRight.z - v3BottomLeft.z;
 
 	std::vector<LineVertex> lLineVertices;
 
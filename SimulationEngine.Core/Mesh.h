@@ -9,6 +9,13 @@
 
 #include "Vertex.h"
 #include "Shader.h"
+#include "MeshCache.h"
+#include "VertexFormat.h"
+#include "Camera.h"
+#include "TriangleBVH.h"
+
+// How much of the screen's height an LOD's error may cover before a finer LOD is drawn.
+#define LOD_SCREEN_ERROR 0.001f
 
 typedef Microsoft::WRL::ComPtr<ID3D11Buffer> BufferPtr;
 
@@ -31,6 +38,27 @@ struct IndexPack
 	int IndexCount;
 };
 
+/// <summary>
+/// Fully processed mesh data waiting in system memory to be uploaded.
+/// Either holds the packed vertices/indices itself or the mapped cache they were read from.
+/// </summary>
+struct MeshData
+{
+	PackedMesh Packed;
+	std::shared_ptr<MeshCache> Cache = nullptr;
+	// The triangles for ray casts, built on the loading thread as well.
+	std::shared_ptr<TriangleBVH> Triangles = nullptr;
+};
+
+/// <summary>
+/// Reports how much a mesh shrank after having its duplicate vertices welded.
+/// </summary>
+struct WeldStats
+{
+	unsigned int VerticesBefore;
+	unsigned int VerticesAfter;
+};
+
 /// <summary>
 /// Specifies the types of calculation changes for Tangents.
 /// </summary>
@@ -48,12 +76,28 @@ class Mesh
 private:
 	BufferPtr m_pVertexBuffer;
 	BufferPtr m_pIndexBuffer;
-	int m_dIndexCount;
-	int m_dVertexCount;
+	int m_dIndexCount = 0;
+	int m_dVertexCount = 0;
+	VertexFormat m_VertexFormat = VertexFormat::Standard;
+	DXGI_FORMAT m_IndexFormat = DXGI_FORMAT_R32_UINT;
+	std::vector<MeshLod> m_lLods;
+	Vector3 m_v3BoundsCenter = Vector3(0.0f, 0.0f, 0.0f);
+	float m_fBoundsRadius = 0.0f;
+	Vector3 m_v3BoundsMin = Vector3(0.0f, 0.0f, 0.0f);
+	Vector3 m_v3BoundsMax = Vector3(0.0f, 0.0f, 0.0f);
+	// A copy of the full resolution triangles kept in system memory for ray casts.
+	std::shared_ptr<TriangleBVH> m_pTriangles = nullptr;
+	// Set when the data for this Mesh could not be loaded, so it is never going to be ready.
+	bool m_bFailed = false;
 
 public:
 
 	// Construction / Rule of Three:
+	/// <summary>
+	/// Constructs an empty Mesh that draws nothing until data is uploaded to it.
+	/// </summary>
+	Mesh(void);
+
 	/// <summary>
 	/// Constructs an instance of the Mesh class.
 	/// </summary>
@@ -61,7 +105,12 @@ public:
 	/// <param name="a_dVertexCount">The quantity of vertices in the array.</param>
 	/// <param name="a_pIndices">The indices inside of this instance of a Mesh object.</param>
 	/// <param name="a_dIndexCount">The amount of indices in the array.</param>
-	Mesh(VertexPack a_VertexData, IndexPack a_IndexData, TangentType a_TangentType = TangentType::Normal);
+	/// <param name="a_bOptimize">Whether to reorder the data for the vertex cache, overdraw and fetching and generate LODs before uploading it.</param>
+	Mesh(
+		VertexPack a_VertexData,
+		IndexPack a_IndexData,
+		TangentType a_TangentType = TangentType::Normal,
+		bool a_bOptimize = false);
 
 	/// <summary>
 	/// Loads in the vertices from an obj file.
@@ -109,15 +158,129 @@ public:
 	/// <returns>The amount of vertices in the Vertex Buffer.</returns>
 	int GetVertexCount(void);
 
+	/// <summary>
+	/// Retrieves the layout the vertices were uploaded in.
+	/// </summary>
+	/// <returns>The format of the Vertex Buffer.</returns>
+	VertexFormat GetVertexFormat(void) const;
+
+	/// <summary>
+	/// Retrieves the amount of levels of detail, counting the full resolution one.
+	/// </summary>
+	/// <returns>The amount of LODs.</returns>
+	unsigned int GetLodCount(void) const;
+
+	/// <summary>
+	/// Gets the smallest corner of the box around every vertex, in object space.
+	/// </summary>
+	Vector3 GetBoundsMin(void) const;
+
+	/// <summary>
+	/// Gets the largest corner of the box around every vertex, in object space.
+	/// </summary>
+	Vector3 GetBoundsMax(void) const;
+
+	/// <summary>
+	/// Gets the center of the sphere around every vertex, in object space.
+	/// </summary>
+	Vector3 GetBoundsCenter(void) const;
+
+	/// <summary>
+	/// Gets the radius of the sphere around every vertex, in object space.
+	/// </summary>
+	float GetBoundsRadius(void) const;
+
+	/// <summary>
+	/// Gets the hierarchy over the Mesh's full resolution triangles, or nullptr while it is still loading.
+	/// </summary>
+	std::shared_ptr<TriangleBVH> GetTriangles(void) const;
+
+	/// <summary>
+	/// Gets whether or not the Mesh has buffers to draw with yet.
+	/// </summary>
+	bool IsReady(void) const;
+
+	/// <summary>
+	/// Gets whether or not loading the Mesh failed.  Failed Meshes draw nothing and have empty bounds.
+	/// </summary>
+	bool IsFailed(void) const;
+
+	/// <summary>
+	/// Marks the Mesh as failed to load.  Must be called from the thread that owns the device.
+	/// </summary>
+	void MarkFailed(void);
+
+	/// <summary>
+	/// Picks the coarsest LOD whose error stays below LOD_SCREEN_ERROR of the screen's height.
+	/// </summary>
+	/// <param name="a_m4World">The world matrix the Mesh is drawn with.</param>
+	/// <param name="a_pCamera">The camera the Mesh is seen through.</param>
+	/// <returns>The LOD to draw.</returns>
+	unsigned int SelectLod(const Matrix4& a_m4World, std::shared_ptr<Camera> a_pCamera) const;
+
+	/// <summary>
+	/// Sets the buffers as the next thing to draw, switching the active Shader over to this Mesh's vertex format first.
+	/// </summary>
+	/// <returns>False if the Mesh is not ready yet or the active Shader cannot read its vertices.</returns>
+	bool Bind(void);
+
+	/// <summary>
+	/// Draws a level of detail out of the buffers set by Bind.
+	/// </summary>
+	/// <param name="a_uLod">The level of detail to draw, 0 being full resolution.</param>
+	void DrawIndexed(unsigned int a_uLod = 0);
+
+	/// <summary>
+	/// Draws a level of detail out of the buffers set by Bind once for every instance.
+	/// </summary>
+	/// <param name="a_uInstanceCount">How many instances to draw.</param>
+	/// <param name="a_uStartInstance">The first instance read out of the per-instance buffers.</param>
+	void DrawIndexedInstanced(unsigned int a_uLod, unsigned int a_uInstanceCount, unsigned int a_uStartInstance);
+
 	/// <summary>
 	/// Sets the buffers and draws with the proper amount of indices.
+	/// Switches the active Shader over to this Mesh's vertex format first.
+	/// Meshes that are not ready yet are skipped.
 	/// </summary>
-	void Draw(void);
+	/// <param name="a_uLod">The level of detail to draw, 0 being full resolution.</param>
+	void Draw(unsigned int a_uLod = 0);
 
 	/// <summary>
-	/// Generates a renderable area surrounding the passed in collection of positions.
+	/// Creates the GPU buffers out of data produced by ImportObj.
+	/// Must be called from the thread that owns the device.
 	/// </summary>
-	static void CreateOutliner(std::shared_ptr<Mesh> a_pMesh, std::vector<Vector3> a_lPositions);
+	void Upload(const MeshData& a_Data);
+
+	/// <summary>
+	/// Creates the GPU buffers out of already packed vertices, indices and LODs.
+	/// Must be called from the thread that owns the device.
+	/// </summary>
+	/// <param name="a_pTriangles">The triangles for ray casts when they were already built, otherwise they are built here.</param>
+	void Upload(const PackedMesh& a_Mesh, std::shared_ptr<TriangleBVH> a_pTriangles = nullptr);
+
+	/// <summary>
+	/// Reads, parses and fully processes an obj file without touching the device,
+	/// so it is safe to call from worker threads.  Cooked caches are used when up to date.
+	/// The vertices are packed into whichever VertexFormat suits them.
+	/// </summary>
+	static void ImportObj(const std::string& a_sObjPath, MeshData& a_Result);
+
+	/// <summary>
+	/// Calculates tangents, optimizes, generates LODs and packs the passed in vertices and indices.
+	/// Does not touch the device, so it is safe to call from worker threads.
+	/// </summary>
+	/// <param name="a_lVertices">The vertices, reordered and trimmed by the optimizer.</param>
+	/// <param name="a_lIndices">The indices, reordered by the optimizer.</param>
+	static void Prepare(
+		std::vector<Vertex>& a_lVertices,
+		std::vector<unsigned int>& a_lIndices,
+		TangentType a_TangentType,
+		PackedMesh& a_Result);
+
+	/// <summary>
+	/// Generates a renderable box around the Mesh's bounds.
+	/// </summary>
+	static void CreateOutliner(std::shared_ptr<Mesh> a_pMesh);
 
 	/// <summary>
 	/// Calculates the Tangents on a given mesh.
@@ -129,12 +292,32 @@ public:
 		int a_dIndexCount,
 		TangentType a_TangentType = TangentType::Normal);
 
+	/// <summary>
+	/// Picks the coarsest of the passed in LODs whose error stays below LOD_SCREEN_ERROR of the screen's height.
+	/// Shared with the AnimatedMesh.
+	/// </summary>
+	static unsigned int SelectLod(
+		const std::vector<MeshLod>& a_lLods,
+		const Vector3& a_v3BoundsCenter,
+		float a_fBoundsRadius,
+		const Matrix4& a_m4World,
+		std::shared_ptr<Camera> a_pCamera);
+
+	/// <summary>
+	/// Merges vertices with identical positions, normals and UVs and remaps the
+	/// indices to point at the shared copies.  Must happen before tangents are calculated.
+	/// </summary>
+	static WeldStats WeldVertices(
+		std::vector<Vertex>& a_lVertices,
+		std::vector<unsigned int>& a_lIndices);
+
 private:
 
 	/// <summary>
-	/// Loads an obj file's vertices from file.
+	/// Creates the immutable vertex and index buffers from the passed in, already packed data.
+	/// Uses the vertex and index counts already saved to the Mesh.
 	/// </summary>
-	void LoadObj(std::string a_sObjDirectory, std::string a_sObjName);
+	void CreateBuffers(VertexFormat a_Format, const void* a_pVertices, const void* a_pIndices);
 };
 
 #endif //__MESH_H_
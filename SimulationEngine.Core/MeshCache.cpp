@@ -0,0 +1,184 @@
+#include "MeshCache.h"
+#include "VertexPacker.h"
+
+#include <vector>
+#include <cstring>
+
+// Blobs are aligned so that the mapped data can be read directly.
+#define MESH_CACHE_ALIGNMENT 16
+
+namespace
+{
+	uint32_t AlignOffset(uint32_t a_uOffset)
+	{
+		return (a_uOffset + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1);
+	}
+}
+
+bool MeshCache::Load(const std::string& a_sSourceFile)
+{
+	m_pHeader = nullptr;
+	if (!m_File.Open(a_sSourceFile + MESH_CACHE_EXTENSION))
+	{
+		return false;
+	}
+
+	// Making sure that the file is actually a cooked mesh of this version.
+	const MeshCacheHeader* pHeader = reinterpret_cast<const MeshCacheHeader*>(m_File.GetData());
+	if (m_File.GetSize() < sizeof(MeshCacheHeader) ||
+		pHeader->Magic != MESH_CACHE_MAGIC ||
+		pHeader->Version != MESH_CACHE_VERSION ||
+		pHeader->Format >= VERTEX_FORMAT_COUNT ||
+		pHeader->VertexStride != VertexPacker::GetVertexStride((VertexFormat)pHeader->Format))
+	{
+		m_File.Close();
+		return false;
+	}
+
+	// Making sure that the blobs are actually inside of the file.
+	uint64_t uIndexStride = VertexPacker::GetIndexStride(pHeader->VertexCount);
+	uint64_t uVertexEnd = (uint64_t)pHeader->VertexOffset + (uint64_t)pHeader->VertexCount * pHeader->VertexStride;
+	uint64_t uIndexEnd = (uint64_t)pHeader->IndexOffset + (uint64_t)pHeader->IndexCount * uIndexStride;
+	uint64_t uLodEnd = (uint64_t)pHeader->LodOffset + (uint64_t)pHeader->LodCount * sizeof(MeshLod);
+	if (uVertexEnd > m_File.GetSize() || uIndexEnd > m_File.GetSize() || uLodEnd > m_File.GetSize() || pHeader->LodCount == 0)
+	{
+		m_File.Close();
+		return false;
+	}
+
+	// Making sure that every LOD only draws indices that are actually in the index blob.
+	const MeshLod* pLods = reinterpret_cast<const MeshLod*>(m_File.GetData() + pHeader->LodOffset);
+	for (uint32_t i = 0; i < pHeader->LodCount; i++)
+	{
+		if (pLods[i].IndexOffset > pHeader->IndexCount || pLods[i].IndexCount > pHeader->IndexCount - pLods[i].IndexOffset)
+		{
+			m_File.Close();
+			return false;
+		}
+	}
+
+	// Stale caches are rejected so that they get rebuilt from the source.
+	if (!IsSourceUnchanged(a_sSourceFile, *pHeader))
+	{
+		m_File.Close();
+		return false;
+	}
+
+	m_pHeader = pHeader;
+	return true;
+}
+
+const void* MeshCache::GetVertexData(void) const
+{
+	return m_File.GetData() + m_pHeader->VertexOffset;
+}
+
+const void* MeshCache::GetIndexData(void) const
+{
+	return m_File.GetData() + m_pHeader->IndexOffset;
+}
+
+VertexFormat MeshCache::GetVertexFormat(void) const { return (VertexFormat)m_pHeader->Format; }
+
+const MeshLod* MeshCache::GetLods(void) const
+{
+	return reinterpret_cast<const MeshLod*>(m_File.GetData() + m_pHeader->LodOffset);
+}
+
+int MeshCache::GetLodCount(void) const { return (int)m_pHeader->LodCount; }
+
+Vector3 MeshCache::GetBoundsCenter(void) const
+{
+	return Vector3(m_pHeader->BoundsCenter[0], m_pHeader->BoundsCenter[1], m_pHeader->BoundsCenter[2]);
+}
+
+float MeshCache::GetBoundsRadius(void) const { return m_pHeader->BoundsRadius; }
+
+Vector3 MeshCache::GetBoundsMin(void) const
+{
+	return Vector3(m_pHeader->BoundsMin[0], m_pHeader->BoundsMin[1], m_pHeader->BoundsMin[2]);
+}
+
+Vector3 MeshCache::GetBoundsMax(void) const
+{
+	return Vector3(m_pHeader->BoundsMax[0], m_pHeader->BoundsMax[1], m_pHeader->BoundsMax[2]);
+}
+
+int MeshCache::GetVertexCount(void) const { return (int)m_pHeader->VertexCount; }
+int MeshCache::GetIndexCount(void) const { return (int)m_pHeader->IndexCount; }
+
+bool MeshCache::Write(const std::string& a_sSourceFile, const PackedMesh& a_Mesh)
+{
+	MeshCacheHeader header{};
+	uint64_t uStampSize = 0;
+	if (!HashSource(a_sSourceFile, header.SourceHash, header.SourceSize) ||
+		!MappedFile::GetFileStamp(a_sSourceFile, uStampSize, header.SourceWriteTime))
+	{
+		return false;
+	}
+
+	// Laying out the file: header, vertex blob, index blob, LOD table.
+	header.Magic = MESH_CACHE_MAGIC;
+	header.Version = MESH_CACHE_VERSION;
+	header.Format = (uint32_t)a_Mesh.Format;
+	header.VertexStride = VertexPacker::GetVertexStride(a_Mesh.Format);
+	header.VertexCount = a_Mesh.VertexCount;
+	header.IndexCount = a_Mesh.IndexCount;
+	header.VertexOffset = AlignOffset(sizeof(MeshCacheHeader));
+	header.IndexOffset = AlignOffset(header.VertexOffset + (uint32_t)a_Mesh.Vertices.size());
+	header.LodCount = (uint32_t)a_Mesh.Lods.size();
+	header.LodOffset = AlignOffset(header.IndexOffset + (uint32_t)a_Mesh.Indices.size());
+	header.BoundsCenter[0] = a_Mesh.BoundsCenter.x;
+	header.BoundsCenter[1] = a_Mesh.BoundsCenter.y;
+	header.BoundsCenter[2] = a_Mesh.BoundsCenter.z;
+	header.BoundsRadius = a_Mesh.BoundsRadius;
+	header.BoundsMin[0] = a_Mesh.BoundsMin.x;
+	header.BoundsMin[1] = a_Mesh.BoundsMin.y;
+	header.BoundsMin[2] = a_Mesh.BoundsMin.z;
+	header.BoundsMax[0] = a_Mesh.BoundsMax.x;
+	header.BoundsMax[1] = a_Mesh.BoundsMax.y;
+	header.BoundsMax[2] = a_Mesh.BoundsMax.z;
+
+	size_t uFileSize = header.LodOffset + a_Mesh.Lods.size() * sizeof(MeshLod);
+	std::vector<unsigned char> lBytes(uFileSize, 0);
+
+	std::memcpy(&lBytes[0], &header, sizeof(MeshCacheHeader));
+	std::memcpy(&lBytes[header.VertexOffset], a_Mesh.Vertices.data(), a_Mesh.Vertices.size());
+	std::memcpy(&lBytes[header.IndexOffset], a_Mesh.Indices.data(), a_Mesh.Indices.size());
+	std::memcpy(&lBytes[header.LodOffset], a_Mesh.Lods.data(), a_Mesh.Lods.size() * sizeof(MeshLod));
+
+	return MappedFile::WriteToDisk(a_sSourceFile + MESH_CACHE_EXTENSION, lBytes.data(), lBytes.size());
+}
+
+bool MeshCache::HashSource(const std::string& a_sSourceFile, uint64_t& a_uHash, uint64_t& a_uSize)
+{
+	MappedFile source(a_sSourceFile);
+	if (!source.IsOpen())
+	{
+		return false;
+	}
+
+	a_uHash = source.HashContents();
+	a_uSize = source.GetSize();
+	return true;
+}
+
+bool MeshCache::IsSourceUnchanged(const std::string& a_sSourceFile, const MeshCacheHeader& a_Header)
+{
+	uint64_t uSize = 0;
+	uint64_t uWriteTime = 0;
+	if (!MappedFile::GetFileStamp(a_sSourceFile, uSize, uWriteTime) || uSize != a_Header.SourceSize)
+	{
+		return false;
+	}
+
+	// An untouched source needs no reading at all.  A touched one of the same size may still hold
+	// the same bytes (checkouts, copies), so only then is the whole file hashed to be sure.
+	if (uWriteTime == a_Header.SourceWriteTime)
+	{
+		return true;
+	}
+
+	uint64_t uHash = 0;
+	return HashSource(a_sSourceFile, uHash, uSize) && uHash == a_Header.SourceHash && uSize == a_Header.SourceSize;
+}
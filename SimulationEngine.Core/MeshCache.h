@@ -0,0 +1,135 @@
+#ifndef __MESHCACHE_H_
+#define __MESHCACHE_H_
+
+#include <string>
+#include <cstdint>
+
+#include "MappedFile.h"
+#include "VertexFormat.h"
+
+// Cooked meshes are written next to their source file with this ending.
+#define MESH_CACHE_EXTENSION ".meshcache"
+
+// "DXMC" in little endian.
+#define MESH_CACHE_MAGIC 0x434D5844
+// Bump whenever the cooked layout or the import pipeline changes.
+#define MESH_CACHE_VERSION 8
+
+/// <summary>
+/// The header at the very start of a cooked mesh file.
+/// The vertex blob (already packed into its VertexFormat), the index blob
+/// (16 bit when the vertex count allows it, every LOD back to back) and the
+/// table of LODs follow at the stored byte offsets.
+/// </summary>
+struct MeshCacheHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t SourceHash;
+	uint64_t SourceSize;
+	uint64_t SourceWriteTime;
+	uint32_t VertexStride;
+	uint32_t VertexCount;
+	uint32_t IndexCount;
+	uint32_t VertexOffset;
+	uint32_t IndexOffset;
+	uint32_t Format;
+	uint32_t LodCount;
+	uint32_t LodOffset;
+	float BoundsCenter[3];
+	float BoundsRadius;
+	float BoundsMin[3];
+	float BoundsMax[3];
+};
+
+/// <summary>
+/// Reads and writes the cooked binary form of an obj mesh.  Loaded caches are
+/// memory-mapped so their vertex/index data can go straight to the GPU.
+/// </summary>
+class MeshCache
+{
+private:
+	MappedFile m_File;
+	const MeshCacheHeader* m_pHeader = nullptr;
+
+public:
+	/// <summary>
+	/// Maps the cache belonging to the passed in source file.  Returns false if
+	/// the cache does not exist, is corrupt, or was cooked from a different source.
+	/// The source is only read and hashed when its size matches but its write time does not.
+	/// </summary>
+	bool Load(const std::string& a_sSourceFile);
+
+	/// <summary>
+	/// Gets the mapped, ready to upload vertices.
+	/// </summary>
+	const void* GetVertexData(void) const;
+
+	/// <summary>
+	/// Gets the mapped, ready to upload indices.
+	/// </summary>
+	const void* GetIndexData(void) const;
+
+	/// <summary>
+	/// Gets the layout the vertices were packed into.
+	/// </summary>
+	VertexFormat GetVertexFormat(void) const;
+
+	/// <summary>
+	/// Gets the mapped table of LODs, the full resolution one first.
+	/// </summary>
+	const MeshLod* GetLods(void) const;
+
+	/// <summary>
+	/// Gets the amount of LODs in the cache.
+	/// </summary>
+	int GetLodCount(void) const;
+
+	/// <summary>
+	/// Gets the center of the sphere around every vertex.
+	/// </summary>
+	Vector3 GetBoundsCenter(void) const;
+
+	/// <summary>
+	/// Gets the radius of the sphere around every vertex.
+	/// </summary>
+	float GetBoundsRadius(void) const;
+
+	/// <summary>
+	/// Gets the smallest corner of the box around every vertex.
+	/// </summary>
+	Vector3 GetBoundsMin(void) const;
+
+	/// <summary>
+	/// Gets the largest corner of the box around every vertex.
+	/// </summary>
+	Vector3 GetBoundsMax(void) const;
+
+	/// <summary>
+	/// Gets the amount of vertices in the cache.
+	/// </summary>
+	int GetVertexCount(void) const;
+
+	/// <summary>
+	/// Gets the amount of indices in the cache.
+	/// </summary>
+	int GetIndexCount(void) const;
+
+	/// <summary>
+	/// Cooks the passed in mesh data into a cache file next to the source file.
+	/// </summary>
+	static bool Write(const std::string& a_sSourceFile, const PackedMesh& a_Mesh);
+
+private:
+	/// <summary>
+	/// Hashes the source file the cache is validated against.
+	/// </summary>
+	static bool HashSource(const std::string& a_sSourceFile, uint64_t& a_uHash, uint64_t& a_uSize);
+
+	/// <summary>
+	/// Checks the source file against the size, write time and hash it was cooked from.
+	/// </summary>
+	static bool IsSourceUnchanged(const std::string& a_sSourceFile, const MeshCacheHeader& a_Header);
+};
+
+#endif //__MESHCACHE_H_
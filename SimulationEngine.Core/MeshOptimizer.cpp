@@ -0,0 +1,412 @@
+#include "MeshOptimizer.h"
+#include "Logger.h"
+
+#include <cmath>
+#include <algorithm>
+
+// Forsyth's scoring settings.  The cache modelled while scoring is larger than the one
+// measured since the order should hold up on hardware with bigger caches as well.
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_LAST_TRIANGLE_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+
+namespace
+{
+	/// <summary>
+	/// Scores for a vertex based on its position in the modelled cache.
+	/// </summary>
+	struct CacheScores
+	{
+		float Position[FORSYTH_CACHE_SIZE];
+
+		CacheScores(void)
+		{
+			for (int i = 0; i < FORSYTH_CACHE_SIZE; i++)
+			{
+				// The last triangle's vertices get a fixed score so it is not immediately reused.
+				Position[i] = i < 3 ? FORSYTH_LAST_TRIANGLE_SCORE :
+					std::pow(1.0f - (i - 3) / (float)(FORSYTH_CACHE_SIZE - 3), FORSYTH_CACHE_DECAY_POWER);
+			}
+		}
+	};
+
+	/// <summary>
+	/// How much a vertex wants to be used next.  Vertices in the cache and vertices with
+	/// few triangles left score higher, so lone triangles do not get stranded.
+	/// </summary>
+	float GetVertexScore(int a_dCachePosition, unsigned int a_uRemaining)
+	{
+		static const CacheScores scores;
+		if (a_uRemaining == 0)
+		{
+			return -1.0f;
+		}
+
+		float fScore = a_dCachePosition >= 0 ? scores.Position[a_dCachePosition] : 0.0f;
+		return fScore + FORSYTH_VALENCE_BOOST_SCALE * std::pow((float)a_uRemaining, -FORSYTH_VALENCE_BOOST_POWER);
+	}
+
+	/// <summary>
+	/// A FIFO post-transform cache, using timestamps so that resetting it is free.
+	/// </summary>
+	struct FifoCache
+	{
+		std::vector<unsigned int> Timestamps;
+		unsigned int Time = VERTEX_CACHE_SIZE + 1;
+
+		FifoCache(unsigned int a_uVertexCount) : Timestamps(a_uVertexCount, 0) {}
+
+		/// <summary>
+		/// Feeds a vertex through the cache.  Returns true if it had to be transformed.
+		/// </summary>
+		bool Miss(unsigned int a_uVertex)
+		{
+			if (Time - Timestamps[a_uVertex] > VERTEX_CACHE_SIZE)
+			{
+				Timestamps[a_uVertex] = Time++;
+				return true;
+			}
+			return false;
+		}
+
+		void Reset(void) { Time += VERTEX_CACHE_SIZE + 1; }
+	};
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<unsigned int>& a_lIndices, unsigned int a_uVertexCount)
+{
+	unsigned int uTriangleCount = (unsigned int)(a_lIndices.size() / 3);
+	if (uTriangleCount == 0)
+	{
+		return;
+	}
+
+	// Building the list of triangles that use each vertex.
+	std::vector<unsigned int> lRemaining(a_uVertexCount, 0);
+	for (unsigned int index : a_lIndices)
+	{
+		lRemaining[index]++;
+	}
+
+	std::vector<unsigned int> lOffsets(a_uVertexCount + 1, 0);
+	for (unsigned int v = 0; v < a_uVertexCount; v++)
+	{
+		lOffsets[v + 1] = lOffsets[v] + lRemaining[v];
+	}
+
+	std::vector<unsigned int> lAdjacency(a_lIndices.size());
+	std::vector<unsigned int> lFilled(a_uVertexCount, 0);
+	for (unsigned int t = 0; t < uTriangleCount; t++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = a_lIndices[t * 3 + c];
+			lAdjacency[lOffsets[v] + lFilled[v]++] = t;
+		}
+	}
+
+	std::vector<int> lCachePositions(a_uVertexCount, -1);
+	std::vector<float> lVertexScores(a_uVertexCount);
+	for (unsigned int v = 0; v < a_uVertexCount; v++)
+	{
+		lVertexScores[v] = GetVertexScore(-1, lRemaining[v]);
+	}
+
+	// Only the starting triangle needs every score, the rest are scored as the cache reaches them.
+	std::vector<float> lTriangleScores(uTriangleCount);
+	std::vector<bool> lEmitted(uTriangleCount, false);
+	for (unsigned int t = 0; t < uTriangleCount; t++)
+	{
+		lTriangleScores[t] = lVertexScores[a_lIndices[t * 3]] +
+			lVertexScores[a_lIndices[t * 3 + 1]] +
+			lVertexScores[a_lIndices[t * 3 + 2]];
+	}
+
+	std::vector<unsigned int> lResult;
+	lResult.reserve(a_lIndices.size());
+
+	std::vector<unsigned int> lCache;
+	std::vector<unsigned int> lNextCache;
+	lCache.reserve(FORSYTH_CACHE_SIZE + 3);
+	lNextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+	// Starting from the best triangle overall.
+	int dBest = (int)(std::max_element(lTriangleScores.begin(), lTriangleScores.end()) - lTriangleScores.begin());
+	unsigned int uCursor = 0;
+
+	for (unsigned int uEmitted = 0; uEmitted < uTriangleCount; uEmitted++)
+	{
+		// Dead end: nothing in the cache connects to a remaining triangle, so picking up
+		// the next one in the input order keeps the whole pass linear.
+		if (dBest < 0)
+		{
+			while (lEmitted[uCursor])
+			{
+				uCursor++;
+			}
+			dBest = (int)uCursor;
+		}
+
+		unsigned int t = (unsigned int)dBest;
+		lEmitted[t] = true;
+		const unsigned int* pTriangle = &a_lIndices[t * 3];
+		lResult.insert(lResult.end(), pTriangle, pTriangle + 3);
+
+		// Removing the triangle from its vertices' lists.
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = pTriangle[c];
+			unsigned int* pBegin = &lAdjacency[lOffsets[v]];
+			unsigned int* pEnd = pBegin + lRemaining[v];
+			*std::find(pBegin, pEnd, t) = *(pEnd - 1);
+			lRemaining[v]--;
+		}
+
+		// The triangle's vertices move to the front of the cache, pushing the rest back.
+		lNextCache.assign(pTriangle, pTriangle + 3);
+		for (unsigned int v : lCache)
+		{
+			if (v != pTriangle[0] && v != pTriangle[1] && v != pTriangle[2])
+			{
+				lNextCache.push_back(v);
+			}
+		}
+
+		// Rescoring everything that moved, including the vertices that fell out of the cache.
+		for (size_t i = 0; i < lNextCache.size(); i++)
+		{
+			unsigned int v = lNextCache[i];
+			lCachePositions[v] = i < FORSYTH_CACHE_SIZE ? (int)i : -1;
+			lVertexScores[v] = GetVertexScore(lCachePositions[v], lRemaining[v]);
+		}
+		if (lNextCache.size() > FORSYTH_CACHE_SIZE)
+		{
+			lNextCache.resize(FORSYTH_CACHE_SIZE);
+		}
+		lCache.swap(lNextCache);
+
+		// The next triangle is the best one touching the cache.
+		dBest = -1;
+		float fBestScore = -1.0f;
+		for (unsigned int v : lCache)
+		{
+			for (unsigned int a = lOffsets[v]; a < lOffsets[v] + lRemaining[v]; a++)
+			{
+				unsigned int uTriangle = lAdjacency[a];
+				float fScore = lVertexScores[a_lIndices[uTriangle * 3]] +
+					lVertexScores[a_lIndices[uTriangle * 3 + 1]] +
+					lVertexScores[a_lIndices[uTriangle * 3 + 2]];
+
+				if (fScore > fBestScore)
+				{
+					fBestScore = fScore;
+					dBest = (int)uTriangle;
+				}
+			}
+		}
+	}
+
+	a_lIndices.swap(lResult);
+}
+
+void MeshOptimizer::OptimizeOverdraw(
+	std::vector<unsigned int>& a_lIndices,
+	const std::vector<Vector3>& a_lPositions,
+	float a_fThreshold)
+{
+	unsigned int uTriangleCount = (unsigned int)(a_lIndices.size() / 3);
+	if (uTriangleCount == 0)
+	{
+		return;
+	}
+
+	// Hard boundaries: where the cache order had to jump and all three vertices missed.
+	std::vector<unsigned int> lHard;
+	FifoCache cache((unsigned int)a_lPositions.size());
+	for (unsigned int t = 0; t < uTriangleCount; t++)
+	{
+		unsigned int uMisses = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			uMisses += cache.Miss(a_lIndices[t * 3 + c]) ? 1 : 0;
+		}
+		if (t == 0 || uMisses == 3)
+		{
+			lHard.push_back(t);
+		}
+	}
+	lHard.push_back(uTriangleCount);
+
+	// Soft boundaries: splitting the hard clusters further wherever doing so barely hurts the cache.
+	std::vector<unsigned int> lClusters;
+	for (size_t h = 0; h + 1 < lHard.size(); h++)
+	{
+		unsigned int uStart = lHard[h];
+		unsigned int uEnd = lHard[h + 1];
+
+		cache.Reset();
+		unsigned int uClusterMisses = 0;
+		for (unsigned int t = uStart; t < uEnd; t++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				uClusterMisses += cache.Miss(a_lIndices[t * 3 + c]) ? 1 : 0;
+			}
+		}
+		float fLimit = uClusterMisses / (float)(uEnd - uStart) * a_fThreshold;
+
+		cache.Reset();
+		lClusters.push_back(uStart);
+		unsigned int uMisses = 0;
+		unsigned int uSubStart = uStart;
+		for (unsigned int t = uStart; t < uEnd; t++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				uMisses += cache.Miss(a_lIndices[t * 3 + c]) ? 1 : 0;
+			}
+
+			// Only splitting once the cluster so far is about as cache friendly as the whole.
+			if (t + 1 < uEnd && uMisses / (float)(t + 1 - uSubStart) <= fLimit)
+			{
+				lClusters.push_back(t + 1);
+				uSubStart = t + 1;
+				uMisses = 0;
+				cache.Reset();
+			}
+		}
+	}
+	lClusters.push_back(uTriangleCount);
+
+	// The mesh's center, weighted by triangle area.
+	Vector3 v3MeshCenter(0.0f, 0.0f, 0.0f);
+	float fMeshArea = 0.0f;
+	std::vector<Vector3> lCenters(lClusters.size() - 1);
+	std::vector<Vector3> lNormals(lClusters.size() - 1);
+
+	for (size_t k = 0; k + 1 < lClusters.size(); k++)
+	{
+		Vector3 v3Center(0.0f, 0.0f, 0.0f);
+		Vector3 v3Normal(0.0f, 0.0f, 0.0f);
+		float fArea = 0.0f;
+
+		for (unsigned int t = lClusters[k]; t < lClusters[k + 1]; t++)
+		{
+			const Vector3& a = a_lPositions[a_lIndices[t * 3]];
+			const Vector3& b = a_lPositions[a_lIndices[t * 3 + 1]];
+			const Vector3& c = a_lPositions[a_lIndices[t * 3 + 2]];
+
+			// Clockwise front faces, so this points out of the surface.
+			float fX = (b.y - a.y) * (c.z - a.z) - (b.z - a.z) * (c.y - a.y);
+			float fY = (b.z - a.z) * (c.x - a.x) - (b.x - a.x) * (c.z - a.z);
+			float fZ = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+			float fTriangleArea = std::sqrt(fX * fX + fY * fY + fZ * fZ);
+
+			v3Center.x += (a.x + b.x + c.x) / 3.0f * fTriangleArea;
+			v3Center.y += (a.y + b.y + c.y) / 3.0f * fTriangleArea;
+			v3Center.z += (a.z + b.z + c.z) / 3.0f * fTriangleArea;
+			v3Normal.x += fX;
+			v3Normal.y += fY;
+			v3Normal.z += fZ;
+			fArea += fTriangleArea;
+		}
+
+		v3MeshCenter.x += v3Center.x;
+		v3MeshCenter.y += v3Center.y;
+		v3MeshCenter.z += v3Center.z;
+		fMeshArea += fArea;
+
+		float fInverseArea = fArea > 0.0f ? 1.0f / fArea : 0.0f;
+		lCenters[k] = Vector3(v3Center.x * fInverseArea, v3Center.y * fInverseArea, v3Center.z * fInverseArea);
+
+		float fLength = std::sqrt(v3Normal.x * v3Normal.x + v3Normal.y * v3Normal.y + v3Normal.z * v3Normal.z);
+		float fInverseLength = fLength > 0.0f ? 1.0f / fLength : 0.0f;
+		lNormals[k] = Vector3(v3Normal.x * fInverseLength, v3Normal.y * fInverseLength, v3Normal.z * fInverseLength);
+	}
+
+	float fInverseMeshArea = fMeshArea > 0.0f ? 1.0f / fMeshArea : 0.0f;
+	v3MeshCenter = Vector3(v3MeshCenter.x * fInverseMeshArea, v3MeshCenter.y * fInverseMeshArea, v3MeshCenter.z * fInverseMeshArea);
+
+	// Clusters that sit far out along their own normal are likely to occlude the others.
+	std::vector<float> lKeys(lCenters.size());
+	std::vector<unsigned int> lOrder(lCenters.size());
+	for (size_t k = 0; k < lCenters.size(); k++)
+	{
+		lKeys[k] = (lCenters[k].x - v3MeshCenter.x) * lNormals[k].x +
+			(lCenters[k].y - v3MeshCenter.y) * lNormals[k].y +
+			(lCenters[k].z - v3MeshCenter.z) * lNormals[k].z;
+		lOrder[k] = (unsigned int)k;
+	}
+	std::stable_sort(lOrder.begin(), lOrder.end(), [&](unsigned int a_uLeft, unsigned int a_uRight)
+		{
+			return lKeys[a_uLeft] > lKeys[a_uRight];
+		});
+
+	std::vector<unsigned int> lResult;
+	lResult.reserve(a_lIndices.size());
+	for (unsigned int k : lOrder)
+	{
+		lResult.insert(lResult.end(), a_lIndices.begin() + lClusters[k] * 3, a_lIndices.begin() + lClusters[k + 1] * 3);
+	}
+	a_lIndices.swap(lResult);
+}
+
+std::vector<unsigned int> MeshOptimizer::OptimizeVertexFetch(std::vector<unsigned int>& a_lIndices, unsigned int a_uVertexCount)
+{
+	std::vector<unsigned int> lRemap(a_uVertexCount, UNUSED_VERTEX);
+	unsigned int uNext = 0;
+
+	for (unsigned int& index : a_lIndices)
+	{
+		if (lRemap[index] == UNUSED_VERTEX)
+		{
+			lRemap[index] = uNext++;
+		}
+		index = lRemap[index];
+	}
+
+	return lRemap;
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const std::vector<unsigned int>& a_lIndices, unsigned int a_uVertexCount)
+{
+	VertexCacheStats stats;
+	if (a_lIndices.empty())
+	{
+		return stats;
+	}
+
+	FifoCache cache(a_uVertexCount);
+	std::vector<bool> lUsed(a_uVertexCount, false);
+	unsigned int uUsed = 0;
+
+	for (unsigned int index : a_lIndices)
+	{
+		stats.Transformed += cache.Miss(index) ? 1 : 0;
+		if (!lUsed[index])
+		{
+			lUsed[index] = true;
+			uUsed++;
+		}
+	}
+
+	stats.ACMR = stats.Transformed / (a_lIndices.size() / 3.0f);
+	stats.ATVR = stats.Transformed / (float)uUsed;
+	return stats;
+}
+
+size_t MeshOptimizer::CountReferenced(const std::vector<unsigned int>& a_lRemap)
+{
+	return a_lRemap.size() - std::count(a_lRemap.begin(), a_lRemap.end(), UNUSED_VERTEX);
+}
+
+void MeshOptimizer::LogStats(const MeshOptimizeStats& a_Stats)
+{
+	Logger::GetInstance()->Log(
+		"MeshOptimizer.cpp",
+		"Optimized mesh: ACMR " + std::to_string(a_Stats.Before.ACMR) + " -> " + std::to_string(a_Stats.After.ACMR) +
+		", ATVR " + std::to_string(a_Stats.Before.ATVR) + " -> " + std::to_string(a_Stats.After.ATVR),
+		DEBUG_LOG);
+}
@@ -0,0 +1,125 @@
+#ifndef __MESHOPTIMIZER_H_
+#define __MESHOPTIMIZER_H_
+
+#include <vector>
+#include <string>
+
+#include "Vectors.h"
+
+// Size of the FIFO post-transform cache the statistics are measured against.
+#define VERTEX_CACHE_SIZE 16
+
+// How much worse than its cluster's ACMR a split is allowed to make the vertex cache.
+#define OVERDRAW_THRESHOLD 1.05f
+
+/// <summary>
+/// How well an index buffer uses the post-transform vertex cache.
+/// </summary>
+struct VertexCacheStats
+{
+	// Average cache miss ratio: vertex shader invocations per triangle (0.5 is ideal, 3 is the worst).
+	float ACMR = 0.0f;
+	// Average transform to vertex ratio: vertex shader invocations per vertex (1 is ideal).
+	float ATVR = 0.0f;
+	unsigned int Transformed = 0;
+};
+
+/// <summary>
+/// The vertex cache statistics of a mesh before and after it was optimized.
+/// </summary>
+struct MeshOptimizeStats
+{
+	VertexCacheStats Before;
+	VertexCacheStats After;
+};
+
+/// <summary>
+/// Reorders mesh data at build time so that the GPU does less work drawing it:
+/// triangles are ordered for the post-transform cache, clusters of them for less
+/// overdraw, and the vertices for linear fetching.  Nothing in here touches the device.
+/// </summary>
+class MeshOptimizer
+{
+public:
+	/// <summary>
+	/// Marks vertices that OptimizeVertexFetch dropped.
+	/// </summary>
+	static const unsigned int UNUSED_VERTEX = 0xFFFFFFFF;
+
+	/// <summary>
+	/// Runs every optimization on a mesh in place, logging the before and after statistics.
+	/// The vertex type only needs a Position member.  Unreferenced vertices are dropped.
+	/// </summary>
+	template <typename V>
+	static MeshOptimizeStats Optimize(std::vector<V>& a_lVertices, std::vector<unsigned int>& a_lIndices)
+	{
+		MeshOptimizeStats stats;
+		unsigned int uVertexCount = (unsigned int)a_lVertices.size();
+		stats.Before = AnalyzeVertexCache(a_lIndices, uVertexCount);
+
+		std::vector<Vector3> lPositions(a_lVertices.size());
+		for (size_t i = 0; i < a_lVertices.size(); i++)
+		{
+			lPositions[i] = a_lVertices[i].Position;
+		}
+
+		OptimizeVertexCache(a_lIndices, uVertexCount);
+		OptimizeOverdraw(a_lIndices, lPositions, OVERDRAW_THRESHOLD);
+
+		// Moving the vertices to where the rewritten indices now expect them.
+		std::vector<unsigned int> lRemap = OptimizeVertexFetch(a_lIndices, uVertexCount);
+		std::vector<V> lReordered(CountReferenced(lRemap));
+		for (size_t i = 0; i < lRemap.size(); i++)
+		{
+			if (lRemap[i] != UNUSED_VERTEX)
+			{
+				lReordered[lRemap[i]] = a_lVertices[i];
+			}
+		}
+		a_lVertices.swap(lReordered);
+
+		stats.After = AnalyzeVertexCache(a_lIndices, (unsigned int)a_lVertices.size());
+		LogStats(stats);
+		return stats;
+	}
+
+	/// <summary>
+	/// Reorders the triangles so that consecutive triangles share as many vertices as possible
+	/// (Tom Forsyth's linear-speed vertex cache optimisation).
+	/// </summary>
+	static void OptimizeVertexCache(std::vector<unsigned int>& a_lIndices, unsigned int a_uVertexCount);
+
+	/// <summary>
+	/// Splits a cache optimized index buffer into clusters and orders them so that the ones facing
+	/// outwards the most are drawn first, which lets the depth test reject more of what follows.
+	/// Splits only happen where they cost less than a_fThreshold times the cluster's ACMR.
+	/// </summary>
+	static void OptimizeOverdraw(
+		std::vector<unsigned int>& a_lIndices,
+		const std::vector<Vector3>& a_lPositions,
+		float a_fThreshold);
+
+	/// <summary>
+	/// Renumbers the vertices in the order the indices first use them so that fetching is linear.
+	/// </summary>
+	/// <returns>Maps each old vertex to its new position, or UNUSED_VERTEX if no triangle uses it.</returns>
+	static std::vector<unsigned int> OptimizeVertexFetch(std::vector<unsigned int>& a_lIndices, unsigned int a_uVertexCount);
+
+	/// <summary>
+	/// Simulates a FIFO post-transform cache of VERTEX_CACHE_SIZE entries over an index buffer.
+	/// </summary>
+	static VertexCacheStats AnalyzeVertexCache(const std::vector<unsigned int>& a_lIndices, unsigned int a_uVertexCount);
+
+private:
+	/// <summary>
+	/// Counts how many vertices survive a remap.
+	/// </summary>
+	static size_t CountReferenced(const std::vector<unsigned int>& a_lRemap);
+
+	/// <summary>
+	/// Writes the statistics of an optimized mesh to the Logger.
+	/// </summary>
+	static void LogStats(const MeshOptimizeStats& a_Stats);
+};
+
+#endif //__MESHOPTIMIZER_H_
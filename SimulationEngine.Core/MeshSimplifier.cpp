@@ -0,0 +1,600 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "Logger.h"
+
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+namespace
+{
+	/// <summary>
+	/// How freely a vertex may be collapsed.
+	/// </summary>
+	enum class VertexKind : unsigned char
+	{
+		// Surrounded by triangles, may collapse onto any neighbour.
+		Manifold,
+		// On an open border, may only slide along it.
+		Border,
+		// On an attribute seam, a non-manifold edge or a border corner.  Never moves.
+		Locked
+	};
+
+	/// <summary>
+	/// A symmetric 4x4 error quadric (Garland and Heckbert), along with the total weight
+	/// of the planes in it so that the error comes out as a squared distance.
+	/// </summary>
+	struct Quadric
+	{
+		double A00 = 0.0, A11 = 0.0, A22 = 0.0;
+		double A01 = 0.0, A02 = 0.0, A12 = 0.0;
+		double B0 = 0.0, B1 = 0.0, B2 = 0.0;
+		double C = 0.0;
+		double Weight = 0.0;
+
+		void AddPlane(double a_dX, double a_dY, double a_dZ, double a_dD, double a_dWeight)
+		{
+			A00 += a_dWeight * a_dX * a_dX;
+			A11 += a_dWeight * a_dY * a_dY;
+			A22 += a_dWeight * a_dZ * a_dZ;
+			A01 += a_dWeight * a_dX * a_dY;
+			A02 += a_dWeight * a_dX * a_dZ;
+			A12 += a_dWeight * a_dY * a_dZ;
+			B0 += a_dWeight * a_dX * a_dD;
+			B1 += a_dWeight * a_dY * a_dD;
+			B2 += a_dWeight * a_dZ * a_dD;
+			C += a_dWeight * a_dD * a_dD;
+			Weight += a_dWeight;
+		}
+
+		void Add(const Quadric& a_Other)
+		{
+			A00 += a_Other.A00; A11 += a_Other.A11; A22 += a_Other.A22;
+			A01 += a_Other.A01; A02 += a_Other.A02; A12 += a_Other.A12;
+			B0 += a_Other.B0; B1 += a_Other.B1; B2 += a_Other.B2;
+			C += a_Other.C;
+			Weight += a_Other.Weight;
+		}
+
+		double Evaluate(const Vector3& a_v3Point) const
+		{
+			double x = a_v3Point.x, y = a_v3Point.y, z = a_v3Point.z;
+			double dError =
+				A00 * x * x + A11 * y * y + A22 * z * z +
+				2.0 * (A01 * x * y + A02 * x * z + A12 * y * z) +
+				2.0 * (B0 * x + B1 * y + B2 * z) +
+				C;
+			return Weight > 0.0 ? std::max(dError, 0.0) / Weight : 0.0;
+		}
+	};
+
+	/// <summary>
+	/// A vertex collapsing onto a neighbour, and what that costs.
+	/// </summary>
+	struct Collapse
+	{
+		unsigned int Source;
+		unsigned int Target;
+		float Cost;
+	};
+
+	Vector3 Subtract(const Vector3& a_v3A, const Vector3& a_v3B)
+	{
+		return Vector3(a_v3A.x - a_v3B.x, a_v3A.y - a_v3B.y, a_v3A.z - a_v3B.z);
+	}
+
+	Vector3 Cross(const Vector3& a_v3A, const Vector3& a_v3B)
+	{
+		return Vector3(
+			a_v3A.y * a_v3B.z - a_v3A.z * a_v3B.y,
+			a_v3A.z * a_v3B.x - a_v3A.x * a_v3B.z,
+			a_v3A.x * a_v3B.y - a_v3A.y * a_v3B.x);
+	}
+
+	float Dot(const Vector3& a_v3A, const Vector3& a_v3B)
+	{
+		return a_v3A.x * a_v3B.x + a_v3A.y * a_v3B.y + a_v3A.z * a_v3B.z;
+	}
+
+	float Length(const Vector3& a_v3A)
+	{
+		return std::sqrt(Dot(a_v3A, a_v3A));
+	}
+
+	uint64_t EdgeKey(unsigned int a_uA, unsigned int a_uB)
+	{
+		return a_uA < a_uB ? ((uint64_t)a_uA << 32) | a_uB : ((uint64_t)a_uB << 32) | a_uA;
+	}
+
+	/// <summary>
+	/// Gets the largest side of the box around the positions.
+	/// </summary>
+	float GetExtent(const std::vector<Vector3>& a_lPositions, Vector3& a_v3Min)
+	{
+		if (a_lPositions.empty())
+		{
+			a_v3Min = Vector3(0.0f, 0.0f, 0.0f);
+			return 0.0f;
+		}
+
+		Vector3 v3Min = a_lPositions[0];
+		Vector3 v3Max = a_lPositions[0];
+		for (const Vector3& v3Position : a_lPositions)
+		{
+			v3Min = Vector3(std::min(v3Min.x, v3Position.x), std::min(v3Min.y, v3Position.y), std::min(v3Min.z, v3Position.z));
+			v3Max = Vector3(std::max(v3Max.x, v3Position.x), std::max(v3Max.y, v3Position.y), std::max(v3Max.z, v3Position.z));
+		}
+
+		a_v3Min = v3Min;
+		return std::max(v3Max.x - v3Min.x, std::max(v3Max.y - v3Min.y, v3Max.z - v3Min.z));
+	}
+
+	/// <summary>
+	/// Sums up how differently two vertices are skinned, from 0 (identical) to 2 (no joint in common).
+	/// </summary>
+	float GetSkinDifference(const JointInfluence& a_A, const JointInfluence& a_B)
+	{
+		float fDifference = 0.0f;
+		for (unsigned int i = 0; i < MAX_JOINT_INFLUENCES; i++)
+		{
+			if (a_A.Joints[i] < 0)
+			{
+				continue;
+			}
+
+			float fOther = 0.0f;
+			for (unsigned int j = 0; j < MAX_JOINT_INFLUENCES; j++)
+			{
+				if (a_B.Joints[j] == a_A.Joints[i])
+				{
+					fOther += a_B.Weights[j];
+				}
+			}
+			fDifference += std::fabs(a_A.Weights[i] - fOther);
+		}
+
+		// Joints that only the second vertex uses.
+		for (unsigned int j = 0; j < MAX_JOINT_INFLUENCES; j++)
+		{
+			bool bShared = false;
+			for (unsigned int i = 0; i < MAX_JOINT_INFLUENCES; i++)
+			{
+				bShared = bShared || (a_A.Joints[i] >= 0 && a_A.Joints[i] == a_B.Joints[j]);
+			}
+
+			if (a_B.Joints[j] >= 0 && !bShared)
+			{
+				fDifference += a_B.Weights[j];
+			}
+		}
+
+		return fDifference;
+	}
+}
+
+std::vector<MeshLod> MeshSimplifier::GenerateLods(const std::vector<SkinnedVertex>& a_lVertices, std::vector<unsigned int>& a_lIndices)
+{
+	std::vector<Vector3> lPositions(a_lVertices.size());
+	std::vector<JointInfluence> lSkin(a_lVertices.size());
+	for (size_t i = 0; i < a_lVertices.size(); i++)
+	{
+		const SkinnedVertex& vertex = a_lVertices[i];
+		lPositions[i] = vertex.Position;
+
+		// The fourth weight is whatever the first three leave over.
+		float lWeights[MAX_JOINT_INFLUENCES] = {
+			vertex.JointWeights.x,
+			vertex.JointWeights.y,
+			vertex.JointWeights.z,
+			1.0f - vertex.JointWeights.x - vertex.JointWeights.y - vertex.JointWeights.z };
+
+		for (unsigned int j = 0; j < MAX_JOINT_INFLUENCES; j++)
+		{
+			lSkin[i].Joints[j] = vertex.JointIndices[j];
+			lSkin[i].Weights[j] = vertex.JointIndices[j] < 0 ? 0.0f : std::max(lWeights[j], 0.0f);
+		}
+	}
+
+	return GenerateLods(lPositions, &lSkin, a_lIndices);
+}
+
+std::vector<MeshLod> MeshSimplifier::GenerateLods(
+	const std::vector<Vector3>& a_lPositions,
+	const std::vector<JointInfluence>* a_pSkin,
+	std::vector<unsigned int>& a_lIndices)
+{
+	std::vector<MeshLod> lLods(1);
+	lLods[0].IndexCount = (uint32_t)a_lIndices.size();
+
+	std::vector<unsigned int> lPrevious = a_lIndices;
+	float fTargetError = LOD_BASE_ERROR;
+	for (unsigned int i = 1; i < MAX_LOD_COUNT; i++)
+	{
+		unsigned int uTarget = (unsigned int)(lPrevious.size() * LOD_INDEX_RATIO) / 3 * 3;
+		float fError = 0.0f;
+		std::vector<unsigned int> lLod = Simplify(lPrevious, a_lPositions, a_pSkin, uTarget, fTargetError, &fError);
+
+		// Not worth the memory when barely anything could be removed.
+		if (lLod.empty() || lLod.size() > lPrevious.size() * LOD_MIN_REDUCTION)
+		{
+			break;
+		}
+
+		MeshOptimizer::OptimizeVertexCache(lLod, (unsigned int)a_lPositions.size());
+
+		// Every LOD is simplified from the one before it, so the errors stack up.
+		MeshLod lod;
+		lod.IndexOffset = (uint32_t)a_lIndices.size();
+		lod.IndexCount = (uint32_t)lLod.size();
+		lod.Error = lLods.back().Error + fError;
+		lLods.push_back(lod);
+
+		a_lIndices.insert(a_lIndices.end(), lLod.begin(), lLod.end());
+		lPrevious.swap(lLod);
+		fTargetError *= 2.0f;
+	}
+
+	std::string sCounts;
+	for (const MeshLod& lod : lLods)
+	{
+		sCounts += " " + std::to_string(lod.IndexCount / 3);
+	}
+	Logger::GetInstance()->Log("MeshSimplifier.cpp", "Generated LOD triangle counts:" + sCounts, DEBUG_LOG);
+
+	return lLods;
+}
+
+std::vector<unsigned int> MeshSimplifier::Simplify(
+	const std::vector<unsigned int>& a_lIndices,
+	const std::vector<Vector3>& a_lPositions,
+	const std::vector<JointInfluence>* a_pSkin,
+	unsigned int a_uTargetIndexCount,
+	float a_fTargetError,
+	float* a_pResultError)
+{
+	unsigned int uVertexCount = (unsigned int)a_lPositions.size();
+	std::vector<unsigned int> lResult = a_lIndices;
+
+	// Working in a unit sized box so that the errors are relative to the mesh.
+	Vector3 v3Min;
+	float fExtent = GetExtent(a_lPositions, v3Min);
+	float fScale = fExtent > 0.0f ? 1.0f / fExtent : 1.0f;
+	std::vector<Vector3> lPositions(uVertexCount);
+	for (unsigned int i = 0; i < uVertexCount; i++)
+	{
+		lPositions[i] = Vector3(
+			(a_lPositions[i].x - v3Min.x) * fScale,
+			(a_lPositions[i].y - v3Min.y) * fScale,
+			(a_lPositions[i].z - v3Min.z) * fScale);
+	}
+
+	// Vertices that share a position but not their other attributes (wedges) are treated as one.
+	std::vector<unsigned int> lCanonical(uVertexCount);
+	std::vector<unsigned int> lWedgeCount(uVertexCount, 0);
+	{
+		std::unordered_map<uint64_t, unsigned int> mFirst;
+		for (unsigned int i = 0; i < uVertexCount; i++)
+		{
+			uint32_t lBits[3];
+			std::memcpy(lBits, &lPositions[i], sizeof(lBits));
+			uint64_t uHash = ((uint64_t)lBits[0] * 73856093u) ^ ((uint64_t)lBits[1] * 19349663u << 16) ^ ((uint64_t)lBits[2] * 83492791u << 32);
+
+			// Collisions are resolved by walking on until a slot with the same position or a free one.
+			unsigned int uFound = i;
+			while (true)
+			{
+				auto found = mFirst.find(uHash);
+				if (found == mFirst.end())
+				{
+					mFirst[uHash] = i;
+					break;
+				}
+				const Vector3& v3Other = lPositions[found->second];
+				if (v3Other.x == lPositions[i].x && v3Other.y == lPositions[i].y && v3Other.z == lPositions[i].z)
+				{
+					uFound = found->second;
+					break;
+				}
+				uHash++;
+			}
+
+			lCanonical[i] = uFound;
+			lWedgeCount[uFound]++;
+		}
+	}
+
+	// Building up the quadrics out of every triangle's plane, weighted by area.
+	std::vector<Quadric> lQuadrics(uVertexCount);
+	for (size_t t = 0; t + 2 < lResult.size(); t += 3)
+	{
+		const Vector3& v3A = lPositions[lResult[t]];
+		Vector3 v3Normal = Cross(Subtract(lPositions[lResult[t + 1]], v3A), Subtract(lPositions[lResult[t + 2]], v3A));
+		float fArea = Length(v3Normal);
+		if (fArea <= 0.0f)
+		{
+			continue;
+		}
+
+		v3Normal = Vector3(v3Normal.x / fArea, v3Normal.y / fArea, v3Normal.z / fArea);
+		double dD = -Dot(v3Normal, v3A);
+		for (unsigned int c = 0; c < 3; c++)
+		{
+			lQuadrics[lCanonical[lResult[t + c]]].AddPlane(v3Normal.x, v3Normal.y, v3Normal.z, dD, fArea * 0.5f);
+		}
+	}
+
+	// Classifying the vertices by the edges around them.
+	std::vector<VertexKind> lKinds(uVertexCount, VertexKind::Manifold);
+	{
+		std::unordered_map<uint64_t, unsigned int> mEdges;
+		for (size_t t = 0; t + 2 < lResult.size(); t += 3)
+		{
+			for (unsigned int e = 0; e < 3; e++)
+			{
+				mEdges[EdgeKey(lCanonical[lResult[t + e]], lCanonical[lResult[t + (e + 1) % 3]])]++;
+			}
+		}
+
+		std::vector<unsigned int> lBorderEdges(uVertexCount, 0);
+		for (size_t t = 0; t + 2 < lResult.size(); t += 3)
+		{
+			for (unsigned int e = 0; e < 3; e++)
+			{
+				unsigned int uA = lCanonical[lResult[t + e]];
+				unsigned int uB = lCanonical[lResult[t + (e + 1) % 3]];
+				unsigned int uUses = mEdges[EdgeKey(uA, uB)];
+				if (uUses > 2)
+				{
+					lKinds[uA] = VertexKind::Locked;
+					lKinds[uB] = VertexKind::Locked;
+				}
+				if (uUses != 1)
+				{
+					continue;
+				}
+
+				lBorderEdges[uA]++;
+				lBorderEdges[uB]++;
+
+				// A plane standing up along the border keeps it from caving in.
+				const Vector3& v3A = lPositions[uA];
+				const Vector3& v3C = lPositions[lCanonical[lResult[t + (e + 2) % 3]]];
+				Vector3 v3Edge = Subtract(lPositions[uB], v3A);
+				Vector3 v3Normal = Cross(v3Edge, Cross(v3Edge, Subtract(v3C, v3A)));
+				float fLength = Length(v3Normal);
+				if (fLength > 0.0f)
+				{
+					v3Normal = Vector3(v3Normal.x / fLength, v3Normal.y / fLength, v3Normal.z / fLength);
+					double dWeight = Dot(v3Edge, v3Edge) * BORDER_QUADRIC_WEIGHT;
+					double dD = -Dot(v3Normal, v3A);
+					lQuadrics[uA].AddPlane(v3Normal.x, v3Normal.y, v3Normal.z, dD, dWeight);
+					lQuadrics[uB].AddPlane(v3Normal.x, v3Normal.y, v3Normal.z, dD, dWeight);
+				}
+			}
+		}
+
+		for (unsigned int i = 0; i < uVertexCount; i++)
+		{
+			if (lCanonical[i] != i || lKinds[i] == VertexKind::Locked)
+			{
+				continue;
+			}
+
+			if (lWedgeCount[i] > 1)
+			{
+				lKinds[i] = VertexKind::Locked;
+			}
+			else if (lBorderEdges[i] > 0)
+			{
+				// Borders that meet or end at a vertex pin it in place.
+				lKinds[i] = lBorderEdges[i] == 2 ? VertexKind::Border : VertexKind::Locked;
+			}
+		}
+	}
+
+	float fMaxError = 0.0f;
+	std::vector<unsigned int> lOffsets(uVertexCount + 1);
+	std::vector<unsigned int> lAdjacency;
+	std::vector<Collapse> lCollapses;
+	std::vector<unsigned int> lRemap(uVertexCount);
+	std::vector<char> lTouched(uVertexCount);
+
+	// Collapsing in passes, each one taking the cheapest collapses that do not overlap.
+	while (lResult.size() > a_uTargetIndexCount)
+	{
+		// Which triangles are around each vertex.
+		std::fill(lOffsets.begin(), lOffsets.end(), 0);
+		for (unsigned int uIndex : lResult)
+		{
+			lOffsets[lCanonical[uIndex] + 1]++;
+		}
+		for (unsigned int i = 0; i < uVertexCount; i++)
+		{
+			lOffsets[i + 1] += lOffsets[i];
+		}
+		lAdjacency.resize(lResult.size());
+		{
+			std::vector<unsigned int> lCursor(lOffsets.begin(), lOffsets.end() - 1);
+			for (size_t i = 0; i < lResult.size(); i++)
+			{
+				lAdjacency[lCursor[lCanonical[lResult[i]]]++] = (unsigned int)(i / 3);
+			}
+		}
+
+		// Borders change as triangles go away, so the border edges are counted again every pass.
+		std::unordered_map<uint64_t, unsigned int> mEdges;
+		for (size_t t = 0; t + 2 < lResult.size(); t += 3)
+		{
+			for (unsigned int e = 0; e < 3; e++)
+			{
+				mEdges[EdgeKey(lCanonical[lResult[t + e]], lCanonical[lResult[t + (e + 1) % 3]])]++;
+			}
+		}
+
+		// Finding the cheapest collapse of every vertex.
+		std::vector<Collapse> lBest(uVertexCount, Collapse{ 0, 0, -1.0f });
+		for (size_t t = 0; t + 2 < lResult.size(); t += 3)
+		{
+			for (unsigned int e = 0; e < 6; e++)
+			{
+				unsigned int uSource = lCanonical[lResult[t + e % 3]];
+				unsigned int uTarget = lCanonical[lResult[t + (e % 3 + (e < 3 ? 1 : 2)) % 3]];
+				if (uSource == uTarget || lKinds[uSource] == VertexKind::Locked)
+				{
+					continue;
+				}
+
+				if (lKinds[uSource] == VertexKind::Border &&
+					(lKinds[uTarget] == VertexKind::Manifold || mEdges[EdgeKey(uSource, uTarget)] != 1))
+				{
+					continue;
+				}
+
+				Quadric quadric = lQuadrics[uSource];
+				quadric.Add(lQuadrics[uTarget]);
+				float fCost = (float)quadric.Evaluate(lPositions[uTarget]);
+				if (a_pSkin != nullptr)
+				{
+					float fSkin = SKIN_COLLAPSE_WEIGHT * GetSkinDifference((*a_pSkin)[uSource], (*a_pSkin)[uTarget]);
+					fCost += fSkin * fSkin;
+				}
+
+				Collapse& best = lBest[uSource];
+				if (best.Cost < 0.0f || fCost < best.Cost)
+				{
+					best = Collapse{ uSource, uTarget, fCost };
+				}
+			}
+		}
+
+		lCollapses.clear();
+		for (const Collapse& collapse : lBest)
+		{
+			if (collapse.Cost >= 0.0f)
+			{
+				lCollapses.push_back(collapse);
+			}
+		}
+		std::sort(lCollapses.begin(), lCollapses.end(), [](const Collapse& a_A, const Collapse& a_B)
+			{
+				return a_A.Cost < a_B.Cost;
+			});
+
+		for (unsigned int i = 0; i < uVertexCount; i++)
+		{
+			lRemap[i] = i;
+		}
+		std::fill(lTouched.begin(), lTouched.end(), 0);
+
+		size_t uTriangleCount = lResult.size() / 3;
+		size_t uTargetTriangles = a_uTargetIndexCount / 3;
+		unsigned int uCollapsed = 0;
+		for (const Collapse& collapse : lCollapses)
+		{
+			if (uTriangleCount <= uTargetTriangles || std::sqrt(collapse.Cost) > a_fTargetError)
+			{
+				break;
+			}
+
+			unsigned int uSource = collapse.Source;
+			unsigned int uTarget = collapse.Target;
+			if (lTouched[uSource] || lTouched[uTarget])
+			{
+				continue;
+			}
+
+			// Rejecting collapses that would fold a triangle over, and finding the
+			// wedge of the target that the source's triangles should be using.
+			bool bFlips = false;
+			unsigned int uWedge = uTarget;
+			size_t uRemoved = 0;
+			for (unsigned int a = lOffsets[uSource]; a < lOffsets[uSource + 1] && !bFlips; a++)
+			{
+				const unsigned int* pTriangle = &lResult[lAdjacency[a] * 3];
+				unsigned int lCorners[3] = { lCanonical[pTriangle[0]], lCanonical[pTriangle[1]], lCanonical[pTriangle[2]] };
+
+				bool bHasTarget = false;
+				for (unsigned int c = 0; c < 3; c++)
+				{
+					if (lCorners[c] == uTarget)
+					{
+						bHasTarget = true;
+						uWedge = pTriangle[c];
+					}
+				}
+				if (bHasTarget)
+				{
+					uRemoved++;
+					continue;
+				}
+
+				Vector3 lBefore[3] = { lPositions[lCorners[0]], lPositions[lCorners[1]], lPositions[lCorners[2]] };
+				Vector3 lAfter[3] = { lBefore[0], lBefore[1], lBefore[2] };
+				for (unsigned int c = 0; c < 3; c++)
+				{
+					if (lCorners[c] == uSource)
+					{
+						lAfter[c] = lPositions[uTarget];
+					}
+				}
+
+				Vector3 v3Before = Cross(Subtract(lBefore[1], lBefore[0]), Subtract(lBefore[2], lBefore[0]));
+				Vector3 v3After = Cross(Subtract(lAfter[1], lAfter[0]), Subtract(lAfter[2], lAfter[0]));
+				bFlips = Dot(v3Before, v3After) <= 0.25f * Length(v3Before) * Length(v3After);
+			}
+
+			if (bFlips)
+			{
+				continue;
+			}
+
+			lRemap[uSource] = uWedge;
+			lQuadrics[uTarget].Add(lQuadrics[uSource]);
+			fMaxError = std::max(fMaxError, std::sqrt(collapse.Cost));
+			uTriangleCount -= uRemoved;
+			uCollapsed++;
+
+			// Everything around the collapse changed shape, so it waits for the next pass.
+			for (unsigned int a = lOffsets[uSource]; a < lOffsets[uSource + 1]; a++)
+			{
+				const unsigned int* pTriangle = &lResult[lAdjacency[a] * 3];
+				for (unsigned int c = 0; c < 3; c++)
+				{
+					lTouched[lCanonical[pTriangle[c]]] = 1;
+				}
+			}
+		}
+
+		if (uCollapsed == 0)
+		{
+			break;
+		}
+
+		// Moving the collapsed vertices and dropping the triangles that became degenerate.
+		size_t uWrite = 0;
+		for (size_t t = 0; t + 2 < lResult.size(); t += 3)
+		{
+			unsigned int uA = lRemap[lResult[t]];
+			unsigned int uB = lRemap[lResult[t + 1]];
+			unsigned int uC = lRemap[lResult[t + 2]];
+			if (lCanonical[uA] == lCanonical[uB] || lCanonical[uB] == lCanonical[uC] || lCanonical[uA] == lCanonical[uC])
+			{
+				continue;
+			}
+
+			lResult[uWrite++] = uA;
+			lResult[uWrite++] = uB;
+			lResult[uWrite++] = uC;
+		}
+		lResult.resize(uWrite);
+	}
+
+	if (a_pResultError != nullptr)
+	{
+		*a_pResultError = fMaxError * fExtent;
+	}
+
+	return lResult;
+}
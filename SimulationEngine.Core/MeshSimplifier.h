@@ -0,0 +1,98 @@
+#ifndef __MESHSIMPLIFIER_H_
+#define __MESHSIMPLIFIER_H_
+
+#include <vector>
+#include <cstddef>
+
+#include "Vectors.h"
+#include "VertexFormat.h"
+#include "SkinnedVertex.h"
+
+// The most levels of detail a mesh gets, counting the full resolution one.
+#define MAX_LOD_COUNT 4
+
+// Every LOD aims for this fraction of the indices of the one before it.
+#define LOD_INDEX_RATIO 0.5f
+
+// The error the first LOD may introduce, relative to the mesh's largest extent.  Doubles per LOD.
+#define LOD_BASE_ERROR 0.01f
+
+// LODs that do not get below this fraction of the indices of the one before them are dropped.
+#define LOD_MIN_REDUCTION 0.8f
+
+// How much a collapse between vertices with entirely different skinning costs, relative to the
+// mesh's extent.  Keeps vertices from sliding across the boundary between two joints.
+#define SKIN_COLLAPSE_WEIGHT 0.05f
+
+// How strongly open borders hold on to their shape compared to the surface.
+#define BORDER_QUADRIC_WEIGHT 10.0f
+
+/// <summary>
+/// The joints a single vertex is skinned to.  Unused joints are negative.
+/// </summary>
+struct JointInfluence
+{
+	int Joints[MAX_JOINT_INFLUENCES];
+	float Weights[MAX_JOINT_INFLUENCES];
+};
+
+/// <summary>
+/// Builds levels of detail at import time by collapsing edges in the order of their
+/// quadric error.  Vertices only ever collapse onto other existing vertices, so every
+/// LOD is just another index buffer into the same vertices.  Nothing in here touches the device.
+/// </summary>
+class MeshSimplifier
+{
+public:
+	/// <summary>
+	/// Generates up to MAX_LOD_COUNT levels of detail for a mesh.  The vertex type only needs a Position member.
+	/// </summary>
+	/// <param name="a_lIndices">The full resolution indices.  Every further LOD is appended to them.</param>
+	/// <returns>Where each LOD lives inside of the indices, the full resolution one first.</returns>
+	template <typename V>
+	static std::vector<MeshLod> GenerateLods(const std::vector<V>& a_lVertices, std::vector<unsigned int>& a_lIndices)
+	{
+		std::vector<Vector3> lPositions(a_lVertices.size());
+		for (size_t i = 0; i < a_lVertices.size(); i++)
+		{
+			lPositions[i] = a_lVertices[i].Position;
+		}
+
+		return GenerateLods(lPositions, nullptr, a_lIndices);
+	}
+
+	/// <summary>
+	/// Generates up to MAX_LOD_COUNT levels of detail for a skinned mesh, keeping vertices
+	/// with different joint weights from being collapsed onto each other.
+	/// </summary>
+	/// <param name="a_lIndices">The full resolution indices.  Every further LOD is appended to them.</param>
+	/// <returns>Where each LOD lives inside of the indices, the full resolution one first.</returns>
+	static std::vector<MeshLod> GenerateLods(const std::vector<SkinnedVertex>& a_lVertices, std::vector<unsigned int>& a_lIndices);
+
+	/// <summary>
+	/// Generates up to MAX_LOD_COUNT levels of detail out of plain positions and optional skinning.
+	/// </summary>
+	static std::vector<MeshLod> GenerateLods(
+		const std::vector<Vector3>& a_lPositions,
+		const std::vector<JointInfluence>* a_pSkin,
+		std::vector<unsigned int>& a_lIndices);
+
+	/// <summary>
+	/// Collapses edges until either the target index count is reached or the next collapse would
+	/// move the surface further than the target error.  Vertices on attribute seams stay where they are
+	/// and vertices on open borders only slide along the border.
+	/// </summary>
+	/// <param name="a_pSkin">Optional joint influences of every vertex.</param>
+	/// <param name="a_fTargetError">The allowed error, relative to the mesh's largest extent.</param>
+	/// <param name="a_pResultError">Receives the largest error actually introduced, in object space.</param>
+	/// <returns>The simplified indices.</returns>
+	static std::vector<unsigned int> Simplify(
+		const std::vector<unsigned int>& a_lIndices,
+		const std::vector<Vector3>& a_lPositions,
+		const std::vector<JointInfluence>* a_pSkin,
+		unsigned int a_uTargetIndexCount,
+		float a_fTargetError,
+		float* a_pResultError = nullptr);
+};
+
+#endif //__MESHSIMPLIFIER_H_
@@ -0,0 +1,440 @@
+#include "ObjParser.h"
+#include "MappedIOSystem.h"
+#include "ThreadPool.h"
+#include "Logger.h"
+
+#include <assimp/fast_atof.h>
+#include <cstring>
+#include <algorithm>
+
+// Chunks smaller than this are not worth a thread of their own.
+#define OBJ_MIN_CHUNK_SIZE (1024 * 1024)
+
+namespace
+{
+	// Which attribute of a corner needs to be offset when merging chunks.
+	enum CornerAttribute
+	{
+		PositionAttribute,
+		UVAttribute,
+		NormalAttribute
+	};
+
+	/// <summary>
+	/// A corner that used a negative (relative) index and therefore
+	/// only knows its index relative to the start of its own chunk.
+	/// </summary>
+	struct RelativeCorner
+	{
+		unsigned int Corner;
+		CornerAttribute Attribute;
+		unsigned int Line;
+	};
+
+	/// <summary>
+	/// Everything parsed out of a single chunk of the file.
+	/// </summary>
+	struct ObjChunk
+	{
+		const char* Begin = nullptr;
+		const char* End = nullptr;
+		ObjData Data;
+		std::vector<RelativeCorner> RelativeCorners;
+		bool Failed = false;
+
+		// Lines are counted from 1 within the chunk, 0 meaning none.
+		unsigned int Lines = 0;
+		unsigned int ErrorLine = 0;
+
+		// The largest absolute index of each attribute and the line it is on,
+		// checked against the attribute counts once every chunk is parsed.
+		int MaxIndex[3] = { -1, -1, -1 };
+		unsigned int MaxIndexLine[3] = { 0, 0, 0 };
+	};
+
+	inline bool IsSpace(char a_cChar)
+	{
+		return a_cChar == ' ' || a_cChar == '\t' || a_cChar == '\r';
+	}
+
+	inline const char* SkipSpaces(const char* a_pChar, const char* a_pEnd)
+	{
+		while (a_pChar < a_pEnd && IsSpace(*a_pChar))
+		{
+			a_pChar++;
+		}
+		return a_pChar;
+	}
+
+	/// <summary>
+	/// Reads a float without going through the locale aware C runtime.
+	/// </summary>
+	inline const char* ReadFloat(const char* a_pChar, const char* a_pEnd, float& a_fValue)
+	{
+		a_pChar = SkipSpaces(a_pChar, a_pEnd);
+		return Assimp::fast_atoreal_move<float>(a_pChar, a_fValue, false);
+	}
+
+	// Bits marking which attributes of a corner used a relative index,
+	// plus one for an index of zero, which obj does not allow.
+	enum RelativeMask
+	{
+		RelativePosition = 1 << PositionAttribute,
+		RelativeUV = 1 << UVAttribute,
+		RelativeNormal = 1 << NormalAttribute,
+		InvalidIndex = 1 << 3
+	};
+
+	/// <summary>
+	/// Resolves an obj index into a zero based index.  Negative indices are
+	/// relative to the amount of that attribute read so far in this chunk,
+	/// which gets corrected once every chunk's size is known.
+	/// </summary>
+	inline int ResolveIndex(int a_nIndex, size_t a_uLocalCount, int a_nBit, int& a_nRelative)
+	{
+		if (a_nIndex > 0)
+		{
+			return a_nIndex - 1;
+		}
+
+		if (a_nIndex == 0)
+		{
+			a_nRelative |= InvalidIndex;
+			return -1;
+		}
+
+		a_nRelative |= a_nBit;
+		return (int)a_uLocalCount + a_nIndex;
+	}
+
+	/// <summary>
+	/// Reads a single "v", "v/t", "v//n" or "v/t/n" face corner.
+	/// </summary>
+	const char* ReadCorner(const char* a_pChar, const ObjData& a_Data, ObjCorner& a_Corner, int& a_nRelative)
+	{
+		a_Corner = { -1, -1, -1 };
+		a_nRelative = 0;
+
+		a_Corner.Position = ResolveIndex(
+			Assimp::strtol10(a_pChar, &a_pChar), a_Data.Positions.size(), RelativePosition, a_nRelative);
+
+		if (*a_pChar != '/')
+		{
+			return a_pChar;
+		}
+		a_pChar++;
+
+		// The UV index is optional ("v//n").
+		if (*a_pChar != '/')
+		{
+			a_Corner.UV = ResolveIndex(
+				Assimp::strtol10(a_pChar, &a_pChar), a_Data.UVs.size(), RelativeUV, a_nRelative);
+		}
+
+		if (*a_pChar != '/')
+		{
+			return a_pChar;
+		}
+		a_pChar++;
+
+		a_Corner.Normal = ResolveIndex(
+			Assimp::strtol10(a_pChar, &a_pChar), a_Data.Normals.size(), RelativeNormal, a_nRelative);
+		return a_pChar;
+	}
+
+	/// <summary>
+	/// Appends a corner to the chunk, remembering any relative indices it used
+	/// and the largest absolute ones so that both can be range checked later.
+	/// </summary>
+	inline void PushCorner(ObjChunk& a_Chunk, const ObjCorner& a_Corner, int a_nRelative, unsigned int a_uLine)
+	{
+		unsigned int uCorner = (unsigned int)a_Chunk.Data.Corners.size();
+		a_Chunk.Data.Corners.push_back(a_Corner);
+
+		const int indices[3] = { a_Corner.Position, a_Corner.UV, a_Corner.Normal };
+		for (int attribute = PositionAttribute; attribute <= NormalAttribute; attribute++)
+		{
+			if (a_nRelative & (1 << attribute))
+			{
+				a_Chunk.RelativeCorners.push_back({ uCorner, (CornerAttribute)attribute, a_uLine });
+			}
+			else if (indices[attribute] > a_Chunk.MaxIndex[attribute])
+			{
+				a_Chunk.MaxIndex[attribute] = indices[attribute];
+				a_Chunk.MaxIndexLine[attribute] = a_uLine;
+			}
+		}
+	}
+
+	/// <summary>
+	/// Parses a face line of any amount of corners, fanning it into triangles.
+	/// </summary>
+	void ReadFace(const char* a_pChar, const char* a_pEnd, ObjChunk& a_Chunk, unsigned int a_uLine)
+	{
+		ObjCorner first{}, previous{};
+		int nFirstRelative = 0, nPreviousRelative = 0;
+		int nRead = 0;
+
+		while (true)
+		{
+			a_pChar = SkipSpaces(a_pChar, a_pEnd);
+			if (a_pChar >= a_pEnd || !((*a_pChar >= '0' && *a_pChar <= '9') || *a_pChar == '-'))
+			{
+				break;
+			}
+
+			ObjCorner corner;
+			int nRelative;
+			a_pChar = ReadCorner(a_pChar, a_Chunk.Data, corner, nRelative);
+			if (nRelative & InvalidIndex)
+			{
+				a_Chunk.ErrorLine = a_uLine;
+				a_Chunk.Failed = true;
+				return;
+			}
+
+			if (nRead == 0)
+			{
+				first = corner;
+				nFirstRelative = nRelative;
+			}
+			else if (nRead >= 2)
+			{
+				PushCorner(a_Chunk, first, nFirstRelative, a_uLine);
+				PushCorner(a_Chunk, previous, nPreviousRelative, a_uLine);
+				PushCorner(a_Chunk, corner, nRelative, a_uLine);
+			}
+
+			previous = corner;
+			nPreviousRelative = nRelative;
+			nRead++;
+		}
+	}
+
+	/// <summary>
+	/// Parses every line of a single chunk.
+	/// </summary>
+	void ParseChunk(ObjChunk& a_Chunk)
+	{
+		ObjData& data = a_Chunk.Data;
+		const char* pLine = a_Chunk.Begin;
+
+		while (pLine < a_Chunk.End && !a_Chunk.Failed)
+		{
+			a_Chunk.Lines++;
+
+			// Finding the end of the line.  Lines have no length limit.
+			const char* pLineEnd = static_cast<const char*>(std::memchr(pLine, '\n', a_Chunk.End - pLine));
+			if (pLineEnd == nullptr)
+			{
+				pLineEnd = a_Chunk.End;
+			}
+
+			const char* pChar = SkipSpaces(pLine, pLineEnd);
+			if (pChar + 1 < pLineEnd)
+			{
+				if (pChar[0] == 'v' && IsSpace(pChar[1]))
+				{
+					Vector3 position;
+					pChar = ReadFloat(pChar + 1, pLineEnd, position.x);
+					pChar = ReadFloat(pChar, pLineEnd, position.y);
+					ReadFloat(pChar, pLineEnd, position.z);
+					data.Positions.push_back(position);
+				}
+				else if (pChar[0] == 'v' && pChar[1] == 'n')
+				{
+					Vector3 normal;
+					pChar = ReadFloat(pChar + 2, pLineEnd, normal.x);
+					pChar = ReadFloat(pChar, pLineEnd, normal.y);
+					ReadFloat(pChar, pLineEnd, normal.z);
+					data.Normals.push_back(normal);
+				}
+				else if (pChar[0] == 'v' && pChar[1] == 't')
+				{
+					Vector2 uv;
+					pChar = ReadFloat(pChar + 2, pLineEnd, uv.x);
+					ReadFloat(pChar, pLineEnd, uv.y);
+					data.UVs.push_back(uv);
+				}
+				else if (pChar[0] == 'f' && IsSpace(pChar[1]))
+				{
+					ReadFace(pChar + 1, pLineEnd, a_Chunk, a_Chunk.Lines);
+				}
+			}
+
+			pLine = pLineEnd + 1;
+		}
+	}
+
+	/// <summary>
+	/// Logs the line of a face that points outside of the file's attributes.
+	/// </summary>
+	void ReportIndexError(size_t a_uLine)
+	{
+		Logger::GetInstance()->Log(
+			"ObjParser.cpp",
+			"Face index out of range on line " + std::to_string(a_uLine),
+			INFO_LOG);
+	}
+}
+
+bool ObjParser::Parse(const std::string& a_sObjFile, ObjData& a_Result)
+{
+	MappedView file;
+	if (!MappedIOSystem::MapFile(a_sObjFile, file))
+	{
+		return false;
+	}
+
+	const char* pText = reinterpret_cast<const char*>(file.Data);
+	size_t uSize = file.Size;
+
+	// The number parsers look one character past the last digit, so the
+	// text has to end with a newline.  Copying is only needed when it does not.
+	if (uSize == 0 || pText[uSize - 1] != '\n')
+	{
+		std::vector<char> lText(pText, pText + uSize);
+		lText.push_back('\n');
+		return Parse(lText.data(), lText.size(), a_Result);
+	}
+
+	return Parse(pText, uSize, a_Result);
+}
+
+bool ObjParser::Parse(const char* a_pText, size_t a_uSize, ObjData& a_Result)
+{
+	ThreadPool* pPool = ThreadPool::GetInstance();
+
+	// Splitting the file into roughly even chunks that end on line boundaries.
+	size_t uChunkCount = std::max<size_t>(1, std::min<size_t>(
+		pPool->GetWorkerCount() + 1,
+		a_uSize / OBJ_MIN_CHUNK_SIZE));
+
+	std::vector<ObjChunk> lChunks(uChunkCount);
+	const char* pEnd = a_pText + a_uSize;
+	const char* pBegin = a_pText;
+	for (size_t i = 0; i < uChunkCount; i++)
+	{
+		const char* pChunkEnd = pEnd;
+		if (i + 1 < uChunkCount)
+		{
+			pChunkEnd = a_pText + (a_uSize / uChunkCount) * (i + 1);
+			pChunkEnd = std::max(pChunkEnd, pBegin);
+			const char* pNewline = static_cast<const char*>(std::memchr(pChunkEnd, '\n', pEnd - pChunkEnd));
+			pChunkEnd = pNewline ? pNewline + 1 : pEnd;
+		}
+
+		lChunks[i].Begin = pBegin;
+		lChunks[i].End = pChunkEnd;
+		pBegin = pChunkEnd;
+	}
+
+	// Parsing every chunk in parallel.
+	pPool->ParallelFor((unsigned int)uChunkCount, 1, [&lChunks](unsigned int a_uBegin, unsigned int a_uEnd)
+		{
+			for (unsigned int i = a_uBegin; i < a_uEnd; i++)
+			{
+				try
+				{
+					ParseChunk(lChunks[i]);
+				}
+				catch (...)
+				{
+					lChunks[i].Failed = true;
+				}
+			}
+		});
+
+	// Each chunk's attributes start where the previous chunk's ended.
+	std::vector<size_t> lPositionBase(uChunkCount), lUVBase(uChunkCount), lNormalBase(uChunkCount), lCornerBase(uChunkCount);
+	std::vector<size_t> lLineBase(uChunkCount);
+	size_t uPositions = 0, uUVs = 0, uNormals = 0, uCorners = 0, uLines = 0;
+	for (size_t i = 0; i < uChunkCount; i++)
+	{
+		lLineBase[i] = uLines;
+		uLines += lChunks[i].Lines;
+
+		if (lChunks[i].Failed)
+		{
+			if (lChunks[i].ErrorLine != 0)
+			{
+				ReportIndexError(lLineBase[i] + lChunks[i].ErrorLine);
+			}
+			return false;
+		}
+
+		lPositionBase[i] = uPositions;
+		lUVBase[i] = uUVs;
+		lNormalBase[i] = uNormals;
+		lCornerBase[i] = uCorners;
+
+		uPositions += lChunks[i].Data.Positions.size();
+		uUVs += lChunks[i].Data.UVs.size();
+		uNormals += lChunks[i].Data.Normals.size();
+		uCorners += lChunks[i].Data.Corners.size();
+	}
+
+	// Absolute indices only have to fit within the whole file's attributes.
+	const size_t counts[3] = { uPositions, uUVs, uNormals };
+	for (size_t i = 0; i < uChunkCount; i++)
+	{
+		for (int attribute = PositionAttribute; attribute <= NormalAttribute; attribute++)
+		{
+			if (lChunks[i].MaxIndex[attribute] >= (int)counts[attribute])
+			{
+				ReportIndexError(lLineBase[i] + lChunks[i].MaxIndexLine[attribute]);
+				return false;
+			}
+		}
+	}
+
+	a_Result.Positions.resize(uPositions);
+	a_Result.UVs.resize(uUVs);
+	a_Result.Normals.resize(uNormals);
+	a_Result.Corners.resize(uCorners);
+
+	// Merging the chunks back together in file order.
+	pPool->ParallelFor((unsigned int)uChunkCount, 1, [&](unsigned int a_uBegin, unsigned int a_uEnd)
+		{
+			for (unsigned int i = a_uBegin; i < a_uEnd; i++)
+			{
+				ObjChunk& chunk = lChunks[i];
+
+				// Offsetting relative indices by the chunk's starting counts.
+				for (const RelativeCorner& relative : chunk.RelativeCorners)
+				{
+					ObjCorner& corner = chunk.Data.Corners[relative.Corner];
+					switch (relative.Attribute)
+					{
+					case PositionAttribute: corner.Position += (int)lPositionBase[i]; break;
+					case UVAttribute: corner.UV += (int)lUVBase[i]; break;
+					case NormalAttribute: corner.Normal += (int)lNormalBase[i]; break;
+					}
+
+					// Relative indices can only point too far back, never past the end.
+					int nIndex = relative.Attribute == PositionAttribute ? corner.Position :
+						relative.Attribute == UVAttribute ? corner.UV : corner.Normal;
+					if (nIndex < 0 && chunk.ErrorLine == 0)
+					{
+						chunk.ErrorLine = relative.Line;
+					}
+				}
+
+				std::copy(chunk.Data.Positions.begin(), chunk.Data.Positions.end(), a_Result.Positions.begin() + lPositionBase[i]);
+				std::copy(chunk.Data.UVs.begin(), chunk.Data.UVs.end(), a_Result.UVs.begin() + lUVBase[i]);
+				std::copy(chunk.Data.Normals.begin(), chunk.Data.Normals.end(), a_Result.Normals.begin() + lNormalBase[i]);
+				std::copy(chunk.Data.Corners.begin(), chunk.Data.Corners.end(), a_Result.Corners.begin() + lCornerBase[i]);
+			}
+		});
+
+	for (size_t i = 0; i < uChunkCount; i++)
+	{
+		if (lChunks[i].ErrorLine != 0)
+		{
+			ReportIndexError(lLineBase[i] + lChunks[i].ErrorLine);
+			return false;
+		}
+	}
+
+	return true;
+}
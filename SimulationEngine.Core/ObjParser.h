@@ -0,0 +1,50 @@
+#ifndef __OBJPARSER_H_
+#define __OBJPARSER_H_
+
+#include <string>
+#include <vector>
+
+#include "Vectors.h"
+
+/// <summary>
+/// One corner of a triangle, pointing into the attribute arrays of ObjData.
+/// Indices are zero based and are -1 when the attribute was not provided.
+/// </summary>
+struct ObjCorner
+{
+	int Position;
+	int UV;
+	int Normal;
+};
+
+/// <summary>
+/// The raw contents of an obj file.  Polygons are already fanned into triangles
+/// and are stored as three consecutive corners in the winding order of the file.
+/// </summary>
+struct ObjData
+{
+	std::vector<Vector3> Positions;
+	std::vector<Vector3> Normals;
+	std::vector<Vector2> UVs;
+	std::vector<ObjCorner> Corners;
+};
+
+/// <summary>
+/// Parses obj files by splitting them into line aligned chunks that
+/// are parsed in parallel and then merged back together in order.
+/// </summary>
+class ObjParser
+{
+public:
+	/// <summary>
+	/// Parses the passed in obj file.  Returns false if the file could not be read or is malformed.
+	/// </summary>
+	static bool Parse(const std::string& a_sObjFile, ObjData& a_Result);
+
+	/// <summary>
+	/// Parses an obj file that is already in memory.  The text must end with a newline.
+	/// </summary>
+	static bool Parse(const char* a_pText, size_t a_uSize, ObjData& a_Result);
+};
+
+#endif //__OBJPARSER_H_
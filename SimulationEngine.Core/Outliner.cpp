@@ -1,5 +1,6 @@
 #include "Outliner.h"
-#include <fstream>
+#include "StateCache.h"
+#include "ObjParser.h"
 
 Outliner::Outliner(void)
 {
@@ -22,114 +23,43 @@ Outliner::Outliner(std::vector<LineVertex> a_lVertices) : Outliner()
 	CompileBuffers();
 }
 
-Outliner::Outliner(std::string a_sObjFile)
+Outliner::Outliner(std::string a_sObjFile) : Outliner()
 {
-	std::ifstream obj(a_sObjFile);
-
-	// Ensure that the file was properly found.
-	if (!obj.is_open())
+	ObjData obj;
+	if (!ObjParser::Parse(a_sObjFile, obj))
 	{
 		throw std::invalid_argument(
 			"Error opening file: Invalid file path or file is inaccessible due to access levels."
 		);
 	}
 
-	std::vector<Vector3> positions;
-	std::vector<LineVertex> verts;
-	std::vector<unsigned int> indices;
-
-	// Count of each index and vertex.
-	int vertCounter = 0;
-	int indexCounter = 0;
-
-	// For loading lines of the obj files.
-	char chars[256];
-
-	while (obj.good())
+	// Every triangle becomes its three edges.
+	m_lVertices.reserve(obj.Corners.size() * 2);
+	for (size_t i = 0; i + 2 < obj.Corners.size(); i += 3)
 	{
-		// Getting a line from the file.
-		obj.getline(chars, 256);
+		const Vector3& v1 = obj.Positions[obj.Corners[i].Position];
+		const Vector3& v2 = obj.Positions[obj.Corners[i + 1].Position];
+		const Vector3& v3 = obj.Positions[obj.Corners[i + 2].Position];
 
-		if (chars[0] == 'v' && 
-			chars[1] != 'n' && 
-			chars[1] != 't')
-		{
-			// Read the 3 numbers directly into an Vector3
-			Vector3 position;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&position.x,
-				&position.y,
-				&position.z
-			);
-
-			// Add to the collection of positions.
-			positions.push_back(position);
-		}
-		else if (chars[0] == 'f')
+		const Vector3 lEdges[6] = { v1, v2, v2, v3, v3, v1 };
+		for (const Vector3& position : lEdges)
 		{
-			// Reading the indices from the obj file.
-			// This assumes the obj contains vertex positions/UVs/normals.
-			unsigned int i[12];
-			int numbersRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// If there was only one number then the obj has no UV coords.
-			// Continue loading without crashing so re-reading in a different way.
-			if (numbersRead == 1)
-			{
-				// Re-read with a different pattern.
-				numbersRead = sscanf_s(
-					chars,
-					"f %d//%d %d//%d %d//%d %d//%d",
-					&i[0], &i[2],
-					&i[3], &i[5],
-					&i[6], &i[8],
-					&i[9], &i[11]);
-
-				// The following indices are where the UVs coords should 
-				// have been, so giving them a valid value.
-				i[1] = 1;
-				i[4] = 1;
-				i[7] = 1;
-				i[10] = 1;
-			}
-
-			LineVertex v1_1;
-			v1_1.Position = positions[i[0] - 1];
-			LineVertex v1_2;
-			v1_2.Position = positions[i[3] - 1];
-
-			LineVertex v2_1;
-			v2_1.Position = positions[i[3] - 1];
-			LineVertex v2_2;
-			v2_1.Position = positions[i[6] - 1];
-
-			LineVertex v3_1;
-			v3_1.Position = positions[i[6] - 1];
-			LineVertex v3_2;
-			v3_2.Position = positions[i[0] - 1];
-
-			verts.push_back(v1_1);
-			verts.push_back(v1_2);
-			verts.push_back(v3_1);
-			verts.push_back(v3_2);
-			verts.push_back(v2_1);
-			verts.push_back(v2_2);
-			vertCounter += 6;
-
-			for (int i = 0; i < 6; i++)
-			{
-				indices.push_back(indexCounter); indexCounter += 1;
-			}
+			LineVertex vertex;
+			vertex.Position = position;
+			m_lVertices.push_back(vertex);
 		}
 	}
+
+	// Collecting the indices together into the vector.
+	for (unsigned int i = 0; i < m_lVertices.size(); i++)
+	{
+		m_lIndices.push_back(i);
+	}
+
+	m_uVertexCount = static_cast<unsigned int>(m_lVertices.size());
+	m_uIndexCount = static_cast<unsigned int>(m_lIndices.size());
+
+	CompileBuffers();
 }
 
 Outliner::~Outliner(void)
@@ -223,7 +153,7 @@ void Outliner::CompileBuffers(void)
 	m_bIsCompiled = true;
 }
 
-void Outliner::Draw()
+void Outliner::Bind(void)
 {
 	// Setting the stride to be the memory size of a Vertex
 	UINT stride = sizeof(LineVertex);
@@ -232,9 +162,12 @@ void Outliner::Draw()
 	UINT offset = 0;
 
 	// Setting this Mesh's buffers as the next thing to draw.
-	Graphics::GetContext()->IASetVertexBuffers(0, 1, m_pVertexBuffer.GetAddressOf(), &stride, &offset);
-	Graphics::GetContext()->IASetIndexBuffer(m_pIndexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	StateCache::GetInstance()->IASetVertexBuffers(0, 1, m_pVertexBuffer.GetAddressOf(), &stride, &offset);
+	StateCache::GetInstance()->IASetIndexBuffer(m_pIndexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+}
 
+void Outliner::DrawIndexed(void)
+{
 	// Starting up the render pipeline and drawing the currently set Index and Vertex buffers.
 	Graphics::GetContext()->DrawIndexed(
 		m_uIndexCount,		// The number of indices to use.
@@ -242,12 +175,18 @@ void Outliner::Draw()
 		0);					// Offset to add to each index.
 }
 
+void Outliner::Draw()
+{
+	Bind();
+	DrawIndexed();
+}
+
 std::shared_ptr<Transform> Outliner::GetTransform(void)
 {
 	return m_pTransform;
 }
 
-void Outliner::SetTransform(Transform a_Transform)
+void Outliner::SetTransform(const Transform& a_Transform)
 {
 	*m_pTransform = a_Transform;
 }
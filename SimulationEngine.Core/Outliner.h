@@ -84,6 +84,16 @@ public:
 	/// </summary>
 	void CompileBuffers(void);
 
+	/// <summary>
+	/// Sets the buffers as the next thing to draw.
+	/// </summary>
+	void Bind(void);
+
+	/// <summary>
+	/// Draws every line out of the buffers set by Bind.
+	/// </summary>
+	void DrawIndexed(void);
+
 	/// <summary>
 	/// Renders the line mesh.
 	/// </summary>
@@ -97,7 +107,7 @@ public:
 	/// <summary>
 	/// Sets the saved transform object.
 	/// </summary>
-	void SetTransform(Transform a_Transform);
+	void SetTransform(const Transform& a_Transform);
 
 	/// <summary>
 	/// Checks whether or not the Outliner has its buffers compiled.
@@ -0,0 +1,37 @@
+#ifndef __RAY_H_
+#define __RAY_H_
+
+#include <cfloat>
+#include <climits>
+
+#include "Vectors.h"
+
+/// <summary>
+/// A world space ray.  The direction is expected to be normalized, so distances along it are in world units.
+/// </summary>
+struct Ray
+{
+	Vector3 Origin = Vector3(0.0f, 0.0f, 0.0f);
+	Vector3 Direction = Vector3(0.0f, 0.0f, 1.0f);
+	// Hits further away than this are ignored.
+	float MaxDistance = FLT_MAX;
+};
+
+/// <summary>
+/// The closest triangle a ray hit.
+/// </summary>
+struct RayHit
+{
+	bool Hit = false;
+	// How far along the ray the hit is.  Going into a cast, the furthest a hit still counts.
+	float Distance = FLT_MAX;
+	Vector3 Position = Vector3(0.0f, 0.0f, 0.0f);
+	// The triangle's normal, facing back towards the ray's origin.
+	Vector3 Normal = Vector3(0.0f, 0.0f, 0.0f);
+	// The index of the entity that was hit in its manager.
+	unsigned int Entity = UINT_MAX;
+	// The index of the triangle that was hit in its mesh's full resolution index buffer.
+	unsigned int Triangle = UINT_MAX;
+};
+
+#endif //__RAY_H_
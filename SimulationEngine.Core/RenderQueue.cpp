@@ -0,0 +1,273 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	const uint64_t LAYER_SHIFT = 63;
+	const uint32_t DEPTH_MASK = (1u << RENDER_KEY_DEPTH_BITS) - 1;
+	const uint32_t SHADER_MAX = (1u << RENDER_KEY_SHADER_BITS) - 1;
+	const uint32_t MATERIAL_MAX = (1u << RENDER_KEY_MATERIAL_BITS) - 1;
+	const uint32_t MESH_MAX = (1u << RENDER_KEY_MESH_BITS) - 1;
+
+	// Opaque keys: layer | shader | material | mesh | depth.
+	const uint64_t OPAQUE_MESH_SHIFT = RENDER_KEY_DEPTH_BITS;
+	const uint64_t OPAQUE_MATERIAL_SHIFT = OPAQUE_MESH_SHIFT + RENDER_KEY_MESH_BITS;
+	const uint64_t OPAQUE_SHADER_SHIFT = OPAQUE_MATERIAL_SHIFT + RENDER_KEY_MATERIAL_BITS;
+
+	// Translucent keys: layer | inverted depth | shader | material | mesh.
+	const uint64_t TRANSLUCENT_MATERIAL_SHIFT = RENDER_KEY_MESH_BITS;
+	const uint64_t TRANSLUCENT_SHADER_SHIFT = TRANSLUCENT_MATERIAL_SHIFT + RENDER_KEY_MATERIAL_BITS;
+	const uint64_t TRANSLUCENT_DEPTH_SHIFT = TRANSLUCENT_SHADER_SHIFT + RENDER_KEY_SHADER_BITS;
+
+	const unsigned int RADIX_BUCKETS = 1u << RENDER_QUEUE_RADIX_BITS;
+	const unsigned int RADIX_PASSES = 64 / RENDER_QUEUE_RADIX_BITS;
+
+	/// <summary>
+	/// Gets a field of a key.
+	/// </summary>
+	uint32_t Extract(uint64_t a_uKey, uint64_t a_uShift, unsigned int a_uBits)
+	{
+		return (uint32_t)((a_uKey >> a_uShift) & ((1ull << a_uBits) - 1));
+	}
+
+	/// <summary>
+	/// Checks whether two draws bind the same state and can be instanced together.
+	/// The ids are compared instead of the keys, which clamped ids would make look equal.
+	/// </summary>
+	bool CanBatch(const DrawItem& a_First, const DrawItem& a_Second)
+	{
+		return
+			(a_First.Key >> LAYER_SHIFT) == (a_Second.Key >> LAYER_SHIFT) &&
+			a_First.Shader == a_Second.Shader &&
+			a_First.Material == a_Second.Material &&
+			a_First.Mesh == a_Second.Mesh &&
+			a_First.Lod == a_Second.Lod;
+	}
+
+	/// <summary>
+	/// Quantizes a depth to RENDER_KEY_DEPTH_BITS bits.  The bits of positive floats
+	/// grow along with their value, so dropping the lowest mantissa bits keeps the order.
+	/// </summary>
+	uint32_t QuantizeDepth(float a_fDepth)
+	{
+		// Also catches NaN.
+		if (!(a_fDepth > 0.0f))
+		{
+			return 0;
+		}
+
+		uint32_t uBits;
+		memcpy(&uBits, &a_fDepth, sizeof(float));
+		return (uBits >> (31 - RENDER_KEY_DEPTH_BITS)) & DEPTH_MASK;
+	}
+}
+
+uint64_t RenderQueue::MakeKey(
+	RenderLayer a_Layer,
+	uint32_t a_uShader,
+	uint32_t a_uMaterial,
+	uint32_t a_uMesh,
+	float a_fDepth)
+{
+	uint64_t uDepth = QuantizeDepth(a_fDepth);
+
+	// Ids past their bits would bleed into the neighbouring fields and break the order.
+	a_uShader = std::min(a_uShader, SHADER_MAX);
+	a_uMaterial = std::min(a_uMaterial, MATERIAL_MAX);
+	a_uMesh = std::min(a_uMesh, MESH_MAX);
+	if (a_Layer == RenderLayer::Opaque)
+	{
+		return
+			((uint64_t)a_uShader << OPAQUE_SHADER_SHIFT) |
+			((uint64_t)a_uMaterial << OPAQUE_MATERIAL_SHIFT) |
+			((uint64_t)a_uMesh << OPAQUE_MESH_SHIFT) |
+			uDepth;
+	}
+
+	// Inverting the depth so the furthest draws come first.
+	return
+		(1ull << LAYER_SHIFT) |
+		((uint64_t)(DEPTH_MASK - uDepth) << TRANSLUCENT_DEPTH_SHIFT) |
+		((uint64_t)a_uShader << TRANSLUCENT_SHADER_SHIFT) |
+		((uint64_t)a_uMaterial << TRANSLUCENT_MATERIAL_SHIFT) |
+		(uint64_t)a_uMesh;
+}
+
+RenderLayer RenderQueue::GetLayer(uint64_t a_uKey)
+{
+	return (a_uKey >> LAYER_SHIFT) ? RenderLayer::Translucent : RenderLayer::Opaque;
+}
+
+uint32_t RenderQueue::GetShader(uint64_t a_uKey)
+{
+	return GetLayer(a_uKey) == RenderLayer::Opaque ?
+		Extract(a_uKey, OPAQUE_SHADER_SHIFT, RENDER_KEY_SHADER_BITS) :
+		Extract(a_uKey, TRANSLUCENT_SHADER_SHIFT, RENDER_KEY_SHADER_BITS);
+}
+
+uint32_t RenderQueue::GetMaterial(uint64_t a_uKey)
+{
+	return GetLayer(a_uKey) == RenderLayer::Opaque ?
+		Extract(a_uKey, OPAQUE_MATERIAL_SHIFT, RENDER_KEY_MATERIAL_BITS) :
+		Extract(a_uKey, TRANSLUCENT_MATERIAL_SHIFT, RENDER_KEY_MATERIAL_BITS);
+}
+
+uint32_t RenderQueue::GetMesh(uint64_t a_uKey)
+{
+	return GetLayer(a_uKey) == RenderLayer::Opaque ?
+		Extract(a_uKey, OPAQUE_MESH_SHIFT, RENDER_KEY_MESH_BITS) :
+		Extract(a_uKey, 0, RENDER_KEY_MESH_BITS);
+}
+
+void RenderQueue::Clear(void)
+{
+	m_lItems.clear();
+}
+
+void RenderQueue::Submit(
+	RenderLayer a_Layer,
+	uint32_t a_uShader,
+	uint32_t a_uMaterial,
+	uint32_t a_uMesh,
+	uint32_t a_uObject,
+	uint32_t a_uLod,
+	float a_fDepth)
+{
+	DrawItem item;
+	item.Key = MakeKey(a_Layer, a_uShader, a_uMaterial, a_uMesh, a_fDepth);
+	item.Object = a_uObject;
+	item.Lod = a_uLod;
+	item.Shader = a_uShader;
+	item.Material = a_uMaterial;
+	item.Mesh = a_uMesh;
+	m_lItems.push_back(item);
+}
+
+void RenderQueue::Sort(void)
+{
+	size_t uCount = m_lItems.size();
+	if (uCount < 2)
+	{
+		return;
+	}
+
+	// Counting every digit of every pass in a single read over the keys.
+	std::vector<uint32_t> lCounts(RADIX_PASSES * RADIX_BUCKETS, 0);
+	for (const DrawItem& item : m_lItems)
+	{
+		for (unsigned int p = 0; p < RADIX_PASSES; p++)
+		{
+			lCounts[p * RADIX_BUCKETS + ((item.Key >> (p * RENDER_QUEUE_RADIX_BITS)) & (RADIX_BUCKETS - 1))]++;
+		}
+	}
+
+	m_lScratch.resize(uCount);
+	for (unsigned int p = 0; p < RADIX_PASSES; p++)
+	{
+		uint32_t* pCounts = &lCounts[p * RADIX_BUCKETS];
+		unsigned int uShift = p * RENDER_QUEUE_RADIX_BITS;
+
+		// Every key has the same digit here, most passes over a frame's keys end up like this.
+		if (pCounts[(m_lItems[0].Key >> uShift) & (RADIX_BUCKETS - 1)] == uCount)
+		{
+			continue;
+		}
+
+		// Turning the counts into where each digit's run starts.
+		uint32_t uOffset = 0;
+		for (unsigned int b = 0; b < RADIX_BUCKETS; b++)
+		{
+			uint32_t uBucket = pCounts[b];
+			pCounts[b] = uOffset;
+			uOffset += uBucket;
+		}
+
+		for (const DrawItem& item : m_lItems)
+		{
+			m_lScratch[pCounts[(item.Key >> uShift) & (RADIX_BUCKETS - 1)]++] = item;
+		}
+		m_lItems.swap(m_lScratch);
+	}
+}
+
+void RenderQueue::Execute(const RenderBackend& a_Backend)
+{
+	m_Stats = RenderStats();
+
+	// Nothing is known to be bound at the start of a frame.
+	uint32_t uShader = UINT32_MAX;
+	uint32_t uMaterial = UINT32_MAX;
+	uint32_t uMesh = UINT32_MAX;
+	uint32_t uObject = UINT32_MAX;
+
+	size_t uCount = m_lItems.size();
+	size_t i = 0;
+	while (i < uCount)
+	{
+		const DrawItem& item = m_lItems[i];
+		if (item.Shader != uShader)
+		{
+			a_Backend.BindShader(item.Shader);
+			uShader = item.Shader;
+			uMesh = UINT32_MAX;
+			m_Stats.ShaderSwitches++;
+		}
+
+		if (item.Material != uMaterial)
+		{
+			a_Backend.BindMaterial(item.Material);
+			uMaterial = item.Material;
+			m_Stats.MaterialSwitches++;
+		}
+
+		if (item.Mesh != uMesh)
+		{
+			a_Backend.BindMesh(item.Mesh);
+			uMesh = item.Mesh;
+			m_Stats.MeshSwitches++;
+		}
+
+		// Finding the run of draws that only differ in their object.  Sorting already put them next to each other,
+		// and drawing the instances in that same order keeps translucent draws back to front.
+		size_t uEnd = i + 1;
+		while (uEnd < uCount && CanBatch(item, m_lItems[uEnd]))
+		{
+			uEnd++;
+		}
+
+		uint32_t uRun = (uint32_t)(uEnd - i);
+		if (item.Shader > SHADER_MAX || item.Material > MATERIAL_MAX || item.Mesh > MESH_MAX)
+		{
+			m_Stats.Unsorted += uRun;
+		}
+
+		if (uRun > 1 && a_Backend.DrawInstanced && a_Backend.DrawInstanced(uMesh, item.Lod, &m_lItems[i], uRun))
+		{
+			// The instances bring their own constants, so whichever object was bound is still bound.
+			m_Stats.Draws++;
+			m_Stats.InstancedDraws++;
+			m_Stats.Instances += uRun;
+			i = uEnd;
+			continue;
+		}
+
+		for (; i < uEnd; i++)
+		{
+			const DrawItem& run = m_lItems[i];
+			if (run.Object != uObject)
+			{
+				a_Backend.BindObject(run.Object);
+				uObject = run.Object;
+				m_Stats.ObjectSwitches++;
+			}
+
+			a_Backend.Draw(uMesh, run.Lod);
+			m_Stats.Draws++;
+		}
+	}
+}
+
+const std::vector<DrawItem>& RenderQueue::GetItems(void) const { return m_lItems; }
+RenderStats RenderQueue::GetStats(void) const { return m_Stats; }
@@ -0,0 +1,166 @@
+#ifndef __RENDERQUEUE_H_
+#define __RENDERQUEUE_H_
+
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+// How many bits of the draw key every field gets.  Together with the layer bit they fill all 64.
+#define RENDER_KEY_SHADER_BITS 8
+#define RENDER_KEY_MATERIAL_BITS 16
+#define RENDER_KEY_MESH_BITS 16
+#define RENDER_KEY_DEPTH_BITS 23
+// The keys are sorted this many bits at a time.
+#define RENDER_QUEUE_RADIX_BITS 8
+
+/// <summary>
+/// Which pass a draw belongs to.  Every opaque draw comes before every translucent one.
+/// </summary>
+enum class RenderLayer
+{
+	Opaque,
+	Translucent
+};
+
+/// <summary>
+/// A single draw, as small as it can be so that sorting a frame's worth of them stays cheap.
+/// The shader, material, mesh and depth are packed into the key, which is all the sort looks at.
+/// </summary>
+struct DrawItem
+{
+	uint64_t Key;
+	// Which constants the draw is made with, as handed out by whoever submitted it.
+	uint32_t Object;
+	uint32_t Lod;
+	// The ids the draw binds.  The key only sorts by them, ids too large for their bits all share the largest value.
+	uint32_t Shader;
+	uint32_t Material;
+	uint32_t Mesh;
+};
+
+/// <summary>
+/// How much state the last executed frame had to change.
+/// </summary>
+struct RenderStats
+{
+	// Draw calls, an instanced draw only counting once.
+	unsigned int Draws = 0;
+	unsigned int InstancedDraws = 0;
+	// The draws that were merged into instanced draws.
+	unsigned int Instances = 0;
+	unsigned int ShaderSwitches = 0;
+	unsigned int MaterialSwitches = 0;
+	unsigned int MeshSwitches = 0;
+	unsigned int ObjectSwitches = 0;
+	// Draws with an id too large for the key, only sorted by depth among each other.
+	unsigned int Unsorted = 0;
+};
+
+/// <summary>
+/// What the queue calls to actually change state and draw.  The engine's is backed by D3D11,
+/// but anything can be plugged in, such as a backend that only records the calls.
+/// </summary>
+struct RenderBackend
+{
+	std::function<void(uint32_t a_uShader)> BindShader;
+	std::function<void(uint32_t a_uMaterial)> BindMaterial;
+	std::function<void(uint32_t a_uMesh)> BindMesh;
+	std::function<void(uint32_t a_uObject)> BindObject;
+	std::function<void(uint32_t a_uMesh, uint32_t a_uLod)> Draw;
+	// Draws a run of draws that only differ in their object all at once.  Optional, and allowed to
+	// refuse by returning false, in which case the run is drawn one object at a time.
+	std::function<bool(uint32_t a_uMesh, uint32_t a_uLod, const DrawItem* a_pItems, uint32_t a_uCount)> DrawInstanced;
+};
+
+/// <summary>
+/// Collects the draws of a frame from every manager, sorts them by state and submits them in one loop.
+/// Opaque draws are grouped by shader, then material, then mesh, and front to back inside of each group.
+/// Translucent draws are strictly back to front, only grouped by state when at the same depth.
+/// Ids are whatever the submitter uses to tell resources apart, the queue only compares them.
+/// Any id is accepted, but only ids that fit into their bits of the key are grouped by when sorting.
+/// </summary>
+class RenderQueue
+{
+private:
+	std::vector<DrawItem> m_lItems;
+	// Where the radix sort scatters to, swapped with the items after every pass.
+	std::vector<DrawItem> m_lScratch;
+	RenderStats m_Stats;
+
+public:
+	/// <summary>
+	/// Packs a draw's state and depth into a key.  Sorting the keys ascending gives the draw order.
+	/// Ids too large for their bits are clamped to the largest value that fits.
+	/// </summary>
+	/// <param name="a_fDepth">Any distance from the camera that grows further away, negative values count as 0.</param>
+	static uint64_t MakeKey(
+		RenderLayer a_Layer,
+		uint32_t a_uShader,
+		uint32_t a_uMaterial,
+		uint32_t a_uMesh,
+		float a_fDepth);
+
+	/// <summary>
+	/// Gets which layer a key was made for.
+	/// </summary>
+	static RenderLayer GetLayer(uint64_t a_uKey);
+
+	/// <summary>
+	/// Gets the shader id packed into a key, clamped if it did not fit.
+	/// </summary>
+	static uint32_t GetShader(uint64_t a_uKey);
+
+	/// <summary>
+	/// Gets the material id packed into a key, clamped if it did not fit.
+	/// </summary>
+	static uint32_t GetMaterial(uint64_t a_uKey);
+
+	/// <summary>
+	/// Gets the mesh id packed into a key, clamped if it did not fit.
+	/// </summary>
+	static uint32_t GetMesh(uint64_t a_uKey);
+
+	/// <summary>
+	/// Removes every draw, ready for the next frame.
+	/// </summary>
+	void Clear(void);
+
+	/// <summary>
+	/// Adds a draw to the queue.
+	/// </summary>
+	/// <param name="a_uObject">Which constants the draw is made with.</param>
+	/// <param name="a_uLod">The level of detail of the mesh to draw.</param>
+	/// <param name="a_fDepth">Any distance from the camera that grows further away.</param>
+	void Submit(
+		RenderLayer a_Layer,
+		uint32_t a_uShader,
+		uint32_t a_uMaterial,
+		uint32_t a_uMesh,
+		uint32_t a_uObject,
+		uint32_t a_uLod,
+		float a_fDepth);
+
+	/// <summary>
+	/// Radix sorts the draws by key.  Draws with equal keys keep the order they were submitted in.
+	/// </summary>
+	void Sort(void);
+
+	/// <summary>
+	/// Walks the draws in their current order, only binding the state that differs from the previous draw.
+	/// Switching shaders rebinds the mesh, since the shader has to be told its vertex format again.
+	/// Neighbouring draws of the same shader, material, mesh and LOD are offered to the backend as one instanced draw.
+	/// </summary>
+	void Execute(const RenderBackend& a_Backend);
+
+	/// <summary>
+	/// Gets the draws, in sorted order once Sort was called.
+	/// </summary>
+	const std::vector<DrawItem>& GetItems(void) const;
+
+	/// <summary>
+	/// Gets how much state the last Execute changed.
+	/// </summary>
+	RenderStats GetStats(void) const;
+};
+
+#endif //__RENDERQUEUE_H_
@@ -0,0 +1,411 @@
+#include "ResourceRegistry.h"
+#include "Logger.h"
+
+#include <cwctype>
+#include <cstdint>
+
+ResourceRegistry* ResourceRegistry::m_pInstance = nullptr;
+
+namespace
+{
+	// Registry entries are only worth keeping when creation actually produced something.
+	template <typename T>
+	bool IsEmpty(const T& a_Value) { return a_Value == nullptr; }
+	bool IsEmpty(const SubEntityMap& a_Value) { return a_Value.empty(); }
+
+	/// <summary>
+	/// Finds a resource by key or creates and stores it.  The lock is not held during
+	/// creation since creating a resource commonly loads other resources through the registry.
+	/// Instead the key is marked as in flight, and anyone else asking for it waits for the
+	/// first caller to finish rather than creating a copy of their own.
+	/// </summary>
+	template <typename Key, typename Value>
+	Value GetOrCreate(
+		std::mutex& a_Mutex,
+		std::unordered_map<Key, Value>& a_mResources,
+		std::unordered_map<Key, std::shared_future<Value>>& a_mLoads,
+		ResourceStats& a_Stats,
+		const Key& a_Key,
+		const std::function<Value()>& a_Create)
+	{
+		std::promise<Value> promise;
+		std::shared_future<Value> loading;
+		{
+			std::lock_guard<std::mutex> lock(a_Mutex);
+			auto found = a_mResources.find(a_Key);
+			if (found != a_mResources.end())
+			{
+				a_Stats.Hits++;
+				return found->second;
+			}
+
+			auto inFlight = a_mLoads.find(a_Key);
+			if (inFlight != a_mLoads.end())
+			{
+				a_Stats.Hits++;
+				loading = inFlight->second;
+			}
+			else
+			{
+				a_Stats.Misses++;
+				a_mLoads.emplace(a_Key, promise.get_future().share());
+			}
+		}
+
+		if (loading.valid())
+		{
+			return loading.get();
+		}
+
+		Value value;
+		try
+		{
+			value = a_Create();
+		}
+		catch (...)
+		{
+			// Waiters see the same failure, and the next request tries again.
+			promise.set_exception(std::current_exception());
+			std::lock_guard<std::mutex> lock(a_Mutex);
+			a_mLoads.erase(a_Key);
+			throw;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(a_Mutex);
+			if (!IsEmpty(value))
+			{
+				a_mResources.emplace(a_Key, value);
+				a_Stats.Live = (unsigned int)a_mResources.size();
+			}
+			a_mLoads.erase(a_Key);
+		}
+
+		promise.set_value(value);
+		return value;
+	}
+
+	/// <summary>
+	/// Turns the shader and sampler something was built with into part of a registry key.
+	/// The registered resource keeps both alive, so their addresses cannot be reused while it is stored.
+	/// </summary>
+	std::string ImportKey(const std::shared_ptr<Shader>& a_pShader, const Microsoft::WRL::ComPtr<ID3D11SamplerState>& a_pSampler)
+	{
+		return "|" + std::to_string(reinterpret_cast<uintptr_t>(a_pShader.get())) +
+			"|" + std::to_string(reinterpret_cast<uintptr_t>(a_pSampler.Get()));
+	}
+
+	/// <summary>
+	/// Shared implementation of NormalizePath for narrow and wide strings.
+	/// </summary>
+	template <typename Char>
+	std::basic_string<Char> Normalize(const std::basic_string<Char>& a_sPath)
+	{
+		typedef std::basic_string<Char> String;
+
+		// Splitting into parts while resolving the relative ones.
+		std::vector<String> lParts;
+		String sPart;
+		bool bAbsolute = !a_sPath.empty() && (a_sPath[0] == '/' || a_sPath[0] == '\\');
+
+		for (size_t i = 0; i <= a_sPath.size(); i++)
+		{
+			Char c = i < a_sPath.size() ? a_sPath[i] : Char('/');
+			if (c != '/' && c != '\\')
+			{
+				// Windows paths are case insensitive.
+				sPart += (Char)std::towlower((wint_t)c);
+				continue;
+			}
+
+			if (sPart.empty() || (sPart.size() == 1 && sPart[0] == '.'))
+			{
+				// Skipping empty and "current directory" parts.
+			}
+			else if (sPart.size() == 2 && sPart[0] == '.' && sPart[1] == '.' &&
+				!lParts.empty() && !(lParts.back().size() == 2 && lParts.back()[0] == '.' && lParts.back()[1] == '.'))
+			{
+				lParts.pop_back();
+			}
+			else
+			{
+				lParts.push_back(sPart);
+			}
+			sPart.clear();
+		}
+
+		String result;
+		if (bAbsolute)
+		{
+			result += Char('/');
+		}
+		for (size_t i = 0; i < lParts.size(); i++)
+		{
+			if (i > 0)
+			{
+				result += Char('/');
+			}
+			result += lParts[i];
+		}
+		return result;
+	}
+
+	/// <summary>
+	/// Gets how many references a COM object has without changing it.
+	/// </summary>
+	unsigned long GetRefCount(IUnknown* a_pObject)
+	{
+		a_pObject->AddRef();
+		return a_pObject->Release();
+	}
+}
+
+ResourceRegistry* ResourceRegistry::GetInstance(void)
+{
+	if (m_pInstance == nullptr)
+	{
+		m_pInstance = new ResourceRegistry();
+	}
+
+	return m_pInstance;
+}
+
+void ResourceRegistry::Release(void)
+{
+	if (m_pInstance == nullptr)
+	{
+		return;
+	}
+
+	delete m_pInstance;
+	m_pInstance = nullptr;
+}
+
+std::shared_ptr<Mesh> ResourceRegistry::GetMesh(
+	const std::string& a_sPath,
+	unsigned int a_uOptions,
+	std::function<std::shared_ptr<Mesh>()> a_Create)
+{
+	std::string sKey = NormalizePath(a_sPath) + "|" + std::to_string(a_uOptions);
+	return GetOrCreate(m_Mutex, m_mMeshes, m_mMeshLoads, m_MeshStats, sKey, a_Create);
+}
+
+ShaderResourcePtr ResourceRegistry::GetTexture(
+	const std::wstring& a_sPath,
+	unsigned int a_uOptions,
+	std::function<ShaderResourcePtr()> a_Create)
+{
+	std::wstring sKey = NormalizePath(a_sPath) + L"|" + std::to_wstring(a_uOptions);
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto found = m_mTextures.find(sKey);
+		if (found != m_mTextures.end() && found->second.SRV != nullptr)
+		{
+			m_TextureStats.Hits++;
+			return found->second.SRV;
+		}
+		m_TextureStats.Misses++;
+	}
+
+	ShaderResourcePtr pSRV = a_Create();
+	if (pSRV != nullptr)
+	{
+		ResolveTexture(a_sPath, a_uOptions, pSRV);
+	}
+	return pSRV;
+}
+
+bool ResourceRegistry::RequestTexture(
+	const std::wstring& a_sPath,
+	unsigned int a_uOptions,
+	std::shared_ptr<Material> a_pMaterial,
+	unsigned int a_uRegister)
+{
+	std::wstring sKey = NormalizePath(a_sPath) + L"|" + std::to_wstring(a_uOptions);
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	auto found = m_mTextures.find(sKey);
+	if (found == m_mTextures.end())
+	{
+		m_TextureStats.Misses++;
+		m_mTextures[sKey].Waiting.push_back({ a_pMaterial, a_uRegister });
+		m_TextureStats.Live = (unsigned int)m_mTextures.size();
+		return true;
+	}
+
+	// Either already loaded or somebody else is loading it already.
+	m_TextureStats.Hits++;
+	if (found->second.SRV != nullptr)
+	{
+		a_pMaterial->SetTextureSRV(a_uRegister, found->second.SRV);
+	}
+	else
+	{
+		found->second.Waiting.push_back({ a_pMaterial, a_uRegister });
+	}
+	return false;
+}
+
+void ResourceRegistry::ResolveTexture(const std::wstring& a_sPath, unsigned int a_uOptions, ShaderResourcePtr a_pSRV)
+{
+	std::wstring sKey = NormalizePath(a_sPath) + L"|" + std::to_wstring(a_uOptions);
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	// Failed loads are forgotten so a later request can try again.
+	if (a_pSRV == nullptr)
+	{
+		m_mTextures.erase(sKey);
+		m_TextureStats.Live = (unsigned int)m_mTextures.size();
+		return;
+	}
+
+	TextureEntry& entry = m_mTextures[sKey];
+	if (entry.SRV == nullptr)
+	{
+		entry.SRV = a_pSRV;
+	}
+
+	for (const auto& waiting : entry.Waiting)
+	{
+		std::shared_ptr<Material> pMaterial = waiting.first.lock();
+		if (pMaterial != nullptr)
+		{
+			pMaterial->SetTextureSRV(waiting.second, entry.SRV);
+		}
+	}
+	entry.Waiting.clear();
+	m_TextureStats.Live = (unsigned int)m_mTextures.size();
+}
+
+std::shared_ptr<Material> ResourceRegistry::GetMaterial(
+	const std::string& a_sLibrary,
+	const std::string& a_sName,
+	std::shared_ptr<Shader> a_pShader,
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> a_pSampler,
+	std::function<std::shared_ptr<Material>()> a_Create)
+{
+	// Material names are case sensitive, so only the library's path is normalized.
+	std::string sKey = NormalizePath(a_sLibrary) + "|" + a_sName + ImportKey(a_pShader, a_pSampler);
+	return GetOrCreate(m_Mutex, m_mMaterials, m_mMaterialLoads, m_MaterialStats, sKey, a_Create);
+}
+
+SubEntityMap ResourceRegistry::GetModel(
+	const std::string& a_sPath,
+	std::shared_ptr<Shader> a_pShader,
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> a_pSampler,
+	std::function<SubEntityMap()> a_Create)
+{
+	std::string sKey = NormalizePath(a_sPath) + ImportKey(a_pShader, a_pSampler);
+	return GetOrCreate(m_Mutex, m_mModels, m_mModelLoads, m_ModelStats, sKey, a_Create);
+}
+
+unsigned int ResourceRegistry::Collect(void)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	unsigned int uFreed = 0;
+
+	// Models go first since they hold onto meshes and materials themselves.
+	for (auto it = m_mModels.begin(); it != m_mModels.end();)
+	{
+		bool bUnused = true;
+		for (const auto& subEntity : it->second)
+		{
+			// The model's own map is the only reference left when nothing else uses it.
+			bUnused &= subEntity.first.use_count() == 1;
+		}
+
+		if (bUnused)
+		{
+			it = m_mModels.erase(it);
+			m_ModelStats.Collected++;
+			uFreed++;
+		}
+		else
+		{
+			it++;
+		}
+	}
+
+	for (auto it = m_mMeshes.begin(); it != m_mMeshes.end();)
+	{
+		if (it->second.use_count() == 1)
+		{
+			it = m_mMeshes.erase(it);
+			m_MeshStats.Collected++;
+			uFreed++;
+		}
+		else
+		{
+			it++;
+		}
+	}
+
+	for (auto it = m_mMaterials.begin(); it != m_mMaterials.end();)
+	{
+		if (it->second.use_count() == 1)
+		{
+			it = m_mMaterials.erase(it);
+			m_MaterialStats.Collected++;
+			uFreed++;
+		}
+		else
+		{
+			it++;
+		}
+	}
+
+	// Textures are COM objects, so the registry is the last user when it holds the only reference.
+	for (auto it = m_mTextures.begin(); it != m_mTextures.end();)
+	{
+		const TextureEntry& entry = it->second;
+		if (entry.SRV != nullptr && entry.Waiting.empty() && GetRefCount(entry.SRV.Get()) == 1)
+		{
+			it = m_mTextures.erase(it);
+			m_TextureStats.Collected++;
+			uFreed++;
+		}
+		else
+		{
+			it++;
+		}
+	}
+
+	m_ModelStats.Live = (unsigned int)m_mModels.size();
+	m_MeshStats.Live = (unsigned int)m_mMeshes.size();
+	m_MaterialStats.Live = (unsigned int)m_mMaterials.size();
+	m_TextureStats.Live = (unsigned int)m_mTextures.size();
+
+	return uFreed;
+}
+
+ResourceStats ResourceRegistry::GetMeshStats(void) { std::lock_guard<std::mutex> lock(m_Mutex); return m_MeshStats; }
+ResourceStats ResourceRegistry::GetTextureStats(void) { std::lock_guard<std::mutex> lock(m_Mutex); return m_TextureStats; }
+ResourceStats ResourceRegistry::GetMaterialStats(void) { std::lock_guard<std::mutex> lock(m_Mutex); return m_MaterialStats; }
+ResourceStats ResourceRegistry::GetModelStats(void) { std::lock_guard<std::mutex> lock(m_Mutex); return m_ModelStats; }
+
+void ResourceRegistry::LogStats(void)
+{
+	const std::pair<const char*, ResourceStats> lStats[] =
+	{
+		{ "Meshes", GetMeshStats() },
+		{ "Textures", GetTextureStats() },
+		{ "Materials", GetMaterialStats() },
+		{ "Models", GetModelStats() }
+	};
+
+	for (const auto& stats : lStats)
+	{
+		Logger::GetInstance()->Log(
+			"ResourceRegistry.cpp",
+			std::string(stats.first) +
+			": " + std::to_string(stats.second.Live) + " live, " +
+			std::to_string(stats.second.Hits) + " hits, " +
+			std::to_string(stats.second.Misses) + " misses, " +
+			std::to_string(stats.second.Collected) + " collected",
+			DEBUG_LOG);
+	}
+}
+
+std::string ResourceRegistry::NormalizePath(const std::string& a_sPath) { return Normalize(a_sPath); }
+std::wstring ResourceRegistry::NormalizePath(const std::wstring& a_sPath) { return Normalize(a_sPath); }
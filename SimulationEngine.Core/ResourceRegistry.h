@@ -0,0 +1,168 @@
+#ifndef __RESOURCEREGISTRY_H_
+#define __RESOURCEREGISTRY_H_
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+
+#include "Mesh.h"
+#include "Material.h"
+#include "Entity.h"
+
+/// <summary>
+/// Hit/miss counters for one type of resource in the registry.
+/// </summary>
+struct ResourceStats
+{
+	unsigned int Hits = 0;
+	unsigned int Misses = 0;
+	unsigned int Live = 0;
+	unsigned int Collected = 0;
+};
+
+/// <summary>
+/// Keeps one shared copy of every loaded resource, keyed by its normalized path and the
+/// options it was imported with.  Asking for the same file twice hands back the same
+/// handle instead of reading, decoding and uploading it again.
+/// </summary>
+class ResourceRegistry
+{
+private:
+	static ResourceRegistry* m_pInstance;
+
+	/// <summary>
+	/// A texture along with the materials still waiting for it to finish loading.
+	/// </summary>
+	struct TextureEntry
+	{
+		ShaderResourcePtr SRV = nullptr;
+		std::vector<std::pair<std::weak_ptr<Material>, unsigned int>> Waiting;
+	};
+
+	std::mutex m_Mutex;
+	std::unordered_map<std::string, std::shared_ptr<Mesh>> m_mMeshes;
+	std::unordered_map<std::wstring, TextureEntry> m_mTextures;
+	std::unordered_map<std::string, std::shared_ptr<Material>> m_mMaterials;
+	std::unordered_map<std::string, SubEntityMap> m_mModels;
+
+	// Resources still being created, which later requests for the same key wait on.
+	std::unordered_map<std::string, std::shared_future<std::shared_ptr<Mesh>>> m_mMeshLoads;
+	std::unordered_map<std::string, std::shared_future<std::shared_ptr<Material>>> m_mMaterialLoads;
+	std::unordered_map<std::string, std::shared_future<SubEntityMap>> m_mModelLoads;
+
+	ResourceStats m_MeshStats;
+	ResourceStats m_TextureStats;
+	ResourceStats m_MaterialStats;
+	ResourceStats m_ModelStats;
+
+public:
+	/// <summary>
+	/// Gets the single instance of the ResourceRegistry.
+	/// </summary>
+	static ResourceRegistry* GetInstance(void);
+
+	/// <summary>
+	/// Drops every resource held by the registry and frees the singleton.
+	/// </summary>
+	static void Release(void);
+
+	/// <summary>
+	/// Gets the mesh loaded from a path, calling a_Create only the first time it is asked for.
+	/// </summary>
+	/// <param name="a_uOptions">Import options that change the produced mesh.  Each combination is stored separately.</param>
+	std::shared_ptr<Mesh> GetMesh(
+		const std::string& a_sPath,
+		unsigned int a_uOptions,
+		std::function<std::shared_ptr<Mesh>()> a_Create);
+
+	/// <summary>
+	/// Gets the texture loaded from a path, calling a_Create only the first time it is asked for.
+	/// </summary>
+	/// <param name="a_uOptions">Import options that change the produced texture.  Each combination is stored separately.</param>
+	ShaderResourcePtr GetTexture(
+		const std::wstring& a_sPath,
+		unsigned int a_uOptions,
+		std::function<ShaderResourcePtr()> a_Create);
+
+	/// <summary>
+	/// Binds a texture to a material register as soon as it is available.  Textures that are already
+	/// loaded are bound immediately, otherwise the material waits for ResolveTexture.
+	/// </summary>
+	/// <returns>True if this was the first request for the texture, meaning the caller has to load it.</returns>
+	bool RequestTexture(
+		const std::wstring& a_sPath,
+		unsigned int a_uOptions,
+		std::shared_ptr<Material> a_pMaterial,
+		unsigned int a_uRegister);
+
+	/// <summary>
+	/// Stores a texture that was requested through RequestTexture and binds it to every waiting material.
+	/// Passing a null texture marks the load as failed and drops the waiting materials.
+	/// </summary>
+	void ResolveTexture(const std::wstring& a_sPath, unsigned int a_uOptions, ShaderResourcePtr a_pSRV);
+
+	/// <summary>
+	/// Gets a material out of a material library, calling a_Create only the first time it is asked for.
+	/// The same material built with a different shader or sampler is stored separately.
+	/// </summary>
+	/// <param name="a_sLibrary">The path of the file the material is defined in.</param>
+	/// <param name="a_sName">The name of the material inside of that file.</param>
+	std::shared_ptr<Material> GetMaterial(
+		const std::string& a_sLibrary,
+		const std::string& a_sName,
+		std::shared_ptr<Shader> a_pShader,
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> a_pSampler,
+		std::function<std::shared_ptr<Material>()> a_Create);
+
+	/// <summary>
+	/// Gets every mesh/material pair of a model file, calling a_Create only the first time it is asked for.
+	/// The materials are built with the passed in shader and sampler, so each combination is stored separately.
+	/// </summary>
+	SubEntityMap GetModel(
+		const std::string& a_sPath,
+		std::shared_ptr<Shader> a_pShader,
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> a_pSampler,
+		std::function<SubEntityMap()> a_Create);
+
+	/// <summary>
+	/// Frees every resource that nothing outside of the registry is using anymore.
+	/// </summary>
+	/// <returns>The amount of resources freed.</returns>
+	unsigned int Collect(void);
+
+	// Statistics accessors.
+	ResourceStats GetMeshStats(void);
+	ResourceStats GetTextureStats(void);
+	ResourceStats GetMaterialStats(void);
+	ResourceStats GetModelStats(void);
+
+	/// <summary>
+	/// Writes the hit/miss statistics of every resource type to the Logger.
+	/// </summary>
+	void LogStats(void);
+
+	/// <summary>
+	/// Lower cases a path, unifies its slashes and resolves "." and ".." so that
+	/// every spelling of the same file maps to the same key.
+	/// </summary>
+	static std::string NormalizePath(const std::string& a_sPath);
+
+	/// <summary>
+	/// Wide string version of NormalizePath.
+	/// </summary>
+	static std::wstring NormalizePath(const std::wstring& a_sPath);
+
+private:
+	ResourceRegistry(void) = default;
+	~ResourceRegistry(void) = default;
+
+	// Removing the copy constructor and operator.
+	ResourceRegistry(const ResourceRegistry&) = delete;
+	ResourceRegistry& operator=(const ResourceRegistry&) = delete;
+};
+
+#endif //__RESOURCEREGISTRY_H_
@@ -0,0 +1,640 @@
+#include "SceneBVH.h"
+
+#include <cmath>
+#include <cfloat>
+#include <utility>
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	/// <summary>
+	/// The objects whose centroids fell into one bucket of an axis.
+	/// </summary>
+	struct SceneBVHBin
+	{
+		Vector3 Min = Vector3(FLT_MAX, FLT_MAX, FLT_MAX);
+		Vector3 Max = Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		unsigned int Count = 0;
+	};
+
+	float GetAxis(const Vector3& a_v3, unsigned int a_uAxis)
+	{
+		return a_uAxis == 0 ? a_v3.x : (a_uAxis == 1 ? a_v3.y : a_v3.z);
+	}
+
+	void Grow(Vector3& a_v3Min, Vector3& a_v3Max, const Vector3& a_v3OtherMin, const Vector3& a_v3OtherMax)
+	{
+		a_v3Min = Vector3(std::min(a_v3Min.x, a_v3OtherMin.x), std::min(a_v3Min.y, a_v3OtherMin.y), std::min(a_v3Min.z, a_v3OtherMin.z));
+		a_v3Max = Vector3(std::max(a_v3Max.x, a_v3OtherMax.x), std::max(a_v3Max.y, a_v3OtherMax.y), std::max(a_v3Max.z, a_v3OtherMax.z));
+	}
+
+	void Grow(Vector3& a_v3Min, Vector3& a_v3Max, const CullBounds& a_Bounds)
+	{
+		const Vector3& c = a_Bounds.Center;
+		const Vector3& e = a_Bounds.Extents;
+		Grow(a_v3Min, a_v3Max, Vector3(c.x - e.x, c.y - e.y, c.z - e.z), Vector3(c.x + e.x, c.y + e.y, c.z + e.z));
+	}
+
+	/// <summary>
+	/// Half of the surface area, which is all the heuristic needs since only ratios of areas matter.
+	/// </summary>
+	float GetHalfArea(const Vector3& a_v3Min, const Vector3& a_v3Max)
+	{
+		float fX = std::max(0.0f, a_v3Max.x - a_v3Min.x);
+		float fY = std::max(0.0f, a_v3Max.y - a_v3Min.y);
+		float fZ = std::max(0.0f, a_v3Max.z - a_v3Min.z);
+		return fX * fY + fY * fZ + fZ * fX;
+	}
+
+	CullBounds ToCullBounds(const SceneBVHNode& a_Node)
+	{
+		CullBounds result;
+		result.Center = Vector3(
+			(a_Node.Min.x + a_Node.Max.x) * 0.5f,
+			(a_Node.Min.y + a_Node.Max.y) * 0.5f,
+			(a_Node.Min.z + a_Node.Max.z) * 0.5f);
+		result.Extents = Vector3(
+			(a_Node.Max.x - a_Node.Min.x) * 0.5f,
+			(a_Node.Max.y - a_Node.Min.y) * 0.5f,
+			(a_Node.Max.z - a_Node.Min.z) * 0.5f);
+		return result;
+	}
+
+	/// <summary>
+	/// The squared distance from a point to the closest point of a box, 0 when inside of it.
+	/// </summary>
+	float GetDistanceSquared(const Vector3& a_v3Point, const Vector3& a_v3Min, const Vector3& a_v3Max)
+	{
+		float fX = std::max(0.0f, std::max(a_v3Min.x - a_v3Point.x, a_v3Point.x - a_v3Max.x));
+		float fY = std::max(0.0f, std::max(a_v3Min.y - a_v3Point.y, a_v3Point.y - a_v3Max.y));
+		float fZ = std::max(0.0f, std::max(a_v3Min.z - a_v3Point.z, a_v3Point.z - a_v3Max.z));
+		return fX * fX + fY * fY + fZ * fZ;
+	}
+
+	float GetDistanceSquared(const Vector3& a_v3Point, const CullBounds& a_Bounds)
+	{
+		const Vector3& c = a_Bounds.Center;
+		const Vector3& e = a_Bounds.Extents;
+		return GetDistanceSquared(a_v3Point, Vector3(c.x - e.x, c.y - e.y, c.z - e.z), Vector3(c.x + e.x, c.y + e.y, c.z + e.z));
+	}
+
+	bool Overlaps(const Vector3& a_v3Min, const Vector3& a_v3Max, const Vector3& a_v3OtherMin, const Vector3& a_v3OtherMax)
+	{
+		return
+			a_v3Min.x <= a_v3OtherMax.x && a_v3Max.x >= a_v3OtherMin.x &&
+			a_v3Min.y <= a_v3OtherMax.y && a_v3Max.y >= a_v3OtherMin.y &&
+			a_v3Min.z <= a_v3OtherMax.z && a_v3Max.z >= a_v3OtherMin.z;
+	}
+
+	bool Overlaps(const Vector3& a_v3Min, const Vector3& a_v3Max, const CullBounds& a_Bounds)
+	{
+		const Vector3& c = a_Bounds.Center;
+		const Vector3& e = a_Bounds.Extents;
+		return Overlaps(a_v3Min, a_v3Max, Vector3(c.x - e.x, c.y - e.y, c.z - e.z), Vector3(c.x + e.x, c.y + e.y, c.z + e.z));
+	}
+}
+
+void SceneBVH::Build(const CullBounds* a_pBounds, unsigned int a_uCount)
+{
+	m_lBounds.assign(a_pBounds, a_pBounds + a_uCount);
+	m_lObjects.resize(a_uCount);
+	for (unsigned int i = 0; i < a_uCount; i++)
+	{
+		m_lObjects[i] = i;
+	}
+
+	m_lNodes.clear();
+	m_lParents.clear();
+	m_lLeaves.assign(a_uCount, 0);
+	m_fCost = 0.0f;
+	m_fBuiltCost = 0.0f;
+	if (a_uCount == 0)
+	{
+		return;
+	}
+
+	// A tree with n objects never has more than 2n - 1 nodes, so references into it stay valid.
+	m_lNodes.reserve(2 * a_uCount);
+	m_lParents.reserve(2 * a_uCount);
+
+	SceneBVHNode root{};
+	root.LeftFirst = 0;
+	root.Count = a_uCount;
+	m_lNodes.push_back(root);
+	m_lParents.push_back(0);
+
+	// Splitting leaves one at a time until every leaf is small enough or not worth splitting.
+	std::vector<unsigned int> lPending(1, 0);
+	while (!lPending.empty())
+	{
+		unsigned int uNode = lPending.back();
+		lPending.pop_back();
+
+		FitNode(uNode);
+		SceneBVHNode& node = m_lNodes[uNode];
+		unsigned int uFirst = node.LeftFirst;
+		unsigned int uCount = node.Count;
+		if (uCount <= SCENE_BVH_LEAF_SIZE)
+		{
+			continue;
+		}
+
+		// Splits are made on the centroids, so objects never end up on both sides.
+		Vector3 v3CentroidMin = Vector3(FLT_MAX, FLT_MAX, FLT_MAX);
+		Vector3 v3CentroidMax = Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (unsigned int i = uFirst; i < uFirst + uCount; i++)
+		{
+			const Vector3& v3Center = m_lBounds[m_lObjects[i]].Center;
+			Grow(v3CentroidMin, v3CentroidMax, v3Center, v3Center);
+		}
+
+		// Bucketing the centroids along every axis and sweeping the buckets from both
+		// ends, so every possible split's cost is known after two passes.
+		float fBestCost = FLT_MAX;
+		unsigned int uBestAxis = 3;
+		unsigned int uBestSplit = 0;
+		for (unsigned int uAxis = 0; uAxis < 3; uAxis++)
+		{
+			float fMin = GetAxis(v3CentroidMin, uAxis);
+			float fExtent = GetAxis(v3CentroidMax, uAxis) - fMin;
+			if (fExtent <= 0.0f)
+			{
+				continue;
+			}
+
+			SceneBVHBin lBins[SCENE_BVH_BINS];
+			float fScale = SCENE_BVH_BINS / fExtent;
+			for (unsigned int i = uFirst; i < uFirst + uCount; i++)
+			{
+				const CullBounds& bounds = m_lBounds[m_lObjects[i]];
+				unsigned int uBin = std::min(SCENE_BVH_BINS - 1, (int)((GetAxis(bounds.Center, uAxis) - fMin) * fScale));
+				lBins[uBin].Count++;
+				Grow(lBins[uBin].Min, lBins[uBin].Max, bounds);
+			}
+
+			float lLeftCost[SCENE_BVH_BINS - 1];
+			unsigned int lLeftCount[SCENE_BVH_BINS - 1];
+			SceneBVHBin left;
+			for (unsigned int b = 0; b < SCENE_BVH_BINS - 1; b++)
+			{
+				left.Count += lBins[b].Count;
+				Grow(left.Min, left.Max, lBins[b].Min, lBins[b].Max);
+				lLeftCount[b] = left.Count;
+				lLeftCost[b] = left.Count * GetHalfArea(left.Min, left.Max);
+			}
+
+			SceneBVHBin right;
+			for (unsigned int b = SCENE_BVH_BINS - 1; b > 0; b--)
+			{
+				right.Count += lBins[b].Count;
+				Grow(right.Min, right.Max, lBins[b].Min, lBins[b].Max);
+				if (right.Count == 0 || lLeftCount[b - 1] == 0)
+				{
+					continue;
+				}
+
+				float fCost = lLeftCost[b - 1] + right.Count * GetHalfArea(right.Min, right.Max);
+				if (fCost < fBestCost)
+				{
+					fBestCost = fCost;
+					uBestAxis = uAxis;
+					uBestSplit = b;
+				}
+			}
+		}
+
+		// Small leaves are kept when testing their objects directly is cheaper than splitting them.
+		float fArea = GetHalfArea(node.Min, node.Max);
+		bool bForceSplit = uCount > SCENE_BVH_MAX_LEAF_SIZE;
+		if (!bForceSplit && (uBestAxis == 3 || SCENE_BVH_TRAVERSAL_COST * fArea + fBestCost >= uCount * fArea))
+		{
+			continue;
+		}
+
+		unsigned int uMid = uFirst + uCount / 2;
+		if (uBestAxis < 3)
+		{
+			// Binning exactly like above, so both halves are guaranteed to be non-empty.
+			float fMin = GetAxis(v3CentroidMin, uBestAxis);
+			float fScale = SCENE_BVH_BINS / (GetAxis(v3CentroidMax, uBestAxis) - fMin);
+			auto split = std::partition(
+				m_lObjects.begin() + uFirst,
+				m_lObjects.begin() + uFirst + uCount,
+				[&](unsigned int a_uObject)
+					{
+						float fCenter = GetAxis(m_lBounds[a_uObject].Center, uBestAxis);
+						return (unsigned int)std::min(SCENE_BVH_BINS - 1, (int)((fCenter - fMin) * fScale)) < uBestSplit;
+					});
+			uMid = (unsigned int)(split - m_lObjects.begin());
+		}
+
+		// Every centroid in the same spot only leaves splitting down the middle.
+		unsigned int uLeft = (unsigned int)m_lNodes.size();
+		SceneBVHNode child{};
+		child.LeftFirst = uFirst;
+		child.Count = uMid - uFirst;
+		m_lNodes.push_back(child);
+		child.LeftFirst = uMid;
+		child.Count = uFirst + uCount - uMid;
+		m_lNodes.push_back(child);
+		m_lParents.push_back(uNode);
+		m_lParents.push_back(uNode);
+
+		node.LeftFirst = uLeft;
+		node.Count = 0;
+		lPending.push_back(uLeft + 1);
+		lPending.push_back(uLeft);
+	}
+
+	// Children always come after their parent, so going backwards fits every inner node after its children.
+	for (unsigned int i = (unsigned int)m_lNodes.size(); i-- > 0;)
+	{
+		SceneBVHNode& node = m_lNodes[i];
+		if (node.Count == 0)
+		{
+			FitNode(i);
+		}
+		else
+		{
+			for (unsigned int o = node.LeftFirst; o < node.LeftFirst + node.Count; o++)
+			{
+				m_lLeaves[m_lObjects[o]] = i;
+			}
+		}
+		m_fCost += GetNodeCost(node);
+	}
+
+	// Stored relative to the root, so growing the whole scene does not count as the tree getting worse.
+	m_fBuiltCost = m_fCost / std::max(FLT_MIN, GetHalfArea(m_lNodes[0].Min, m_lNodes[0].Max));
+}
+
+void SceneBVH::Refit(unsigned int a_uObject, const CullBounds& a_Bounds)
+{
+	m_lBounds[a_uObject] = a_Bounds;
+
+	// Walking up to the root, stopping early once a node did not change.
+	unsigned int uNode = m_lLeaves[a_uObject];
+	while (true)
+	{
+		SceneBVHNode old = m_lNodes[uNode];
+		FitNode(uNode);
+
+		const SceneBVHNode& node = m_lNodes[uNode];
+		m_fCost += GetNodeCost(node) - GetNodeCost(old);
+		bool bChanged =
+			node.Min.x != old.Min.x || node.Min.y != old.Min.y || node.Min.z != old.Min.z ||
+			node.Max.x != old.Max.x || node.Max.y != old.Max.y || node.Max.z != old.Max.z;
+		if (!bChanged || uNode == 0)
+		{
+			break;
+		}
+
+		uNode = m_lParents[uNode];
+	}
+}
+
+bool SceneBVH::NeedsRebuild(void) const
+{
+	if (m_lNodes.empty())
+	{
+		return false;
+	}
+
+	float fRootArea = std::max(FLT_MIN, GetHalfArea(m_lNodes[0].Min, m_lNodes[0].Max));
+	return m_fCost / fRootArea > m_fBuiltCost * SCENE_BVH_REBUILD_RATIO;
+}
+
+unsigned int SceneBVH::GetObjectCount(void) const { return (unsigned int)m_lObjects.size(); }
+const std::vector<SceneBVHNode>& SceneBVH::GetNodes(void) const { return m_lNodes; }
+const std::vector<unsigned int>& SceneBVH::GetObjects(void) const { return m_lObjects; }
+
+void SceneBVH::QueryFrustum(const Vector4* a_pPlanes, std::vector<unsigned int>& a_lResult) const
+{
+	a_lResult.clear();
+	if (m_lNodes.empty())
+	{
+		return;
+	}
+
+	std::vector<unsigned int> lStack(1, 0);
+	while (!lStack.empty())
+	{
+		unsigned int uNode = lStack.back();
+		lStack.pop_back();
+
+		const SceneBVHNode& node = m_lNodes[uNode];
+		CullResult result = FrustumCuller::Classify(a_pPlanes, ToCullBounds(node));
+		if (result == CullResult::Outside)
+		{
+			continue;
+		}
+		if (result == CullResult::Inside)
+		{
+			CollectSubtree(uNode, a_lResult);
+			continue;
+		}
+
+		if (node.Count == 0)
+		{
+			lStack.push_back(node.LeftFirst + 1);
+			lStack.push_back(node.LeftFirst);
+			continue;
+		}
+
+		for (unsigned int i = node.LeftFirst; i < node.LeftFirst + node.Count; i++)
+		{
+			if (FrustumCuller::Classify(a_pPlanes, m_lBounds[m_lObjects[i]]) != CullResult::Outside)
+			{
+				a_lResult.push_back(m_lObjects[i]);
+			}
+		}
+	}
+}
+
+void SceneBVH::QueryOverlap(const Vector3& a_v3Min, const Vector3& a_v3Max, std::vector<unsigned int>& a_lResult) const
+{
+	a_lResult.clear();
+	if (m_lNodes.empty())
+	{
+		return;
+	}
+
+	std::vector<unsigned int> lStack(1, 0);
+	while (!lStack.empty())
+	{
+		const SceneBVHNode& node = m_lNodes[lStack.back()];
+		lStack.pop_back();
+		if (!Overlaps(a_v3Min, a_v3Max, node.Min, node.Max))
+		{
+			continue;
+		}
+
+		if (node.Count == 0)
+		{
+			lStack.push_back(node.LeftFirst + 1);
+			lStack.push_back(node.LeftFirst);
+			continue;
+		}
+
+		for (unsigned int i = node.LeftFirst; i < node.LeftFirst + node.Count; i++)
+		{
+			if (Overlaps(a_v3Min, a_v3Max, m_lBounds[m_lObjects[i]]))
+			{
+				a_lResult.push_back(m_lObjects[i]);
+			}
+		}
+	}
+}
+
+void SceneBVH::QuerySphere(const Vector3& a_v3Center, float a_fRadius, std::vector<unsigned int>& a_lResult) const
+{
+	a_lResult.clear();
+	if (m_lNodes.empty())
+	{
+		return;
+	}
+
+	float fRadiusSquared = a_fRadius * a_fRadius;
+	std::vector<unsigned int> lStack(1, 0);
+	while (!lStack.empty())
+	{
+		const SceneBVHNode& node = m_lNodes[lStack.back()];
+		lStack.pop_back();
+		if (GetDistanceSquared(a_v3Center, node.Min, node.Max) > fRadiusSquared)
+		{
+			continue;
+		}
+
+		if (node.Count == 0)
+		{
+			lStack.push_back(node.LeftFirst + 1);
+			lStack.push_back(node.LeftFirst);
+			continue;
+		}
+
+		for (unsigned int i = node.LeftFirst; i < node.LeftFirst + node.Count; i++)
+		{
+			if (GetDistanceSquared(a_v3Center, m_lBounds[m_lObjects[i]]) <= fRadiusSquared)
+			{
+				a_lResult.push_back(m_lObjects[i]);
+			}
+		}
+	}
+}
+
+bool SceneBVH::QueryNearest(
+	const Vector3& a_v3Point,
+	float a_fMaxDistance,
+	unsigned int& a_uObject,
+	float& a_fDistance) const
+{
+	if (m_lNodes.empty())
+	{
+		return false;
+	}
+
+	// Nodes further away than the closest object found so far are skipped, so visiting the
+	// closer child first finds a good candidate early and prunes most of the tree.
+	bool bFound = false;
+	float fBestSquared = a_fMaxDistance * a_fMaxDistance;
+	std::vector<std::pair<float, unsigned int>> lStack(1, std::make_pair(GetDistanceSquared(a_v3Point, m_lNodes[0].Min, m_lNodes[0].Max), 0u));
+	while (!lStack.empty())
+	{
+		std::pair<float, unsigned int> entry = lStack.back();
+		lStack.pop_back();
+		if (entry.first > fBestSquared)
+		{
+			continue;
+		}
+
+		const SceneBVHNode& node = m_lNodes[entry.second];
+		if (node.Count == 0)
+		{
+			const SceneBVHNode& left = m_lNodes[node.LeftFirst];
+			const SceneBVHNode& right = m_lNodes[node.LeftFirst + 1];
+			std::pair<float, unsigned int> leftEntry(GetDistanceSquared(a_v3Point, left.Min, left.Max), node.LeftFirst);
+			std::pair<float, unsigned int> rightEntry(GetDistanceSquared(a_v3Point, right.Min, right.Max), node.LeftFirst + 1);
+			if (leftEntry.first < rightEntry.first)
+			{
+				std::swap(leftEntry, rightEntry);
+			}
+			lStack.push_back(leftEntry);
+			lStack.push_back(rightEntry);
+			continue;
+		}
+
+		for (unsigned int i = node.LeftFirst; i < node.LeftFirst + node.Count; i++)
+		{
+			float fDistanceSquared = GetDistanceSquared(a_v3Point, m_lBounds[m_lObjects[i]]);
+			if (fDistanceSquared <= fBestSquared)
+			{
+				fBestSquared = fDistanceSquared;
+				a_uObject = m_lObjects[i];
+				bFound = true;
+			}
+		}
+	}
+
+	if (bFound)
+	{
+		a_fDistance = sqrtf(fBestSquared);
+	}
+	return bFound;
+}
+
+void SceneBVH::QueryRay(
+	const Vector3& a_v3Origin,
+	const Vector3& a_v3Direction,
+	float a_fMaxDistance,
+	const std::function<float(unsigned int a_uObject, float a_fMaxDistance)>& a_Test) const
+{
+	float fEnter = 0.0f;
+	XMVector vOrigin = XMLoadFloat3(&a_v3Origin);
+	XMVector vInverseDirection = GetInverseDirection(a_v3Direction);
+	if (m_lNodes.empty() || !IntersectRay(m_lNodes[0].Min, m_lNodes[0].Max, vOrigin, vInverseDirection, a_fMaxDistance, fEnter))
+	{
+		return;
+	}
+
+	// Closer children are visited first, so hits found early cut off whatever lies behind them.
+	std::vector<std::pair<float, unsigned int>> lStack(1, std::make_pair(fEnter, 0u));
+	while (!lStack.empty())
+	{
+		std::pair<float, unsigned int> entry = lStack.back();
+		lStack.pop_back();
+		if (entry.first > a_fMaxDistance)
+		{
+			continue;
+		}
+
+		const SceneBVHNode& node = m_lNodes[entry.second];
+		if (node.Count == 0)
+		{
+			const SceneBVHNode& left = m_lNodes[node.LeftFirst];
+			const SceneBVHNode& right = m_lNodes[node.LeftFirst + 1];
+			float fLeft = 0.0f;
+			float fRight = 0.0f;
+			bool bLeft = IntersectRay(left.Min, left.Max, vOrigin, vInverseDirection, a_fMaxDistance, fLeft);
+			bool bRight = IntersectRay(right.Min, right.Max, vOrigin, vInverseDirection, a_fMaxDistance, fRight);
+			if (bLeft && bRight)
+			{
+				bool bLeftFirst = fLeft <= fRight;
+				lStack.push_back(bLeftFirst ? std::make_pair(fRight, node.LeftFirst + 1) : std::make_pair(fLeft, node.LeftFirst));
+				lStack.push_back(bLeftFirst ? std::make_pair(fLeft, node.LeftFirst) : std::make_pair(fRight, node.LeftFirst + 1));
+			}
+			else if (bLeft)
+			{
+				lStack.push_back(std::make_pair(fLeft, node.LeftFirst));
+			}
+			else if (bRight)
+			{
+				lStack.push_back(std::make_pair(fRight, node.LeftFirst + 1));
+			}
+			continue;
+		}
+
+		for (unsigned int i = node.LeftFirst; i < node.LeftFirst + node.Count; i++)
+		{
+			const CullBounds& bounds = m_lBounds[m_lObjects[i]];
+			const Vector3& c = bounds.Center;
+			const Vector3& e = bounds.Extents;
+			if (!IntersectRay(
+				Vector3(c.x - e.x, c.y - e.y, c.z - e.z),
+				Vector3(c.x + e.x, c.y + e.y, c.z + e.z),
+				vOrigin,
+				vInverseDirection,
+				a_fMaxDistance,
+				fEnter))
+			{
+				continue;
+			}
+
+			a_fMaxDistance = std::min(a_fMaxDistance, a_Test(m_lObjects[i], a_fMaxDistance));
+			if (a_fMaxDistance < 0.0f)
+			{
+				return;
+			}
+		}
+	}
+}
+
+XMVector SceneBVH::GetInverseDirection(const Vector3& a_v3Direction)
+{
+	// A tiny component keeps its sign, so the slabs of that axis end up infinitely far away on the right side.
+	XMVector vDirection = XMLoadFloat3(&a_v3Direction);
+	XMVector vTiny = XMVectorReplicate(1e-30f);
+	XMVector vNudged = XMVectorSelect(vTiny, -vTiny, XMVectorLess(vDirection, XMVectorZero()));
+	vDirection = XMVectorSelect(vDirection, vNudged, XMVectorLess(XMVectorAbs(vDirection), vTiny));
+	return XMVectorReciprocal(vDirection);
+}
+
+bool SceneBVH::IntersectRay(
+	const Vector3& a_v3Min,
+	const Vector3& a_v3Max,
+	const XMVector& a_vOrigin,
+	const XMVector& a_vInverseDirection,
+	float a_fMaxDistance,
+	float& a_fEnter)
+{
+	XMVector vNear = (XMLoadFloat3(&a_v3Min) - a_vOrigin) * a_vInverseDirection;
+	XMVector vFar = (XMLoadFloat3(&a_v3Max) - a_vOrigin) * a_vInverseDirection;
+	XMVector vEnter = XMVectorMin(vNear, vFar);
+	XMVector vExit = XMVectorMax(vNear, vFar);
+
+	// The ray is inside of the box once it is past all three entering slabs, and leaves it at the first exiting one.
+	vEnter = XMVectorMax(vEnter, XMVectorMax(XMVectorSplatY(vEnter), XMVectorSplatZ(vEnter)));
+	vExit = XMVectorMin(vExit, XMVectorMin(XMVectorSplatY(vExit), XMVectorSplatZ(vExit)));
+	float fEnter = std::max(0.0f, XMVectorGetX(vEnter));
+	float fExit = std::min(a_fMaxDistance, XMVectorGetX(vExit));
+
+	a_fEnter = fEnter;
+	return fEnter <= fExit;
+}
+
+void SceneBVH::FitNode(unsigned int a_uNode)
+{
+	SceneBVHNode& node = m_lNodes[a_uNode];
+	node.Min = Vector3(FLT_MAX, FLT_MAX, FLT_MAX);
+	node.Max = Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	if (node.Count == 0)
+	{
+		const SceneBVHNode& left = m_lNodes[node.LeftFirst];
+		const SceneBVHNode& right = m_lNodes[node.LeftFirst + 1];
+		Grow(node.Min, node.Max, left.Min, left.Max);
+		Grow(node.Min, node.Max, right.Min, right.Max);
+		return;
+	}
+
+	for (unsigned int i = node.LeftFirst; i < node.LeftFirst + node.Count; i++)
+	{
+		Grow(node.Min, node.Max, m_lBounds[m_lObjects[i]]);
+	}
+}
+
+float SceneBVH::GetNodeCost(const SceneBVHNode& a_Node) const
+{
+	float fArea = GetHalfArea(a_Node.Min, a_Node.Max);
+	return a_Node.Count == 0 ? SCENE_BVH_TRAVERSAL_COST * fArea : a_Node.Count * fArea;
+}
+
+void SceneBVH::CollectSubtree(unsigned int a_uNode, std::vector<unsigned int>& a_lResult) const
+{
+	std::vector<unsigned int> lStack(1, a_uNode);
+	while (!lStack.empty())
+	{
+		const SceneBVHNode& node = m_lNodes[lStack.back()];
+		lStack.pop_back();
+
+		if (node.Count == 0)
+		{
+			lStack.push_back(node.LeftFirst + 1);
+			lStack.push_back(node.LeftFirst);
+			continue;
+		}
+
+		a_lResult.insert(a_lResult.end(), m_lObjects.begin() + node.LeftFirst, m_lObjects.begin() + node.LeftFirst + node.Count);
+	}
+}
@@ -0,0 +1,171 @@
+#ifndef __SCENEBVH_H_
+#define __SCENEBVH_H_
+
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+#include "Vectors.h"
+#include "FrustumCuller.h"
+
+// The most objects a leaf holds before splitting it is always worth it.
+#define SCENE_BVH_LEAF_SIZE 4
+// Leaves never hold more than this, even when the SAH would rather keep them together.
+#define SCENE_BVH_MAX_LEAF_SIZE 16
+// How many buckets the centroids are sorted into when looking for the cheapest split.
+#define SCENE_BVH_BINS 16
+// The relative cost of stepping into a node compared to testing a single object.
+#define SCENE_BVH_TRAVERSAL_COST 1.0f
+// Rebuild once refitting made the tree this many times as expensive to traverse as right after building it.
+#define SCENE_BVH_REBUILD_RATIO 1.5f
+
+/// <summary>
+/// A single node of the hierarchy.  Both children of a node are stored next to each other,
+/// and a leaf's objects are a contiguous range of the object list.  32 bytes, two per cache line.
+/// </summary>
+struct SceneBVHNode
+{
+	Vector3 Min;
+	// The left child for inner nodes, the right one is right after it.  The first object for leaves.
+	uint32_t LeftFirst;
+	Vector3 Max;
+	// How many objects the leaf holds, 0 for inner nodes.
+	uint32_t Count;
+};
+
+/// <summary>
+/// A bounding volume hierarchy over the world space boxes of objects, built with the
+/// surface area heuristic.  Objects are identified by the index they were passed in at.
+/// Moving objects are refitted in place, which slowly makes the tree worse, so it tracks its
+/// own traversal cost and asks to be rebuilt once it degraded too far.
+/// Queries are safe to run from several threads at once, as long as nothing changes the tree meanwhile.
+/// </summary>
+class SceneBVH
+{
+private:
+	std::vector<SceneBVHNode> m_lNodes;
+	// The object indices, ordered so that every leaf's objects are next to each other.
+	std::vector<unsigned int> m_lObjects;
+	std::vector<CullBounds> m_lBounds;
+
+	// What refitting needs to walk from an object up to the root.
+	std::vector<unsigned int> m_lParents;
+	std::vector<unsigned int> m_lLeaves;
+
+	// The surface area heuristic cost of the whole tree, and what it was relative to the root's area right after building.
+	float m_fCost = 0.0f;
+	float m_fBuiltCost = 0.0f;
+
+public:
+	/// <summary>
+	/// Builds the hierarchy from scratch, replacing whatever was in it.
+	/// </summary>
+	/// <param name="a_pBounds">The world space box of every object.</param>
+	void Build(const CullBounds* a_pBounds, unsigned int a_uCount);
+
+	/// <summary>
+	/// Moves a single object, growing or shrinking every node above it to fit.
+	/// </summary>
+	void Refit(unsigned int a_uObject, const CullBounds& a_Bounds);
+
+	/// <summary>
+	/// Checks whether refitting degraded the tree enough to be worth rebuilding.
+	/// </summary>
+	bool NeedsRebuild(void) const;
+
+	/// <summary>
+	/// Gets how many objects the hierarchy was built over.
+	/// </summary>
+	unsigned int GetObjectCount(void) const;
+
+	/// <summary>
+	/// Gets the nodes, root first.
+	/// </summary>
+	const std::vector<SceneBVHNode>& GetNodes(void) const;
+
+	/// <summary>
+	/// Gets the object indices in the order the leaves point into.
+	/// </summary>
+	const std::vector<unsigned int>& GetObjects(void) const;
+
+	/// <summary>
+	/// Finds every object whose box is at least partially inside of a frustum.
+	/// Subtrees completely inside of it are taken in without testing anything below them.
+	/// </summary>
+	/// <param name="a_pPlanes">The six frustum planes, as handed out by the Camera.</param>
+	/// <param name="a_lResult">Filled with the visible objects.</param>
+	void QueryFrustum(const Vector4* a_pPlanes, std::vector<unsigned int>& a_lResult) const;
+
+	/// <summary>
+	/// Finds every object whose box overlaps another box.
+	/// </summary>
+	void QueryOverlap(const Vector3& a_v3Min, const Vector3& a_v3Max, std::vector<unsigned int>& a_lResult) const;
+
+	/// <summary>
+	/// Finds every object whose box touches a sphere.
+	/// </summary>
+	void QuerySphere(const Vector3& a_v3Center, float a_fRadius, std::vector<unsigned int>& a_lResult) const;
+
+	/// <summary>
+	/// Finds the object whose box is closest to a point.  Points inside of a box are at distance 0.
+	/// </summary>
+	/// <param name="a_fMaxDistance">Objects further away than this are ignored.</param>
+	/// <param name="a_uObject">Set to the closest object.</param>
+	/// <param name="a_fDistance">Set to the distance to the closest object's box.</param>
+	/// <returns>False if no object was close enough.</returns>
+	bool QueryNearest(
+		const Vector3& a_v3Point,
+		float a_fMaxDistance,
+		unsigned int& a_uObject,
+		float& a_fDistance) const;
+
+	/// <summary>
+	/// Walks every object whose box a ray passes through, closest boxes first.
+	/// </summary>
+	/// <param name="a_v3Direction">The direction of the ray, distances are in multiples of its length.</param>
+	/// <param name="a_fMaxDistance">Boxes further along the ray than this are skipped.</param>
+	/// <param name="a_Test">Tests the object itself, returning the new furthest distance worth looking at.
+	/// Returning a shorter distance after a hit prunes everything behind it, and a negative one stops the walk.</param>
+	void QueryRay(
+		const Vector3& a_v3Origin,
+		const Vector3& a_v3Direction,
+		float a_fMaxDistance,
+		const std::function<float(unsigned int a_uObject, float a_fMaxDistance)>& a_Test) const;
+
+	/// <summary>
+	/// Gets the reciprocal of a ray's direction, with zero components nudged so the slab test never multiplies zero by infinity.
+	/// </summary>
+	static XMVector GetInverseDirection(const Vector3& a_v3Direction);
+
+	/// <summary>
+	/// Slab tests a box against a ray, all three axes at once.
+	/// </summary>
+	/// <param name="a_vInverseDirection">As handed out by GetInverseDirection.</param>
+	/// <param name="a_fEnter">Set to the distance the ray enters the box at, or 0 when it starts inside.</param>
+	/// <returns>Whether the ray enters the box before a_fMaxDistance.</returns>
+	static bool IntersectRay(
+		const Vector3& a_v3Min,
+		const Vector3& a_v3Max,
+		const XMVector& a_vOrigin,
+		const XMVector& a_vInverseDirection,
+		float a_fMaxDistance,
+		float& a_fEnter);
+
+private:
+	/// <summary>
+	/// Fits a node around every object or child below it.
+	/// </summary>
+	void FitNode(unsigned int a_uNode);
+
+	/// <summary>
+	/// Gets a node's share of the traversal cost: its surface area weighted by what it costs to enter.
+	/// </summary>
+	float GetNodeCost(const SceneBVHNode& a_Node) const;
+
+	/// <summary>
+	/// Adds every object below a node to the result without testing any of them.
+	/// </summary>
+	void CollectSubtree(unsigned int a_uNode, std::vector<unsigned int>& a_lResult) const;
+};
+
+#endif //__SCENEBVH_H_
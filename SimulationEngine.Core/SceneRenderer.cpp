@@ -0,0 +1,312 @@
+#include "SceneRenderer.h"
+#include "StateCache.h"
+
+#include <cstring>
+
+SceneRenderer::SceneRenderer(void)
+{
+	m_pFrameCBuffer = std::make_shared<CBufferMapper<FrameCBufferData>>(FRAME_CBUFFER_REGISTER, ShaderType::VertexShader);
+
+	m_Backend.BindShader = [this](uint32_t a_uShader)
+	{
+		m_lShaders[a_uShader]->SetShader();
+	};
+
+	m_Backend.BindMaterial = [this](uint32_t a_uMaterial)
+	{
+		Material* pMaterial = m_lMaterials[a_uMaterial];
+		if (pMaterial != nullptr)
+		{
+			pMaterial->PrepMaterialForDraw();
+		}
+	};
+
+	m_Backend.BindMesh = [this](uint32_t a_uMesh)
+	{
+		const RenderMesh& mesh = m_lMeshes[a_uMesh];
+		if (mesh.Static != nullptr)
+		{
+			m_bMeshBound = mesh.Static->Bind();
+		}
+		else if (mesh.Animated != nullptr)
+		{
+			m_bMeshBound = mesh.Animated->Bind();
+		}
+		else
+		{
+			mesh.Lines->Bind();
+			m_bMeshBound = true;
+		}
+	};
+
+	m_Backend.BindObject = [this](uint32_t a_uObject)
+	{
+		const RenderObject& object = m_lObjects[a_uObject];
+		switch (object.Stage)
+		{
+		case ShaderType::PixelShader:
+			StateCache::GetInstance()->PSSetConstantBuffers(object.Register, 1, &object.Buffer);
+			break;
+
+		case ShaderType::VertexShader:
+			StateCache::GetInstance()->VSSetConstantBuffers(object.Register, 1, &object.Buffer);
+			break;
+		}
+	};
+
+	m_Backend.Draw = [this](uint32_t a_uMesh, uint32_t a_uLod)
+	{
+		// The active shader could not read the mesh's vertices.
+		if (!m_bMeshBound || !Shader::SetInstancing(false))
+		{
+			return;
+		}
+
+		const RenderMesh& mesh = m_lMeshes[a_uMesh];
+		if (mesh.Static != nullptr)
+		{
+			mesh.Static->DrawIndexed(a_uLod);
+		}
+		else if (mesh.Animated != nullptr)
+		{
+			mesh.Animated->DrawIndexed(a_uLod);
+		}
+		else
+		{
+			mesh.Lines->DrawIndexed();
+		}
+	};
+
+	m_Backend.DrawInstanced = [this](uint32_t a_uMesh, uint32_t a_uLod, const DrawItem* a_pItems, uint32_t a_uCount)
+	{
+		// Only static meshes are instanced, animated ones each have their own joints.
+		const RenderMesh& mesh = m_lMeshes[a_uMesh];
+		if (!m_bMeshBound || mesh.Static == nullptr)
+		{
+			return false;
+		}
+
+		for (uint32_t i = 0; i < a_uCount; i++)
+		{
+			if (m_lObjects[a_pItems[i].Object].Instance == RENDER_NO_INSTANCE)
+			{
+				return false;
+			}
+		}
+
+		if (!Shader::SetInstancing(true))
+		{
+			return false;
+		}
+
+		UINT uStart = 0;
+		if (!WriteInstances(a_pItems, a_uCount, uStart))
+		{
+			return false;
+		}
+
+		mesh.Static->DrawIndexedInstanced(a_uLod, a_uCount, uStart);
+		return true;
+	};
+}
+
+void SceneRenderer::BeginFrame(std::shared_ptr<Camera> a_pCamera, const Light* a_pLights)
+{
+	m_Queue.Clear();
+	m_lShaders.clear();
+	m_mShaderIds.clear();
+	m_lMaterials.clear();
+	m_mMaterialIds.clear();
+	m_lMeshes.clear();
+	m_mMeshIds.clear();
+	m_lObjects.clear();
+	m_lInstances.clear();
+
+	// The first instances of the frame discard whatever the last frame left in the buffer.
+	m_uInstanceCursor = 0;
+
+	// Reserving RENDER_NO_MATERIAL for draws without a material.
+	m_lMaterials.push_back(nullptr);
+
+	m_v3CameraPosition = a_pCamera->GetTransform().GetPosition();
+
+	FrameCBufferData frame{};
+	frame.View = a_pCamera->GetView();
+	frame.Projection = a_pCamera->GetProjection();
+	frame.CameraPosition = m_v3CameraPosition;
+	for (unsigned int i = 0; i < MAX_LIGHT_COUNT; i++)
+	{
+		frame.Lights[i] = a_pLights[i];
+	}
+
+	// A still camera under unchanged lights keeps what is already on the GPU.
+	if (!m_bFrameUploaded || memcmp(&frame, &m_FrameData, sizeof(FrameCBufferData)) != 0)
+	{
+		m_FrameData = frame;
+		m_pFrameCBuffer->MapBufferData(m_FrameData);
+		m_bFrameUploaded = true;
+	}
+
+	// The same buffer serves both stages.
+	ID3D11Buffer* pBuffer = m_pFrameCBuffer->GetBuffer();
+	StateCache::GetInstance()->VSSetConstantBuffers(FRAME_CBUFFER_REGISTER, 1, &pBuffer);
+	StateCache::GetInstance()->PSSetConstantBuffers(FRAME_CBUFFER_REGISTER, 1, &pBuffer);
+}
+
+uint32_t SceneRenderer::GetShaderId(Shader* a_pShader)
+{
+	auto it = m_mShaderIds.find(a_pShader);
+	if (it != m_mShaderIds.end())
+	{
+		return it->second;
+	}
+
+	uint32_t uId = (uint32_t)m_lShaders.size();
+	m_lShaders.push_back(a_pShader);
+	m_mShaderIds[a_pShader] = uId;
+	return uId;
+}
+
+uint32_t SceneRenderer::GetMaterialId(Material* a_pMaterial)
+{
+	auto it = m_mMaterialIds.find(a_pMaterial);
+	if (it != m_mMaterialIds.end())
+	{
+		return it->second;
+	}
+
+	uint32_t uId = (uint32_t)m_lMaterials.size();
+	m_lMaterials.push_back(a_pMaterial);
+	m_mMaterialIds[a_pMaterial] = uId;
+	return uId;
+}
+
+uint32_t SceneRenderer::GetMeshId(Mesh* a_pMesh)
+{
+	RenderMesh mesh;
+	mesh.Static = a_pMesh;
+	return AddMesh(a_pMesh, mesh);
+}
+
+uint32_t SceneRenderer::GetMeshId(AnimatedMesh* a_pMesh)
+{
+	RenderMesh mesh;
+	mesh.Animated = a_pMesh;
+	return AddMesh(a_pMesh, mesh);
+}
+
+uint32_t SceneRenderer::GetMeshId(Outliner* a_pOutliner)
+{
+	RenderMesh mesh;
+	mesh.Lines = a_pOutliner;
+	return AddMesh(a_pOutliner, mesh);
+}
+
+uint32_t SceneRenderer::AddMesh(const void* a_pKey, const RenderMesh& a_Mesh)
+{
+	auto it = m_mMeshIds.find(a_pKey);
+	if (it != m_mMeshIds.end())
+	{
+		return it->second;
+	}
+
+	uint32_t uId = (uint32_t)m_lMeshes.size();
+	m_lMeshes.push_back(a_Mesh);
+	m_mMeshIds[a_pKey] = uId;
+	return uId;
+}
+
+uint32_t SceneRenderer::AddObject(const CBufferMapper<VertexCBufferData>& a_CBuffer, const VertexCBufferData& a_Instance)
+{
+	uint32_t uObject = AddObject<VertexCBufferData>(a_CBuffer);
+	m_lObjects[uObject].Instance = (uint32_t)m_lInstances.size();
+	m_lInstances.push_back(a_Instance);
+	return uObject;
+}
+
+bool SceneRenderer::WriteInstances(const DrawItem* a_pItems, uint32_t a_uCount, UINT& a_uStart)
+{
+	m_lInstanceScratch.clear();
+	for (uint32_t i = 0; i < a_uCount; i++)
+	{
+		m_lInstanceScratch.push_back(m_lInstances[m_lObjects[a_pItems[i].Object].Instance]);
+	}
+
+	// Growing the buffer when a single run does not fit into it.  The old one stays
+	// alive for as long as the context still has it bound.
+	UINT uStride = sizeof(VertexCBufferData);
+	if (a_uCount > m_uInstanceCapacity)
+	{
+		UINT uCapacity = m_uInstanceCapacity * 2;
+		uCapacity = uCapacity > a_uCount ? uCapacity : a_uCount;
+		uCapacity = uCapacity > RENDER_MIN_INSTANCE_CAPACITY ? uCapacity : RENDER_MIN_INSTANCE_CAPACITY;
+
+		D3D11_BUFFER_DESC desc{};
+		desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.ByteWidth = uCapacity * uStride;
+
+		m_pInstanceBuffer.Reset();
+		if (FAILED(Graphics::GetDevice()->CreateBuffer(&desc, 0, m_pInstanceBuffer.GetAddressOf())))
+		{
+			m_uInstanceCapacity = 0;
+			return false;
+		}
+		m_uInstanceCapacity = uCapacity;
+		m_uInstanceCursor = 0;
+	}
+
+	// Appending behind the runs drawn so far this frame, and only discarding once the buffer is used up.
+	D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (m_uInstanceCursor == 0 || m_uInstanceCursor + a_uCount > m_uInstanceCapacity)
+	{
+		mapType = D3D11_MAP_WRITE_DISCARD;
+		m_uInstanceCursor = 0;
+	}
+
+	StateCache::GetInstance()->WriteBuffer(
+		m_pInstanceBuffer.Get(),
+		m_lInstanceScratch.data(),
+		a_uCount * uStride,
+		mapType,
+		m_uInstanceCursor * uStride);
+
+	// The draw picks its instances through its start instance, so the buffer is always bound from its front.
+	UINT uOffset = 0;
+	StateCache::GetInstance()->IASetVertexBuffers(INSTANCE_VERTEX_SLOT, 1, m_pInstanceBuffer.GetAddressOf(), &uStride, &uOffset);
+
+	a_uStart = m_uInstanceCursor;
+	m_uInstanceCursor += a_uCount;
+	return true;
+}
+
+float SceneRenderer::GetDepth(const Vector3& a_v3Position) const
+{
+	// The squared distance sorts the same as the distance itself.
+	float fX = a_v3Position.x - m_v3CameraPosition.x;
+	float fY = a_v3Position.y - m_v3CameraPosition.y;
+	float fZ = a_v3Position.z - m_v3CameraPosition.z;
+	return fX * fX + fY * fY + fZ * fZ;
+}
+
+void SceneRenderer::Submit(
+	RenderLayer a_Layer,
+	uint32_t a_uShader,
+	uint32_t a_uMaterial,
+	uint32_t a_uMesh,
+	uint32_t a_uObject,
+	uint32_t a_uLod,
+	float a_fDepth)
+{
+	m_Queue.Submit(a_Layer, a_uShader, a_uMaterial, a_uMesh, a_uObject, a_uLod, a_fDepth);
+}
+
+void SceneRenderer::Draw(void)
+{
+	m_Queue.Sort();
+	m_bMeshBound = false;
+	m_Queue.Execute(m_Backend);
+}
+
+RenderStats SceneRenderer::GetStats(void) const { return m_Queue.GetStats(); }
@@ -0,0 +1,191 @@
+#ifndef __SCENERENDERER_H_
+#define __SCENERENDERER_H_
+
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "RenderQueue.h"
+#include "CBufferMapper.h"
+#include "CBuffers.h"
+#include "Shader.h"
+#include "Material.h"
+#include "Mesh.h"
+#include "AnimatedMesh.h"
+#include "Outliner.h"
+#include "Camera.h"
+
+// The material id of draws that bind no material at all, such as lines.
+#define RENDER_NO_MATERIAL 0
+// The instance of objects that can only be drawn through their constant buffer.
+#define RENDER_NO_INSTANCE UINT32_MAX
+// How many instances the instance buffer holds at the least, it grows whenever a single run needs more.
+#define RENDER_MIN_INSTANCE_CAPACITY 256
+
+/// <summary>
+/// One of the kinds of vertex and index buffers that can be drawn.  Only one of them is set.
+/// </summary>
+struct RenderMesh
+{
+	Mesh* Static = nullptr;
+	AnimatedMesh* Animated = nullptr;
+	Outliner* Lines = nullptr;
+};
+
+/// <summary>
+/// An already uploaded constant buffer holding one object's constants, and where it is bound to.
+/// Objects with a copy of their constants can also be drawn as instances.
+/// </summary>
+struct RenderObject
+{
+	ID3D11Buffer* Buffer = nullptr;
+	unsigned int Register = 0;
+	ShaderType Stage = ShaderType::VertexShader;
+	uint32_t Instance = RENDER_NO_INSTANCE;
+};
+
+/// <summary>
+/// Turns the draws every manager submits over a frame into D3D11 calls.  Shaders, materials,
+/// meshes and object constants are handed ids as they are first seen in a frame, which the
+/// RenderQueue sorts by.  The pointers behind the ids are only kept for the frame, so
+/// everything submitted has to stay alive until Draw returns.
+/// Runs of the same static mesh and material whose objects all carry their instance
+/// constants are drawn with a single DrawIndexedInstanced, when the shader has an instanced variant.
+/// </summary>
+class SceneRenderer
+{
+private:
+	RenderQueue m_Queue;
+	RenderBackend m_Backend;
+
+	std::vector<Shader*> m_lShaders;
+	std::unordered_map<const Shader*, uint32_t> m_mShaderIds;
+	std::vector<Material*> m_lMaterials;
+	std::unordered_map<const Material*, uint32_t> m_mMaterialIds;
+	std::vector<RenderMesh> m_lMeshes;
+	std::unordered_map<const void*, uint32_t> m_mMeshIds;
+	std::vector<RenderObject> m_lObjects;
+	std::vector<VertexCBufferData> m_lInstances;
+
+	// The per-instance vertex stream, filled front to back over a frame and started over when full.
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_pInstanceBuffer = nullptr;
+	UINT m_uInstanceCapacity = 0;
+	UINT m_uInstanceCursor = 0;
+	std::vector<VertexCBufferData> m_lInstanceScratch;
+
+	// The camera and lights shared by every draw, and what was last uploaded of them.
+	std::shared_ptr<CBufferMapper<FrameCBufferData>> m_pFrameCBuffer = nullptr;
+	FrameCBufferData m_FrameData{};
+	bool m_bFrameUploaded = false;
+
+	Vector3 m_v3CameraPosition;
+	// Whether the mesh bound last can be drawn from.
+	bool m_bMeshBound = false;
+
+public:
+	/// <summary>
+	/// Constructs the SceneRenderer with its D3D11 backend.
+	/// </summary>
+	SceneRenderer(void);
+
+	/// <summary>
+	/// Forgets the previous frame's draws and ids, then uploads and binds the frame's constants.
+	/// Called before anything is submitted.
+	/// </summary>
+	/// <param name="a_pCamera">The camera the frame is seen through, also used for the depth of draws.</param>
+	/// <param name="a_pLights">The MAX_LIGHT_COUNT lights every draw of the frame is lit by.</param>
+	void BeginFrame(std::shared_ptr<Camera> a_pCamera, const Light* a_pLights);
+
+	/// <summary>
+	/// Gets the id of a shader for this frame.
+	/// </summary>
+	uint32_t GetShaderId(Shader* a_pShader);
+
+	/// <summary>
+	/// Gets the id of a material for this frame.
+	/// </summary>
+	uint32_t GetMaterialId(Material* a_pMaterial);
+
+	/// <summary>
+	/// Gets the id of a mesh for this frame.
+	/// </summary>
+	uint32_t GetMeshId(Mesh* a_pMesh);
+
+	/// <summary>
+	/// Gets the id of an animated mesh for this frame.
+	/// </summary>
+	uint32_t GetMeshId(AnimatedMesh* a_pMesh);
+
+	/// <summary>
+	/// Gets the id of a line mesh for this frame.
+	/// </summary>
+	uint32_t GetMeshId(Outliner* a_pOutliner);
+
+	/// <summary>
+	/// Adds an object's constant buffer, which has to be uploaded already.
+	/// </summary>
+	/// <returns>The object id to submit draws with.</returns>
+	template <typename T>
+	uint32_t AddObject(const CBufferMapper<T>& a_CBuffer)
+	{
+		RenderObject object;
+		object.Buffer = a_CBuffer.GetBuffer();
+		object.Register = a_CBuffer.GetRegisterIndex();
+		object.Stage = a_CBuffer.GetTargetShader();
+		m_lObjects.push_back(object);
+		return (uint32_t)m_lObjects.size() - 1;
+	}
+
+	/// <summary>
+	/// Adds an entity's constant buffer, which has to be uploaded already, along with a copy
+	/// of its constants so it can be drawn as an instance as well.
+	/// </summary>
+	/// <returns>The object id to submit draws with.</returns>
+	uint32_t AddObject(const CBufferMapper<VertexCBufferData>& a_CBuffer, const VertexCBufferData& a_Instance);
+
+	/// <summary>
+	/// Gets the depth draws around a world space point are sorted by.
+	/// </summary>
+	float GetDepth(const Vector3& a_v3Position) const;
+
+	/// <summary>
+	/// Adds a draw to the frame.
+	/// </summary>
+	void Submit(
+		RenderLayer a_Layer,
+		uint32_t a_uShader,
+		uint32_t a_uMaterial,
+		uint32_t a_uMesh,
+		uint32_t a_uObject,
+		uint32_t a_uLod,
+		float a_fDepth);
+
+	/// <summary>
+	/// Sorts every draw of the frame and issues them in one loop.
+	/// </summary>
+	void Draw(void);
+
+	/// <summary>
+	/// Gets how much state the last Draw changed.
+	/// </summary>
+	RenderStats GetStats(void) const;
+
+private:
+	// Removing the copy constructor and operator, the backend points back at this instance.
+	SceneRenderer(const SceneRenderer&) = delete;
+	SceneRenderer& operator=(const SceneRenderer&) = delete;
+
+	/// <summary>
+	/// Gets the id of any kind of mesh, adding it when it was not seen yet this frame.
+	/// </summary>
+	uint32_t AddMesh(const void* a_pKey, const RenderMesh& a_Mesh);
+
+	/// <summary>
+	/// Writes the instance constants of a run of draws into the instance buffer and binds it.
+	/// </summary>
+	/// <param name="a_uStart">Set to the instance the run starts at.</param>
+	/// <returns>False if the instance buffer could not be created.</returns>
+	bool WriteInstances(const DrawItem* a_pItems, uint32_t a_uCount, UINT& a_uStart);
+};
+
+#endif //__SCENERENDERER_H_
@@ -1,37 +1,181 @@
 #include "Shader.h"
+#include "StateCache.h"
 #include "Logger.h"
 
 #include <Windows.h>
+#include <initializer_list>
 
 #pragma comment(lib, "d3dcompiler.lib")
 #include <d3dcompiler.h>
 
+Shader* Shader::m_pActiveShader = nullptr;
+
+namespace
+{
+	/// <summary>
+	/// Fills in one per-vertex input element, placed right after the previous one.
+	/// </summary>
+	void SetInputElement(D3D11_INPUT_ELEMENT_DESC& a_Element, LPCSTR a_sSemantic, DXGI_FORMAT a_Format)
+	{
+		a_Element.SemanticName = a_sSemantic;
+		a_Element.Format = a_Format;
+		a_Element.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
+	}
+
+	/// <summary>
+	/// Describes how the input assembler reads each VertexFormat.  Has to match the
+	/// member order of Vertex, SkinnedVertex, CompactVertex and CompactSkinnedVertex.
+	/// </summary>
+	/// <returns>The amount of elements written.</returns>
+	UINT GetInputElements(VertexFormat a_Format, bool a_bInstanced, D3D11_INPUT_ELEMENT_DESC* a_pElements)
+	{
+		UINT uCount = 0;
+		SetInputElement(a_pElements[uCount++], "POSITION", DXGI_FORMAT_R32G32B32_FLOAT);
+
+		if (a_Format == VertexFormat::Compact || a_Format == VertexFormat::CompactSkinned)
+		{
+			// Octahedral normals/tangents and half precision UVs, decoded in VertexInput.hlsli.
+			SetInputElement(a_pElements[uCount++], "NORMAL", DXGI_FORMAT_R16G16_SNORM);
+			SetInputElement(a_pElements[uCount++], "TANGENT", DXGI_FORMAT_R16G16_SNORM);
+			SetInputElement(a_pElements[uCount++], "UV", DXGI_FORMAT_R16G16_FLOAT);
+		}
+		else
+		{
+			SetInputElement(a_pElements[uCount++], "NORMAL", DXGI_FORMAT_R32G32B32_FLOAT);
+			SetInputElement(a_pElements[uCount++], "UV", DXGI_FORMAT_R32G32_FLOAT);
+			SetInputElement(a_pElements[uCount++], "TANGENT", DXGI_FORMAT_R32G32B32_FLOAT);
+		}
+
+		if (a_Format == VertexFormat::Skinned)
+		{
+			SetInputElement(a_pElements[uCount++], "BLENDWEIGHT", DXGI_FORMAT_R32G32B32_FLOAT);
+			SetInputElement(a_pElements[uCount++], "BLENDINDICES", DXGI_FORMAT_R32G32B32A32_SINT);
+		}
+		else if (a_Format == VertexFormat::CompactSkinned)
+		{
+			SetInputElement(a_pElements[uCount++], "BLENDWEIGHT", DXGI_FORMAT_R8G8B8A8_UNORM);
+			SetInputElement(a_pElements[uCount++], "BLENDINDICES", DXGI_FORMAT_R8G8B8A8_UINT);
+		}
+
+		// The world and inverse transpose world of every instance, one row at a time.  Matches VertexCBufferData.
+		if (a_bInstanced)
+		{
+			for (LPCSTR sSemantic : { "WORLD", "WORLDINVTRANSPOSE" })
+			{
+				for (UINT uRow = 0; uRow < 4; uRow++)
+				{
+					D3D11_INPUT_ELEMENT_DESC& element = a_pElements[uCount++];
+					SetInputElement(element, sSemantic, DXGI_FORMAT_R32G32B32A32_FLOAT);
+					element.SemanticIndex = uRow;
+					element.InputSlot = INSTANCE_VERTEX_SLOT;
+					element.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+					element.InstanceDataStepRate = 1;
+				}
+			}
+		}
+
+		return uCount;
+	}
+
+	/// <summary>
+	/// Gets the file name of a variant of a vertex shader, with its name put in front of "VS",
+	/// or an empty string if the shader is not named like one.
+	/// </summary>
+	std::wstring GetVariant(const std::wstring& a_sVertexShader, const std::wstring& a_sVariant)
+	{
+		const std::wstring sSuffix = L"VS.cso";
+		if (a_sVertexShader.size() < sSuffix.size() ||
+			a_sVertexShader.compare(a_sVertexShader.size() - sSuffix.size(), sSuffix.size(), sSuffix) != 0)
+		{
+			return std::wstring();
+		}
+
+		return a_sVertexShader.substr(0, a_sVertexShader.size() - sSuffix.size()) + a_sVariant + sSuffix;
+	}
+}
+
 Shader::Shader(std::wstring a_sVertexShaderFile,
 	std::wstring a_sPixelShaderFile,
-	ShaderTopology a_ShaderTopology)
+	ShaderTopology a_ShaderTopology,
+	bool a_bInstanced)
 {
 	m_ShaderTopology = a_ShaderTopology;
 	FindExecutableLocation();
 
 	// Default shaders when using the default constructor.
-	CompileShaders(a_sVertexShaderFile, a_sPixelShaderFile);
+	CompileShaders(a_sVertexShaderFile, a_sPixelShaderFile, a_bInstanced);
+}
+
+Shader::~Shader(void)
+{
+	if (m_pActiveShader == this)
+	{
+		m_pActiveShader = nullptr;
+	}
 }
 
 void Shader::SetShader(void)
 {
-	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context = Graphics::GetContext();
+	StateCache* pStateCache = StateCache::GetInstance();
+	m_pActiveShader = this;
 
 	// Setting that the buffer vertices will be rendered as triangles.
-	context->IASetPrimitiveTopology((D3D11_PRIMITIVE_TOPOLOGY)m_ShaderTopology);
+	pStateCache->IASetPrimitiveTopology((D3D11_PRIMITIVE_TOPOLOGY)m_ShaderTopology);
 
-	// Setting the input layout.
-	context->IASetInputLayout(m_pInputLayout.Get());
+	// Setting the input layout and vertex shader of whichever format was drawn last.
+	BindVertexStage(m_ActiveFormat, m_bInstanced);
 
-	// Setting the pixel and vertex shaders.
-	context->VSSetShader(m_pVertexShader.Get(), 0, 0);
-	context->PSSetShader(m_pPixelShader.Get(), 0, 0);
+	// Setting the pixel shader.
+	pStateCache->PSSetShader(m_pPixelShader.Get());
 }
 
+bool Shader::SetVertexFormat(VertexFormat a_Format)
+{
+	// Nothing to switch over when no shader was set through this class.
+	if (m_pActiveShader == nullptr || m_pActiveShader->m_ActiveFormat == a_Format)
+	{
+		return true;
+	}
+
+	// Staying instanced if the format has an instanced variant, the next draw decides anyway.
+	return
+		m_pActiveShader->BindVertexStage(a_Format, m_pActiveShader->m_bInstanced) ||
+		m_pActiveShader->BindVertexStage(a_Format, false);
+}
+
+bool Shader::SetInstancing(bool a_bInstanced)
+{
+	// Without a shader set through this class there is nothing to read the instances.
+	if (m_pActiveShader == nullptr)
+	{
+		return !a_bInstanced;
+	}
+	if (m_pActiveShader->m_bInstanced == a_bInstanced)
+	{
+		return true;
+	}
+
+	return m_pActiveShader->BindVertexStage(m_pActiveShader->m_ActiveFormat, a_bInstanced);
+}
+
+bool Shader::BindVertexStage(VertexFormat a_Format, bool a_bInstanced)
+{
+	const VertexStage& stage = a_bInstanced ?
+		m_lInstancedStages[(unsigned int)a_Format] :
+		m_lVertexStages[(unsigned int)a_Format];
+	if (stage.VertexShader == nullptr || stage.InputLayout == nullptr)
+	{
+		return false;
+	}
+
+	StateCache* pStateCache = StateCache::GetInstance();
+	pStateCache->IASetInputLayout(stage.InputLayout.Get());
+	pStateCache->VSSetShader(stage.VertexShader.Get());
+
+	m_ActiveFormat = a_Format;
+	m_bInstanced = a_bInstanced;
+	return true;
+}
 void Shader::FindExecutableLocation(void)
 {
 	// Default to the current directory.
@@ -62,14 +206,12 @@ std::wstring Shader::CreateShaderFilePath(std::wstring a_sShaderFileName)
 	return std::wstring(m_sExecutablePath.begin(), m_sExecutablePath.end()) + a_sShaderFileName;
 }
 
-void Shader::CompileShaders(std::wstring a_sVertexShader, std::wstring a_sPixelShader)
+void Shader::CompileShaders(std::wstring a_sVertexShader, std::wstring a_sPixelShader, bool a_bInstanced)
 {
 	ID3DBlob* pixelShaderBlob;
-	ID3DBlob* vertexShaderBlob;
 
-	// Loading the data stored within the cso files.
+	// Loading the data stored within the cso file.
 	D3DReadFileToBlob(CreateShaderFilePath(a_sPixelShader).c_str(), &pixelShaderBlob);
-	D3DReadFileToBlob(CreateShaderFilePath(a_sVertexShader).c_str(), &vertexShaderBlob);
 
 	// Creating the pixel shader with the blob.
 	Graphics::GetDevice()->CreatePixelShader(
@@ -77,16 +219,20 @@ void Shader::CompileShaders(std::wstring a_sVertexShader, std::wstring a_sPixelS
 		pixelShaderBlob->GetBufferSize(),
 		0,
 		m_pPixelShader.GetAddressOf());
-
-	// Creating the vertex shader with the blob.
-	Graphics::GetDevice()->CreateVertexShader(
-		vertexShaderBlob->GetBufferPointer(),
-		vertexShaderBlob->GetBufferSize(),
-		0,
-		m_pVertexShader.GetAddressOf());
+	pixelShaderBlob->Release();
 
 	if (m_ShaderTopology == ShaderTopology::LineList)
 	{
+		ID3DBlob* vertexShaderBlob;
+		D3DReadFileToBlob(CreateShaderFilePath(a_sVertexShader).c_str(), &vertexShaderBlob);
+
+		VertexStage stage;
+		Graphics::GetDevice()->CreateVertexShader(
+			vertexShaderBlob->GetBufferPointer(),
+			vertexShaderBlob->GetBufferSize(),
+			0,
+			stage.VertexShader.GetAddressOf());
+
 		const UINT uLineSize = 1;
 		D3D11_INPUT_ELEMENT_DESC lineInputElements[uLineSize] = {};
 		lineInputElements[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;
@@ -99,40 +245,84 @@ void Shader::CompileShaders(std::wstring a_sVertexShader, std::wstring a_sPixelS
 			uLineSize,
 			vertexShaderBlob->GetBufferPointer(),
 			vertexShaderBlob->GetBufferSize(),
-			m_pInputLayout.GetAddressOf());
+			stage.InputLayout.GetAddressOf());
+		vertexShaderBlob->Release();
+
+		// Every format starts with its position, so lines read all of them the same way.
+		for (unsigned int i = 0; i < VERTEX_FORMAT_COUNT; i++)
+		{
+			m_lVertexStages[i] = stage;
+		}
 		return;
 	}
 
-	// Creating the semantic input elements for the shader program.
-	const UINT uSize = 4;
-	D3D11_INPUT_ELEMENT_DESC inputElements[uSize] = {};
-
-	// Every Vertex Shader will use the same input layout.
-	// POSITION
-	inputElements[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;			
-	inputElements[0].SemanticName = "POSITION";						
-	inputElements[0].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-
-	// NORMAL
-	inputElements[1].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-	inputElements[1].SemanticName = "NORMAL";
-	inputElements[1].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-
-	// UV
-	inputElements[2].Format = DXGI_FORMAT_R32G32_FLOAT;		
-	inputElements[2].SemanticName = "UV";						
-	inputElements[2].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-
-	// TANGENT
-	inputElements[3].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-	inputElements[3].SemanticName = "TANGENT";
-	inputElements[3].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-
-	// Creating the input layout with the semantic descriptions.
-	Graphics::GetDevice()->CreateInputLayout(
-		inputElements,							
-		uSize,										
-		vertexShaderBlob->GetBufferPointer(),	
-		vertexShaderBlob->GetBufferSize(),		
-		m_pInputLayout.GetAddressOf());
+	// The full precision formats are read by the vertex shader as is,
+	// the compact ones by the variant that decodes them first.
+	const VertexFormat lFullFormats[2] = { VertexFormat::Standard, VertexFormat::Skinned };
+	const VertexFormat lCompactFormats[2] = { VertexFormat::Compact, VertexFormat::CompactSkinned };
+	CreateVertexStages(a_sVertexShader, lFullFormats, false);
+
+	std::wstring sCompactShader = GetVariant(a_sVertexShader, L"Compact");
+	if (!sCompactShader.empty())
+	{
+		CreateVertexStages(sCompactShader, lCompactFormats, false);
+	}
+
+	// The instanced variants are opt-in, shaders without them draw every instance on its own.
+	if (!a_bInstanced)
+	{
+		return;
+	}
+
+	std::wstring sInstancedShader = GetVariant(a_sVertexShader, L"Instanced");
+	if (!sInstancedShader.empty())
+	{
+		CreateVertexStages(sInstancedShader, lFullFormats, true);
+		if (m_lInstancedStages[(unsigned int)VertexFormat::Standard].VertexShader != nullptr)
+		{
+			CreateVertexStages(GetVariant(sInstancedShader, L"Compact"), lCompactFormats, true);
+		}
+	}
+}
+
+void Shader::CreateVertexStages(std::wstring a_sVertexShader, const VertexFormat (&a_lFormats)[2], bool a_bInstanced)
+{
+	ID3DBlob* vertexShaderBlob;
+	if (FAILED(D3DReadFileToBlob(CreateShaderFilePath(a_sVertexShader).c_str(), &vertexShaderBlob)))
+	{
+		Logger::GetInstance()->Log(
+			"Shader.cpp",
+			"Missing vertex shader " + std::string(a_sVertexShader.begin(), a_sVertexShader.end()),
+			INFO_LOG);
+		return;
+	}
+
+	// Creating the vertex shader with the blob.
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> pVertexShader;
+	Graphics::GetDevice()->CreateVertexShader(
+		vertexShaderBlob->GetBufferPointer(),
+		vertexShaderBlob->GetBufferSize(),
+		0,
+		pVertexShader.GetAddressOf());
+
+	for (VertexFormat format : a_lFormats)
+	{
+		// Creating the semantic input elements for the format.
+		D3D11_INPUT_ELEMENT_DESC inputElements[16] = {};
+		UINT uSize = GetInputElements(format, a_bInstanced, inputElements);
+
+		// Creating the input layout with the semantic descriptions.
+		VertexStage& stage = a_bInstanced ?
+			m_lInstancedStages[(unsigned int)format] :
+			m_lVertexStages[(unsigned int)format];
+		stage.VertexShader = pVertexShader;
+		Graphics::GetDevice()->CreateInputLayout(
+			inputElements,
+			uSize,
+			vertexShaderBlob->GetBufferPointer(),
+			vertexShaderBlob->GetBufferSize(),
+			stage.InputLayout.GetAddressOf());
+	}
+
+	vertexShaderBlob->Release();
 }
@@ -4,6 +4,10 @@
 #include<string>
 
 #include "Graphics.h"
+#include "VertexFormat.h"
+
+// The vertex buffer slot instanced vertex shaders read their per-instance data from.
+#define INSTANCE_VERTEX_SLOT 1
 
 /// <summary>
 /// Less verbose versions of the D3D11 topology values.
@@ -14,18 +18,35 @@ enum ShaderTopology
 	LineList = D3D11_PRIMITIVE_TOPOLOGY_LINELIST
 };
 
+/// <summary>
+/// The vertex shader and input layout that read one VertexFormat.
+/// </summary>
+struct VertexStage
+{
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> VertexShader = nullptr;
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> InputLayout = nullptr;
+};
+
 /// <summary>
 /// Compiles and deploys shaders used by the simulation.
+/// Compact vertex formats are read by a variant of the vertex shader whose
+/// file name has "Compact" in front of "VS" (EntityVS.cso -> EntityCompactVS.cso).
+/// Shaders created with instancing use the variant with "Instanced" in front of that (EntityInstancedVS.cso,
+/// EntityInstancedCompactVS.cso), which reads its world matrices from INSTANCE_VERTEX_SLOT.
 /// </summary>
 class Shader
 {
 private:
+	static Shader* m_pActiveShader;
+
 	ShaderTopology m_ShaderTopology;
 	std::string m_sExecutablePath;	
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> m_pPixelShader = nullptr;
-	Microsoft::WRL::ComPtr<ID3D11VertexShader> m_pVertexShader = nullptr;
 
-	Microsoft::WRL::ComPtr<ID3D11InputLayout> m_pInputLayout = nullptr;
+	VertexStage m_lVertexStages[VERTEX_FORMAT_COUNT];
+	VertexStage m_lInstancedStages[VERTEX_FORMAT_COUNT];
+	VertexFormat m_ActiveFormat = VertexFormat::Standard;
+	bool m_bInstanced = false;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> m_pConstantBuffer = nullptr;
 		
 public:
@@ -34,16 +55,43 @@ public:
 	/// </summary>
 	/// <param name="a_sVertexShaderFile">The vertex shader .cso file.</param>
 	/// <param name="a_sPixelShaderFile">The pixel shader .cso file.</param>
+	/// <param name="a_bInstanced">Whether to also load the instanced variants of the vertex shader.</param>
 	Shader(std::wstring a_sVertexShaderFile = L"EntityVS.cso", 
 		   std::wstring a_sPixelShaderFile = L"EntityPS.cso",
-		   ShaderTopology a_ShaderTopology = ShaderTopology::TriangleList);
+		   ShaderTopology a_ShaderTopology = ShaderTopology::TriangleList,
+		   bool a_bInstanced = false);
+
+	/// <summary>
+	/// Destructs the shader, making sure it is no longer seen as the active one.
+	/// </summary>
+	~Shader(void);
 
 	/// <summary>
 	/// Sets this shader program as the active shader.
 	/// </summary>
 	void SetShader(void);
 
+	/// <summary>
+	/// Switches the active shader over to the vertex shader and input layout that read the passed
+	/// in format.  Only touches the pipeline when the format actually changes.
+	/// </summary>
+	/// <returns>False if the active shader has no way of reading the format.</returns>
+	static bool SetVertexFormat(VertexFormat a_Format);
+
+	/// <summary>
+	/// Switches the active shader between its instanced and its regular vertex shader,
+	/// keeping the vertex format.  Only touches the pipeline when something actually changes.
+	/// </summary>
+	/// <returns>False if the active shader has no instanced variant for the format.</returns>
+	static bool SetInstancing(bool a_bInstanced);
+
 private:
+	/// <summary>
+	/// Binds the vertex shader and input layout of a format to the pipeline.
+	/// </summary>
+	/// <returns>False if the stage of that format could not be created.</returns>
+	bool BindVertexStage(VertexFormat a_Format, bool a_bInstanced);
+
 	/// <summary>
 	/// Finds the filepath containing the executable.  This is where HLSL/.cso files are put.
 	/// </summary>
@@ -61,7 +109,17 @@ private:
 	/// </summary>
 	/// <param name="a_sVertexShader">The vertex shader file name.</param>
 	/// <param name="a_sPixelShader">The pixel shader file name.</param>
-	void CompileShaders(std::wstring a_sVertexShader, std::wstring a_sPixelShader);
+	/// <param name="a_bInstanced">Whether to also load the instanced variants of the vertex shader.</param>
+	void CompileShaders(std::wstring a_sVertexShader, std::wstring a_sPixelShader, bool a_bInstanced);
+
+	/// <summary>
+	/// Creates a vertex shader and the input layouts of the formats it reads.
+	/// Missing files are skipped, leaving those formats unreadable.
+	/// </summary>
+	/// <param name="a_sVertexShader">The vertex shader file name.</param>
+	/// <param name="a_lFormats">The formats the vertex shader reads.</param>
+	/// <param name="a_bInstanced">Whether the vertex shader also reads per-instance data.</param>
+	void CreateVertexStages(std::wstring a_sVertexShader, const VertexFormat (&a_lFormats)[2], bool a_bInstanced);
 };
 
 #endif //__SHADER_H_
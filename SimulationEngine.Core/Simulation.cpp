@@ -8,6 +8,11 @@
 #include "Transform.h"
 #include "Logger.h"
 #include "SimulationUtils.h"
+#include "ThreadPool.h"
+#include "AssetLoader.h"
+#include "StateCache.h"
+#include "ResourceRegistry.h"
+#include "TransformPool.h"
 
 // External code.
 #include "ImGui/imgui.h"
@@ -23,6 +28,33 @@
 #define SPHERE_FILE "sphere.graphics_obj"
 #define CYLINDER_FILE "cylinder.graphics_obj"
 
+namespace
+{
+	/// <summary>
+	/// Draws drag floats for a transform's position, rotation and scale.  Values are edited
+	/// on copies and only written back when dragged, so just looking never dirties anything.
+	/// </summary>
+	void DrawTransformEditor(std::shared_ptr<Transform> a_pTransform, const std::string& a_sNum)
+	{
+		Vector3 v3Position = a_pTransform->GetPosition();
+		Vector3 v3Rotation = a_pTransform->GetRotation();
+		Vector3 v3Scale = a_pTransform->GetScale();
+
+		if (ImGui::DragFloat3(("Position##" + a_sNum).c_str(), &v3Position.x, 0.025f))
+		{
+			a_pTransform->SetPosition(v3Position);
+		}
+		if (ImGui::DragFloat3(("Rotation##" + a_sNum).c_str(), &v3Rotation.x, 0.025f))
+		{
+			a_pTransform->SetRotation(v3Rotation);
+		}
+		if (ImGui::DragFloat3(("Scale##" + a_sNum).c_str(), &v3Scale.x, 0.025f))
+		{
+			a_pTransform->SetScale(v3Scale);
+		}
+	}
+}
+
 void Simulation::Init()
 {
 	int width = Application::GetInstance()->GetWidth();
@@ -44,6 +76,7 @@ void Simulation::Init()
 	Graphics::GetDevice()->CreateSamplerState(&sampleDesc, &pSampler);
 
 	m_pEntityManager = std::make_shared<EntityManager>();
+	m_pRenderer = std::make_shared<SceneRenderer>();
 
 	Light light{};
 	light.Type = LIGHT_TYPE_DIRECTIONAL;
@@ -60,36 +93,41 @@ void Simulation::Init()
 	light.Position = Vector3(0.0f, -1.0f, 0.0f);
 	m_pEntityManager->AddLight(light, LightIndex::Light1);
 
-	m_pShader = std::make_shared<Shader>();
+	// Entities are the only things drawn in batches of instances.
+	m_pShader = std::make_shared<Shader>(
+		L"EntityVS.cso",
+		L"EntityPS.cso",
+		ShaderTopology::TriangleList,
+		true
+	);
 	std::shared_ptr<Material> mat = std::make_shared<Material>(
 		m_pShader, 
 		Vector4(0.0f, 0.0f, 0.0f, 1.0f),
 		0.5f);
 
+	// Every asset below starts loading in the background and shows up once its upload is processed.
+	AssetLoader* pLoader = AssetLoader::GetInstance();
+
 	std::shared_ptr<Shader> pShader = std::make_shared<Shader>(
 		L"AnimatedEntityVS.cso",
 		L"AnimatedEntityPS.cso",
 		ShaderTopology::TriangleList
 	);
 	m_pAnimEntities = std::make_shared<AnimEntityManager>(pShader);
-	std::shared_ptr<AnimatedEntity> m_pTestEntity = std::make_shared<AnimatedEntity>("../SimulationEngine.Assets/Advanced/standard.fbx", m_pShader, pSampler);
+	std::shared_ptr<AnimatedEntity> m_pTestEntity = pLoader->LoadAnimatedEntity("../SimulationEngine.Assets/Advanced/standard.fbx", m_pShader, pSampler);
 	m_pTestEntity->GetTransform()->Rotate(Vector3(
 		DirectX::XMConvertToRadians(270.0f),
 		DirectX::XMConvertToRadians(180.0f), 
 		DirectX::XMConvertToRadians(0.0f)));
 	m_pAnimEntities->AddAnimEntity(m_pTestEntity);
 
-	TextureSet cobblestone = Utils::LoadTextureSet(L"cobblestone");
-	mat->AddTexturesSRV(0, cobblestone.Albedo);		// Albedo
-	mat->AddTexturesSRV(1, cobblestone.Normal);		// Normals
-	mat->AddTexturesSRV(2, cobblestone.Roughness);	// Roughness
-	mat->AddTexturesSRV(3, cobblestone.Metal);		// Metal
+	pLoader->LoadTextureSet(mat, L"cobblestone");	// Albedo, Normals, Roughness, Metal
 	mat->AddSampler(0, pSampler);					// Sampler
 
-	std::shared_ptr<Mesh> sphere = std::make_shared<Mesh>(MODEL_DIRECTORY, SPHERE_FILE);
-	std::shared_ptr<Mesh> cylinder = std::make_shared<Mesh>(MODEL_DIRECTORY, CYLINDER_FILE);
-	std::shared_ptr<Mesh> cube = std::make_shared<Mesh>(MODEL_DIRECTORY, CUBE_FILE);
-	std::shared_ptr<Mesh> helix = std::make_shared<Mesh>("../SimulationEngine.Assets/Models/", "helix.graphics_obj");
+	std::shared_ptr<Mesh> sphere = pLoader->LoadMesh(MODEL_DIRECTORY, SPHERE_FILE);
+	std::shared_ptr<Mesh> cylinder = pLoader->LoadMesh(MODEL_DIRECTORY, CYLINDER_FILE);
+	std::shared_ptr<Mesh> cube = pLoader->LoadMesh(MODEL_DIRECTORY, CUBE_FILE);
+	std::shared_ptr<Mesh> helix = pLoader->LoadMesh("../SimulationEngine.Assets/Models/", "helix.graphics_obj");
 
 	//std::shared_ptr<Entity> pCar = std::make_shared<Entity>(m_pShader, pSampler, "../SimulationEngine.Assets/TexturedModels/mcl35m_2.graphics_obj");
 
@@ -100,7 +138,7 @@ void Simulation::Init()
 
 	//m_pEntityManager->AddEntity(pCar);
 
-	EntityPtrCollection& entities = m_pEntityManager->GetEntities();
+	const EntityPtrCollection& entities = m_pEntityManager->GetEntities();
 	for (UINT i = 0; i < entities.size(); i++)
 	{
 		std::shared_ptr<Transform> t = entities[i]->GetTransform();
@@ -111,7 +149,8 @@ void Simulation::Init()
 	}
 
 	m_pSky = std::make_shared<Sky>(cube, pSampler);
-	m_pSky->CreateCubemap(
+	pLoader->LoadCubemap(
+		m_pSky,
 		L"../SimulationEngine.Assets/Textures/Skies/right.png",
 		L"../SimulationEngine.Assets/Textures/Skies/left.png",
 		L"../SimulationEngine.Assets/Textures/Skies/up.png",
@@ -127,12 +166,15 @@ void Simulation::Init()
 	ImGui_ImplWin32_Init(Application::GetInstance()->GetHandle());
 	ImGui_ImplDX11_Init(Graphics::GetDevice().Get(), Graphics::GetContext().Get());
 	ImGui::StyleColorsDark();
-	Graphics::GetContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	StateCache::GetInstance()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 #endif
 }
 
 void Simulation::Update(float a_fDeltaTime)
 {
+	// Finishing off any assets the workers are done with.
+	AssetLoader::GetInstance()->ProcessUploads();
+
 	m_pCamera->UpdateMovement(a_fDeltaTime);
 
 	EntityPtrCollection entities = m_pEntityManager->GetEntities();
@@ -150,15 +192,24 @@ void Simulation::Update(float a_fDeltaTime)
 	}
 
 #if defined(DEBUG) | defined(_DEBUG)
+	// Outliners follow the entity drawing their mesh once attached, so this only does anything for new ones.
 	std::map<std::shared_ptr<Mesh>, std::shared_ptr<Outliner>> mOutliners = LineManager::GetInstance()->GetOutliners();
-	int i = 0;
-	for (const auto& kvp : mOutliners)
+	for (UINT i = 0; i < entities.size(); i++)
 	{
-		kvp.second->SetTransform(*entities[i]->GetTransform());
-		i++;
+		for (const std::shared_ptr<Mesh>& pMesh : entities[i]->GetMeshes())
+		{
+			auto outliner = mOutliners.find(pMesh);
+			if (outliner != mOutliners.end() && !outliner->second->GetTransform()->HasParent())
+			{
+				entities[i]->Attach(outliner->second->GetTransform());
+			}
+		}
 	}
 #endif
 
+	// Recomputing the matrices of everything that moved this frame in one go.
+	TransformPool::GetInstance()->Update();
+
 	if (Input::KeyDown(VK_ESCAPE))
 	{
 		Application::GetInstance()->Quit();
@@ -167,6 +218,9 @@ void Simulation::Update(float a_fDeltaTime)
 
 void Simulation::Draw(float a_fDeltaTime)
 {
+	// Counting the calls the state cache drops from here on as the new frame's.
+	StateCache::GetInstance()->BeginFrame();
+
 	float background[4] = { 0.1f, 0.2f, 0.5f, 0.0f };
 	// Clearing the screen.
 	Graphics::GetContext()->ClearRenderTargetView(
@@ -179,17 +233,19 @@ void Simulation::Draw(float a_fDeltaTime)
 	Matrix4 m4View = m_pCamera->GetView();
 	Matrix4 m4Proj = m_pCamera->GetProjection();
 
-	m_pAnimEntities->Draw(m_pCamera);
-
-	// Setting the shader and rendering the entities.
-	m_pShader->SetShader();
-	m_pEntityManager->Draw(m_pCamera);
+	// Every manager only submits its draws, which are then sorted by state and drawn together.
+	// The camera and lights go up once for the whole frame.
+	m_pRenderer->BeginFrame(m_pCamera, m_pEntityManager->GetLights());
+	m_pAnimEntities->Submit(*m_pRenderer, m_pCamera);
+	m_pEntityManager->Submit(*m_pRenderer, m_pCamera);
 
 	if (m_bDebugRendering)
 	{
-		LineManager::GetInstance()->Draw(m_pCamera, Vector4(0.0f, 1.0f, 1.0f, 1.0f));
+		LineManager::GetInstance()->Submit(*m_pRenderer, m_pCamera, Vector4(0.0f, 1.0f, 1.0f, 1.0f));
 	}
 
+	m_pRenderer->Draw();
+
 	// Rendering the skybox last since last is slightly more efficient.
 	m_pSky->Draw(m4View, m4Proj);
 
@@ -233,6 +289,12 @@ void Simulation::UpdateImGui(float a_fDeltaTime)
 	Input::SetKeyboardCapture(false);
 	Input::SetMouseCapture(false);
 
+	// Right clicking the scene picks whatever is under the cursor, unless the click was meant for the UI.
+	if (Input::MouseRightPress() && !io.WantCaptureMouse)
+	{
+		PickEntity(io.MousePos.x, io.MousePos.y);
+	}
+
 	// Setting what is inside of the Gui.
 	ImGui::Begin("Application Settings");
 
@@ -249,6 +311,41 @@ void Simulation::UpdateImGui(float a_fDeltaTime)
 	// Framerate text in the UI:
 	ImGui::Text("Delta Time: %f", a_fDeltaTime);
 
+	CullStats entityCulling = m_pEntityManager->GetCullStats();
+	CullStats animCulling = m_pAnimEntities->GetCullStats();
+	ImGui::Text("Entities: %u visible, %u culled", entityCulling.Visible, entityCulling.Culled);
+	ImGui::Text("AnimEntities: %u visible, %u culled", animCulling.Visible, animCulling.Culled);
+
+	RenderStats renderStats = m_pRenderer->GetStats();
+	ImGui::Text(
+		"Draws: %u (%u instanced, %u instances, %u unsorted)",
+		renderStats.Draws,
+		renderStats.InstancedDraws,
+		renderStats.Instances,
+		renderStats.Unsorted);
+	ImGui::Text(
+		"Switches: %u shader, %u material, %u mesh",
+		renderStats.ShaderSwitches,
+		renderStats.MaterialSwitches,
+		renderStats.MeshSwitches);
+
+	StateCacheStats stateStats = StateCache::GetInstance()->GetStats();
+	ImGui::Text("State calls: %u issued, %u avoided", stateStats.Issued, stateStats.Avoided);
+	ImGui::Text("Constant uploads: %u, %u bytes", stateStats.Uploads, stateStats.UploadedBytes);
+
+	if (m_PickHit.Hit)
+	{
+		ImGui::Text(
+			"Picked: %s %u at %.2f",
+			m_bPickedAnimated ? "AnimEntity" : "Entity",
+			m_PickHit.Entity,
+			m_PickHit.Distance);
+	}
+	else
+	{
+		ImGui::Text("Right click the scene to pick an entity");
+	}
+
 	if (ImGui::TreeNode("Debug"))
 	{
 		if (ImGui::Button("Enable Debug Rendering"))
@@ -258,6 +355,58 @@ void Simulation::UpdateImGui(float a_fDeltaTime)
 
 		ImGui::TreePop();
 	}
+	if (ImGui::TreeNode("Benchmarks"))
+	{
+		if (ImGui::Button("Benchmark Tangent Generation"))
+		{
+			m_TangentBenchmark = TangentGenerator::Benchmark(1024, 5);
+		}
+		if (m_TangentBenchmark.TriangleCount > 0)
+		{
+			ImGui::Text("Triangles: %u", m_TangentBenchmark.TriangleCount);
+			ImGui::Text("Scalar: %.3f ms", m_TangentBenchmark.ScalarMilliseconds);
+			ImGui::Text("Parallel: %.3f ms", m_TangentBenchmark.ParallelMilliseconds);
+			ImGui::Text("Speedup: %.2fx", m_TangentBenchmark.ScalarMilliseconds / m_TangentBenchmark.ParallelMilliseconds);
+			ImGui::Text("Max difference: %g", m_TangentBenchmark.MaxDifference);
+		}
+
+		ImGui::TreePop();
+	}
+	if (ImGui::TreeNode("Resources"))
+	{
+		ResourceRegistry* pRegistry = ResourceRegistry::GetInstance();
+		const std::pair<const char*, ResourceStats> lStats[] =
+		{
+			{ "Meshes", pRegistry->GetMeshStats() },
+			{ "Textures", pRegistry->GetTextureStats() },
+			{ "Materials", pRegistry->GetMaterialStats() },
+			{ "Models", pRegistry->GetModelStats() }
+		};
+
+		ImGui::Text("Pending loads: %u", AssetLoader::GetInstance()->GetPendingCount());
+		for (const auto& stats : lStats)
+		{
+			ImGui::Text(
+				"%s: %u live, %u hits, %u misses",
+				stats.first,
+				stats.second.Live,
+				stats.second.Hits,
+				stats.second.Misses);
+		}
+
+		if (ImGui::Button("Free Unused Resources"))
+		{
+			pRegistry->Collect();
+		}
+
+		ImGui::TreePop();
+	}
+	// Opening the picked entity's editor.
+	bool bRevealEntities = m_bRevealPick && !m_bPickedAnimated;
+	if (bRevealEntities)
+	{
+		ImGui::SetNextItemOpen(true);
+	}
 	if (ImGui::TreeNode("Entities"))
 	{
 		EntityPtrCollection entities = m_pEntityManager->GetEntities();
@@ -270,28 +419,27 @@ void Simulation::UpdateImGui(float a_fDeltaTime)
 			sInterface += sNum;
 
 			// Creating the nodes for the individual entities.
+			if (bRevealEntities && i == m_PickHit.Entity)
+			{
+				ImGui::SetNextItemOpen(true);
+			}
 			if (ImGui::TreeNode(sInterface.c_str()))
 			{
 				std::shared_ptr<Transform> current = entities[i]->GetTransform();
 
 				// Creating the drag floats.
-				ImGui::DragFloat3(
-					("Position##" + sNum).c_str(),
-					&current->GetPosition().x,
-					0.025f);
-				ImGui::DragFloat3(
-					("Rotation##" + sNum).c_str(),
-					&current->GetRotation().x,
-					0.025f);
-				ImGui::DragFloat3(
-					("Scale##" + sNum).c_str(),
-					&current->GetScale().x,
-					0.025f);
+				DrawTransformEditor(current, sNum);
 				ImGui::TreePop();
 			}
 		}
 		ImGui::TreePop();
 	}
+	// Same for a picked animated entity.
+	bool bRevealAnimEntities = m_bRevealPick && m_bPickedAnimated;
+	if (bRevealAnimEntities)
+	{
+		ImGui::SetNextItemOpen(true);
+	}
 	if (ImGui::TreeNode("AnimEntities"))
 	{
 		std::vector<std::shared_ptr<AnimatedEntity>> entities = m_pAnimEntities->GetEntities();
@@ -304,23 +452,16 @@ void Simulation::UpdateImGui(float a_fDeltaTime)
 			sInterface += sNum;
 
 			// Creating the nodes for the individual entities.
+			if (bRevealAnimEntities && i == m_PickHit.Entity)
+			{
+				ImGui::SetNextItemOpen(true);
+			}
 			if (ImGui::TreeNode(sInterface.c_str()))
 			{
 				std::shared_ptr<Transform> current = entities[i]->GetTransform();
 
 				// Creating the drag floats.
-				ImGui::DragFloat3(
-					("Position##" + sNum).c_str(),
-					&current->GetPosition().x,
-					0.025f);
-				ImGui::DragFloat3(
-					("Rotation##" + sNum).c_str(),
-					&current->GetRotation().x,
-					0.025f);
-				ImGui::DragFloat3(
-					("Scale##" + sNum).c_str(),
-					&current->GetScale().x,
-					0.025f);
+				DrawTransformEditor(current, sNum);
 				ImGui::TreePop();
 			}
 		}
@@ -370,6 +511,26 @@ void Simulation::UpdateImGui(float a_fDeltaTime)
 
 	// Closing the sub window.
 	ImGui::End();
+	m_bRevealPick = false;
+}
+
+void Simulation::PickEntity(float a_fX, float a_fY)
+{
+	Ray ray = m_pCamera->GetPickRay(
+		a_fX,
+		a_fY,
+		(float)Application::GetInstance()->GetWidth(),
+		(float)Application::GetInstance()->GetHeight());
+
+	// Keeping whichever of the two managers had the closer hit.
+	RayHit entityHit;
+	RayHit animHit;
+	m_pEntityManager->Raycast(ray, entityHit);
+	m_pAnimEntities->Raycast(ray, animHit);
+
+	m_bPickedAnimated = animHit.Hit && (!entityHit.Hit || animHit.Distance < entityHit.Distance);
+	m_PickHit = m_bPickedAnimated ? animHit : entityHit;
+	m_bRevealPick = m_PickHit.Hit;
 }
 
 void Simulation::OnResize()
@@ -386,6 +547,12 @@ void Simulation::OnResize()
 Simulation::~Simulation()
 {
 	LineManager::Release();
+	// The workers are joined first since they still hand work back to the AssetLoader.
+	ThreadPool::Release();
+	AssetLoader::Release();
+	ResourceRegistry::Release();
+	TransformPool::Release();
+	StateCache::Release();
 
 #if defined(DEBUG) | defined(_DEBUG)
 	// ImGui clean up
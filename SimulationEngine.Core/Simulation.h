@@ -7,6 +7,8 @@
 #include "EntityManager.h"
 #include "LineManager.h"
 #include "AnimEntityManager.h"
+#include "SceneRenderer.h"
+#include "TangentGenerator.h"
 
 /* Safely reallocates memory.  Deletes data and initializes the pointer to nullptr. */
 #define SafeDelete(p) { if (p) { delete p; p = nullptr; } }
@@ -24,6 +26,12 @@ private:
 	// ImGui Fields:
 	float m_fUIFramerate = 0.0f;
 	bool m_bDebugRendering = true;
+	TangentBenchmark m_TangentBenchmark;
+
+	// The entity last picked with the mouse, and whether its tree node still has to be opened.
+	RayHit m_PickHit;
+	bool m_bPickedAnimated = false;
+	bool m_bRevealPick = false;
 
 	// Simulation Fields:
 	std::shared_ptr<Camera> m_pCamera = nullptr;
@@ -32,6 +40,7 @@ private:
 	std::shared_ptr<EntityManager> m_pEntityManager = nullptr;
 
 	std::shared_ptr<AnimEntityManager> m_pAnimEntities = nullptr;
+	std::shared_ptr<SceneRenderer> m_pRenderer = nullptr;
 public:
 	/// <summary>
 	/// Constructs the Simulation class.
@@ -75,6 +84,12 @@ public:
 	/// Callback for when the screen is resized by the user.
 	/// </summary>
 	void OnResize(void);
+
+private:
+	/// <summary>
+	/// Casts a ray through a pixel of the window and remembers the closest entity it hit.
+	/// </summary>
+	void PickEntity(float a_fX, float a_fY);
 };
 
 #endif //__SIMULATION_H_
@@ -1,7 +1,12 @@
 #include "SimulationUtils.h"
 #include "Graphics.h"
+#include "Material.h"
+#include "ResourceRegistry.h"
+#include "MappedIOSystem.h"
 
-#include <WICTextureLoader.h>
+#include <wincodec.h>
+
+#pragma comment(lib, "windowscodecs.lib")
 
 #define PBR_FILE_PATH L"../SimulationEngine.Assets/Textures/PBR/"
 
@@ -12,60 +17,311 @@
 
 TextureSet Utils::LoadTextureSet(std::wstring a_sTextureName)
 {
-	Microsoft::WRL::ComPtr<ID3D11Device> device = Graphics::GetDevice().Get();
-	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context = Graphics::GetContext().Get();
-
 	TextureSet result{};
 
-	std::wstring sAlbedo = (PBR_FILE_PATH + a_sTextureName + ALBEDO_ENDING).c_str();
-	std::wstring sNormal = (PBR_FILE_PATH + a_sTextureName + NORMALS_ENDING).c_str();
-	std::wstring sRoughness = (PBR_FILE_PATH + a_sTextureName + ROUGHNESS_ENDING).c_str();
-	std::wstring sMetal = (PBR_FILE_PATH + a_sTextureName + METAL_ENDING).c_str();
+	// Going through LoadTexture so sets that share files only load them once.
+	result.Albedo = LoadTexture(GetTextureSetFile(a_sTextureName, ALBEDO_REGISTER), ALBEDO_REGISTER);
+	result.Normal = LoadTexture(GetTextureSetFile(a_sTextureName, NORMAL_REGISTER), NORMAL_REGISTER);
+	result.Roughness = LoadTexture(GetTextureSetFile(a_sTextureName, ROUGHNESS_REGISTER), ROUGHNESS_REGISTER);
+	result.Metal = LoadTexture(GetTextureSetFile(a_sTextureName, METAL_REGISTER), METAL_REGISTER);
 
-	DirectX::CreateWICTextureFromFile(
-		device.Get(),
-		context.Get(),
-		sAlbedo.c_str(),
-		nullptr,
-		&result.Albedo);
-	DirectX::CreateWICTextureFromFile(
-		device.Get(),
-		context.Get(),
-		sNormal.c_str(),
+	return result;
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Utils::LoadTexture(std::wstring a_sFileName, unsigned int a_uRegister)
+{
+	// Cooked the same way the AssetLoader does it, so both share the registry entry and the cache.
+	TextureCookOptions options;
+	options.Usage = GetTextureUsage(a_uRegister);
+
+	// Only the first request for a file actually reads it.
+	return ResourceRegistry::GetInstance()->GetTexture(a_sFileName, TextureCooker::PackOptions(options), [&]()
+		{
+			CookedTexture texture;
+			if (!LoadCookedTexture(a_sFileName, options, texture))
+			{
+				return Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>();
+			}
+
+			return CreateTexture(texture);
+		});
+}
+
+std::wstring Utils::GetTextureSetFile(std::wstring a_sTextureName, unsigned int a_uRegister)
+{
+	switch (a_uRegister)
+	{
+	case NORMAL_REGISTER: return PBR_FILE_PATH + a_sTextureName + NORMALS_ENDING;
+	case ROUGHNESS_REGISTER: return PBR_FILE_PATH + a_sTextureName + ROUGHNESS_ENDING;
+	case METAL_REGISTER: return PBR_FILE_PATH + a_sTextureName + METAL_ENDING;
+	default: return PBR_FILE_PATH + a_sTextureName + ALBEDO_ENDING;
+	}
+}
+
+namespace
+{
+	/// <summary>
+	/// Keeps COM initialized on the calling thread for as long as it is in scope.
+	/// Worker threads never initialize COM on their own, so every decode does it.
+	/// </summary>
+	struct ComScope
+	{
+		HRESULT Result;
+
+		ComScope(void) { Result = CoInitializeEx(nullptr, COINIT_MULTITHREADED); }
+		~ComScope(void) { if (SUCCEEDED(Result)) CoUninitialize(); }
+	};
+
+	/// <summary>
+	/// Creates the WIC factory used for decoding images.
+	/// </summary>
+	Microsoft::WRL::ComPtr<IWICImagingFactory> CreateWICFactory(void)
+	{
+		Microsoft::WRL::ComPtr<IWICImagingFactory> factory;
+		CoCreateInstance(
+			CLSID_WICImagingFactory,
+			nullptr,
+			CLSCTX_INPROC_SERVER,
+			IID_PPV_ARGS(factory.GetAddressOf()));
+
+		return factory;
+	}
+
+	/// <summary>
+	/// Converts the first frame of a decoder into RGBA pixels.
+	/// </summary>
+	bool DecodeFirstFrame(IWICBitmapDecoder* a_pDecoder, ImageData& a_Result)
+	{
+		Microsoft::WRL::ComPtr<IWICBitmapFrameDecode> frame;
+		if (FAILED(a_pDecoder->GetFrame(0, frame.GetAddressOf())))
+		{
+			return false;
+		}
+
+		UINT uWidth = 0;
+		UINT uHeight = 0;
+		frame->GetSize(&uWidth, &uHeight);
+
+		// Converting whatever the file stored into the one format the engine uploads.
+		Microsoft::WRL::ComPtr<IWICBitmapSource> converted;
+		if (FAILED(WICConvertBitmapSource(GUID_WICPixelFormat32bppRGBA, frame.Get(), converted.GetAddressOf())))
+		{
+			return false;
+		}
+
+		a_Result.Width = uWidth;
+		a_Result.Height = uHeight;
+		a_Result.Pixels.resize((size_t)uWidth * uHeight * 4);
+
+		return SUCCEEDED(converted->CopyPixels(
+			nullptr,
+			uWidth * 4,
+			(UINT)a_Result.Pixels.size(),
+			a_Result.Pixels.data()));
+	}
+}
+
+bool Utils::NarrowPath(const std::wstring& a_sPath, std::string& a_sResult)
+{
+	a_sResult.clear();
+	if (a_sPath.empty())
+	{
+		return true;
+	}
+
+	// The narrow file functions read paths in the ANSI code page, so that is what the path is converted to.
+	// Characters it cannot hold would be replaced by a default one, which is caught instead of opening the wrong path.
+	BOOL bUsedDefault = FALSE;
+	int iSize = WideCharToMultiByte(CP_ACP, WC_NO_BEST_FIT_CHARS, a_sPath.c_str(), (int)a_sPath.size(), nullptr, 0, nullptr, &bUsedDefault);
+	if (iSize <= 0 || bUsedDefault)
+	{
+		return false;
+	}
+
+	a_sResult.resize(iSize);
+	WideCharToMultiByte(CP_ACP, WC_NO_BEST_FIT_CHARS, a_sPath.c_str(), (int)a_sPath.size(), &a_sResult[0], iSize, nullptr, nullptr);
+	return true;
+}
+
+bool Utils::DecodeImage(std::wstring a_sFileName, ImageData& a_Result)
+{
+	// Decoding straight out of the mapping (or the mounted archive) instead of letting WIC read the file.
+	// Paths that cannot be narrowed go through WIC's own file reading, which takes the wide path as is.
+	std::string sFileName;
+	MappedView view;
+	if (NarrowPath(a_sFileName, sFileName) && MappedIOSystem::MapFile(sFileName, view))
+	{
+		return DecodeImage(view.Data, view.Size, a_Result);
+	}
+
+	ComScope com;
+	Microsoft::WRL::ComPtr<IWICImagingFactory> factory = CreateWICFactory();
+	if (factory == nullptr)
+	{
+		return false;
+	}
+
+	Microsoft::WRL::ComPtr<IWICBitmapDecoder> decoder;
+	if (FAILED(factory->CreateDecoderFromFilename(
+		a_sFileName.c_str(),
 		nullptr,
-		&result.Normal);
-	DirectX::CreateWICTextureFromFile(
-		device.Get(),
-		context.Get(),
-		sRoughness.c_str(),
+		GENERIC_READ,
+		WICDecodeMetadataCacheOnDemand,
+		decoder.GetAddressOf())))
+	{
+		return false;
+	}
+
+	return DecodeFirstFrame(decoder.Get(), a_Result);
+}
+
+bool Utils::DecodeImage(const void* a_pData, size_t a_uSize, ImageData& a_Result)
+{
+	ComScope com;
+	Microsoft::WRL::ComPtr<IWICImagingFactory> factory = CreateWICFactory();
+	if (factory == nullptr)
+	{
+		return false;
+	}
+
+	// Wrapping the memory in a stream so WIC can read it like a file.
+	Microsoft::WRL::ComPtr<IWICStream> stream;
+	if (FAILED(factory->CreateStream(stream.GetAddressOf())) ||
+		FAILED(stream->InitializeFromMemory((BYTE*)a_pData, (DWORD)a_uSize)))
+	{
+		return false;
+	}
+
+	Microsoft::WRL::ComPtr<IWICBitmapDecoder> decoder;
+	if (FAILED(factory->CreateDecoderFromStream(
+		stream.Get(),
 		nullptr,
-		&result.Roughness);
-	DirectX::CreateWICTextureFromFile(
-		device.Get(),
-		context.Get(),
-		sMetal.c_str(),
+		WICDecodeMetadataCacheOnDemand,
+		decoder.GetAddressOf())))
+	{
+		return false;
+	}
+
+	return DecodeFirstFrame(decoder.Get(), a_Result);
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Utils::CreateTexture(const ImageData& a_Image)
+{
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> result;
+	if (a_Image.Pixels.empty())
+	{
+		return result;
+	}
+
+	// Zero mip levels asks for the full chain, which the context fills in below.
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = a_Image.Width;
+	desc.Height = a_Image.Height;
+	desc.MipLevels = 0;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.SampleDesc.Quality = 0;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+	desc.CPUAccessFlags = 0;
+	desc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	if (FAILED(Graphics::GetDevice()->CreateTexture2D(&desc, nullptr, texture.GetAddressOf())))
+	{
+		return result;
+	}
+
+	// Uploading the top mip and generating the rest on the GPU.
+	Graphics::GetContext()->UpdateSubresource(
+		texture.Get(),
+		0,
 		nullptr,
-		&result.Metal);
+		a_Image.Pixels.data(),
+		a_Image.Width * 4,
+		0);
+	Graphics::GetDevice()->CreateShaderResourceView(texture.Get(), nullptr, result.GetAddressOf());
+	Graphics::GetContext()->GenerateMips(result.Get());
 
 	return result;
 }
 
-Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Utils::LoadTexture(std::wstring a_sFileName)
+bool Utils::LoadCookedTexture(std::wstring a_sFileName, const TextureCookOptions& a_Options, CookedTexture& a_Result)
+{
+	// The cache functions take narrow paths.  A path that cannot be narrowed is still cooked, just never cached.
+	std::string sFileName;
+	bool bCacheable = NarrowPath(a_sFileName, sFileName);
+	if (bCacheable && TextureCooker::LoadCache(sFileName, a_Options, a_Result))
+	{
+		return true;
+	}
+
+	ImageData image;
+	if (!DecodeImage(a_sFileName, image) || !TextureCooker::Cook(image, a_Options, a_Result))
+	{
+		return false;
+	}
+
+	// Failing to write the cache only means cooking again next time.
+	if (bCacheable)
+	{
+		TextureCooker::WriteCache(sFileName, a_Options, a_Result);
+	}
+	return true;
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Utils::CreateTexture(const CookedTexture& a_Texture)
 {
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> result;
-	Microsoft::WRL::ComPtr<ID3D11Device> device = Graphics::GetDevice().Get();
-	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context = Graphics::GetContext().Get();
-	
-	DirectX::CreateWICTextureFromFile(
-		device.Get(),
-		context.Get(),
-		a_sFileName.c_str(),
-		nullptr,
-		&result);
+	if (a_Texture.Mips.empty())
+	{
+		return result;
+	}
 
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = a_Texture.Width;
+	desc.Height = a_Texture.Height;
+	desc.MipLevels = (UINT)a_Texture.Mips.size();
+	desc.ArraySize = 1;
+	desc.Format = (DXGI_FORMAT)a_Texture.Format;
+	desc.SampleDesc.Count = 1;
+	desc.SampleDesc.Quality = 0;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.CPUAccessFlags = 0;
+	desc.MiscFlags = 0;
+
+	// Every mip was already built on the CPU, so they all go in as initial data.
+	std::vector<D3D11_SUBRESOURCE_DATA> lMipData(a_Texture.Mips.size());
+	for (size_t i = 0; i < a_Texture.Mips.size(); i++)
+	{
+		lMipData[i].pSysMem = a_Texture.GetMipData(i);
+		lMipData[i].SysMemPitch = a_Texture.Mips[i].RowPitch;
+		lMipData[i].SysMemSlicePitch = 0;
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	if (FAILED(Graphics::GetDevice()->CreateTexture2D(&desc, lMipData.data(), texture.GetAddressOf())))
+	{
+		return result;
+	}
+
+	Graphics::GetDevice()->CreateShaderResourceView(texture.Get(), nullptr, result.GetAddressOf());
 	return result;
 }
 
+TextureUsage Utils::GetTextureUsage(unsigned int a_uRegister)
+{
+	switch (a_uRegister)
+	{
+	case NORMAL_REGISTER: return TextureUsage::Normal;
+	case ROUGHNESS_REGISTER: return TextureUsage::Roughness;
+	case METAL_REGISTER: return TextureUsage::Metal;
+	default: return TextureUsage::Albedo;
+	}
+}
+
 std::wstring Utils::SanitizeFileName(std::string a_sStringToChange)
 {
 	// Saving the inputed string as a wstring.
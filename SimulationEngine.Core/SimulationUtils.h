@@ -7,6 +7,8 @@
 #include <assimp/postprocess.h>
 
 #include "TextureSet.h"
+#include "ImageData.h"
+#include "TextureCooker.h"
 #include "Vectors.h"
 
 namespace Utils
@@ -19,9 +21,60 @@ namespace Utils
 	TextureSet LoadTextureSet(std::wstring a_sTextureName);
 
 	/// <summary>
-	/// Loads an individual resource (SRV) into the program.
+	/// Loads an individual resource (SRV) into the program, cooked for the material register it is bound to.
+	/// Files that are already loaded are shared through the ResourceRegistry.
 	/// </summary>
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> LoadTexture(std::wstring a_sFileName);
+	/// <param name="a_uRegister">The material register the texture is bound to, which decides how it is cooked.</param>
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> LoadTexture(std::wstring a_sFileName, unsigned int a_uRegister);
+
+	/// <summary>
+	/// Gets the path of one of the files that make up a texture set.
+	/// </summary>
+	/// <param name="a_uRegister">The material register of the texture (albedo, normal, roughness or metal).</param>
+	std::wstring GetTextureSetFile(std::wstring a_sTextureName, unsigned int a_uRegister);
+
+	/// <summary>
+	/// Converts a wide path into the code page the narrow file functions (CreateFileA and the like) expect.
+	/// </summary>
+	/// <returns>False when the path has characters the code page cannot hold, opening the result would miss the file.</returns>
+	bool NarrowPath(const std::wstring& a_sPath, std::string& a_sResult);
+
+	/// <summary>
+	/// Decodes an image file into RGBA pixels.  Does not touch the device, so it is safe on worker threads.
+	/// </summary>
+	/// <returns>Whether or not the image could be decoded.</returns>
+	bool DecodeImage(std::wstring a_sFileName, ImageData& a_Result);
+
+	/// <summary>
+	/// Decodes an encoded image (png, jpg, etc.) that is already in memory into RGBA pixels.
+	/// Does not touch the device, so it is safe on worker threads.
+	/// </summary>
+	/// <returns>Whether or not the image could be decoded.</returns>
+	bool DecodeImage(const void* a_pData, size_t a_uSize, ImageData& a_Result);
+
+	/// <summary>
+	/// Creates a texture and SRV out of decoded pixels, generating the full mip chain.
+	/// Must be called from the thread that owns the device context.
+	/// </summary>
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateTexture(const ImageData& a_Image);
+
+	/// <summary>
+	/// Gets the cooked form of an image file, reading it from the texture cache when it is up to date
+	/// and otherwise decoding, cooking and caching it.  Does not touch the device, so it is safe on worker threads.
+	/// </summary>
+	/// <returns>Whether or not the image could be decoded.</returns>
+	bool LoadCookedTexture(std::wstring a_sFileName, const TextureCookOptions& a_Options, CookedTexture& a_Result);
+
+	/// <summary>
+	/// Creates an immutable texture and SRV out of a cooked texture, uploading every mip at once.
+	/// Must be called from the thread that owns the device.
+	/// </summary>
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateTexture(const CookedTexture& a_Texture);
+
+	/// <summary>
+	/// Gets what the texture bound to a material register is used for.
+	/// </summary>
+	TextureUsage GetTextureUsage(unsigned int a_uRegister);
 
 	/// <summary>
 	/// Cleans up a file prior to use in other texture loading functions.
@@ -8,6 +8,20 @@ Skeleton::Skeleton()
 	m_pJoints = new Joint[m_uSkeletonCapacity];
 }
 
+Skeleton::Skeleton(const std::vector<Joint>& a_lJoints)
+{
+	m_uSkeletonCapacity = std::max(m_uSkeletonCapacity, (unsigned int)a_lJoints.size());
+	m_pJoints = new Joint[m_uSkeletonCapacity];
+
+	// The joints are already in order, so they are copied over as they are.
+	for (unsigned int i = 0; i < a_lJoints.size(); i++)
+	{
+		m_pJoints[i] = a_lJoints[i];
+	}
+	m_uJointCount = (unsigned int)a_lJoints.size();
+	IndexJoints();
+}
+
 Skeleton::~Skeleton()
 {
 	if (m_pJoints != nullptr)
@@ -32,6 +46,7 @@ Skeleton& Skeleton::operator=(const Skeleton& a_Other)
 
 	m_uJointCount = a_Other.m_uJointCount;
 	m_uSkeletonCapacity = a_Other.m_uSkeletonCapacity;
+	m_mJointIndices = a_Other.m_mJointIndices;
 
 	return *this;
 }
@@ -47,6 +62,7 @@ Skeleton::Skeleton(const Skeleton& a_Other)
 
 	m_uJointCount = a_Other.m_uJointCount;
 	m_uSkeletonCapacity = a_Other.m_uSkeletonCapacity;
+	m_mJointIndices = a_Other.m_mJointIndices;
 }
 
 void Skeleton::AddJoint(Joint a_NewJoint)
@@ -74,12 +90,40 @@ void Skeleton::AddJoint(Joint a_NewJoint)
 	m_pJoints[m_uJointCount] = a_NewJoint;
 	m_uJointCount++;
 
-	// Sorting all of the joints by their parent index.
-	std::sort(&m_pJoints[0], &m_pJoints[m_uJointCount], [](const Joint& j1, const Joint& j2)
+	// Joints added breadth first already arrive in order, so nothing has to move.
+	if (m_uJointCount < 2 || m_pJoints[m_uJointCount - 2].ParentIndex <= a_NewJoint.ParentIndex)
+	{
+		m_mJointIndices.emplace(a_NewJoint.Name, m_uJointCount - 1);
+		return;
+	}
+
+	// Sorting all of the joints by their parent index.  The sort has to be stable, or joints
+	// sharing a parent would swap places and the parent indices pointing at them would go stale.
+	std::stable_sort(&m_pJoints[0], &m_pJoints[m_uJointCount], [](const Joint& j1, const Joint& j2)
 		{
 			return j1.ParentIndex < j2.ParentIndex;
 		});
+
+	IndexJoints();
+}
+
+int Skeleton::FindJoint(const std::string& a_sName) const
+{
+	auto joint = m_mJointIndices.find(a_sName);
+	return joint == m_mJointIndices.end() ? -1 : (int)joint->second;
 }
 
 Joint* Skeleton::GetJoints(void) { return m_pJoints; }
 unsigned int Skeleton::GetJointCount(void) { return m_uJointCount; }
+
+void Skeleton::IndexJoints(void)
+{
+	m_mJointIndices.clear();
+	m_mJointIndices.reserve(m_uJointCount);
+
+	// Only the first joint of any name is kept.
+	for (unsigned int i = 0; i < m_uJointCount; i++)
+	{
+		m_mJointIndices.emplace(m_pJoints[i].Name, i);
+	}
+}
@@ -2,6 +2,8 @@
 #define __SKELETON_H_
 
 #include <string>
+#include <vector>
+#include <unordered_map>
 
 #include "Vectors.h"
 
@@ -42,12 +44,22 @@ private:
 
 	Joint* m_pJoints = nullptr;
 
+	/// <summary>
+	/// Maps every joint's name to its index in the collection.
+	/// </summary>
+	std::unordered_map<std::string, unsigned int> m_mJointIndices;
+
 public:
 	/// <summary>
 	/// Constructs an empty Skeleton structure.
 	/// </summary>
 	Skeleton();
 
+	/// <summary>
+	/// Constructs a Skeleton out of joints that are already sorted by their parent indices.
+	/// </summary>
+	Skeleton(const std::vector<Joint>& a_lJoints);
+
 	/// <summary>
 	/// Destructs Skeletons.
 	/// </summary>
@@ -63,10 +75,17 @@ public:
 
 	/// <summary>
 	/// Adds a new joint to the skeleton structure and sorts everything by parent indices.
+	/// Joints with the same parent keep the order they were added in.
 	/// Example: root > parent > child > child > sub child 1 > sub child 2
 	/// </summary>
 	void AddJoint(Joint a_NewJoint);
 
+	/// <summary>
+	/// Looks up a joint by its name.  Joints sharing a name resolve to the first one.
+	/// </summary>
+	/// <returns>The joint's index, or -1 if there is no joint with that name.</returns>
+	int FindJoint(const std::string& a_sName) const;
+
 	/// <summary>
 	/// Allows full access to the joint data held within the Skeleton.
 	/// </summary>
@@ -76,6 +95,12 @@ public:
 	/// Gets the amount of joints in the skeleton.
 	/// </summary>
 	unsigned int GetJointCount(void);
+
+private:
+	/// <summary>
+	/// Rebuilds the name lookup after the joints moved around.
+	/// </summary>
+	void IndexJoints(void);
 };
 
 #endif //__SKELETON_H_
@@ -3,12 +3,18 @@
 
 #include "Vertex.h"
 
-#define MAX_JOINT_COUNT 4
+// The most joints a single vertex can be skinned to.
+#define MAX_JOINT_INFLUENCES 4
 
+/// <summary>
+/// A Vertex that is skinned to up to MAX_JOINT_INFLUENCES joints of a skeleton, strongest first.
+/// Only the first three weights are stored, the last one is whatever is left of 1.
+/// Unused influences have a joint index of -1.
+/// </summary>
 struct SkinnedVertex : Vertex
 {
 	Vector3 JointWeights;
-	int JointIndices[MAX_JOINT_COUNT] = {-1, -1, -1, -1};
+	int JointIndices[MAX_JOINT_INFLUENCES] = {-1, -1, -1, -1};
 };
 
 #endif //__SKINNEDVERTEX_H_
\ No newline at end of file
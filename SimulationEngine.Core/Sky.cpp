@@ -1,8 +1,9 @@
 #include "Sky.h"
+#include "StateCache.h"
 #include "Sky.h"
 #include "Graphics.h"
-
-#include <WICTextureLoader.h>
+#include "SimulationUtils.h"
+#include "Logger.h"
 
 using namespace DirectX;
 #define SKY_CBUFFER_REGISTER 1
@@ -30,13 +31,21 @@ Sky::Sky(std::shared_ptr<Mesh> a_pMesh, Microsoft::WRL::ComPtr<ID3D11SamplerStat
 	m_pCBuffer = std::make_shared<CBufferMapper<SkyCBuffer>>(SKY_CBUFFER_REGISTER);
 }
 
+bool Sky::IsReady(void) const { return m_pSRV != nullptr; }
+
 void Sky::Draw(Matrix4 a_m4View, Matrix4 a_m4Projection)
 {
-	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context = Graphics::GetContext();
+	// Nothing to sample from until the faces are loaded.
+	if (!IsReady())
+	{
+		return;
+	}
+
+	StateCache* pStateCache = StateCache::GetInstance();
 
 	// Setting the proper rasterizer and depth stencil.
-	context->RSSetState(m_pRasterizer.Get());
-	context->OMSetDepthStencilState(m_pDepthStencil.Get(), 0);
+	pStateCache->RSSetState(m_pRasterizer.Get());
+	pStateCache->OMSetDepthStencilState(m_pDepthStencil.Get(), 0);
 
 	// Setting the active shaders.
 	m_pShader->SetShader();
@@ -48,15 +57,15 @@ void Sky::Draw(Matrix4 a_m4View, Matrix4 a_m4Projection)
 	m_pCBuffer->MapBufferData(dto);
 
 	// Setting data for use within shaders.
-	context->PSSetShaderResources(0, 1, m_pSRV.GetAddressOf());
-	context->PSSetSamplers(0, 1, m_pSampler.GetAddressOf());
+	pStateCache->PSSetShaderResources(0, 1, m_pSRV.GetAddressOf());
+	pStateCache->PSSetSamplers(0, 1, m_pSampler.GetAddressOf());
 
 	// Rendering the skybox.
 	m_pSkyMesh->Draw();
 
 	// Reseting render states.
-	context->RSSetState(nullptr);
-	context->OMSetDepthStencilState(nullptr, 0);
+	pStateCache->RSSetState(nullptr);
+	pStateCache->OMSetDepthStencilState(nullptr, 0);
 }
 
 void Sky::CreateCubemap(
@@ -68,67 +77,84 @@ void Sky::CreateCubemap(
 	const wchar_t* back)
 {
 	const int CUBE_SIZE = 6;
-	Microsoft::WRL::ComPtr<ID3D11Device> device = Graphics::GetDevice();
+	const wchar_t* lFiles[CUBE_SIZE] = { right, left, up, down, front, back };
+
+	// Cooking (or reading the cache of) all 6 textures into an array together.
+	TextureCookOptions options;
+	options.Fast = true;
+	CookedTexture faces[CUBE_SIZE];
+	for (int i = 0; i < CUBE_SIZE; i++)
+	{
+		std::wstring sFile = lFiles[i];
+		if (!Utils::LoadCookedTexture(sFile, options, faces[i]))
+		{
+			Logger::GetInstance()->Log("Sky.cpp", "Failed to decode a skybox face.", INFO_LOG);
+			return;
+		}
+	}
+
+	CreateCubemap(faces);
+}
 
-	// Loading all 6 textures into an array together.
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> textures[CUBE_SIZE] = {};
+void Sky::CreateCubemap(const CookedTexture a_Faces[6])
+{
+	const int CUBE_SIZE = 6;
+	Microsoft::WRL::ComPtr<ID3D11Device> device = Graphics::GetDevice();
 
-	CreateWICTextureFromFile(device.Get(), right, (ID3D11Resource**)textures[0].GetAddressOf(), 0);
-	CreateWICTextureFromFile(device.Get(), left, (ID3D11Resource**)textures[1].GetAddressOf(), 0);
-	CreateWICTextureFromFile(device.Get(), up, (ID3D11Resource**)textures[2].GetAddressOf(), 0);
-	CreateWICTextureFromFile(device.Get(), down, (ID3D11Resource**)textures[3].GetAddressOf(), 0);
-	CreateWICTextureFromFile(device.Get(), front, (ID3D11Resource**)textures[4].GetAddressOf(), 0);
-	CreateWICTextureFromFile(device.Get(), back, (ID3D11Resource**)textures[5].GetAddressOf(), 0);
+	// Every face of a cube map has to share the same dimensions and layout.
+	for (int i = 1; i < CUBE_SIZE; i++)
+	{
+		if (a_Faces[i].Width != a_Faces[0].Width ||
+			a_Faces[i].Height != a_Faces[0].Height ||
+			a_Faces[i].Format != a_Faces[0].Format ||
+			a_Faces[i].Mips.size() != a_Faces[0].Mips.size())
+		{
+			Logger::GetInstance()->Log("Sky.cpp", "Skybox faces are not the same size.", INFO_LOG);
+			return;
+		}
+	}
 
-	// Using the description of the first texture for all textures.
-	D3D11_TEXTURE2D_DESC faceDesc = {};
-	textures[0]->GetDesc(&faceDesc);
+	UINT uMipCount = (UINT)a_Faces[0].Mips.size();
 
 	// Creating the cube map description.
 	D3D11_TEXTURE2D_DESC cubeDesc = {};
 	cubeDesc.ArraySize = 6;
 	cubeDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-	cubeDesc.CPUAccessFlags = 0;       
-	cubeDesc.Format = faceDesc.Format; 
-	cubeDesc.Width = faceDesc.Width;   
-	cubeDesc.Height = faceDesc.Height; 
-	cubeDesc.MipLevels = 1;            
-	cubeDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE; 
-	cubeDesc.Usage = D3D11_USAGE_DEFAULT;
+	cubeDesc.CPUAccessFlags = 0;
+	cubeDesc.Format = (DXGI_FORMAT)a_Faces[0].Format;
+	cubeDesc.Width = a_Faces[0].Width;
+	cubeDesc.Height = a_Faces[0].Height;
+	cubeDesc.MipLevels = uMipCount;
+	cubeDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+	cubeDesc.Usage = D3D11_USAGE_IMMUTABLE;
 	cubeDesc.SampleDesc.Count = 1;
 	cubeDesc.SampleDesc.Quality = 0;
 
-	// Creating the cube map texture more directly.
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> cubeMap;
-	device->CreateTexture2D(&cubeDesc, 0, cubeMap.GetAddressOf());
-
-	// Looping through each texture and copying them to the cube map texture.
+	// Subresources are ordered face by face, with every mip of a face next to each other.
+	std::vector<D3D11_SUBRESOURCE_DATA> lFaceData(CUBE_SIZE * uMipCount);
 	for (int i = 0; i < CUBE_SIZE; i++)
 	{
-		// Calculating the subresource position to copy into.
-		unsigned int subresource = D3D11CalcSubresource(
-			0, 
-			i, 
-			1);
-
-		// Copying from one resource to another.
-		Graphics::GetContext()->CopySubresourceRegion(
-			cubeMap.Get(),
-			subresource,
-			0, 0, 0,
-			textures[i].Get(), 
-			0, 
-			0);
+		for (UINT j = 0; j < uMipCount; j++)
+		{
+			D3D11_SUBRESOURCE_DATA& data = lFaceData[i * uMipCount + j];
+			data.pSysMem = a_Faces[i].GetMipData(j);
+			data.SysMemPitch = a_Faces[i].Mips[j].RowPitch;
+			data.SysMemSlicePitch = 0;
+		}
 	}
 
+	// Creating the cube map texture more directly.
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> cubeMap;
+	device->CreateTexture2D(&cubeDesc, lFaceData.data(), cubeMap.GetAddressOf());
+
 	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Format = cubeDesc.Format;
 	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
-	srvDesc.TextureCube.MipLevels = 1;
+	srvDesc.TextureCube.MipLevels = uMipCount;
 	srvDesc.TextureCube.MostDetailedMip = 0;
 
 	// Making the SRV.
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cubeSRV;
 	device->CreateShaderResourceView(cubeMap.Get(), &srvDesc, cubeSRV.GetAddressOf());
 	m_pSRV = cubeSRV;
-}
\ No newline at end of file
+}
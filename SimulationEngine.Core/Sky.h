@@ -5,6 +5,7 @@
 #include "Shader.h"
 #include "Camera.h"
 #include "CBufferMapper.h"
+#include "TextureCooker.h"
 
 #include <d3d11.h>
 #include <wrl/client.h>
@@ -41,7 +42,12 @@ public:
 	Sky(std::shared_ptr<Mesh> a_pMesh, Microsoft::WRL::ComPtr<ID3D11SamplerState> a_pSampler);
 
 	/// <summary>
-	/// Renders the skybox to the world.
+	/// Gets whether or not the cube map has been created yet.
+	/// </summary>
+	bool IsReady(void) const;
+
+	/// <summary>
+	/// Renders the skybox to the world.  Nothing is drawn until the cube map is ready.
 	/// </summary>
 	void Draw(Matrix4 a_m4View, Matrix4 a_m4Projection);
 
@@ -55,6 +61,12 @@ public:
 		const wchar_t* down,
 		const wchar_t* front,
 		const wchar_t* back);
+
+	/// <summary>
+	/// Creates the cube map and SRV out of six already cooked faces ordered right, left,
+	/// up, down, front, back.  All faces must share the same size, format and mip count.
+	/// </summary>
+	void CreateCubemap(const CookedTexture a_Faces[6]);
 };
 
 #endif //__SKY_H_
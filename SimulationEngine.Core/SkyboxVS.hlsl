@@ -15,8 +15,9 @@ cbuffer ExternalData : register(b1)
     matrix projection;
 }
 
-VertexToPixel_Sky main(VertexShaderInput input)
+VertexToPixel_Sky main(RawVertexShaderInput raw)
 {
+    VertexShaderInput input = DecodeVertexInput(raw);
     VertexToPixel_Sky output;
     
     matrix viewNoTranslation = view;
@@ -0,0 +1,304 @@
+#include "StateCache.h"
+
+#include <cstring>
+#include <cstdint>
+#include <initializer_list>
+
+StateCache* StateCache::m_pInstance = nullptr;
+
+namespace
+{
+	/// <summary>
+	/// Sets a cached binding to an address no object ever has, so whatever is bound next goes through.
+	/// </summary>
+	template <typename T>
+	void Forget(T*& a_pObject)
+	{
+		a_pObject = reinterpret_cast<T*>(UINTPTR_MAX);
+	}
+
+	/// <summary>
+	/// Forgets every slot of an array of bindings.
+	/// </summary>
+	template <typename T, size_t N>
+	void Forget(T* (&a_lObjects)[N])
+	{
+		for (T*& pObject : a_lObjects)
+		{
+			Forget(pObject);
+		}
+	}
+
+	/// <summary>
+	/// Copies a range of bindings into the cached slots, narrowing the range down to the
+	/// first and last slot that actually changed.
+	/// </summary>
+	/// <returns>False if every slot already held its value.</returns>
+	template <typename T>
+	bool NarrowRange(T* a_pSlots, UINT& a_uStartSlot, UINT& a_uCount, T const*& a_pValues)
+	{
+		UINT uFirst = 0;
+		while (uFirst < a_uCount && a_pSlots[a_uStartSlot + uFirst] == a_pValues[uFirst])
+		{
+			uFirst++;
+		}
+		if (uFirst == a_uCount)
+		{
+			return false;
+		}
+
+		UINT uLast = a_uCount - 1;
+		while (a_pSlots[a_uStartSlot + uLast] == a_pValues[uLast])
+		{
+			uLast--;
+		}
+
+		for (UINT i = uFirst; i <= uLast; i++)
+		{
+			a_pSlots[a_uStartSlot + i] = a_pValues[i];
+		}
+
+		a_uStartSlot += uFirst;
+		a_pValues += uFirst;
+		a_uCount = uLast - uFirst + 1;
+		return true;
+	}
+}
+
+StateCache* StateCache::GetInstance(void)
+{
+	if (m_pInstance == nullptr)
+	{
+		m_pInstance = new StateCache();
+	}
+
+	return m_pInstance;
+}
+
+void StateCache::Release(void)
+{
+	if (m_pInstance == nullptr)
+	{
+		return;
+	}
+
+	delete m_pInstance;
+	m_pInstance = nullptr;
+}
+
+void StateCache::Invalidate(void)
+{
+	// The context could hold anything now, so every binding is set to something nothing ever binds.
+	// Formats, strides, offsets and factors are always compared together with their object, so forgetting the objects is enough.
+	m_Topology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	Forget(m_pInputLayout);
+	Forget(m_lVertexBuffers);
+	Forget(m_pIndexBuffer);
+
+	Forget(m_pVertexShader);
+	Forget(m_pPixelShader);
+	for (StageState* pStage : { &m_VertexStage, &m_PixelStage })
+	{
+		Forget(pStage->ConstantBuffers);
+		Forget(pStage->ShaderResources);
+		Forget(pStage->Samplers);
+	}
+
+	Forget(m_pRasterizerState);
+	Forget(m_pDepthStencilState);
+	Forget(m_pBlendState);
+}
+
+void StateCache::BeginFrame(void)
+{
+	m_LastFrameStats = m_Stats;
+	m_Stats = StateCacheStats();
+}
+
+StateCacheStats StateCache::GetStats(void) const { return m_LastFrameStats; }
+
+bool StateCache::Count(bool a_bChanged)
+{
+	if (a_bChanged)
+	{
+		m_Stats.Issued++;
+	}
+	else
+	{
+		m_Stats.Avoided++;
+	}
+	return a_bChanged;
+}
+
+void StateCache::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY a_Topology)
+{
+	if (Count(a_Topology != m_Topology))
+	{
+		m_Topology = a_Topology;
+		Graphics::GetContext()->IASetPrimitiveTopology(a_Topology);
+	}
+}
+
+void StateCache::IASetInputLayout(ID3D11InputLayout* a_pInputLayout)
+{
+	if (Count(a_pInputLayout != m_pInputLayout))
+	{
+		m_pInputLayout = a_pInputLayout;
+		Graphics::GetContext()->IASetInputLayout(a_pInputLayout);
+	}
+}
+
+void StateCache::IASetVertexBuffers(
+	UINT a_uStartSlot,
+	UINT a_uCount,
+	ID3D11Buffer* const* a_ppBuffers,
+	const UINT* a_pStrides,
+	const UINT* a_pOffsets)
+{
+	// The buffer, stride and offset of a slot only count as the same binding all together.
+	UINT uFirst = a_uCount;
+	UINT uLast = 0;
+	for (UINT i = 0; i < a_uCount; i++)
+	{
+		UINT uSlot = a_uStartSlot + i;
+		if (m_lVertexBuffers[uSlot] != a_ppBuffers[i] ||
+			m_lStrides[uSlot] != a_pStrides[i] ||
+			m_lOffsets[uSlot] != a_pOffsets[i])
+		{
+			uFirst = uFirst < i ? uFirst : i;
+			uLast = i;
+
+			m_lVertexBuffers[uSlot] = a_ppBuffers[i];
+			m_lStrides[uSlot] = a_pStrides[i];
+			m_lOffsets[uSlot] = a_pOffsets[i];
+		}
+	}
+
+	if (Count(uFirst != a_uCount))
+	{
+		Graphics::GetContext()->IASetVertexBuffers(
+			a_uStartSlot + uFirst,
+			uLast - uFirst + 1,
+			a_ppBuffers + uFirst,
+			a_pStrides + uFirst,
+			a_pOffsets + uFirst);
+	}
+}
+
+void StateCache::IASetIndexBuffer(ID3D11Buffer* a_pBuffer, DXGI_FORMAT a_Format, UINT a_uOffset)
+{
+	if (Count(a_pBuffer != m_pIndexBuffer || a_Format != m_IndexFormat || a_uOffset != m_uIndexOffset))
+	{
+		m_pIndexBuffer = a_pBuffer;
+		m_IndexFormat = a_Format;
+		m_uIndexOffset = a_uOffset;
+		Graphics::GetContext()->IASetIndexBuffer(a_pBuffer, a_Format, a_uOffset);
+	}
+}
+
+void StateCache::VSSetShader(ID3D11VertexShader* a_pShader)
+{
+	if (Count(a_pShader != m_pVertexShader))
+	{
+		m_pVertexShader = a_pShader;
+		Graphics::GetContext()->VSSetShader(a_pShader, 0, 0);
+	}
+}
+
+void StateCache::VSSetConstantBuffers(UINT a_uStartSlot, UINT a_uCount, ID3D11Buffer* const* a_ppBuffers)
+{
+	if (Count(NarrowRange(m_VertexStage.ConstantBuffers, a_uStartSlot, a_uCount, a_ppBuffers)))
+	{
+		Graphics::GetContext()->VSSetConstantBuffers(a_uStartSlot, a_uCount, a_ppBuffers);
+	}
+}
+
+void StateCache::PSSetShader(ID3D11PixelShader* a_pShader)
+{
+	if (Count(a_pShader != m_pPixelShader))
+	{
+		m_pPixelShader = a_pShader;
+		Graphics::GetContext()->PSSetShader(a_pShader, 0, 0);
+	}
+}
+
+void StateCache::PSSetConstantBuffers(UINT a_uStartSlot, UINT a_uCount, ID3D11Buffer* const* a_ppBuffers)
+{
+	if (Count(NarrowRange(m_PixelStage.ConstantBuffers, a_uStartSlot, a_uCount, a_ppBuffers)))
+	{
+		Graphics::GetContext()->PSSetConstantBuffers(a_uStartSlot, a_uCount, a_ppBuffers);
+	}
+}
+
+void StateCache::PSSetShaderResources(UINT a_uStartSlot, UINT a_uCount, ID3D11ShaderResourceView* const* a_ppViews)
+{
+	if (Count(NarrowRange(m_PixelStage.ShaderResources, a_uStartSlot, a_uCount, a_ppViews)))
+	{
+		Graphics::GetContext()->PSSetShaderResources(a_uStartSlot, a_uCount, a_ppViews);
+	}
+}
+
+void StateCache::PSSetSamplers(UINT a_uStartSlot, UINT a_uCount, ID3D11SamplerState* const* a_ppSamplers)
+{
+	if (Count(NarrowRange(m_PixelStage.Samplers, a_uStartSlot, a_uCount, a_ppSamplers)))
+	{
+		Graphics::GetContext()->PSSetSamplers(a_uStartSlot, a_uCount, a_ppSamplers);
+	}
+}
+
+void StateCache::WriteBuffer(
+	ID3D11Buffer* a_pBuffer,
+	const void* a_pData,
+	UINT a_uSize,
+	D3D11_MAP a_MapType,
+	UINT a_uOffset)
+{
+	// Either way no draw still reading the buffer is waited on.
+	D3D11_MAPPED_SUBRESOURCE mapped{};
+	if (FAILED(Graphics::GetContext()->Map(a_pBuffer, 0, a_MapType, 0, &mapped)))
+	{
+		return;
+	}
+
+	memcpy((char*)mapped.pData + a_uOffset, a_pData, a_uSize);
+	Graphics::GetContext()->Unmap(a_pBuffer, 0);
+
+	m_Stats.Uploads++;
+	m_Stats.UploadedBytes += a_uSize;
+}
+
+void StateCache::RSSetState(ID3D11RasterizerState* a_pState)
+{
+	if (Count(a_pState != m_pRasterizerState))
+	{
+		m_pRasterizerState = a_pState;
+		Graphics::GetContext()->RSSetState(a_pState);
+	}
+}
+
+void StateCache::OMSetDepthStencilState(ID3D11DepthStencilState* a_pState, UINT a_uStencilRef)
+{
+	if (Count(a_pState != m_pDepthStencilState || a_uStencilRef != m_uStencilRef))
+	{
+		m_pDepthStencilState = a_pState;
+		m_uStencilRef = a_uStencilRef;
+		Graphics::GetContext()->OMSetDepthStencilState(a_pState, a_uStencilRef);
+	}
+}
+
+void StateCache::OMSetBlendState(ID3D11BlendState* a_pState, const FLOAT a_lBlendFactor[4], UINT a_uSampleMask)
+{
+	// No blend factor means all ones to the context.
+	const FLOAT lOnes[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	const FLOAT* pBlendFactor = a_lBlendFactor != nullptr ? a_lBlendFactor : lOnes;
+
+	if (Count(a_pState != m_pBlendState ||
+		memcmp(pBlendFactor, m_lBlendFactor, sizeof(m_lBlendFactor)) != 0 ||
+		a_uSampleMask != m_uSampleMask))
+	{
+		m_pBlendState = a_pState;
+		memcpy(m_lBlendFactor, pBlendFactor, sizeof(m_lBlendFactor));
+		m_uSampleMask = a_uSampleMask;
+		Graphics::GetContext()->OMSetBlendState(a_pState, pBlendFactor, a_uSampleMask);
+	}
+}
@@ -0,0 +1,145 @@
+#ifndef __STATECACHE_H_
+#define __STATECACHE_H_
+
+#include "Graphics.h"
+
+/// <summary>
+/// How many calls into the device context the StateCache let through and how many it dropped,
+/// and how much constant data was uploaded through it.
+/// </summary>
+struct StateCacheStats
+{
+	unsigned int Issued = 0;
+	unsigned int Avoided = 0;
+	unsigned int Uploads = 0;
+	unsigned int UploadedBytes = 0;
+};
+
+/// <summary>
+/// The state the StateCache last bound to a single shader stage.
+/// </summary>
+struct StageState
+{
+	ID3D11Buffer* ConstantBuffers[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT] = {};
+	ID3D11ShaderResourceView* ShaderResources[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT] = {};
+	ID3D11SamplerState* Samplers[D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT] = {};
+};
+
+/// <summary>
+/// Sits between the engine and the device context, remembering what is bound and dropping
+/// every call that would bind it again.  Ranges are narrowed down to the slots that changed.
+/// Bound objects are referenced by the context, so their addresses can never be reused while cached.
+/// Anything binding state through the context directly has to restore it afterwards or call Invalidate.
+/// Only used from the thread that owns the device.
+/// </summary>
+class StateCache
+{
+private:
+	static StateCache* m_pInstance;
+
+	// Input assembler state.
+	D3D11_PRIMITIVE_TOPOLOGY m_Topology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	ID3D11InputLayout* m_pInputLayout = nullptr;
+	ID3D11Buffer* m_lVertexBuffers[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT] = {};
+	UINT m_lStrides[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT] = {};
+	UINT m_lOffsets[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT] = {};
+	ID3D11Buffer* m_pIndexBuffer = nullptr;
+	DXGI_FORMAT m_IndexFormat = DXGI_FORMAT_UNKNOWN;
+	UINT m_uIndexOffset = 0;
+
+	// Shader stages.
+	ID3D11VertexShader* m_pVertexShader = nullptr;
+	ID3D11PixelShader* m_pPixelShader = nullptr;
+	StageState m_VertexStage;
+	StageState m_PixelStage;
+
+	// Fixed function state.
+	ID3D11RasterizerState* m_pRasterizerState = nullptr;
+	ID3D11DepthStencilState* m_pDepthStencilState = nullptr;
+	UINT m_uStencilRef = 0;
+	ID3D11BlendState* m_pBlendState = nullptr;
+	FLOAT m_lBlendFactor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	UINT m_uSampleMask = 0xffffffff;
+
+	StateCacheStats m_Stats;
+	StateCacheStats m_LastFrameStats;
+
+public:
+	/// <summary>
+	/// Gets the single instance of the StateCache.
+	/// </summary>
+	static StateCache* GetInstance(void);
+
+	/// <summary>
+	/// Frees the StateCache singleton.
+	/// </summary>
+	static void Release(void);
+
+	/// <summary>
+	/// Forgets everything that is bound, so the next call of every kind goes through.
+	/// </summary>
+	void Invalidate(void);
+
+	/// <summary>
+	/// Starts counting calls for a new frame, keeping the counts of the one that just ended.
+	/// </summary>
+	void BeginFrame(void);
+
+	/// <summary>
+	/// Gets the call counts of the last full frame.
+	/// </summary>
+	StateCacheStats GetStats(void) const;
+
+	// The same calls as on the device context, forwarded only when something changes.
+
+	void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY a_Topology);
+	void IASetInputLayout(ID3D11InputLayout* a_pInputLayout);
+	void IASetVertexBuffers(
+		UINT a_uStartSlot,
+		UINT a_uCount,
+		ID3D11Buffer* const* a_ppBuffers,
+		const UINT* a_pStrides,
+		const UINT* a_pOffsets);
+	void IASetIndexBuffer(ID3D11Buffer* a_pBuffer, DXGI_FORMAT a_Format, UINT a_uOffset);
+
+	void VSSetShader(ID3D11VertexShader* a_pShader);
+	void VSSetConstantBuffers(UINT a_uStartSlot, UINT a_uCount, ID3D11Buffer* const* a_ppBuffers);
+
+	void PSSetShader(ID3D11PixelShader* a_pShader);
+	void PSSetConstantBuffers(UINT a_uStartSlot, UINT a_uCount, ID3D11Buffer* const* a_ppBuffers);
+	void PSSetShaderResources(UINT a_uStartSlot, UINT a_uCount, ID3D11ShaderResourceView* const* a_ppViews);
+	void PSSetSamplers(UINT a_uStartSlot, UINT a_uCount, ID3D11SamplerState* const* a_ppSamplers);
+
+	/// <summary>
+	/// Writes into a dynamic buffer, counting the bytes written.  Never skipped,
+	/// whoever calls it already knows the data changed.
+	/// </summary>
+	/// <param name="a_MapType">Discarding replaces the whole buffer, not overwriting appends to what draws may still read.</param>
+	/// <param name="a_uOffset">Where in the buffer the data goes, in bytes.</param>
+	void WriteBuffer(
+		ID3D11Buffer* a_pBuffer,
+		const void* a_pData,
+		UINT a_uSize,
+		D3D11_MAP a_MapType = D3D11_MAP_WRITE_DISCARD,
+		UINT a_uOffset = 0);
+
+	void RSSetState(ID3D11RasterizerState* a_pState);
+	void OMSetDepthStencilState(ID3D11DepthStencilState* a_pState, UINT a_uStencilRef);
+	void OMSetBlendState(ID3D11BlendState* a_pState, const FLOAT a_lBlendFactor[4], UINT a_uSampleMask);
+
+private:
+	StateCache(void) = default;
+	~StateCache(void) = default;
+
+	// Removing the copy constructor and operator.
+	StateCache(const StateCache&) = delete;
+	StateCache& operator=(const StateCache&) = delete;
+
+	/// <summary>
+	/// Counts a call as either issued or avoided.
+	/// </summary>
+	/// <returns>Whether the call has to go through.</returns>
+	bool Count(bool a_bChanged);
+};
+
+#endif //__STATECACHE_H_
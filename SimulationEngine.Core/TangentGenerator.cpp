@@ -0,0 +1,437 @@
+#include "TangentGenerator.h"
+#include "ThreadPool.h"
+#include "Logger.h"
+
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <xmmintrin.h>
+
+// The smallest amount of vertices worth handing to a thread when resolving the tangents.
+#define TANGENT_MIN_VERTEX_BATCH 4096
+
+// Tangents shorter than this after being made orthogonal are treated as missing.
+#define TANGENT_MIN_LENGTH_SQ 1e-20f
+
+namespace
+{
+	/// <summary>
+	/// Makes a single accumulated tangent orthogonal to its normal and normalizes it.
+	/// Falls back to any direction orthogonal to the normal when there is nothing left of it.
+	/// </summary>
+	void ResolveTangent(const Vector3& a_v3Normal, float a_fX, float a_fY, float a_fZ, bool a_bInvert, Vector3& a_v3Result)
+	{
+		float fDot = a_v3Normal.x * a_fX + a_v3Normal.y * a_fY + a_v3Normal.z * a_fZ;
+		float fX = a_fX - a_v3Normal.x * fDot;
+		float fY = a_fY - a_v3Normal.y * fDot;
+		float fZ = a_fZ - a_v3Normal.z * fDot;
+		float fLengthSq = fX * fX + fY * fY + fZ * fZ;
+
+		if (!(fLengthSq > TANGENT_MIN_LENGTH_SQ))
+		{
+			// Crossing the normal with whichever axis it is least aligned with.
+			float fAbsX = std::fabs(a_v3Normal.x);
+			float fAbsY = std::fabs(a_v3Normal.y);
+			float fAbsZ = std::fabs(a_v3Normal.z);
+			if (fAbsX <= fAbsY && fAbsX <= fAbsZ)
+			{
+				fX = 0.0f;
+				fY = a_v3Normal.z;
+				fZ = -a_v3Normal.y;
+			}
+			else if (fAbsY <= fAbsZ)
+			{
+				fX = -a_v3Normal.z;
+				fY = 0.0f;
+				fZ = a_v3Normal.x;
+			}
+			else
+			{
+				fX = a_v3Normal.y;
+				fY = -a_v3Normal.x;
+				fZ = 0.0f;
+			}
+			fLengthSq = fX * fX + fY * fY + fZ * fZ;
+
+			// Not even a normal to go off of.
+			if (!(fLengthSq > TANGENT_MIN_LENGTH_SQ))
+			{
+				fX = 1.0f;
+				fY = 0.0f;
+				fZ = 0.0f;
+				fLengthSq = 1.0f;
+			}
+		}
+
+		float fScale = (a_bInvert ? -1.0f : 1.0f) / std::sqrt(fLengthSq);
+		a_v3Result = Vector3(fX * fScale, fY * fScale, fZ * fScale);
+	}
+
+	/// <summary>
+	/// Calculates the tangent of a single triangle, one component at a time.
+	/// </summary>
+	/// <returns>False if the triangle's UVs are degenerate.</returns>
+	bool TriangleTangent(const Vertex& a_V1, const Vertex& a_V2, const Vertex& a_V3, float* a_pResult)
+	{
+		float x1 = a_V2.Position.x - a_V1.Position.x;
+		float y1 = a_V2.Position.y - a_V1.Position.y;
+		float z1 = a_V2.Position.z - a_V1.Position.z;
+		float x2 = a_V3.Position.x - a_V1.Position.x;
+		float y2 = a_V3.Position.y - a_V1.Position.y;
+		float z2 = a_V3.Position.z - a_V1.Position.z;
+		float s1 = a_V2.UV.x - a_V1.UV.x;
+		float t1 = a_V2.UV.y - a_V1.UV.y;
+		float s2 = a_V3.UV.x - a_V1.UV.x;
+		float t2 = a_V3.UV.y - a_V1.UV.y;
+
+		float fDeterminant = s1 * t2 - s2 * t1;
+		if (!(std::fabs(fDeterminant) >= TANGENT_DEGENERATE_UV))
+		{
+			return false;
+		}
+
+		float r = 1.0f / fDeterminant;
+		a_pResult[0] = (t2 * x1 - t1 * x2) * r;
+		a_pResult[1] = (t2 * y1 - t1 * y2) * r;
+		a_pResult[2] = (t2 * z1 - t1 * z2) * r;
+		return true;
+	}
+
+	/// <summary>
+	/// Adds a triangle's tangent onto its three corners inside of an accumulation buffer.
+	/// </summary>
+	/// <param name="a_uStride">The distance between two vertices' tangents, in floats.</param>
+	inline void Accumulate(float* a_pAccumulation, size_t a_uStride, const unsigned int* a_pTriangle, float a_fX, float a_fY, float a_fZ)
+	{
+		for (unsigned int c = 0; c < 3; c++)
+		{
+			float* pTangent = a_pAccumulation + a_pTriangle[c] * a_uStride;
+			pTangent[0] += a_fX;
+			pTangent[1] += a_fY;
+			pTangent[2] += a_fZ;
+		}
+	}
+
+	/// <summary>
+	/// Accumulates the tangents of the triangles [begin, end) into an accumulation buffer.
+	/// The edges are worked out as whole vectors straight off of the vertices, since gathering four
+	/// triangles' worth of scattered vertices into lanes costs more than the math it would save.
+	/// </summary>
+	void AccumulateTriangles(
+		const Vertex* a_pVertices,
+		const unsigned int* a_pIndices,
+		unsigned int a_uBegin,
+		unsigned int a_uEnd,
+		float* a_pAccumulation,
+		size_t a_uStride)
+	{
+		for (unsigned int t = a_uBegin; t < a_uEnd; t++)
+		{
+			const unsigned int* pTriangle = a_pIndices + t * 3;
+			const Vertex& v1 = a_pVertices[pTriangle[0]];
+			const Vertex& v2 = a_pVertices[pTriangle[1]];
+			const Vertex& v3 = a_pVertices[pTriangle[2]];
+
+			float s1 = v2.UV.x - v1.UV.x;
+			float t1 = v2.UV.y - v1.UV.y;
+			float s2 = v3.UV.x - v1.UV.x;
+			float t2 = v3.UV.y - v1.UV.y;
+
+			// Triangles without any UV area would divide by zero and can not point the tangent anywhere.
+			float fDeterminant = s1 * t2 - s2 * t1;
+			if (!(std::fabs(fDeterminant) >= TANGENT_DEGENERATE_UV))
+			{
+				continue;
+			}
+			float r = 1.0f / fDeterminant;
+
+			// The fourth lane picks up the normal's x, which is never stored back.
+			__m128 vPosition = _mm_loadu_ps(&v1.Position.x);
+			__m128 vEdge1 = _mm_sub_ps(_mm_loadu_ps(&v2.Position.x), vPosition);
+			__m128 vEdge2 = _mm_sub_ps(_mm_loadu_ps(&v3.Position.x), vPosition);
+			__m128 vTangent = _mm_sub_ps(
+				_mm_mul_ps(vEdge1, _mm_set1_ps(t2 * r)),
+				_mm_mul_ps(vEdge2, _mm_set1_ps(t1 * r)));
+
+			float lTangent[4];
+			_mm_storeu_ps(lTangent, vTangent);
+			Accumulate(a_pAccumulation, a_uStride, pTriangle, lTangent[0], lTangent[1], lTangent[2]);
+		}
+	}
+
+	/// <summary>
+	/// Adds up a vertex's tangent with its share in every extra accumulation buffer.
+	/// </summary>
+	inline void SumTangent(
+		const Vertex& a_Vertex,
+		const float* a_pAccumulation,
+		size_t a_uBufferSize,
+		unsigned int a_uBufferCount,
+		float& a_fX,
+		float& a_fY,
+		float& a_fZ)
+	{
+		a_fX = a_Vertex.Tangent.x;
+		a_fY = a_Vertex.Tangent.y;
+		a_fZ = a_Vertex.Tangent.z;
+		for (unsigned int b = 0; b < a_uBufferCount; b++)
+		{
+			const float* pTangent = a_pAccumulation + a_uBufferSize * b;
+			a_fX += pTangent[0];
+			a_fY += pTangent[1];
+			a_fZ += pTangent[2];
+		}
+	}
+
+	/// <summary>
+	/// Sums the accumulation buffers of the vertices [begin, end) and writes out their
+	/// orthonormalized tangents, four vertices at a time.
+	/// </summary>
+	/// <param name="a_pAccumulation">The extra buffers, three floats per vertex, after the vertices' own tangents.</param>
+	void ResolveVertices(
+		Vertex* a_pVertices,
+		unsigned int a_uVertexCount,
+		const float* a_pAccumulation,
+		unsigned int a_uBufferCount,
+		unsigned int a_uBegin,
+		unsigned int a_uEnd,
+		bool a_bInvert)
+	{
+		const __m128 vMinLength = _mm_set1_ps(TANGENT_MIN_LENGTH_SQ);
+		const __m128 vSign = _mm_set1_ps(a_bInvert ? -1.0f : 1.0f);
+		const size_t uBufferSize = (size_t)a_uVertexCount * 3;
+
+		unsigned int i = a_uBegin;
+		for (; i + 4 <= a_uEnd; i += 4)
+		{
+			// Summing up every slice's share of the four tangents.
+			float lSum[3][4];
+			for (unsigned int l = 0; l < 4; l++)
+			{
+				SumTangent(a_pVertices[i + l], a_pAccumulation + (size_t)(i + l) * 3, uBufferSize, a_uBufferCount, lSum[0][l], lSum[1][l], lSum[2][l]);
+			}
+
+			const Vertex* p = a_pVertices + i;
+			__m128 tx = _mm_loadu_ps(lSum[0]);
+			__m128 ty = _mm_loadu_ps(lSum[1]);
+			__m128 tz = _mm_loadu_ps(lSum[2]);
+			__m128 nx = _mm_setr_ps(p[0].Normal.x, p[1].Normal.x, p[2].Normal.x, p[3].Normal.x);
+			__m128 ny = _mm_setr_ps(p[0].Normal.y, p[1].Normal.y, p[2].Normal.y, p[3].Normal.y);
+			__m128 nz = _mm_setr_ps(p[0].Normal.z, p[1].Normal.z, p[2].Normal.z, p[3].Normal.z);
+
+			// Gram-Schmidt, so the normal and tangent are exactly 90 degrees apart.
+			__m128 vDot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, tx), _mm_mul_ps(ny, ty)), _mm_mul_ps(nz, tz));
+			tx = _mm_sub_ps(tx, _mm_mul_ps(nx, vDot));
+			ty = _mm_sub_ps(ty, _mm_mul_ps(ny, vDot));
+			tz = _mm_sub_ps(tz, _mm_mul_ps(nz, vDot));
+			__m128 vLengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)), _mm_mul_ps(tz, tz));
+			int dValid = _mm_movemask_ps(_mm_cmpgt_ps(vLengthSq, vMinLength));
+
+			__m128 vScale = _mm_div_ps(vSign, _mm_sqrt_ps(_mm_max_ps(vLengthSq, vMinLength)));
+			float lResult[3][4];
+			_mm_storeu_ps(lResult[0], _mm_mul_ps(tx, vScale));
+			_mm_storeu_ps(lResult[1], _mm_mul_ps(ty, vScale));
+			_mm_storeu_ps(lResult[2], _mm_mul_ps(tz, vScale));
+
+			for (unsigned int l = 0; l < 4; l++)
+			{
+				Vertex& vertex = a_pVertices[i + l];
+				if (dValid & (1 << l))
+				{
+					vertex.Tangent = Vector3(lResult[0][l], lResult[1][l], lResult[2][l]);
+				}
+				else
+				{
+					ResolveTangent(vertex.Normal, lSum[0][l], lSum[1][l], lSum[2][l], a_bInvert, vertex.Tangent);
+				}
+			}
+		}
+
+		// The leftover vertices.
+		for (; i < a_uEnd; i++)
+		{
+			float fX, fY, fZ;
+			SumTangent(a_pVertices[i], a_pAccumulation + (size_t)i * 3, uBufferSize, a_uBufferCount, fX, fY, fZ);
+			ResolveTangent(a_pVertices[i].Normal, fX, fY, fZ, a_bInvert, a_pVertices[i].Tangent);
+		}
+	}
+}
+
+void TangentGenerator::Generate(
+	Vertex* a_pVertices,
+	unsigned int a_uVertexCount,
+	const unsigned int* a_pIndices,
+	unsigned int a_uIndexCount,
+	bool a_bInvert)
+{
+	if (a_uVertexCount == 0)
+	{
+		return;
+	}
+
+	ThreadPool* pPool = ThreadPool::GetInstance();
+	unsigned int uTriangleCount = a_uIndexCount / 3;
+
+	// Every slice of triangles gets its own buffer to add into so that no two threads ever
+	// write to the same tangent.  The first slice adds straight into the vertices and the rest
+	// get buffers of their own.  More slices than threads would only cost memory.
+	size_t uBufferSize = (size_t)a_uVertexCount * 3;
+	unsigned int uSliceCount = std::min(pPool->GetWorkerCount() + 1, std::max(1u, uTriangleCount / TANGENT_MIN_SLICE));
+	uSliceCount = (unsigned int)std::max<size_t>(1, std::min<size_t>(uSliceCount, 1 + TANGENT_ACCUMULATION_BUDGET / (uBufferSize * sizeof(float))));
+
+	for (unsigned int i = 0; i < a_uVertexCount; i++)
+	{
+		a_pVertices[i].Tangent = Vector3(0, 0, 0);
+	}
+
+	std::vector<float> lAccumulation(uBufferSize * (uSliceCount - 1), 0.0f);
+	float* pAccumulation = lAccumulation.data();
+
+	pPool->ParallelFor(uSliceCount, 1, [&](unsigned int a_uBegin, unsigned int a_uEnd)
+		{
+			for (unsigned int s = a_uBegin; s < a_uEnd; s++)
+			{
+				unsigned int uFirst = (unsigned int)((unsigned long long)uTriangleCount * s / uSliceCount);
+				unsigned int uLast = (unsigned int)((unsigned long long)uTriangleCount * (s + 1) / uSliceCount);
+				if (s == 0)
+				{
+					AccumulateTriangles(a_pVertices, a_pIndices, uFirst, uLast, &a_pVertices[0].Tangent.x, sizeof(Vertex) / sizeof(float));
+				}
+				else
+				{
+					AccumulateTriangles(a_pVertices, a_pIndices, uFirst, uLast, pAccumulation + uBufferSize * (s - 1), 3);
+				}
+			}
+		});
+
+	pPool->ParallelFor(a_uVertexCount, TANGENT_MIN_VERTEX_BATCH, [&](unsigned int a_uBegin, unsigned int a_uEnd)
+		{
+			ResolveVertices(a_pVertices, a_uVertexCount, pAccumulation, uSliceCount - 1, a_uBegin, a_uEnd, a_bInvert);
+		});
+}
+
+void TangentGenerator::GenerateScalar(
+	Vertex* a_pVertices,
+	unsigned int a_uVertexCount,
+	const unsigned int* a_pIndices,
+	unsigned int a_uIndexCount,
+	bool a_bInvert)
+{
+	// Reset tangents
+	for (unsigned int i = 0; i < a_uVertexCount; i++)
+	{
+		a_pVertices[i].Tangent = Vector3(0, 0, 0);
+	}
+
+	// Calculate tangents one whole triangle at a time
+	for (unsigned int i = 0; i + 3 <= a_uIndexCount; i += 3)
+	{
+		Vertex& v1 = a_pVertices[a_pIndices[i]];
+		Vertex& v2 = a_pVertices[a_pIndices[i + 1]];
+		Vertex& v3 = a_pVertices[a_pIndices[i + 2]];
+
+		float lTangent[3];
+		if (!TriangleTangent(v1, v2, v3, lTangent))
+		{
+			continue;
+		}
+
+		Vertex* lCorners[3] = { &v1, &v2, &v3 };
+		for (Vertex* pCorner : lCorners)
+		{
+			pCorner->Tangent.x += lTangent[0];
+			pCorner->Tangent.y += lTangent[1];
+			pCorner->Tangent.z += lTangent[2];
+		}
+	}
+
+	// Ensure all of the tangents are orthogonal to the normals
+	for (unsigned int i = 0; i < a_uVertexCount; i++)
+	{
+		Vector3 v3Tangent = a_pVertices[i].Tangent;
+		ResolveTangent(a_pVertices[i].Normal, v3Tangent.x, v3Tangent.y, v3Tangent.z, a_bInvert, a_pVertices[i].Tangent);
+	}
+}
+
+TangentBenchmark TangentGenerator::Benchmark(unsigned int a_uGridSize, unsigned int a_uRuns)
+{
+	a_uGridSize = std::max(1u, a_uGridSize);
+	a_uRuns = std::max(1u, a_uRuns);
+
+	// A rippled grid, so the tangents are not all the same.
+	unsigned int uSide = a_uGridSize + 1;
+	std::vector<Vertex> lVertices(uSide * uSide);
+	for (unsigned int y = 0; y < uSide; y++)
+	{
+		for (unsigned int x = 0; x < uSide; x++)
+		{
+			float fU = (float)x / a_uGridSize;
+			float fV = (float)y / a_uGridSize;
+			float fHeight = 0.05f * std::sin(fU * 40.0f) * std::cos(fV * 40.0f);
+
+			Vertex& vertex = lVertices[y * uSide + x];
+			vertex.Position = Vector3(fU, fHeight, fV);
+			vertex.Normal = Vector3(0.0f, 1.0f, 0.0f);
+			vertex.UV = Vector2(fU + 0.1f * fHeight, fV);
+			vertex.Tangent = Vector3(0.0f, 0.0f, 0.0f);
+		}
+	}
+
+	std::vector<unsigned int> lIndices;
+	lIndices.reserve((size_t)a_uGridSize * a_uGridSize * 6);
+	for (unsigned int y = 0; y < a_uGridSize; y++)
+	{
+		for (unsigned int x = 0; x < a_uGridSize; x++)
+		{
+			unsigned int uCorner = y * uSide + x;
+			lIndices.push_back(uCorner);
+			lIndices.push_back(uCorner + uSide);
+			lIndices.push_back(uCorner + 1);
+			lIndices.push_back(uCorner + 1);
+			lIndices.push_back(uCorner + uSide);
+			lIndices.push_back(uCorner + uSide + 1);
+		}
+	}
+
+	TangentBenchmark result;
+	result.VertexCount = (unsigned int)lVertices.size();
+	result.TriangleCount = (unsigned int)lIndices.size() / 3;
+
+	std::vector<Vertex> lScalar = lVertices;
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned int r = 0; r < a_uRuns; r++)
+	{
+		GenerateScalar(lScalar.data(), result.VertexCount, lIndices.data(), (unsigned int)lIndices.size());
+	}
+	auto end = std::chrono::steady_clock::now();
+	result.ScalarMilliseconds = std::chrono::duration<double, std::milli>(end - start).count() / a_uRuns;
+
+	std::vector<Vertex> lParallel = lVertices;
+	start = std::chrono::steady_clock::now();
+	for (unsigned int r = 0; r < a_uRuns; r++)
+	{
+		Generate(lParallel.data(), result.VertexCount, lIndices.data(), (unsigned int)lIndices.size());
+	}
+	end = std::chrono::steady_clock::now();
+	result.ParallelMilliseconds = std::chrono::duration<double, std::milli>(end - start).count() / a_uRuns;
+
+	for (size_t i = 0; i < lVertices.size(); i++)
+	{
+		const Vector3& v3Scalar = lScalar[i].Tangent;
+		const Vector3& v3Parallel = lParallel[i].Tangent;
+		result.MaxDifference = std::max(result.MaxDifference, std::fabs(v3Scalar.x - v3Parallel.x));
+		result.MaxDifference = std::max(result.MaxDifference, std::fabs(v3Scalar.y - v3Parallel.y));
+		result.MaxDifference = std::max(result.MaxDifference, std::fabs(v3Scalar.z - v3Parallel.z));
+	}
+
+	Logger::GetInstance()->Log(
+		"TangentGenerator.cpp",
+		"Tangents for " + std::to_string(result.TriangleCount) + " triangles took " +
+		std::to_string(result.ScalarMilliseconds) + "ms scalar and " +
+		std::to_string(result.ParallelMilliseconds) + "ms parallel",
+		INFO_LOG);
+
+	return result;
+}
@@ -0,0 +1,68 @@
+#ifndef __TANGENTGENERATOR_H_
+#define __TANGENTGENERATOR_H_
+
+#include "Vertex.h"
+
+// The fewest triangles worth handing to a thread of their own.
+#define TANGENT_MIN_SLICE 16384
+
+// The most memory the per-thread tangent accumulation buffers may take up together.
+#define TANGENT_ACCUMULATION_BUDGET (64u * 1024u * 1024u)
+
+// Triangles whose UVs span less area than this can not tell which way the tangent points.
+#define TANGENT_DEGENERATE_UV 1e-12f
+
+/// <summary>
+/// How the parallel tangent generation compares against the plain scalar loop.
+/// </summary>
+struct TangentBenchmark
+{
+	unsigned int VertexCount = 0;
+	unsigned int TriangleCount = 0;
+	// The average time of a single run, in milliseconds.
+	double ScalarMilliseconds = 0.0;
+	double ParallelMilliseconds = 0.0;
+	// The largest difference between any two tangents both versions produced.
+	float MaxDifference = 0.0f;
+};
+
+/// <summary>
+/// Calculates per-vertex tangents out of positions, UVs and normals.  The triangles are split across
+/// the ThreadPool with one accumulation buffer per slice, the math is done with SSE,
+/// and triangles with degenerate UVs are skipped instead of being divided by zero.
+/// Nothing in here touches the device.
+/// </summary>
+class TangentGenerator
+{
+public:
+	/// <summary>
+	/// Calculates the tangents of every vertex, orthogonal to its normal.
+	/// Vertices that no usable triangle touches get any tangent orthogonal to their normal.
+	/// </summary>
+	/// <param name="a_bInvert">Whether to flip the tangents around.</param>
+	static void Generate(
+		Vertex* a_pVertices,
+		unsigned int a_uVertexCount,
+		const unsigned int* a_pIndices,
+		unsigned int a_uIndexCount,
+		bool a_bInvert = false);
+
+	/// <summary>
+	/// The original single threaded, one triangle at a time version.  Kept as the benchmark's baseline.
+	/// </summary>
+	static void GenerateScalar(
+		Vertex* a_pVertices,
+		unsigned int a_uVertexCount,
+		const unsigned int* a_pIndices,
+		unsigned int a_uIndexCount,
+		bool a_bInvert = false);
+
+	/// <summary>
+	/// Times both versions on a dense grid of the passed in size and logs the results.
+	/// </summary>
+	/// <param name="a_uGridSize">The amount of quads along each side of the grid.</param>
+	/// <param name="a_uRuns">How many times each version runs.</param>
+	static TangentBenchmark Benchmark(unsigned int a_uGridSize, unsigned int a_uRuns);
+};
+
+#endif //__TANGENTGENERATOR_H_
@@ -0,0 +1,1183 @@
+#include "TextureCooker.h"
+#include "ThreadPool.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <xmmintrin.h>
+
+// Kaiser window settings.  The filter covers 3 destination pixels.
+#define KAISER_WIDTH 3.0f
+#define KAISER_ALPHA 4.0f
+#define KAISER_TAPS 6
+
+// Gamma the albedo textures are authored in.  Matches the decode in EntityPS.
+#define ALBEDO_GAMMA 2.2f
+
+// DDS constants.
+#define DDS_MAGIC 0x20534444
+#define DDS_FOURCC_DX10 0x30315844
+#define DDS_FLAGS_REQUIRED 0x1007
+#define DDS_FLAG_PITCH 0x8
+#define DDS_FLAG_MIPMAPCOUNT 0x20000
+#define DDS_FLAG_LINEARSIZE 0x80000
+#define DDS_PIXELFORMAT_FOURCC 0x4
+#define DDS_CAPS_TEXTURE 0x1000
+#define DDS_CAPS_COMPLEX 0x8
+#define DDS_CAPS_MIPMAP 0x400000
+#define DDS_DIMENSION_TEXTURE2D 3
+
+namespace
+{
+	struct DDSPixelFormat
+	{
+		uint32_t Size;
+		uint32_t Flags;
+		uint32_t FourCC;
+		uint32_t RGBBitCount;
+		uint32_t RBitMask;
+		uint32_t GBitMask;
+		uint32_t BBitMask;
+		uint32_t ABitMask;
+	};
+
+	/// <summary>
+	/// The standard DDS header.  The reserved words hold the cache validation data.
+	/// </summary>
+	struct DDSHeader
+	{
+		uint32_t Magic;
+		uint32_t Size;
+		uint32_t Flags;
+		uint32_t Height;
+		uint32_t Width;
+		uint32_t PitchOrLinearSize;
+		uint32_t Depth;
+		uint32_t MipMapCount;
+		uint32_t CacheMagic;
+		uint32_t CacheVersion;
+		uint32_t CacheOptions;
+		uint32_t SourceHash[2];
+		uint32_t SourceSize[2];
+		uint32_t SourceWriteTime[2];
+		uint32_t Reserved1[2];
+		DDSPixelFormat PixelFormat;
+		uint32_t Caps;
+		uint32_t Caps2;
+		uint32_t Caps3;
+		uint32_t Caps4;
+		uint32_t Reserved2;
+		// DX10 extension, needed to store BC7 and the explicit DXGI format.
+		uint32_t DXGIFormat;
+		uint32_t ResourceDimension;
+		uint32_t MiscFlag;
+		uint32_t ArraySize;
+		uint32_t MiscFlags2;
+	};
+	static_assert(sizeof(DDSHeader) == 148, "DDS header must match the file format.");
+
+	/// <summary>
+	/// A mip level being filtered, stored as 4 floats per pixel.
+	/// </summary>
+	struct FloatImage
+	{
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		std::vector<float> Pixels;
+	};
+
+	/// <summary>
+	/// Lookup tables between gamma and linear albedo values.
+	/// </summary>
+	struct GammaTables
+	{
+		float ToLinear[256];
+		unsigned char ToGamma[4096];
+
+		GammaTables(void)
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				ToLinear[i] = std::pow(i / 255.0f, ALBEDO_GAMMA);
+			}
+			for (int i = 0; i < 4096; i++)
+			{
+				ToGamma[i] = (unsigned char)(std::pow(i / 4095.0f, 1.0f / ALBEDO_GAMMA) * 255.0f + 0.5f);
+			}
+		}
+	};
+
+	const GammaTables& GetGammaTables(void)
+	{
+		static const GammaTables tables;
+		return tables;
+	}
+
+	unsigned char ToByte(float a_fValue)
+	{
+		return (unsigned char)(std::min(std::max(a_fValue, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+
+	/// <summary>
+	/// Converts 8 bit pixels into the space they are filtered in.
+	/// </summary>
+	void ToFloatImage(const ImageData& a_Image, TextureUsage a_Usage, FloatImage& a_Result)
+	{
+		const float* pToLinear = GetGammaTables().ToLinear;
+
+		a_Result.Width = a_Image.Width;
+		a_Result.Height = a_Image.Height;
+		a_Result.Pixels.resize((size_t)a_Image.Width * a_Image.Height * 4);
+
+		for (size_t i = 0; i < a_Result.Pixels.size(); i++)
+		{
+			unsigned char uValue = a_Image.Pixels[i];
+			bool bColor = a_Usage == TextureUsage::Albedo && (i & 3) != 3;
+			a_Result.Pixels[i] = bColor ? pToLinear[uValue] : uValue / 255.0f;
+		}
+	}
+
+	/// <summary>
+	/// Converts filtered pixels back into 8 bits.
+	/// </summary>
+	void ToImageData(const FloatImage& a_Image, TextureUsage a_Usage, ImageData& a_Result)
+	{
+		const unsigned char* pToGamma = GetGammaTables().ToGamma;
+
+		a_Result.Width = a_Image.Width;
+		a_Result.Height = a_Image.Height;
+		a_Result.Pixels.resize(a_Image.Pixels.size());
+
+		for (size_t i = 0; i < a_Image.Pixels.size(); i++)
+		{
+			float fValue = a_Image.Pixels[i];
+			if (a_Usage == TextureUsage::Albedo && (i & 3) != 3)
+			{
+				int dIndex = (int)(std::min(std::max(fValue, 0.0f), 1.0f) * 4095.0f + 0.5f);
+				a_Result.Pixels[i] = pToGamma[dIndex];
+			}
+			else
+			{
+				a_Result.Pixels[i] = ToByte(fValue);
+			}
+		}
+	}
+
+	/// <summary>
+	/// Zeroth order modified Bessel function of the first kind, used by the Kaiser window.
+	/// </summary>
+	float BesselI0(float a_fX)
+	{
+		float fSum = 1.0f;
+		float fTerm = 1.0f;
+		float fHalf = a_fX * 0.5f;
+		for (int k = 1; k < 32; k++)
+		{
+			fTerm *= fHalf / k;
+			fSum += fTerm * fTerm;
+			if (fTerm * fTerm < fSum * 1e-8f)
+			{
+				break;
+			}
+		}
+		return fSum;
+	}
+
+	/// <summary>
+	/// Works out the weights of the Kaiser windowed sinc filter used to halve an image.
+	/// Tap i reads the source pixel at 2x - 2 + i.
+	/// </summary>
+	void GetKaiserWeights(float a_lWeights[KAISER_TAPS])
+	{
+		const float PI = 3.14159265358979f;
+		float fTotal = 0.0f;
+		for (int i = 0; i < KAISER_TAPS; i++)
+		{
+			// Distance to the destination pixel's center, in destination pixels.
+			float fX = ((i - 2) + 0.5f - 1.0f) * 0.5f;
+			float fSinc = fX == 0.0f ? 1.0f : std::sin(PI * fX) / (PI * fX);
+
+			float fWindow = fX / (KAISER_WIDTH * 0.5f);
+			float fKaiser = std::fabs(fWindow) >= 1.0f ? 0.0f :
+				BesselI0(KAISER_ALPHA * std::sqrt(1.0f - fWindow * fWindow)) / BesselI0(KAISER_ALPHA);
+
+			a_lWeights[i] = fSinc * fKaiser;
+			fTotal += a_lWeights[i];
+		}
+
+		for (int i = 0; i < KAISER_TAPS; i++)
+		{
+			a_lWeights[i] /= fTotal;
+		}
+	}
+
+	/// <summary>
+	/// Averages every 2x2 square of the source into one destination pixel.
+	/// Odd edges are clamped, the same way the GPU generates its mips.
+	/// </summary>
+	void BoxDownsample(const FloatImage& a_Source, FloatImage& a_Result)
+	{
+		const float* pSource = a_Source.Pixels.data();
+		float* pResult = a_Result.Pixels.data();
+		uint32_t uMaxX = a_Source.Width - 1;
+		uint32_t uMaxY = a_Source.Height - 1;
+
+		ThreadPool::GetInstance()->ParallelFor(a_Result.Height, 16, [&](unsigned int a_uBegin, unsigned int a_uEnd)
+			{
+				const __m128 quarter = _mm_set1_ps(0.25f);
+				for (uint32_t y = a_uBegin; y < a_uEnd; y++)
+				{
+					const float* pRow0 = pSource + (size_t)std::min(y * 2, uMaxY) * a_Source.Width * 4;
+					const float* pRow1 = pSource + (size_t)std::min(y * 2 + 1, uMaxY) * a_Source.Width * 4;
+					float* pOut = pResult + (size_t)y * a_Result.Width * 4;
+
+					for (uint32_t x = 0; x < a_Result.Width; x++)
+					{
+						uint32_t x0 = std::min(x * 2, uMaxX) * 4;
+						uint32_t x1 = std::min(x * 2 + 1, uMaxX) * 4;
+
+						__m128 sum = _mm_add_ps(
+							_mm_add_ps(_mm_loadu_ps(pRow0 + x0), _mm_loadu_ps(pRow0 + x1)),
+							_mm_add_ps(_mm_loadu_ps(pRow1 + x0), _mm_loadu_ps(pRow1 + x1)));
+						_mm_storeu_ps(pOut + x * 4, _mm_mul_ps(sum, quarter));
+					}
+				}
+			});
+	}
+
+	/// <summary>
+	/// Halves an image with a separable Kaiser windowed sinc.  Sharper than a box filter
+	/// while still keeping the aliasing that makes distant surfaces shimmer out.
+	/// </summary>
+	void KaiserDownsample(const FloatImage& a_Source, FloatImage& a_Result)
+	{
+		float lWeights[KAISER_TAPS];
+		GetKaiserWeights(lWeights);
+
+		// Shrinking horizontally first into an image that is only half as wide.
+		FloatImage horizontal;
+		horizontal.Width = a_Result.Width;
+		horizontal.Height = a_Source.Height;
+		horizontal.Pixels.resize((size_t)horizontal.Width * horizontal.Height * 4);
+
+		int dMaxX = (int)a_Source.Width - 1;
+		int dMaxY = (int)a_Source.Height - 1;
+
+		ThreadPool::GetInstance()->ParallelFor(horizontal.Height, 16, [&](unsigned int a_uBegin, unsigned int a_uEnd)
+			{
+				for (uint32_t y = a_uBegin; y < a_uEnd; y++)
+				{
+					const float* pRow = a_Source.Pixels.data() + (size_t)y * a_Source.Width * 4;
+					float* pOut = horizontal.Pixels.data() + (size_t)y * horizontal.Width * 4;
+
+					for (uint32_t x = 0; x < horizontal.Width; x++)
+					{
+						__m128 sum = _mm_setzero_ps();
+						for (int i = 0; i < KAISER_TAPS; i++)
+						{
+							int dX = std::min(std::max((int)x * 2 - 2 + i, 0), dMaxX);
+							sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(pRow + dX * 4), _mm_set1_ps(lWeights[i])));
+						}
+						_mm_storeu_ps(pOut + x * 4, sum);
+					}
+				}
+			});
+
+		ThreadPool::GetInstance()->ParallelFor(a_Result.Height, 16, [&](unsigned int a_uBegin, unsigned int a_uEnd)
+			{
+				for (uint32_t y = a_uBegin; y < a_uEnd; y++)
+				{
+					const float* lRows[KAISER_TAPS];
+					for (int i = 0; i < KAISER_TAPS; i++)
+					{
+						int dY = std::min(std::max((int)y * 2 - 2 + i, 0), dMaxY);
+						lRows[i] = horizontal.Pixels.data() + (size_t)dY * horizontal.Width * 4;
+					}
+
+					float* pOut = a_Result.Pixels.data() + (size_t)y * a_Result.Width * 4;
+					for (uint32_t x = 0; x < a_Result.Width * 4; x += 4)
+					{
+						__m128 sum = _mm_setzero_ps();
+						for (int i = 0; i < KAISER_TAPS; i++)
+						{
+							sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(lRows[i] + x), _mm_set1_ps(lWeights[i])));
+						}
+
+						// Negative lobes can overshoot, which would wrap around once stored.
+						sum = _mm_min_ps(_mm_max_ps(sum, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+						_mm_storeu_ps(pOut + x, sum);
+					}
+				}
+			});
+	}
+
+	/// <summary>
+	/// Makes the normals of a filtered normal map unit length again.
+	/// </summary>
+	void RenormalizeNormals(FloatImage& a_Image)
+	{
+		size_t uPixelCount = (size_t)a_Image.Width * a_Image.Height;
+		for (size_t i = 0; i < uPixelCount; i++)
+		{
+			float* pPixel = &a_Image.Pixels[i * 4];
+			float fX = pPixel[0] * 2.0f - 1.0f;
+			float fY = pPixel[1] * 2.0f - 1.0f;
+			float fZ = pPixel[2] * 2.0f - 1.0f;
+
+			float fLength = std::sqrt(fX * fX + fY * fY + fZ * fZ);
+			if (fLength > 1e-6f)
+			{
+				pPixel[0] = fX / fLength * 0.5f + 0.5f;
+				pPixel[1] = fY / fLength * 0.5f + 0.5f;
+				pPixel[2] = fZ / fLength * 0.5f + 0.5f;
+			}
+		}
+	}
+
+	// ---------------------------------------------------------------------------------------
+	// Block compression.
+	// ---------------------------------------------------------------------------------------
+
+	/// <summary>
+	/// Finds the direction the colors of a block spread out along the most.
+	/// </summary>
+	template <int Channels>
+	void GetPrincipalAxis(const float a_lPoints[16][4], float a_lMean[4], float a_lAxis[4])
+	{
+		for (int c = 0; c < Channels; c++)
+		{
+			a_lMean[c] = 0.0f;
+			for (int i = 0; i < 16; i++)
+			{
+				a_lMean[c] += a_lPoints[i][c];
+			}
+			a_lMean[c] /= 16.0f;
+		}
+
+		float lCovariance[Channels][Channels] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			for (int r = 0; r < Channels; r++)
+			{
+				for (int c = 0; c < Channels; c++)
+				{
+					lCovariance[r][c] += (a_lPoints[i][r] - a_lMean[r]) * (a_lPoints[i][c] - a_lMean[c]);
+				}
+			}
+		}
+
+		// Power iteration, starting from an even mix of every channel.
+		for (int c = 0; c < Channels; c++)
+		{
+			a_lAxis[c] = 1.0f;
+		}
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float lNext[Channels] = {};
+			float fLargest = 0.0f;
+			for (int r = 0; r < Channels; r++)
+			{
+				for (int c = 0; c < Channels; c++)
+				{
+					lNext[r] += lCovariance[r][c] * a_lAxis[c];
+				}
+				fLargest = std::max(fLargest, std::fabs(lNext[r]));
+			}
+
+			if (fLargest < 1e-8f)
+			{
+				break;
+			}
+			for (int c = 0; c < Channels; c++)
+			{
+				a_lAxis[c] = lNext[c] / fLargest;
+			}
+		}
+
+		float fLength = 0.0f;
+		for (int c = 0; c < Channels; c++)
+		{
+			fLength += a_lAxis[c] * a_lAxis[c];
+		}
+		fLength = std::sqrt(fLength);
+		for (int c = 0; c < Channels; c++)
+		{
+			a_lAxis[c] = fLength > 0.0f ? a_lAxis[c] / fLength : 0.0f;
+		}
+	}
+
+	/// <summary>
+	/// Places two endpoints at the extremes of the block along its principal axis.
+	/// </summary>
+	template <int Channels>
+	void GetEndpoints(const float a_lPoints[16][4], float a_lStart[4], float a_lEnd[4])
+	{
+		float lMean[4];
+		float lAxis[4];
+		GetPrincipalAxis<Channels>(a_lPoints, lMean, lAxis);
+
+		float fMin = 0.0f;
+		float fMax = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			float fT = 0.0f;
+			for (int c = 0; c < Channels; c++)
+			{
+				fT += (a_lPoints[i][c] - lMean[c]) * lAxis[c];
+			}
+			fMin = std::min(fMin, fT);
+			fMax = std::max(fMax, fT);
+		}
+
+		for (int c = 0; c < Channels; c++)
+		{
+			a_lStart[c] = std::min(std::max(lMean[c] + lAxis[c] * fMin, 0.0f), 255.0f);
+			a_lEnd[c] = std::min(std::max(lMean[c] + lAxis[c] * fMax, 0.0f), 255.0f);
+		}
+	}
+
+	/// <summary>
+	/// Least squares fit of the two endpoints that best reproduce the block with the chosen indices.
+	/// </summary>
+	/// <param name="a_lBlend">How far along from the start to the end each pixel's index is, in [0, 1].</param>
+	/// <returns>False if the indices do not pin the endpoints down.</returns>
+	template <int Channels>
+	bool RefitEndpoints(const float a_lPoints[16][4], const float a_lBlend[16], float a_lStart[4], float a_lEnd[4])
+	{
+		float fAA = 0.0f;
+		float fAB = 0.0f;
+		float fBB = 0.0f;
+		float lAX[4] = {};
+		float lBX[4] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			float fA = 1.0f - a_lBlend[i];
+			float fB = a_lBlend[i];
+			fAA += fA * fA;
+			fAB += fA * fB;
+			fBB += fB * fB;
+			for (int c = 0; c < Channels; c++)
+			{
+				lAX[c] += fA * a_lPoints[i][c];
+				lBX[c] += fB * a_lPoints[i][c];
+			}
+		}
+
+		float fDeterminant = fAA * fBB - fAB * fAB;
+		if (std::fabs(fDeterminant) < 1e-6f)
+		{
+			return false;
+		}
+
+		for (int c = 0; c < Channels; c++)
+		{
+			a_lStart[c] = std::min(std::max((lAX[c] * fBB - lBX[c] * fAB) / fDeterminant, 0.0f), 255.0f);
+			a_lEnd[c] = std::min(std::max((lBX[c] * fAA - lAX[c] * fAB) / fDeterminant, 0.0f), 255.0f);
+		}
+		return true;
+	}
+
+	void LoadPoints(const unsigned char* a_pPixels, float a_lPoints[16][4])
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				a_lPoints[i][c] = a_pPixels[i * 4 + c];
+			}
+		}
+	}
+
+	uint16_t PackColor565(const float a_lColor[4])
+	{
+		uint16_t uR = (uint16_t)(a_lColor[0] * 31.0f / 255.0f + 0.5f);
+		uint16_t uG = (uint16_t)(a_lColor[1] * 63.0f / 255.0f + 0.5f);
+		uint16_t uB = (uint16_t)(a_lColor[2] * 31.0f / 255.0f + 0.5f);
+		return (uint16_t)((uR << 11) | (uG << 5) | uB);
+	}
+
+	void UnpackColor565(uint16_t a_uColor, int a_lResult[3])
+	{
+		int dR = (a_uColor >> 11) & 31;
+		int dG = (a_uColor >> 5) & 63;
+		int dB = a_uColor & 31;
+		a_lResult[0] = (dR << 3) | (dR >> 2);
+		a_lResult[1] = (dG << 2) | (dG >> 4);
+		a_lResult[2] = (dB << 3) | (dB >> 2);
+	}
+
+	/// <summary>
+	/// Picks the closest of the 4 BC1 palette entries for every pixel.
+	/// </summary>
+	/// <returns>The total squared error of the block.</returns>
+	int EvaluateBC1(const float a_lPoints[16][4], uint16_t a_uColor0, uint16_t a_uColor1, uint8_t a_lIndices[16])
+	{
+		int lPalette[4][3];
+		UnpackColor565(a_uColor0, lPalette[0]);
+		UnpackColor565(a_uColor1, lPalette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			lPalette[2][c] = (2 * lPalette[0][c] + lPalette[1][c] + 1) / 3;
+			lPalette[3][c] = (lPalette[0][c] + 2 * lPalette[1][c] + 1) / 3;
+		}
+
+		int dTotal = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			int dBest = INT32_MAX;
+			for (int p = 0; p < 4; p++)
+			{
+				int dError = 0;
+				for (int c = 0; c < 3; c++)
+				{
+					int dDelta = (int)a_lPoints[i][c] - lPalette[p][c];
+					dError += dDelta * dDelta;
+				}
+				if (dError < dBest)
+				{
+					dBest = dError;
+					a_lIndices[i] = (uint8_t)p;
+				}
+			}
+			dTotal += dBest;
+		}
+		return dTotal;
+	}
+
+	/// <summary>
+	/// BC1: two 565 endpoints and 2 bit indices, always in the 4 color mode.
+	/// </summary>
+	void EncodeBC1(const unsigned char* a_pPixels, unsigned char* a_pOut)
+	{
+		// Where each index sits between the two endpoints.
+		const float BLEND[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+		float lPoints[16][4];
+		LoadPoints(a_pPixels, lPoints);
+
+		float lStart[4];
+		float lEnd[4];
+		GetEndpoints<3>(lPoints, lStart, lEnd);
+
+		uint16_t uColor0 = PackColor565(lEnd);
+		uint16_t uColor1 = PackColor565(lStart);
+		uint8_t lIndices[16];
+		int dError = EvaluateBC1(lPoints, uColor0, uColor1, lIndices);
+
+		// One refinement pass, kept only if it actually helps.
+		float lBlend[16];
+		for (int i = 0; i < 16; i++)
+		{
+			lBlend[i] = BLEND[lIndices[i]];
+		}
+		if (dError > 0 && RefitEndpoints<3>(lPoints, lBlend, lEnd, lStart))
+		{
+			uint16_t uRefit0 = PackColor565(lEnd);
+			uint16_t uRefit1 = PackColor565(lStart);
+			uint8_t lRefitIndices[16];
+			if (EvaluateBC1(lPoints, uRefit0, uRefit1, lRefitIndices) < dError)
+			{
+				uColor0 = uRefit0;
+				uColor1 = uRefit1;
+				std::memcpy(lIndices, lRefitIndices, sizeof(lIndices));
+			}
+		}
+
+		// The 4 color mode needs the first endpoint to be the larger one.
+		if (uColor0 < uColor1)
+		{
+			std::swap(uColor0, uColor1);
+			for (int i = 0; i < 16; i++)
+			{
+				lIndices[i] ^= 1;
+			}
+		}
+		else if (uColor0 == uColor1)
+		{
+			std::memset(lIndices, 0, sizeof(lIndices));
+		}
+
+		uint32_t uBits = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			uBits |= (uint32_t)lIndices[i] << (i * 2);
+		}
+		std::memcpy(a_pOut, &uColor0, 2);
+		std::memcpy(a_pOut + 2, &uColor1, 2);
+		std::memcpy(a_pOut + 4, &uBits, 4);
+	}
+
+	/// <summary>
+	/// BC4: one channel stored as two 8 bit endpoints and 3 bit indices.
+	/// </summary>
+	/// <param name="a_uChannel">Which of the RGBA channels to encode.</param>
+	void EncodeBC4(const unsigned char* a_pPixels, int a_uChannel, unsigned char* a_pOut)
+	{
+		int dMin = 255;
+		int dMax = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			dMin = std::min(dMin, (int)a_pPixels[i * 4 + a_uChannel]);
+			dMax = std::max(dMax, (int)a_pPixels[i * 4 + a_uChannel]);
+		}
+
+		// The 8 value mode, which needs the first endpoint to be the larger one.
+		int lPalette[8] = { dMax, dMin };
+		for (int i = 2; i < 8; i++)
+		{
+			lPalette[i] = ((8 - i) * dMax + (i - 1) * dMin + 3) / 7;
+		}
+
+		uint64_t uBits = 0;
+		if (dMax != dMin)
+		{
+			for (int i = 0; i < 16; i++)
+			{
+				int dValue = a_pPixels[i * 4 + a_uChannel];
+				int dBest = 0;
+				for (int p = 1; p < 8; p++)
+				{
+					if (std::abs(lPalette[p] - dValue) < std::abs(lPalette[dBest] - dValue))
+					{
+						dBest = p;
+					}
+				}
+				uBits |= (uint64_t)dBest << (i * 3);
+			}
+		}
+
+		a_pOut[0] = (unsigned char)dMax;
+		a_pOut[1] = (unsigned char)dMin;
+		for (int i = 0; i < 6; i++)
+		{
+			a_pOut[2 + i] = (unsigned char)(uBits >> (i * 8));
+		}
+	}
+
+	// BC7 interpolation weights for 4 bit indices.
+	const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	/// <summary>
+	/// Quantizes a BC7 mode 6 endpoint to 7 bits per channel plus a shared low bit,
+	/// trying both low bits and keeping the closer one.
+	/// </summary>
+	void QuantizeBC7Endpoint(const float a_lEndpoint[4], int a_lResult[4], int& a_dPBit)
+	{
+		int dBestError = INT32_MAX;
+		for (int p = 0; p < 2; p++)
+		{
+			int lQuantized[4];
+			int dError = 0;
+			for (int c = 0; c < 4; c++)
+			{
+				lQuantized[c] = std::min(std::max((int)((a_lEndpoint[c] - p) * 0.5f + 0.5f), 0), 127);
+				int dDelta = ((lQuantized[c] << 1) | p) - (int)(a_lEndpoint[c] + 0.5f);
+				dError += dDelta * dDelta;
+			}
+
+			if (dError < dBestError)
+			{
+				dBestError = dError;
+				a_dPBit = p;
+				std::memcpy(a_lResult, lQuantized, sizeof(lQuantized));
+			}
+		}
+	}
+
+	/// <summary>
+	/// Picks the closest of the 16 BC7 palette entries for every pixel.
+	/// </summary>
+	/// <returns>The total squared error of the block.</returns>
+	int EvaluateBC7(const float a_lPoints[16][4], const int a_lStart[4], const int a_lEnd[4], uint8_t a_lIndices[16])
+	{
+		int lPalette[16][4];
+		for (int p = 0; p < 16; p++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				lPalette[p][c] = ((64 - BC7_WEIGHTS[p]) * a_lStart[c] + BC7_WEIGHTS[p] * a_lEnd[c] + 32) >> 6;
+			}
+		}
+
+		int dTotal = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			int dBest = INT32_MAX;
+			for (int p = 0; p < 16; p++)
+			{
+				int dError = 0;
+				for (int c = 0; c < 4; c++)
+				{
+					int dDelta = (int)a_lPoints[i][c] - lPalette[p][c];
+					dError += dDelta * dDelta;
+				}
+				if (dError < dBest)
+				{
+					dBest = dError;
+					a_lIndices[i] = (uint8_t)p;
+				}
+			}
+			dTotal += dBest;
+		}
+		return dTotal;
+	}
+
+	/// <summary>
+	/// Writes bits into a 128 bit block, lowest bit first.
+	/// </summary>
+	struct BlockWriter
+	{
+		unsigned char* Out;
+		unsigned int Position = 0;
+
+		void Write(uint32_t a_uValue, unsigned int a_uCount)
+		{
+			for (unsigned int i = 0; i < a_uCount; i++, Position++)
+			{
+				if ((a_uValue >> i) & 1)
+				{
+					Out[Position >> 3] |= (unsigned char)(1 << (Position & 7));
+				}
+			}
+		}
+	};
+
+	/// <summary>
+	/// BC7 in mode 6: a single RGBA line with 7 bit endpoints, shared low bits and 4 bit indices.
+	/// </summary>
+	void EncodeBC7(const unsigned char* a_pPixels, unsigned char* a_pOut)
+	{
+		float lPoints[16][4];
+		LoadPoints(a_pPixels, lPoints);
+
+		float lStart[4];
+		float lEnd[4];
+		GetEndpoints<4>(lPoints, lStart, lEnd);
+
+		int lQuantizedStart[4];
+		int lQuantizedEnd[4];
+		int dPBitStart = 0;
+		int dPBitEnd = 0;
+		QuantizeBC7Endpoint(lStart, lQuantizedStart, dPBitStart);
+		QuantizeBC7Endpoint(lEnd, lQuantizedEnd, dPBitEnd);
+
+		int lUnpackedStart[4];
+		int lUnpackedEnd[4];
+		for (int c = 0; c < 4; c++)
+		{
+			lUnpackedStart[c] = (lQuantizedStart[c] << 1) | dPBitStart;
+			lUnpackedEnd[c] = (lQuantizedEnd[c] << 1) | dPBitEnd;
+		}
+
+		uint8_t lIndices[16];
+		int dError = EvaluateBC7(lPoints, lUnpackedStart, lUnpackedEnd, lIndices);
+
+		// One refinement pass, kept only if it actually helps.
+		float lBlend[16];
+		for (int i = 0; i < 16; i++)
+		{
+			lBlend[i] = BC7_WEIGHTS[lIndices[i]] / 64.0f;
+		}
+		if (dError > 0 && RefitEndpoints<4>(lPoints, lBlend, lStart, lEnd))
+		{
+			int lRefitStart[4];
+			int lRefitEnd[4];
+			int dRefitPBitStart = 0;
+			int dRefitPBitEnd = 0;
+			QuantizeBC7Endpoint(lStart, lRefitStart, dRefitPBitStart);
+			QuantizeBC7Endpoint(lEnd, lRefitEnd, dRefitPBitEnd);
+
+			int lRefitUnpackedStart[4];
+			int lRefitUnpackedEnd[4];
+			for (int c = 0; c < 4; c++)
+			{
+				lRefitUnpackedStart[c] = (lRefitStart[c] << 1) | dRefitPBitStart;
+				lRefitUnpackedEnd[c] = (lRefitEnd[c] << 1) | dRefitPBitEnd;
+			}
+
+			uint8_t lRefitIndices[16];
+			if (EvaluateBC7(lPoints, lRefitUnpackedStart, lRefitUnpackedEnd, lRefitIndices) < dError)
+			{
+				std::memcpy(lQuantizedStart, lRefitStart, sizeof(lRefitStart));
+				std::memcpy(lQuantizedEnd, lRefitEnd, sizeof(lRefitEnd));
+				dPBitStart = dRefitPBitStart;
+				dPBitEnd = dRefitPBitEnd;
+				std::memcpy(lIndices, lRefitIndices, sizeof(lIndices));
+			}
+		}
+
+		// The first index only has room for 3 bits, so its top bit has to be zero.
+		if (lIndices[0] & 8)
+		{
+			std::swap(lQuantizedStart, lQuantizedEnd);
+			std::swap(dPBitStart, dPBitEnd);
+			for (int i = 0; i < 16; i++)
+			{
+				lIndices[i] = (uint8_t)(15 - lIndices[i]);
+			}
+		}
+
+		std::memset(a_pOut, 0, 16);
+		BlockWriter writer{ a_pOut };
+		writer.Write(1 << 6, 7);
+		for (int c = 0; c < 4; c++)
+		{
+			writer.Write(lQuantizedStart[c], 7);
+			writer.Write(lQuantizedEnd[c], 7);
+		}
+		writer.Write(dPBitStart, 1);
+		writer.Write(dPBitEnd, 1);
+		for (int i = 0; i < 16; i++)
+		{
+			writer.Write(lIndices[i], i == 0 ? 3 : 4);
+		}
+	}
+
+	/// <summary>
+	/// Compresses one mip level into its spot in the cooked data.
+	/// </summary>
+	void CompressMip(const ImageData& a_Mip, TextureFormat a_Format, unsigned char* a_pOut, uint32_t a_uRowPitch)
+	{
+		if (a_Format == TextureFormat::RGBA8)
+		{
+			std::memcpy(a_pOut, a_Mip.Pixels.data(), a_Mip.Pixels.size());
+			return;
+		}
+
+		uint32_t uBlocksWide = std::max(1u, (a_Mip.Width + 3) / 4);
+		uint32_t uBlocksHigh = std::max(1u, (a_Mip.Height + 3) / 4);
+		uint32_t uBlockBytes = TextureCooker::GetBlockBytes(a_Format);
+
+		ThreadPool::GetInstance()->ParallelFor(uBlocksHigh, 4, [&](unsigned int a_uBegin, unsigned int a_uEnd)
+			{
+				unsigned char lBlock[64];
+				for (uint32_t by = a_uBegin; by < a_uEnd; by++)
+				{
+					for (uint32_t bx = 0; bx < uBlocksWide; bx++)
+					{
+						// Blocks hanging off the edge of the small mips repeat the edge pixels.
+						for (uint32_t i = 0; i < 16; i++)
+						{
+							uint32_t x = std::min(bx * 4 + (i & 3), a_Mip.Width - 1);
+							uint32_t y = std::min(by * 4 + (i >> 2), a_Mip.Height - 1);
+							std::memcpy(&lBlock[i * 4], &a_Mip.Pixels[((size_t)y * a_Mip.Width + x) * 4], 4);
+						}
+
+						TextureCooker::EncodeBlock(a_Format, lBlock, a_pOut + (size_t)by * a_uRowPitch + bx * uBlockBytes);
+					}
+				}
+			});
+	}
+}
+
+TextureFormat TextureCooker::ChooseFormat(const ImageData& a_Image, const TextureCookOptions& a_Options)
+{
+	// The top level of a block compressed texture has to be made of whole blocks.
+	if (a_Image.Width % 4 != 0 || a_Image.Height % 4 != 0)
+	{
+		return TextureFormat::RGBA8;
+	}
+
+	switch (a_Options.Usage)
+	{
+	case TextureUsage::Normal: return TextureFormat::BC5;
+	case TextureUsage::Roughness: return TextureFormat::BC4;
+	case TextureUsage::Metal: return TextureFormat::BC4;
+	default: break;
+	}
+
+	if (!a_Options.Fast)
+	{
+		return TextureFormat::BC7;
+	}
+
+	// BC1 has no real alpha, so only fully opaque images can use it.
+	for (size_t i = 3; i < a_Image.Pixels.size(); i += 4)
+	{
+		if (a_Image.Pixels[i] != 255)
+		{
+			return TextureFormat::BC3;
+		}
+	}
+	return TextureFormat::BC1;
+}
+
+void TextureCooker::GenerateMips(
+	const ImageData& a_Image,
+	const TextureCookOptions& a_Options,
+	std::vector<ImageData>& a_lMips)
+{
+	a_lMips.clear();
+	if (a_Image.Pixels.empty())
+	{
+		return;
+	}
+	a_lMips.push_back(a_Image);
+
+	// Every level is filtered from the full precision level above it, not the rounded one.
+	FloatImage current;
+	ToFloatImage(a_Image, a_Options.Usage, current);
+
+	while (current.Width > 1 || current.Height > 1)
+	{
+		FloatImage next;
+		next.Width = std::max(1u, current.Width / 2);
+		next.Height = std::max(1u, current.Height / 2);
+		next.Pixels.resize((size_t)next.Width * next.Height * 4);
+
+		if (a_Options.Filter == MipFilter::Kaiser)
+		{
+			KaiserDownsample(current, next);
+		}
+		else
+		{
+			BoxDownsample(current, next);
+		}
+
+		// Averaged normals shrink, which would darken the lighting of distant surfaces.
+		if (a_Options.Usage == TextureUsage::Normal)
+		{
+			RenormalizeNormals(next);
+		}
+
+		a_lMips.emplace_back();
+		ToImageData(next, a_Options.Usage, a_lMips.back());
+		current = std::move(next);
+	}
+}
+
+bool TextureCooker::Cook(const ImageData& a_Image, const TextureCookOptions& a_Options, CookedTexture& a_Result)
+{
+	std::vector<ImageData> lMips;
+	GenerateMips(a_Image, a_Options, lMips);
+	if (lMips.empty())
+	{
+		return false;
+	}
+
+	a_Result.Format = ChooseFormat(a_Image, a_Options);
+	a_Result.Width = a_Image.Width;
+	a_Result.Height = a_Image.Height;
+	a_Result.Mapping = nullptr;
+	a_Result.MappedData = nullptr;
+
+	size_t uSize = LayoutMips(a_Result.Format, a_Result.Width, a_Result.Height, (uint32_t)lMips.size(), a_Result.Mips);
+	a_Result.Data.assign(uSize, 0);
+
+	for (size_t i = 0; i < lMips.size(); i++)
+	{
+		const CookedMip& mip = a_Result.Mips[i];
+		CompressMip(lMips[i], a_Result.Format, a_Result.Data.data() + mip.Offset, mip.RowPitch);
+	}
+	return true;
+}
+
+bool TextureCooker::LoadCache(const std::string& a_sSourceFile, const TextureCookOptions& a_Options, CookedTexture& a_Result)
+{
+	std::shared_ptr<MappedFile> pFile = std::make_shared<MappedFile>();
+	if (!pFile->Open(a_sSourceFile + TEXTURE_CACHE_EXTENSION) || pFile->GetSize() < sizeof(DDSHeader))
+	{
+		return false;
+	}
+
+	// Making sure that the file is a texture cooked by this version with the same options.
+	const DDSHeader* pHeader = reinterpret_cast<const DDSHeader*>(pFile->GetData());
+	if (pHeader->Magic != DDS_MAGIC ||
+		pHeader->PixelFormat.FourCC != DDS_FOURCC_DX10 ||
+		pHeader->CacheMagic != TEXTURE_CACHE_MAGIC ||
+		pHeader->CacheVersion != TEXTURE_CACHE_VERSION ||
+		pHeader->CacheOptions != PackOptions(a_Options) ||
+		pHeader->Width == 0 || pHeader->Height == 0 ||
+		pHeader->MipMapCount == 0 || pHeader->MipMapCount > 32 ||
+		GetBlockBytes((TextureFormat)pHeader->DXGIFormat) == 0)
+	{
+		return false;
+	}
+
+	// Making sure that every mip is actually inside of the file.
+	std::vector<CookedMip> lMips;
+	TextureFormat format = (TextureFormat)pHeader->DXGIFormat;
+	size_t uSize = LayoutMips(format, pHeader->Width, pHeader->Height, pHeader->MipMapCount, lMips);
+	if (sizeof(DDSHeader) + uSize > pFile->GetSize())
+	{
+		return false;
+	}
+
+	// Stale caches are rejected so that they get cooked again from the source.
+	if (!IsSourceUnchanged(
+		a_sSourceFile,
+		((uint64_t)pHeader->SourceHash[1] << 32) | pHeader->SourceHash[0],
+		((uint64_t)pHeader->SourceSize[1] << 32) | pHeader->SourceSize[0],
+		((uint64_t)pHeader->SourceWriteTime[1] << 32) | pHeader->SourceWriteTime[0]))
+	{
+		return false;
+	}
+
+	a_Result.Format = format;
+	a_Result.Width = pHeader->Width;
+	a_Result.Height = pHeader->Height;
+	a_Result.Mips = std::move(lMips);
+	a_Result.Data.clear();
+	a_Result.MappedData = pFile->GetData() + sizeof(DDSHeader);
+	a_Result.Mapping = pFile;
+	return true;
+}
+
+bool TextureCooker::WriteCache(const std::string& a_sSourceFile, const TextureCookOptions& a_Options, const CookedTexture& a_Texture)
+{
+	if (a_Texture.Mips.empty())
+	{
+		return false;
+	}
+
+	uint64_t uHash = 0;
+	uint64_t uSourceSize = 0;
+	uint64_t uStampSize = 0;
+	uint64_t uWriteTime = 0;
+	if (!HashSource(a_sSourceFile, uHash, uSourceSize) ||
+		!MappedFile::GetFileStamp(a_sSourceFile, uStampSize, uWriteTime))
+	{
+		return false;
+	}
+
+	bool bCompressed = a_Texture.Format != TextureFormat::RGBA8;
+	const CookedMip& lastMip = a_Texture.Mips.back();
+	size_t uDataSize = lastMip.Offset + lastMip.Size;
+
+	DDSHeader header{};
+	header.Magic = DDS_MAGIC;
+	header.Size = 124;
+	header.Flags = DDS_FLAGS_REQUIRED | DDS_FLAG_MIPMAPCOUNT | (bCompressed ? DDS_FLAG_LINEARSIZE : DDS_FLAG_PITCH);
+	header.Height = a_Texture.Height;
+	header.Width = a_Texture.Width;
+	header.PitchOrLinearSize = bCompressed ? (uint32_t)a_Texture.Mips[0].Size : a_Texture.Mips[0].RowPitch;
+	header.MipMapCount = (uint32_t)a_Texture.Mips.size();
+	header.CacheMagic = TEXTURE_CACHE_MAGIC;
+	header.CacheVersion = TEXTURE_CACHE_VERSION;
+	header.CacheOptions = PackOptions(a_Options);
+	header.SourceHash[0] = (uint32_t)uHash;
+	header.SourceHash[1] = (uint32_t)(uHash >> 32);
+	header.SourceSize[0] = (uint32_t)uSourceSize;
+	header.SourceSize[1] = (uint32_t)(uSourceSize >> 32);
+	header.SourceWriteTime[0] = (uint32_t)uWriteTime;
+	header.SourceWriteTime[1] = (uint32_t)(uWriteTime >> 32);
+	header.PixelFormat.Size = sizeof(DDSPixelFormat);
+	header.PixelFormat.Flags = DDS_PIXELFORMAT_FOURCC;
+	header.PixelFormat.FourCC = DDS_FOURCC_DX10;
+	header.Caps = DDS_CAPS_TEXTURE | DDS_CAPS_COMPLEX | DDS_CAPS_MIPMAP;
+	header.DXGIFormat = (uint32_t)a_Texture.Format;
+	header.ResourceDimension = DDS_DIMENSION_TEXTURE2D;
+	header.ArraySize = 1;
+
+	std::vector<unsigned char> lBytes(sizeof(DDSHeader) + uDataSize);
+	std::memcpy(&lBytes[0], &header, sizeof(DDSHeader));
+	std::memcpy(&lBytes[sizeof(DDSHeader)], a_Texture.GetMipData(0), uDataSize);
+
+	return MappedFile::WriteToDisk(a_sSourceFile + TEXTURE_CACHE_EXTENSION, lBytes.data(), lBytes.size());
+}
+
+uint32_t TextureCooker::PackOptions(const TextureCookOptions& a_Options)
+{
+	return (uint32_t)a_Options.Usage | ((uint32_t)a_Options.Filter << 8) | ((a_Options.Fast ? 1u : 0u) << 16);
+}
+
+uint32_t TextureCooker::GetBlockBytes(TextureFormat a_Format)
+{
+	switch (a_Format)
+	{
+	case TextureFormat::RGBA8: return 4;
+	case TextureFormat::BC1: return 8;
+	case TextureFormat::BC4: return 8;
+	case TextureFormat::BC3: return 16;
+	case TextureFormat::BC5: return 16;
+	case TextureFormat::BC7: return 16;
+	default: return 0;
+	}
+}
+
+void TextureCooker::EncodeBlock(TextureFormat a_Format, const unsigned char* a_pPixels, unsigned char* a_pOut)
+{
+	switch (a_Format)
+	{
+	case TextureFormat::BC1:
+		EncodeBC1(a_pPixels, a_pOut);
+		break;
+	case TextureFormat::BC3:
+		EncodeBC4(a_pPixels, 3, a_pOut);
+		EncodeBC1(a_pPixels, a_pOut + 8);
+		break;
+	case TextureFormat::BC4:
+		EncodeBC4(a_pPixels, 0, a_pOut);
+		break;
+	case TextureFormat::BC5:
+		EncodeBC4(a_pPixels, 0, a_pOut);
+		EncodeBC4(a_pPixels, 1, a_pOut + 8);
+		break;
+	case TextureFormat::BC7:
+		EncodeBC7(a_pPixels, a_pOut);
+		break;
+	default:
+		throw std::invalid_argument("Error encoding block: Format is not block compressed.");
+	}
+}
+
+size_t TextureCooker::LayoutMips(
+	TextureFormat a_Format,
+	uint32_t a_uWidth,
+	uint32_t a_uHeight,
+	uint32_t a_uMipCount,
+	std::vector<CookedMip>& a_lMips)
+{
+	bool bCompressed = a_Format != TextureFormat::RGBA8;
+	uint32_t uBlockBytes = GetBlockBytes(a_Format);
+	size_t uOffset = 0;
+
+	a_lMips.resize(a_uMipCount);
+	for (uint32_t i = 0; i < a_uMipCount; i++)
+	{
+		CookedMip& mip = a_lMips[i];
+		mip.Width = std::max(1u, a_uWidth >> i);
+		mip.Height = std::max(1u, a_uHeight >> i);
+
+		uint32_t uColumns = bCompressed ? std::max(1u, (mip.Width + 3) / 4) : mip.Width;
+		uint32_t uRows = bCompressed ? std::max(1u, (mip.Height + 3) / 4) : mip.Height;
+		mip.RowPitch = uColumns * uBlockBytes;
+		mip.Offset = uOffset;
+		mip.Size = (size_t)mip.RowPitch * uRows;
+		uOffset += mip.Size;
+	}
+	return uOffset;
+}
+
+bool TextureCooker::HashSource(const std::string& a_sSourceFile, uint64_t& a_uHash, uint64_t& a_uSize)
+{
+	MappedFile source(a_sSourceFile);
+	if (!source.IsOpen())
+	{
+		return false;
+	}
+
+	a_uHash = source.HashContents();
+	a_uSize = source.GetSize();
+	return true;
+}
+
+bool TextureCooker::IsSourceUnchanged(const std::string& a_sSourceFile, uint64_t a_uHash, uint64_t a_uSize, uint64_t a_uWriteTime)
+{
+	uint64_t uSize = 0;
+	uint64_t uWriteTime = 0;
+	if (!MappedFile::GetFileStamp(a_sSourceFile, uSize, uWriteTime) || uSize != a_uSize)
+	{
+		return false;
+	}
+
+	// Same as the mesh cache, the whole source is only hashed when it was touched since cooking.
+	if (uWriteTime == a_uWriteTime)
+	{
+		return true;
+	}
+
+	uint64_t uHash = 0;
+	return HashSource(a_sSourceFile, uHash, uSize) && uHash == a_uHash && uSize == a_uSize;
+}
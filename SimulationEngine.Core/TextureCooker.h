@@ -0,0 +1,179 @@
+#ifndef __TEXTURECOOKER_H_
+#define __TEXTURECOOKER_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "ImageData.h"
+#include "MappedFile.h"
+
+// Cooked textures are written next to their source file with this ending.
+#define TEXTURE_CACHE_EXTENSION ".dds"
+
+// "DXTC" in little endian, stored in the reserved part of the DDS header.
+#define TEXTURE_CACHE_MAGIC 0x43545844
+// Bump whenever the cooked layout or the cooking pipeline changes.
+#define TEXTURE_CACHE_VERSION 2
+
+/// <summary>
+/// What a texture is used for.  Decides how its mips are filtered and which block format it is stored in.
+/// </summary>
+enum class TextureUsage : uint32_t
+{
+	Albedo,
+	Normal,
+	Roughness,
+	Metal
+};
+
+/// <summary>
+/// The filter used to shrink each mip level into the next one.
+/// </summary>
+enum class MipFilter : uint32_t
+{
+	Box,
+	Kaiser
+};
+
+/// <summary>
+/// Formats a texture can be cooked into.  The values match DXGI_FORMAT so that
+/// they can be handed straight to the device without this header including it.
+/// </summary>
+enum class TextureFormat : uint32_t
+{
+	RGBA8 = 28,
+	BC1 = 71,
+	BC3 = 77,
+	BC4 = 80,
+	BC5 = 83,
+	BC7 = 98
+};
+
+/// <summary>
+/// Settings that change the produced texture.  Different settings are cached separately.
+/// </summary>
+struct TextureCookOptions
+{
+	TextureUsage Usage = TextureUsage::Albedo;
+	MipFilter Filter = MipFilter::Kaiser;
+	// Stores color in BC1/BC3 instead of BC7, halving opaque textures again at some quality cost.
+	bool Fast = false;
+};
+
+/// <summary>
+/// Where a single mip level lives inside of a CookedTexture's data.
+/// </summary>
+struct CookedMip
+{
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t RowPitch;
+	size_t Offset;
+	size_t Size;
+};
+
+/// <summary>
+/// A fully mipped and block compressed texture, ready to be uploaded as is.
+/// The data is either owned or points into a memory-mapped cache file.
+/// </summary>
+struct CookedTexture
+{
+	TextureFormat Format = TextureFormat::RGBA8;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	std::vector<CookedMip> Mips;
+
+	// Filled in when the texture was cooked in memory.
+	std::vector<unsigned char> Data;
+	// Filled in when the texture was loaded from a cache file.
+	std::shared_ptr<MappedFile> Mapping;
+	const unsigned char* MappedData = nullptr;
+
+	/// <summary>
+	/// Gets the first byte of a mip level.
+	/// </summary>
+	const unsigned char* GetMipData(size_t a_uMip) const
+	{
+		const unsigned char* pData = Mapping != nullptr ? MappedData : Data.data();
+		return pData + Mips[a_uMip].Offset;
+	}
+};
+
+/// <summary>
+/// Turns decoded images into mipped, block compressed textures on the CPU and caches the
+/// result on disk.  Nothing in here touches the device, so it can run on the workers.
+/// </summary>
+class TextureCooker
+{
+public:
+	/// <summary>
+	/// Picks the block format for an image: BC7 (or BC1/BC3 when fast) for albedo,
+	/// BC5 for normals and BC4 for single channel roughness and metal maps.
+	/// Images whose size is not a multiple of 4 stay uncompressed.
+	/// </summary>
+	static TextureFormat ChooseFormat(const ImageData& a_Image, const TextureCookOptions& a_Options);
+
+	/// <summary>
+	/// Builds the full mip chain of an image, down to 1x1.  Albedo is filtered in linear
+	/// space and normals are renormalized at every level.  The first entry is the image itself.
+	/// </summary>
+	static void GenerateMips(
+		const ImageData& a_Image,
+		const TextureCookOptions& a_Options,
+		std::vector<ImageData>& a_lMips);
+
+	/// <summary>
+	/// Generates the mips of an image and compresses every level.
+	/// </summary>
+	/// <returns>Whether or not there was anything to cook.</returns>
+	static bool Cook(const ImageData& a_Image, const TextureCookOptions& a_Options, CookedTexture& a_Result);
+
+	/// <summary>
+	/// Maps the cooked texture belonging to the passed in source file.  Returns false if the cache
+	/// does not exist, is corrupt, was cooked with different options or from a different source.
+	/// </summary>
+	static bool LoadCache(const std::string& a_sSourceFile, const TextureCookOptions& a_Options, CookedTexture& a_Result);
+
+	/// <summary>
+	/// Writes a cooked texture out as a DDS file next to its source file.
+	/// </summary>
+	static bool WriteCache(const std::string& a_sSourceFile, const TextureCookOptions& a_Options, const CookedTexture& a_Texture);
+
+	/// <summary>
+	/// Packs the options into a single value, used to tell apart textures cooked with different settings.
+	/// </summary>
+	static uint32_t PackOptions(const TextureCookOptions& a_Options);
+
+	/// <summary>
+	/// Gets the amount of bytes one 4x4 block takes up, or one pixel for uncompressed formats.
+	/// </summary>
+	static uint32_t GetBlockBytes(TextureFormat a_Format);
+
+	/// <summary>
+	/// Encodes one block of 4x4 RGBA pixels.  Only block compressed formats are accepted.
+	/// </summary>
+	/// <param name="a_pPixels">16 RGBA pixels, row by row.</param>
+	/// <param name="a_pOut">Receives GetBlockBytes(a_Format) bytes.</param>
+	static void EncodeBlock(TextureFormat a_Format, const unsigned char* a_pPixels, unsigned char* a_pOut);
+
+private:
+	/// <summary>
+	/// Works out the size and position of every mip level of a texture.
+	/// </summary>
+	/// <returns>The total amount of bytes needed.</returns>
+	static size_t LayoutMips(TextureFormat a_Format, uint32_t a_uWidth, uint32_t a_uHeight, uint32_t a_uMipCount, std::vector<CookedMip>& a_lMips);
+
+	/// <summary>
+	/// Hashes the source file the cache is validated against.
+	/// </summary>
+	static bool HashSource(const std::string& a_sSourceFile, uint64_t& a_uHash, uint64_t& a_uSize);
+
+	/// <summary>
+	/// Checks the source file against the size, write time and hash it was cooked from.
+	/// </summary>
+	static bool IsSourceUnchanged(const std::string& a_sSourceFile, uint64_t a_uHash, uint64_t a_uSize, uint64_t a_uWriteTime);
+};
+
+#endif //__TEXTURECOOKER_H_
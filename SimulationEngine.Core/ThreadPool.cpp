@@ -0,0 +1,222 @@
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <algorithm>
+
+std::atomic<ThreadPool*> ThreadPool::m_pInstance{ nullptr };
+std::mutex ThreadPool::m_InstanceMutex;
+bool ThreadPool::m_bReleased = false;
+
+namespace
+{
+	/// <summary>
+	/// Book keeping shared between the caller of ParallelFor and its helpers.
+	/// </summary>
+	struct ParallelForState
+	{
+		std::function<void(unsigned int, unsigned int)> Function;
+		unsigned int Count = 0;
+		unsigned int BatchSize = 0;
+		unsigned int BatchCount = 0;
+		std::atomic<unsigned int> NextBatch{ 0 };
+		std::atomic<unsigned int> FinishedBatches{ 0 };
+		std::mutex Mutex;
+		std::condition_variable Finished;
+		// The first exception thrown by a batch, handed to the caller once every batch is done.
+		std::exception_ptr Error = nullptr;
+
+		/// <summary>
+		/// Claims and runs batches until there are none left.
+		/// </summary>
+		void RunBatches(void)
+		{
+			unsigned int uBatch;
+			while ((uBatch = NextBatch.fetch_add(1)) < BatchCount)
+			{
+				unsigned int uBegin = uBatch * BatchSize;
+				unsigned int uEnd = std::min(uBegin + BatchSize, Count);
+				try
+				{
+					Function(uBegin, uEnd);
+				}
+				catch (...)
+				{
+					// Failed batches still count as finished, or the caller would wait forever.
+					std::lock_guard<std::mutex> lock(Mutex);
+					if (Error == nullptr)
+					{
+						Error = std::current_exception();
+					}
+				}
+
+				if (FinishedBatches.fetch_add(1) + 1 == BatchCount)
+				{
+					std::lock_guard<std::mutex> lock(Mutex);
+					Finished.notify_all();
+				}
+			}
+		}
+	};
+}
+
+ThreadPool* ThreadPool::GetInstance(void)
+{
+	// Only taking the lock while the pool may still have to be created.
+	ThreadPool* pInstance = m_pInstance.load(std::memory_order_acquire);
+	if (pInstance == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(m_InstanceMutex);
+		pInstance = m_pInstance.load(std::memory_order_relaxed);
+		if (pInstance == nullptr && !m_bReleased)
+		{
+			pInstance = new ThreadPool();
+			m_pInstance.store(pInstance, std::memory_order_release);
+		}
+	}
+
+	return pInstance;
+}
+
+void ThreadPool::Release(void)
+{
+	ThreadPool* pInstance;
+	{
+		std::lock_guard<std::mutex> lock(m_InstanceMutex);
+		m_bReleased = true;
+		pInstance = m_pInstance.load(std::memory_order_relaxed);
+	}
+
+	if (pInstance == nullptr)
+	{
+		return;
+	}
+
+	// The pool stays published while the workers drain the queue, since those tasks commonly use it
+	// themselves.  Joining without holding the lock means none of them can block on it either.
+	pInstance->Stop();
+
+	m_pInstance.store(nullptr, std::memory_order_release);
+	delete pInstance;
+}
+
+ThreadPool::ThreadPool(void)
+{
+	// Leaving a hardware thread free for the main thread.
+	unsigned int uThreads = std::thread::hardware_concurrency();
+	unsigned int uWorkers = uThreads > 1 ? uThreads - 1 : 1;
+
+	for (unsigned int i = 0; i < uWorkers; i++)
+	{
+		m_lWorkers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool(void)
+{
+	Stop();
+}
+
+void ThreadPool::Stop(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_bStopping = true;
+	}
+	m_Condition.notify_all();
+
+	for (std::thread& worker : m_lWorkers)
+	{
+		if (worker.joinable())
+		{
+			worker.join();
+		}
+	}
+}
+
+unsigned int ThreadPool::GetWorkerCount(void) const
+{
+	return (unsigned int)m_lWorkers.size();
+}
+
+void ThreadPool::ParallelFor(
+	unsigned int a_uCount,
+	unsigned int a_uMinBatchSize,
+	const std::function<void(unsigned int, unsigned int)>& a_Function)
+{
+	if (a_uCount == 0)
+	{
+		return;
+	}
+
+	// Aiming for a few batches per thread so uneven batches balance out.
+	unsigned int uThreads = GetWorkerCount() + 1;
+	unsigned int uBatchSize = std::max(a_uMinBatchSize, (a_uCount + uThreads * 4 - 1) / (uThreads * 4));
+	uBatchSize = std::max(uBatchSize, 1u);
+	unsigned int uBatchCount = (a_uCount + uBatchSize - 1) / uBatchSize;
+
+	// Small ranges are not worth waking up workers for.
+	if (uBatchCount == 1)
+	{
+		a_Function(0, a_uCount);
+		return;
+	}
+
+	std::shared_ptr<ParallelForState> pState = std::make_shared<ParallelForState>();
+	pState->Function = a_Function;
+	pState->Count = a_uCount;
+	pState->BatchSize = uBatchSize;
+	pState->BatchCount = uBatchCount;
+
+	// Helpers that start after every batch is claimed simply return.
+	unsigned int uHelpers = std::min(GetWorkerCount(), uBatchCount - 1);
+	for (unsigned int i = 0; i < uHelpers; i++)
+	{
+		Enqueue([pState]() { pState->RunBatches(); });
+	}
+
+	// The caller works too, which means that nested calls can never starve.
+	pState->RunBatches();
+
+	std::unique_lock<std::mutex> lock(pState->Mutex);
+	pState->Finished.wait(lock, [&pState]()
+		{
+			return pState->FinishedBatches.load() == pState->BatchCount;
+		});
+
+	if (pState->Error != nullptr)
+	{
+		std::rethrow_exception(pState->Error);
+	}
+}
+
+void ThreadPool::Enqueue(std::function<void()> a_Task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_lTasks.push(std::move(a_Task));
+	}
+	m_Condition.notify_one();
+}
+
+void ThreadPool::WorkerLoop(void)
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Condition.wait(lock, [this]() { return m_bStopping || !m_lTasks.empty(); });
+
+			// Finishing off queued work before shutting down.
+			if (m_bStopping && m_lTasks.empty())
+			{
+				return;
+			}
+
+			task = std::move(m_lTasks.front());
+			m_lTasks.pop();
+		}
+
+		task();
+	}
+}
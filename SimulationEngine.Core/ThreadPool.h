@@ -0,0 +1,113 @@
+#ifndef __THREADPOOL_H_
+#define __THREADPOOL_H_
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <atomic>
+
+/// <summary>
+/// A fixed set of worker threads that the engine hands CPU heavy work off to.
+/// </summary>
+class ThreadPool
+{
+private:
+	// Workers and loaders ask for the pool too, so creating it is guarded.
+	static std::atomic<ThreadPool*> m_pInstance;
+	static std::mutex m_InstanceMutex;
+	// Set once Release starts, so that nothing creates a new pool while the old one is torn down.
+	static bool m_bReleased;
+
+	std::vector<std::thread> m_lWorkers;
+	std::queue<std::function<void()>> m_lTasks;
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	bool m_bStopping = false;
+
+public:
+	/// <summary>
+	/// Gets the single instance of the ThreadPool, creating it on first use.  Safe to call from any thread.
+	/// Returns nullptr once Release has freed the pool.
+	/// </summary>
+	static ThreadPool* GetInstance(void);
+
+	/// <summary>
+	/// Finishes the queued work, joins the worker threads and frees the ThreadPool singleton.
+	/// Queued tasks can still use the pool while they finish.  Only called on shutdown.
+	/// </summary>
+	static void Release(void);
+
+	/// <summary>
+	/// Gets the amount of worker threads in the pool.
+	/// </summary>
+	unsigned int GetWorkerCount(void) const;
+
+	/// <summary>
+	/// Queues a function to run on a worker thread.
+	/// </summary>
+	/// <returns>A future holding the result of the function.</returns>
+	template <typename F>
+	auto Submit(F a_Function) -> std::future<decltype(a_Function())>
+	{
+		typedef decltype(a_Function()) Result;
+
+		// Packaged tasks are move-only so they are shared into the std::function.
+		std::shared_ptr<std::packaged_task<Result()>> pTask =
+			std::make_shared<std::packaged_task<Result()>>(std::move(a_Function));
+		std::future<Result> result = pTask->get_future();
+
+		Enqueue([pTask]() { (*pTask)(); });
+		return result;
+	}
+
+	/// <summary>
+	/// Splits the range [0, a_uCount) into batches and runs them across the workers.
+	/// The calling thread helps out and the call returns once every batch is done,
+	/// so it is safe to call from inside of another task.  If batches throw, the
+	/// first exception is rethrown to the caller after every batch has finished.
+	/// </summary>
+	/// <param name="a_uCount">The size of the range.</param>
+	/// <param name="a_uMinBatchSize">The smallest amount of items worth handing to a thread.</param>
+	/// <param name="a_Function">Called with the [begin, end) range of every batch.</param>
+	void ParallelFor(
+		unsigned int a_uCount,
+		unsigned int a_uMinBatchSize,
+		const std::function<void(unsigned int, unsigned int)>& a_Function);
+
+private:
+	/// <summary>
+	/// Spins up one worker per hardware thread, minus the main thread.
+	/// </summary>
+	ThreadPool(void);
+
+	/// <summary>
+	/// Stops and joins all of the workers.
+	/// </summary>
+	~ThreadPool(void);
+
+	/// <summary>
+	/// Lets the workers finish every queued task and joins them.  Does nothing the second time.
+	/// </summary>
+	void Stop(void);
+
+	// Removing the copy constructor and operator.
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/// <summary>
+	/// Pushes a task onto the queue and wakes up a worker.
+	/// </summary>
+	void Enqueue(std::function<void()> a_Task);
+
+	/// <summary>
+	/// The loop every worker thread runs.
+	/// </summary>
+	void WorkerLoop(void);
+};
+
+#endif //__THREADPOOL_H_
@@ -2,270 +2,247 @@
 
 using namespace DirectX;
 
-Transform::Transform() :
-    m_v3Position(0.0f, 0.0f, 0.0f),
-    m_v3Rotation(0.0f, 0.0f, 0.0f),
-    m_v3Scale(1.0f, 1.0f, 1.0f),
-    m_bIsDirty(false)
+Transform::Transform()
 {
-    XMStoreFloat4x4(&m_m4WorldMatrix, XMMatrixIdentity());
-    XMStoreFloat4x4(&m_m4WorldInverseTranspose, XMMatrixIdentity());
+    m_Slot = TransformPool::GetInstance()->Allocate();
+}
+
+Transform::Transform(const Transform& a_Other)
+{
+    m_Slot = TransformPool::GetInstance()->Allocate();
+    *this = a_Other;
+}
+
+Transform& Transform::operator=(const Transform& a_Other)
+{
+    TransformBlock* pBlock = m_Slot.Block;
+    const TransformBlock* pOther = a_Other.m_Slot.Block;
+
+    pBlock->Positions[m_Slot.Index] = pOther->Positions[a_Other.m_Slot.Index];
+    pBlock->Orientations[m_Slot.Index] = pOther->Orientations[a_Other.m_Slot.Index];
+    pBlock->Rotations[m_Slot.Index] = pOther->Rotations[a_Other.m_Slot.Index];
+    pBlock->Scales[m_Slot.Index] = pOther->Scales[a_Other.m_Slot.Index];
+    pBlock->Rights[m_Slot.Index] = pOther->Rights[a_Other.m_Slot.Index];
+    pBlock->Ups[m_Slot.Index] = pOther->Ups[a_Other.m_Slot.Index];
+    pBlock->Forwards[m_Slot.Index] = pOther->Forwards[a_Other.m_Slot.Index];
+
+    // If the other's euler angles were edited its orientation is stale, so this one's has to be rebuilt too.
+    MarkDirty(TransformPool::IsEulerDirty(a_Other.m_Slot));
+    return *this;
+}
+
+Transform::~Transform()
+{
+    TransformPool::Free(m_Slot);
 }
 
 void Transform::SetPosition(float a_fX, float a_fY, float a_fZ)
 {
-    m_v3Position.x = a_fX;
-    m_v3Position.y = a_fY;
-    m_v3Position.z = a_fZ;
+    m_Slot.Block->Positions[m_Slot.Index].x = a_fX;
+    m_Slot.Block->Positions[m_Slot.Index].y = a_fY;
+    m_Slot.Block->Positions[m_Slot.Index].z = a_fZ;
 
-    m_bIsDirty = true;
+    MarkDirty();
 }
 void Transform::SetPosition(Vector3 a_v3Position)
 {
-    m_v3Position.x = a_v3Position.x;
-    m_v3Position.y = a_v3Position.y;
-    m_v3Position.z = a_v3Position.z;
+    m_Slot.Block->Positions[m_Slot.Index].x = a_v3Position.x;
+    m_Slot.Block->Positions[m_Slot.Index].y = a_v3Position.y;
+    m_Slot.Block->Positions[m_Slot.Index].z = a_v3Position.z;
 
-    m_bIsDirty = true;
+    MarkDirty();
 }
 void Transform::SetRotation(float a_fP, float a_fY, float a_fR)
 {
-    m_v3Rotation.x = a_fP;
-    m_v3Rotation.y = a_fY;
-    m_v3Rotation.z = a_fR;
+    m_Slot.Block->Rotations[m_Slot.Index].x = a_fP;
+    m_Slot.Block->Rotations[m_Slot.Index].y = a_fY;
+    m_Slot.Block->Rotations[m_Slot.Index].z = a_fR;
 
-    m_bIsDirty = true;
+    MarkDirty(true);
 }
 void Transform::SetRotation(Vector3 a_v3Rotation)
 {
-    m_v3Rotation.x = a_v3Rotation.x;
-    m_v3Rotation.y = a_v3Rotation.y;
-    m_v3Rotation.z = a_v3Rotation.z;
+    m_Slot.Block->Rotations[m_Slot.Index].x = a_v3Rotation.x;
+    m_Slot.Block->Rotations[m_Slot.Index].y = a_v3Rotation.y;
+    m_Slot.Block->Rotations[m_Slot.Index].z = a_v3Rotation.z;
 
-    m_bIsDirty = true;
+    MarkDirty(true);
 }
 void Transform::SetScale(float a_fX, float a_fY, float a_fZ)
 {
-    m_v3Scale.x = a_fX;
-    m_v3Scale.y = a_fY;
-    m_v3Scale.z = a_fZ;
+    m_Slot.Block->Scales[m_Slot.Index].x = a_fX;
+    m_Slot.Block->Scales[m_Slot.Index].y = a_fY;
+    m_Slot.Block->Scales[m_Slot.Index].z = a_fZ;
 
-    m_bIsDirty = true;
+    MarkDirty();
 }
 void Transform::SetScale(Vector3 a_v3Scale)
 {
-    m_v3Scale.x = a_v3Scale.x;
-    m_v3Scale.y = a_v3Scale.y;
-    m_v3Scale.z = a_v3Scale.z;
+    m_Slot.Block->Scales[m_Slot.Index].x = a_v3Scale.x;
+    m_Slot.Block->Scales[m_Slot.Index].y = a_v3Scale.y;
+    m_Slot.Block->Scales[m_Slot.Index].z = a_v3Scale.z;
 
-    m_bIsDirty = true;
+    MarkDirty();
 }
 
 void Transform::MoveAbsolute(float a_fX, float a_fY, float a_fZ)
 {
     // Using the super optimized math functions to move the position.
     XMStoreFloat3(
-        &m_v3Position,
-        XMLoadFloat3(&m_v3Position) + XMVectorSet(a_fX, a_fY, a_fZ, 0.0f)
+        &m_Slot.Block->Positions[m_Slot.Index],
+        XMLoadFloat3(&m_Slot.Block->Positions[m_Slot.Index]) + XMVectorSet(a_fX, a_fY, a_fZ, 0.0f)
     );
 
-    m_bIsDirty = true;
+    MarkDirty();
 }
 void Transform::MoveAbsolute(Vector3 a_v3Offset)
 {
     // Using the super optimized math functions to move the position.
     XMStoreFloat3(
-        &m_v3Position,
-        XMLoadFloat3(&m_v3Position) + XMVectorSet(a_v3Offset.x, a_v3Offset.y, a_v3Offset.z, 0.0f)
+        &m_Slot.Block->Positions[m_Slot.Index],
+        XMLoadFloat3(&m_Slot.Block->Positions[m_Slot.Index]) + XMVectorSet(a_v3Offset.x, a_v3Offset.y, a_v3Offset.z, 0.0f)
     );
 
-    m_bIsDirty = true;
+    MarkDirty();
 }
 void Transform::MoveRelative(float a_fX, float a_fY, float a_fZ)
 {
-    // Creating the offset and quaternion vectors.
-    Vector3 v3 = Vector3(a_fX, a_fY, a_fZ);
-    XMVECTOR vOffset = XMLoadFloat3(&v3);
-    XMVECTOR vQuat = XMQuaternionRotationRollPitchYaw(
-        m_v3Rotation.x,     // Roll
-        m_v3Rotation.y,     // Pitch
-        m_v3Rotation.z);    // Yaw
-
-    // Getting the resulting vector that we will actually move by.
-    XMVECTOR vResult = XMVector3Rotate(vOffset, vQuat);
+    // Moving along the cached axes, they only need rebuilding if the rotation was edited.
+    TransformPool::ResolveOrientation(m_Slot);
+    XMVECTOR vResult =
+        XMLoadFloat3(&m_Slot.Block->Rights[m_Slot.Index]) * XMVectorReplicate(a_fX) +
+        XMLoadFloat3(&m_Slot.Block->Ups[m_Slot.Index]) * XMVectorReplicate(a_fY) +
+        XMLoadFloat3(&m_Slot.Block->Forwards[m_Slot.Index]) * XMVectorReplicate(a_fZ);
 
     // Adding that to the position and saving the result as the new position.
     XMStoreFloat3(
-        &m_v3Position,
-        XMLoadFloat3(&m_v3Position) + vResult
+        &m_Slot.Block->Positions[m_Slot.Index],
+        XMLoadFloat3(&m_Slot.Block->Positions[m_Slot.Index]) + vResult
     );
+
+    MarkDirty();
 }
 void Transform::MoveRelative(Vector3 a_v3Offset)
 {
-    // Creating the offset and quaternion vectors.
-    XMVECTOR vOffset = XMLoadFloat3(&a_v3Offset);
-    XMVECTOR vQuat = XMQuaternionRotationRollPitchYaw(
-        m_v3Rotation.x,     // Roll
-        m_v3Rotation.y,     // Pitch
-        m_v3Rotation.z);    // Yaw
-
-    // Getting the resulting vector that we will actually move by.
-    XMVECTOR vResult = XMVector3Rotate(vOffset, vQuat);
+    // Moving along the cached axes, they only need rebuilding if the rotation was edited.
+    TransformPool::ResolveOrientation(m_Slot);
+    XMVECTOR vResult =
+        XMLoadFloat3(&m_Slot.Block->Rights[m_Slot.Index]) * XMVectorReplicate(a_v3Offset.x) +
+        XMLoadFloat3(&m_Slot.Block->Ups[m_Slot.Index]) * XMVectorReplicate(a_v3Offset.y) +
+        XMLoadFloat3(&m_Slot.Block->Forwards[m_Slot.Index]) * XMVectorReplicate(a_v3Offset.z);
 
     // Adding that to the position and saving the result as the new position.
     XMStoreFloat3(
-        &m_v3Position,
-        XMLoadFloat3(&m_v3Position) + vResult
+        &m_Slot.Block->Positions[m_Slot.Index],
+        XMLoadFloat3(&m_Slot.Block->Positions[m_Slot.Index]) + vResult
     );
+
+    MarkDirty();
 }
 void Transform::Rotate(float a_fP, float a_fY, float a_fR)
 {
     XMStoreFloat3(
-        &m_v3Rotation,
-        XMLoadFloat3(&m_v3Rotation) + XMVectorSet(a_fP, a_fY, a_fR, 1.0f)
+        &m_Slot.Block->Rotations[m_Slot.Index],
+        XMLoadFloat3(&m_Slot.Block->Rotations[m_Slot.Index]) + XMVectorSet(a_fP, a_fY, a_fR, 1.0f)
     );
 
-    m_bIsDirty = true;
+    MarkDirty(true);
 }
 void Transform::Rotate(Vector3 a_v3Rotation)
 {
     XMStoreFloat3(
-        &m_v3Rotation,
-        XMLoadFloat3(&m_v3Rotation) + XMVectorSet(a_v3Rotation.x, a_v3Rotation.y, a_v3Rotation.z, 1.0f)
+        &m_Slot.Block->Rotations[m_Slot.Index],
+        XMLoadFloat3(&m_Slot.Block->Rotations[m_Slot.Index]) + XMVectorSet(a_v3Rotation.x, a_v3Rotation.y, a_v3Rotation.z, 1.0f)
     );
 
-    m_bIsDirty = true;
+    MarkDirty(true);
 }
 void Transform::Scale(float a_fX, float a_fY, float a_fZ)
 {
     XMStoreFloat3(
-        &m_v3Scale,
-        XMLoadFloat3(&m_v3Scale) * XMVectorSet(a_fX, a_fY, a_fY, 1.0f)
+        &m_Slot.Block->Scales[m_Slot.Index],
+        XMLoadFloat3(&m_Slot.Block->Scales[m_Slot.Index]) * XMVectorSet(a_fX, a_fY, a_fY, 1.0f)
     );
 
-    m_bIsDirty = true;
+    MarkDirty();
 }
 void Transform::Scale(Vector3 a_v3Scale)
 {
     XMStoreFloat3(
-        &m_v3Scale,
-        XMLoadFloat3(&m_v3Scale) * XMVectorSet(a_v3Scale.x, a_v3Scale.y, a_v3Scale.z, 1.0f)
+        &m_Slot.Block->Scales[m_Slot.Index],
+        XMLoadFloat3(&m_Slot.Block->Scales[m_Slot.Index]) * XMVectorSet(a_v3Scale.x, a_v3Scale.y, a_v3Scale.z, 1.0f)
     );
 
-    m_bIsDirty = true;
+    MarkDirty();
 }
 
-Vector3& Transform::GetPosition()
+const Vector3& Transform::GetPosition() const
 {
-    // Assume that when returning the position that the data will be altered.
-    m_bIsDirty = true;
-    return m_v3Position;
+    return m_Slot.Block->Positions[m_Slot.Index];
 }
-Vector3& Transform::GetRotation()
+const Vector3& Transform::GetRotation() const
 {
-    // Assume that when returning the rotation that the data will be altered.
-    m_bIsDirty = true;
-    return m_v3Rotation;
+    return m_Slot.Block->Rotations[m_Slot.Index];
 }
-Vector3& Transform::GetScale()
+const Vector3& Transform::GetScale() const
 {
-    // Assume that when returning the scale that the data will be altered.
-    m_bIsDirty = true;
-    return m_v3Scale;
+    return m_Slot.Block->Scales[m_Slot.Index];
 }
 
-Vector3 Transform::GetUp()
+Vector3 Transform::GetUp() const
 {
-    // Temporarily use this result vector for the direction
-    Vector3 v3Result = Vector3(0.0f, 1.0f, 0.0f);
-
-    // Creating the offset and quaternion vectors.
-    XMVECTOR vWorldUp = XMLoadFloat3(&v3Result);
-    XMVECTOR vOrientation = XMQuaternionRotationRollPitchYaw(
-        m_v3Rotation.x,     // Roll
-        m_v3Rotation.y,     // Pitch
-        m_v3Rotation.z);    // Yaw
-
-    XMStoreFloat3(
-        &v3Result,
-        XMVector3Rotate(vWorldUp, vOrientation)
-    );
-
-    return v3Result;
+    // The axes are cached with the orientation, so this is just a load.
+    TransformPool::ResolveOrientation(m_Slot);
+    return m_Slot.Block->Ups[m_Slot.Index];
 }
-Vector3 Transform::GetRight()
+Vector3 Transform::GetRight() const
 {
-    // Temporarily use this result vector for the direction
-    Vector3 v3Result = Vector3(1.0f, 0.0f, 0.0f);
-
-    // Creating the offset and quaternion vectors.
-    XMVECTOR vWorldUp = XMLoadFloat3(&v3Result);
-    XMVECTOR vOrientation = XMQuaternionRotationRollPitchYaw(
-        m_v3Rotation.x,     // Roll
-        m_v3Rotation.y,     // Pitch
-        m_v3Rotation.z);    // Yaw
-
-    XMStoreFloat3(
-        &v3Result,
-        XMVector3Rotate(vWorldUp, vOrientation)
-    );
-
-    return v3Result;
+    TransformPool::ResolveOrientation(m_Slot);
+    return m_Slot.Block->Rights[m_Slot.Index];
 }
-Vector3 Transform::GetForward()
+Vector3 Transform::GetForward() const
 {
-    // Temporarily use this result vector for the direction
-    Vector3 v3Result = Vector3(0.0f, 0.0f, 1.0f);
-
-    // Creating the offset and quaternion vectors.
-    XMVECTOR vWorldUp = XMLoadFloat3(&v3Result);
-    XMVECTOR vOrientation = XMQuaternionRotationRollPitchYaw(
-        m_v3Rotation.x,     // Roll
-        m_v3Rotation.y,     // Pitch
-        m_v3Rotation.z);    // Yaw
-
-    XMStoreFloat3(
-        &v3Result,
-        XMVector3Rotate(vWorldUp, vOrientation)
-    );
-
-    return v3Result;
+    TransformPool::ResolveOrientation(m_Slot);
+    return m_Slot.Block->Forwards[m_Slot.Index];
 }
 
-Matrix4 Transform::GetWorld()
+void Transform::SetOrientation(Vector4 a_v4Orientation)
 {
-    if (!m_bIsDirty) return m_m4WorldMatrix;
-
-    CalculateMatrices();
-
-    // Returning the resulting value.
-    return m_m4WorldMatrix;
+    TransformPool::SetOrientation(m_Slot, a_v4Orientation);
 }
-Matrix4 Transform::GetWorldInvTra()
+Vector4 Transform::GetOrientation() const
 {
-    if (!m_bIsDirty) return m_m4WorldInverseTranspose;
-
-    CalculateMatrices();
-
-    // Returning the resulting value.
-    return m_m4WorldInverseTranspose;
+    TransformPool::ResolveOrientation(m_Slot);
+    return m_Slot.Block->Orientations[m_Slot.Index];
 }
 
-void Transform::CalculateMatrices(void)
+Matrix4 Transform::GetWorld() const
 {
-    m_bIsDirty = false;
+    // Usually already done by the pool's update, only recalculated here when changed since.
+    TransformPool::Resolve(m_Slot);
+    return m_Slot.Block->Worlds[m_Slot.Index];
+}
+Matrix4 Transform::GetWorldInvTra() const
+{
+    TransformPool::Resolve(m_Slot);
+    return m_Slot.Block->WorldInvTras[m_Slot.Index];
+}
 
-    // Calculating matrices based on the rotation/scale/translation vectors.
-    XMMatrix trMatrix = XMMatrixTranslation(m_v3Position.x, m_v3Position.y, m_v3Position.z);
-    XMMatrix roMatrix = XMMatrixRotationRollPitchYaw(m_v3Rotation.x, m_v3Rotation.y, m_v3Rotation.z);
-    XMMatrix scMatrix = XMMatrixScaling(m_v3Scale.x, m_v3Scale.y, m_v3Scale.z);
+uint32_t Transform::GetGeneration() const
+{
+    return TransformPool::GetGeneration(m_Slot);
+}
 
-    // Calculating the world matrix.
-    XMMatrix world = scMatrix * roMatrix * trMatrix;
+void Transform::SetParent(const Transform* a_pParent)
+{
+    TransformPool::GetInstance()->SetParent(m_Slot, a_pParent != nullptr ? &a_pParent->m_Slot : nullptr);
+}
+bool Transform::HasParent(void) const
+{
+    return TransformPool::HasParent(m_Slot);
+}
 
-    // Storing the product of those matrices in the world matrix.
-    XMStoreFloat4x4(&m_m4WorldMatrix, world);
-    XMStoreFloat4x4(&m_m4WorldInverseTranspose,
-        XMMatrixInverse(0, XMMatrixTranspose(world))
-    );
+void Transform::MarkDirty(bool a_bEulerChanged)
+{
+    TransformPool::MarkDirty(m_Slot, a_bEulerChanged);
 }
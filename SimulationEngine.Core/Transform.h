@@ -2,21 +2,16 @@
 #define __TRANSFORM_H_
 
 #include "Vectors.h"
+#include "TransformPool.h"
 
 /// <summary>
 /// Calculates movement and orientation for objects in the simulation.
+/// A thin view into the TransformPool, which owns the actual data.
 /// </summary>
 class Transform
 {
 private:
-	Matrix4 m_m4WorldMatrix;
-	Matrix4 m_m4WorldInverseTranspose;
-
-	Vector3 m_v3Position;
-	Vector3 m_v3Scale;
-	Vector3 m_v3Rotation;
-
-	bool m_bIsDirty;
+	TransformSlot m_Slot;
 
 public:
 	/// <summary>
@@ -24,6 +19,21 @@ public:
 	/// </summary>
 	Transform();
 
+	/// <summary>
+	/// Copies the passed in Transform into a slot of its own.
+	/// </summary>
+	Transform(const Transform& a_Other);
+
+	/// <summary>
+	/// Copies the values of the passed in Transform into this one's slot.
+	/// </summary>
+	Transform& operator=(const Transform& a_Other);
+
+	/// <summary>
+	/// Hands the slot back to the TransformPool.
+	/// </summary>
+	~Transform();
+
 	// --------------------------------------------
 	// Lots of methods without XML docs.
 	// This is because they should be relatively 
@@ -50,34 +60,59 @@ public:
 	void Scale(float a_fX, float a_fY, float a_fZ);
 
 	// Getter for the position.
-	Vector3& GetPosition(void);
+	const Vector3& GetPosition(void) const;
 
 	// Getter for the rotation.
-	Vector3& GetRotation(void);
+	const Vector3& GetRotation(void) const;
 
 	// Getter for the scale.
-	Vector3& GetScale(void);
+	const Vector3& GetScale(void) const;
 
 	// Up direction getter.
-	Vector3 GetUp(void);
+	Vector3 GetUp(void) const;
 
 	// Right direction getter.
-	Vector3 GetRight(void);
+	Vector3 GetRight(void) const;
 
 	// Forward direction getter.
-	Vector3 GetForward(void);
+	Vector3 GetForward(void) const;
+
+	/// <summary>
+	/// Sets the orientation as a quaternion.  The rotation getter is kept in sync as pitch, yaw and roll.
+	/// </summary>
+	void SetOrientation(Vector4 a_v4Orientation);
+
+	// Getter for the orientation quaternion.
+	Vector4 GetOrientation(void) const;
 
 	// Gets the world matrix.
-	Matrix4 GetWorld(void);
+	Matrix4 GetWorld(void) const;
 
 	// Gets the World InvTra matrix.
-	Matrix4 GetWorldInvTra(void);
+	Matrix4 GetWorldInvTra(void) const;
+
+	/// <summary>
+	/// Gets the change generation, which goes up every time the world matrix changes.
+	/// Compare it against a stored one to tell whether anything derived from the world matrix is stale.
+	/// </summary>
+	uint32_t GetGeneration(void) const;
+
+	/// <summary>
+	/// Attaches this Transform to a parent, making its position, rotation and scale relative to it.
+	/// Its world matrices then only update with the TransformPool's update.  Main thread only.
+	/// </summary>
+	/// <param name="a_pParent">The new parent, or nullptr to detach again.</param>
+	void SetParent(const Transform* a_pParent);
+
+	// Whether or not this Transform is attached to a parent.
+	bool HasParent(void) const;
 
 private:
 	/// <summary>
-	/// Calculates the World and World InvTra matrices.
+	/// Flags the World and World InvTra matrices for the pool's next update.
 	/// </summary>
-	void CalculateMatrices(void);
+	/// <param name="a_bEulerChanged">Whether the rotation was edited, so the orientation has to be rebuilt from it.</param>
+	void MarkDirty(bool a_bEulerChanged = false);
 };
 
 #endif //__TRANSFORM_H_
@@ -0,0 +1,606 @@
+#include "TransformPool.h"
+#include "ThreadPool.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+TransformPool* TransformPool::m_pInstance = nullptr;
+
+TransformPool* TransformPool::GetInstance(void)
+{
+	if (m_pInstance == nullptr)
+	{
+		m_pInstance = new TransformPool();
+	}
+
+	return m_pInstance;
+}
+
+void TransformPool::Release(void)
+{
+	if (m_pInstance == nullptr)
+	{
+		return;
+	}
+
+	delete m_pInstance;
+	m_pInstance = nullptr;
+}
+
+TransformPool::TransformPool(void) { }
+
+TransformPool::~TransformPool(void) { }
+
+TransformSlot TransformPool::Allocate(void)
+{
+	TransformSlot slot;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (!m_lFreeSlots.empty())
+		{
+			slot = m_lFreeSlots.back();
+			m_lFreeSlots.pop_back();
+		}
+		else
+		{
+			unsigned int uBlock = m_uNextIndex / TRANSFORM_BLOCK_SIZE;
+			if (uBlock >= TRANSFORM_MAX_BLOCKS)
+			{
+				throw std::length_error("Too many transforms: the TransformPool is full.");
+			}
+
+			// Publishing the block only once it is fully set up, Update may be reading the count.
+			if (m_lBlocks[uBlock] == nullptr)
+			{
+				m_lBlocks[uBlock].reset(new TransformBlock());
+				for (unsigned int w = 0; w < TRANSFORM_DIRTY_WORDS; w++)
+				{
+					m_lBlocks[uBlock]->Dirty[w].store(0);
+					m_lBlocks[uBlock]->EulerDirty[w].store(0);
+				}
+				m_uBlockCount.store(uBlock + 1, std::memory_order_release);
+			}
+
+			slot.Block = m_lBlocks[uBlock].get();
+			slot.Index = m_uNextIndex % TRANSFORM_BLOCK_SIZE;
+			m_uNextIndex++;
+		}
+	}
+
+	Reset(slot);
+	return slot;
+}
+
+void TransformPool::Free(const TransformSlot& a_Slot)
+{
+	if (m_pInstance == nullptr || a_Slot.Block == nullptr)
+	{
+		return;
+	}
+
+	// Freed slots are skipped by Update until they are handed out again.
+	a_Slot.Block->Dirty[a_Slot.Index / 64].fetch_and(~(1ull << (a_Slot.Index % 64)));
+	a_Slot.Block->EulerDirty[a_Slot.Index / 64].fetch_and(~(1ull << (a_Slot.Index % 64)));
+
+	// The hierarchy belongs to the main thread, so the slot is only recycled by the next update.
+	std::lock_guard<std::mutex> lock(m_pInstance->m_Mutex);
+	m_pInstance->m_lPendingFrees.push_back(a_Slot);
+}
+
+void TransformPool::Update(void)
+{
+	// Taking freed slots out of the hierarchy before they can be handed out again.
+	std::vector<TransformSlot> lFreed;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		lFreed.swap(m_lPendingFrees);
+	}
+
+	for (const TransformSlot& slot : lFreed)
+	{
+		if (slot.Block->HierarchyIndices[slot.Index] >= 0)
+		{
+			RemoveNode(slot);
+		}
+	}
+
+	if (!lFreed.empty())
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_lFreeSlots.insert(m_lFreeSlots.end(), lFreed.begin(), lFreed.end());
+	}
+
+	unsigned int uBlockCount = m_uBlockCount.load(std::memory_order_acquire);
+
+	// Every dirty word is claimed by exactly one batch, so no two threads touch the same transform.
+	ThreadPool::GetInstance()->ParallelFor(uBlockCount * TRANSFORM_DIRTY_WORDS, TRANSFORM_MIN_WORD_BATCH, [&](unsigned int a_uBegin, unsigned int a_uEnd)
+		{
+			for (unsigned int w = a_uBegin; w < a_uEnd; w++)
+			{
+				TransformBlock* pBlock = m_lBlocks[w / TRANSFORM_DIRTY_WORDS].get();
+				unsigned int uWord = w % TRANSFORM_DIRTY_WORDS;
+
+				// Clearing the bits first, so changes made while updating are picked up next frame.
+				uint64_t uBits = pBlock->Dirty[uWord].exchange(0);
+				if (uBits == 0)
+				{
+					continue;
+				}
+				uint64_t uEulerBits = pBlock->EulerDirty[uWord].exchange(0);
+
+				unsigned int lIndices[4];
+				unsigned int uCount = 0;
+				unsigned int uEulerMask = 0;
+				for (unsigned int b = 0; uBits != 0; b++, uBits >>= 1, uEulerBits >>= 1)
+				{
+					if ((uBits & 1) == 0)
+					{
+						continue;
+					}
+
+					uEulerMask |= (unsigned int)(uEulerBits & 1) << uCount;
+					lIndices[uCount++] = uWord * 64 + b;
+					if (uCount == 4)
+					{
+						CalculateBatch(pBlock, lIndices, uCount, uEulerMask);
+						uCount = 0;
+						uEulerMask = 0;
+					}
+				}
+
+				if (uCount > 0)
+				{
+					CalculateBatch(pBlock, lIndices, uCount, uEulerMask);
+				}
+			}
+		});
+
+	// Only parented transforms still need their parent's matrices applied on top.
+	UpdateHierarchy();
+}
+
+unsigned int TransformPool::GetCount(void)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_uNextIndex - (unsigned int)(m_lFreeSlots.size() + m_lPendingFrees.size());
+}
+
+void TransformPool::SetParent(const TransformSlot& a_Child, const TransformSlot* a_pParent)
+{
+	if (a_pParent != nullptr && a_pParent->Block == a_Child.Block && a_pParent->Index == a_Child.Index)
+	{
+		throw std::invalid_argument("A transform can not be its own parent.");
+	}
+
+	// Detaching something that was never attached to anything.
+	if (a_pParent == nullptr && a_Child.Block->HierarchyIndices[a_Child.Index] < 0)
+	{
+		return;
+	}
+
+	unsigned int uChild = GetNode(a_Child);
+	unsigned int uParent = a_pParent != nullptr ? GetNode(*a_pParent) : 0;
+	unsigned int uSize = m_lHierarchy[uChild].SubtreeSize;
+	if (a_pParent != nullptr && uParent >= uChild && uParent < uChild + uSize)
+	{
+		throw std::invalid_argument("A transform can not be parented to one of its own children.");
+	}
+
+	// Unhooking the subtree from its old ancestors, which all come before it.
+	for (int a = m_lHierarchy[uChild].Parent; a >= 0; a = m_lHierarchy[a].Parent)
+	{
+		m_lHierarchy[a].SubtreeSize -= uSize;
+	}
+
+	std::vector<TransformNode> lSubtree(m_lHierarchy.begin() + uChild, m_lHierarchy.begin() + uChild + uSize);
+	m_lHierarchy.erase(m_lHierarchy.begin() + uChild, m_lHierarchy.begin() + uChild + uSize);
+	lSubtree[0].ParentSlot = a_pParent != nullptr ? *a_pParent : TransformSlot();
+	lSubtree[0].WorldDirty = true;
+
+	// A lone root does not need to be in the hierarchy at all, it goes back to being a plain transform.
+	if (a_pParent == nullptr && uSize == 1)
+	{
+		a_Child.Block->HierarchyIndices[a_Child.Index] = -1;
+		IndexHierarchy();
+		MarkDirty(a_Child);
+		return;
+	}
+
+	// Children go after the parent's existing subtree, roots at the very end.
+	unsigned int uInsert = (unsigned int)m_lHierarchy.size();
+	if (a_pParent != nullptr)
+	{
+		if (uParent > uChild)
+		{
+			uParent -= uSize;
+		}
+		uInsert = uParent + m_lHierarchy[uParent].SubtreeSize;
+	}
+
+	m_lHierarchy.insert(m_lHierarchy.begin() + uInsert, lSubtree.begin(), lSubtree.end());
+	IndexHierarchy();
+	FlagAncestors(m_lHierarchy[uInsert].Parent);
+}
+
+bool TransformPool::HasParent(const TransformSlot& a_Slot)
+{
+	int nNode = a_Slot.Block->HierarchyIndices[a_Slot.Index];
+	return nNode >= 0 && m_pInstance->m_lHierarchy[nNode].Parent >= 0;
+}
+
+void TransformPool::MarkDirty(const TransformSlot& a_Slot, bool a_bEulerChanged)
+{
+	// The euler bit goes first, so an update that sees the dirty bit also sees it.
+	if (a_bEulerChanged)
+	{
+		a_Slot.Block->EulerDirty[a_Slot.Index / 64].fetch_or(1ull << (a_Slot.Index % 64));
+	}
+	a_Slot.Block->Generations[a_Slot.Index]++;
+	a_Slot.Block->Dirty[a_Slot.Index / 64].fetch_or(1ull << (a_Slot.Index % 64));
+
+	// The local matrix is still computed by the batched update, the hierarchy only needs to know to pick it up.
+	int nNode = a_Slot.Block->HierarchyIndices[a_Slot.Index];
+	if (nNode >= 0)
+	{
+		TransformNode& node = m_pInstance->m_lHierarchy[nNode];
+		node.LocalDirty = true;
+		m_pInstance->FlagAncestors(node.Parent);
+	}
+}
+
+void TransformPool::Resolve(const TransformSlot& a_Slot)
+{
+	// Parented transforms depend on their parent, so only the full update resolves them.
+	if (a_Slot.Block->HierarchyIndices[a_Slot.Index] >= 0)
+	{
+		return;
+	}
+
+	// Checking before clearing, so clean transforms never write to the shared dirty words.
+	uint64_t uMask = 1ull << (a_Slot.Index % 64);
+	std::atomic<uint64_t>& dirty = a_Slot.Block->Dirty[a_Slot.Index / 64];
+	if ((dirty.load(std::memory_order_relaxed) & uMask) == 0 || (dirty.fetch_and(~uMask) & uMask) == 0)
+	{
+		return;
+	}
+
+	bool bEulerChanged = (a_Slot.Block->EulerDirty[a_Slot.Index / 64].fetch_and(~uMask) & uMask) != 0;
+	CalculateBatch(a_Slot.Block, &a_Slot.Index, 1, bEulerChanged ? 1 : 0);
+}
+
+uint32_t TransformPool::GetGeneration(const TransformSlot& a_Slot)
+{
+	return a_Slot.Block->Generations[a_Slot.Index];
+}
+
+bool TransformPool::IsEulerDirty(const TransformSlot& a_Slot)
+{
+	return (a_Slot.Block->EulerDirty[a_Slot.Index / 64].load() & (1ull << (a_Slot.Index % 64))) != 0;
+}
+
+void TransformPool::ResolveOrientation(const TransformSlot& a_Slot)
+{
+	uint64_t uMask = 1ull << (a_Slot.Index % 64);
+	if ((a_Slot.Block->EulerDirty[a_Slot.Index / 64].fetch_and(~uMask) & uMask) == 0)
+	{
+		return;
+	}
+
+	// The matrices stay dirty, the update builds them from the quaternion stored here.
+	const Vector3& v3Euler = a_Slot.Block->Rotations[a_Slot.Index];
+	XMVector vOrientation = XMQuaternionRotationRollPitchYaw(v3Euler.x, v3Euler.y, v3Euler.z);
+	XMStoreFloat4(&a_Slot.Block->Orientations[a_Slot.Index], vOrientation);
+	StoreAxes(a_Slot, XMMatrixRotationQuaternion(vOrientation));
+}
+
+void TransformPool::SetOrientation(const TransformSlot& a_Slot, const Vector4& a_v4Orientation)
+{
+	XMVector vOrientation = XMQuaternionNormalize(XMLoadFloat4(&a_v4Orientation));
+	XMMatrix rotation = XMMatrixRotationQuaternion(vOrientation);
+	XMStoreFloat4(&a_Slot.Block->Orientations[a_Slot.Index], vOrientation);
+	StoreAxes(a_Slot, rotation);
+
+	// Matching the euler angles to the rotation, the third row is (cos(p) sin(y), -sin(p), cos(p) cos(y)).
+	Matrix4 m4Rotation;
+	XMStoreFloat4x4(&m4Rotation, rotation);
+	Vector3& v3Euler = a_Slot.Block->Rotations[a_Slot.Index];
+	float fCosP = sqrtf(m4Rotation._31 * m4Rotation._31 + m4Rotation._33 * m4Rotation._33);
+	v3Euler.x = atan2f(-m4Rotation._32, fCosP);
+	if (fCosP > 1e-5f)
+	{
+		v3Euler.y = atan2f(m4Rotation._31, m4Rotation._33);
+		v3Euler.z = atan2f(m4Rotation._12, m4Rotation._22);
+	}
+	else
+	{
+		// Looking straight up or down, only the sum of yaw and roll is known so it all goes into the yaw.
+		v3Euler.y = atan2f(-m4Rotation._13, m4Rotation._11);
+		v3Euler.z = 0.0f;
+	}
+
+	a_Slot.Block->EulerDirty[a_Slot.Index / 64].fetch_and(~(1ull << (a_Slot.Index % 64)));
+	MarkDirty(a_Slot);
+}
+
+void TransformPool::StoreAxes(const TransformSlot& a_Slot, const XMMatrix& a_Rotation)
+{
+	XMStoreFloat3(&a_Slot.Block->Rights[a_Slot.Index], a_Rotation.r[0]);
+	XMStoreFloat3(&a_Slot.Block->Ups[a_Slot.Index], a_Rotation.r[1]);
+	XMStoreFloat3(&a_Slot.Block->Forwards[a_Slot.Index], a_Rotation.r[2]);
+}
+
+void TransformPool::CalculateBatch(
+	TransformBlock* a_pBlock,
+	const unsigned int* a_pIndices,
+	unsigned int a_uCount,
+	unsigned int a_uEulerMask)
+{
+	// Short batches repeat their last transform, only the real ones are written back.
+	unsigned int lIndices[4];
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		lIndices[i] = a_pIndices[i < a_uCount ? i : a_uCount - 1];
+	}
+
+	// Turning the four transforms sideways, so every vector holds one component of all four.
+	XMMatrix position = XMMatrixTranspose(XMMatrix(
+		XMLoadFloat3(&a_pBlock->Positions[lIndices[0]]),
+		XMLoadFloat3(&a_pBlock->Positions[lIndices[1]]),
+		XMLoadFloat3(&a_pBlock->Positions[lIndices[2]]),
+		XMLoadFloat3(&a_pBlock->Positions[lIndices[3]])));
+	XMMatrix orientation = XMMatrixTranspose(XMMatrix(
+		XMLoadFloat4(&a_pBlock->Orientations[lIndices[0]]),
+		XMLoadFloat4(&a_pBlock->Orientations[lIndices[1]]),
+		XMLoadFloat4(&a_pBlock->Orientations[lIndices[2]]),
+		XMLoadFloat4(&a_pBlock->Orientations[lIndices[3]])));
+	XMMatrix scale = XMMatrixTranspose(XMMatrix(
+		XMLoadFloat3(&a_pBlock->Scales[lIndices[0]]),
+		XMLoadFloat3(&a_pBlock->Scales[lIndices[1]]),
+		XMLoadFloat3(&a_pBlock->Scales[lIndices[2]]),
+		XMLoadFloat3(&a_pBlock->Scales[lIndices[3]])));
+
+	// Only transforms whose euler angles were edited pay for the trig of rebuilding their quaternion.
+	if (a_uEulerMask != 0)
+	{
+		XMMatrix euler = XMMatrixTranspose(XMMatrix(
+			XMLoadFloat3(&a_pBlock->Rotations[lIndices[0]]),
+			XMLoadFloat3(&a_pBlock->Rotations[lIndices[1]]),
+			XMLoadFloat3(&a_pBlock->Rotations[lIndices[2]]),
+			XMLoadFloat3(&a_pBlock->Rotations[lIndices[3]])));
+
+		XMVector vHalf = XMVectorReplicate(0.5f);
+		XMVector vSinP, vCosP, vSinY, vCosY, vSinR, vCosR;
+		XMVectorSinCos(&vSinP, &vCosP, euler.r[0] * vHalf);
+		XMVectorSinCos(&vSinY, &vCosY, euler.r[1] * vHalf);
+		XMVectorSinCos(&vSinR, &vCosR, euler.r[2] * vHalf);
+
+		// The same quaternion as XMQuaternionRotationRollPitchYaw: roll, then pitch, then yaw.
+		XMVector lEuler[4] =
+		{
+			vCosR * vSinP * vCosY + vSinR * vCosP * vSinY,
+			vCosR * vCosP * vSinY - vSinR * vSinP * vCosY,
+			vSinR * vCosP * vCosY - vCosR * vSinP * vSinY,
+			vCosR * vCosP * vCosY + vSinR * vSinP * vSinY
+		};
+
+		XMVector vSelect = XMVectorSelectControl(
+			(a_uEulerMask >> 0) & 1,
+			(a_uEulerMask >> 1) & 1,
+			(a_uEulerMask >> 2) & 1,
+			(a_uEulerMask >> 3) & 1);
+		for (unsigned int c = 0; c < 4; c++)
+		{
+			orientation.r[c] = XMVectorSelect(orientation.r[c], lEuler[c], vSelect);
+		}
+
+		XMMatrix stored = XMMatrixTranspose(orientation);
+		for (unsigned int i = 0; i < a_uCount; i++)
+		{
+			XMStoreFloat4(&a_pBlock->Orientations[lIndices[i]], stored.r[i]);
+		}
+	}
+
+	// The rotation matrix of a unit quaternion, same as XMMatrixRotationQuaternion.
+	XMVector vX = orientation.r[0];
+	XMVector vY = orientation.r[1];
+	XMVector vZ = orientation.r[2];
+	XMVector vW = orientation.r[3];
+	XMVector vX2 = vX + vX;
+	XMVector vY2 = vY + vY;
+	XMVector vZ2 = vZ + vZ;
+	XMVector vOne = XMVectorSplatOne();
+	XMVector vR00 = vOne - (vY * vY2 + vZ * vZ2);
+	XMVector vR01 = vX * vY2 + vW * vZ2;
+	XMVector vR02 = vX * vZ2 - vW * vY2;
+	XMVector vR10 = vX * vY2 - vW * vZ2;
+	XMVector vR11 = vOne - (vX * vX2 + vZ * vZ2);
+	XMVector vR12 = vY * vZ2 + vW * vX2;
+	XMVector vR20 = vX * vZ2 + vW * vY2;
+	XMVector vR21 = vY * vZ2 - vW * vX2;
+	XMVector vR22 = vOne - (vX * vX2 + vY * vY2);
+
+	// World = scale * rotation * translation, so every rotation row is scaled by its own axis.
+	XMVector vZero = XMVectorZero();
+	XMMatrix world0 = XMMatrixTranspose(XMMatrix(vR00 * scale.r[0], vR01 * scale.r[0], vR02 * scale.r[0], vZero));
+	XMMatrix world1 = XMMatrixTranspose(XMMatrix(vR10 * scale.r[1], vR11 * scale.r[1], vR12 * scale.r[1], vZero));
+	XMMatrix world2 = XMMatrixTranspose(XMMatrix(vR20 * scale.r[2], vR21 * scale.r[2], vR22 * scale.r[2], vZero));
+	XMMatrix world3 = XMMatrixTranspose(XMMatrix(position.r[0], position.r[1], position.r[2], vOne));
+
+	// The rotation is orthonormal, so the inverse transpose of the world only needs the scale inverted:
+	// its rows are the rotation rows over their scale, and the last column undoes the translation.
+	XMVector vInvX = XMVectorReciprocal(scale.r[0]);
+	XMVector vInvY = XMVectorReciprocal(scale.r[1]);
+	XMVector vInvZ = XMVectorReciprocal(scale.r[2]);
+	XMVector vT0 = XMVectorNegate(position.r[0] * vR00 + position.r[1] * vR01 + position.r[2] * vR02) * vInvX;
+	XMVector vT1 = XMVectorNegate(position.r[0] * vR10 + position.r[1] * vR11 + position.r[2] * vR12) * vInvY;
+	XMVector vT2 = XMVectorNegate(position.r[0] * vR20 + position.r[1] * vR21 + position.r[2] * vR22) * vInvZ;
+	XMMatrix inverse0 = XMMatrixTranspose(XMMatrix(vR00 * vInvX, vR01 * vInvX, vR02 * vInvX, vT0));
+	XMMatrix inverse1 = XMMatrixTranspose(XMMatrix(vR10 * vInvY, vR11 * vInvY, vR12 * vInvY, vT1));
+	XMMatrix inverse2 = XMMatrixTranspose(XMMatrix(vR20 * vInvZ, vR21 * vInvZ, vR22 * vInvZ, vT2));
+	XMVector vInverse3 = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+
+	// The unscaled rotation rows are the transform's right, up and forward axes.
+	XMMatrix right = XMMatrixTranspose(XMMatrix(vR00, vR01, vR02, vZero));
+	XMMatrix up = XMMatrixTranspose(XMMatrix(vR10, vR11, vR12, vZero));
+	XMMatrix forward = XMMatrixTranspose(XMMatrix(vR20, vR21, vR22, vZero));
+
+	for (unsigned int i = 0; i < a_uCount; i++)
+	{
+		XMStoreFloat4x4(&a_pBlock->Worlds[lIndices[i]], XMMatrix(world0.r[i], world1.r[i], world2.r[i], world3.r[i]));
+		XMStoreFloat4x4(&a_pBlock->WorldInvTras[lIndices[i]], XMMatrix(inverse0.r[i], inverse1.r[i], inverse2.r[i], vInverse3));
+		XMStoreFloat3(&a_pBlock->Rights[lIndices[i]], right.r[i]);
+		XMStoreFloat3(&a_pBlock->Ups[lIndices[i]], up.r[i]);
+		XMStoreFloat3(&a_pBlock->Forwards[lIndices[i]], forward.r[i]);
+	}
+}
+
+void TransformPool::Reset(const TransformSlot& a_Slot)
+{
+	a_Slot.Block->Positions[a_Slot.Index] = Vector3(0.0f, 0.0f, 0.0f);
+	a_Slot.Block->Orientations[a_Slot.Index] = Vector4(0.0f, 0.0f, 0.0f, 1.0f);
+	a_Slot.Block->Rotations[a_Slot.Index] = Vector3(0.0f, 0.0f, 0.0f);
+	a_Slot.Block->Scales[a_Slot.Index] = Vector3(1.0f, 1.0f, 1.0f);
+	a_Slot.Block->Rights[a_Slot.Index] = Vector3(1.0f, 0.0f, 0.0f);
+	a_Slot.Block->Ups[a_Slot.Index] = Vector3(0.0f, 1.0f, 0.0f);
+	a_Slot.Block->Forwards[a_Slot.Index] = Vector3(0.0f, 0.0f, 1.0f);
+	XMStoreFloat4x4(&a_Slot.Block->Worlds[a_Slot.Index], XMMatrixIdentity());
+	XMStoreFloat4x4(&a_Slot.Block->WorldInvTras[a_Slot.Index], XMMatrixIdentity());
+	a_Slot.Block->HierarchyIndices[a_Slot.Index] = -1;
+	// Never reset, a reused slot must not look unchanged to whatever cached its previous owner.
+	a_Slot.Block->Generations[a_Slot.Index]++;
+	a_Slot.Block->Dirty[a_Slot.Index / 64].fetch_and(~(1ull << (a_Slot.Index % 64)));
+	a_Slot.Block->EulerDirty[a_Slot.Index / 64].fetch_and(~(1ull << (a_Slot.Index % 64)));
+}
+
+unsigned int TransformPool::GetNode(const TransformSlot& a_Slot)
+{
+	int nNode = a_Slot.Block->HierarchyIndices[a_Slot.Index];
+	if (nNode >= 0)
+	{
+		return (unsigned int)nNode;
+	}
+
+	// The local matrix is picked up again by the next update.
+	TransformNode node;
+	node.Slot = a_Slot;
+	node.LocalDirty = true;
+	m_lHierarchy.push_back(node);
+
+	unsigned int uNode = (unsigned int)m_lHierarchy.size() - 1;
+	a_Slot.Block->HierarchyIndices[a_Slot.Index] = (int32_t)uNode;
+	a_Slot.Block->Dirty[a_Slot.Index / 64].fetch_or(1ull << (a_Slot.Index % 64));
+	return uNode;
+}
+
+void TransformPool::RemoveNode(const TransformSlot& a_Slot)
+{
+	unsigned int uNode = (unsigned int)a_Slot.Block->HierarchyIndices[a_Slot.Index];
+	unsigned int uEnd = uNode + m_lHierarchy[uNode].SubtreeSize;
+
+	// Turning the direct children into roots, their own subtrees stay where they are.
+	for (unsigned int i = uNode + 1; i < uEnd; i += m_lHierarchy[i].SubtreeSize)
+	{
+		m_lHierarchy[i].ParentSlot = TransformSlot();
+		m_lHierarchy[i].WorldDirty = true;
+	}
+
+	m_lHierarchy.erase(m_lHierarchy.begin() + uNode);
+	a_Slot.Block->HierarchyIndices[a_Slot.Index] = -1;
+	IndexHierarchy();
+}
+
+void TransformPool::IndexHierarchy(void)
+{
+	for (unsigned int i = 0; i < (unsigned int)m_lHierarchy.size(); i++)
+	{
+		TransformNode& node = m_lHierarchy[i];
+		node.Slot.Block->HierarchyIndices[node.Slot.Index] = (int32_t)i;
+		node.SubtreeSize = 1;
+	}
+
+	for (TransformNode& node : m_lHierarchy)
+	{
+		node.Parent = node.ParentSlot.Block != nullptr ?
+			node.ParentSlot.Block->HierarchyIndices[node.ParentSlot.Index] :
+			-1;
+	}
+
+	// Parents come before their children, so walking backwards finishes every subtree before its root.
+	for (unsigned int i = (unsigned int)m_lHierarchy.size(); i-- > 0;)
+	{
+		if (m_lHierarchy[i].Parent >= 0)
+		{
+			m_lHierarchy[m_lHierarchy[i].Parent].SubtreeSize += m_lHierarchy[i].SubtreeSize;
+		}
+	}
+}
+
+void TransformPool::FlagAncestors(int a_nNode)
+{
+	// Stopping at the first flagged ancestor, everything above it is already flagged.
+	while (a_nNode >= 0 && !m_lHierarchy[a_nNode].ChildDirty)
+	{
+		m_lHierarchy[a_nNode].ChildDirty = true;
+		a_nNode = m_lHierarchy[a_nNode].Parent;
+	}
+}
+
+void TransformPool::UpdateHierarchy(void)
+{
+	// Every node before this index has a parent whose world matrix changed this frame.
+	unsigned int uChangedEnd = 0;
+	unsigned int uCount = (unsigned int)m_lHierarchy.size();
+
+	for (unsigned int i = 0; i < uCount;)
+	{
+		TransformNode& node = m_lHierarchy[i];
+		bool bParentChanged = i < uChangedEnd;
+		if (!bParentChanged && !node.LocalDirty && !node.WorldDirty && !node.ChildDirty)
+		{
+			i += node.SubtreeSize;
+			continue;
+		}
+
+		TransformBlock* pBlock = node.Slot.Block;
+		unsigned int uIndex = node.Slot.Index;
+
+		// The batched update just wrote the new local matrices where the world matrices go.
+		if (node.LocalDirty)
+		{
+			node.Local = pBlock->Worlds[uIndex];
+			node.LocalInvTra = pBlock->WorldInvTras[uIndex];
+		}
+
+		if (bParentChanged || node.LocalDirty || node.WorldDirty)
+		{
+			if (node.Parent < 0)
+			{
+				pBlock->Worlds[uIndex] = node.Local;
+				pBlock->WorldInvTras[uIndex] = node.LocalInvTra;
+			}
+			else
+			{
+				// The inverse transpose of a product is the product of the inverse transposes, in the same order.
+				const TransformSlot& parent = m_lHierarchy[node.Parent].Slot;
+				XMStoreFloat4x4(&pBlock->Worlds[uIndex], XMMatrixMultiply(
+					XMLoadFloat4x4(&node.Local),
+					XMLoadFloat4x4(&parent.Block->Worlds[parent.Index])));
+				XMStoreFloat4x4(&pBlock->WorldInvTras[uIndex], XMMatrixMultiply(
+					XMLoadFloat4x4(&node.LocalInvTra),
+					XMLoadFloat4x4(&parent.Block->WorldInvTras[parent.Index])));
+			}
+
+			// Moving a parent or reparenting changes the world matrix without the transform itself being touched.
+			pBlock->Generations[uIndex]++;
+			uChangedEnd = std::max(uChangedEnd, i + node.SubtreeSize);
+		}
+
+		node.LocalDirty = false;
+		node.WorldDirty = false;
+		node.ChildDirty = false;
+		i++;
+	}
+}
@@ -0,0 +1,237 @@
+#ifndef __TRANSFORMPOOL_H_
+#define __TRANSFORMPOOL_H_
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+#include "Vectors.h"
+
+// Transforms are handed out in blocks of this many, so their data never moves once allocated.
+#define TRANSFORM_BLOCK_SIZE 1024
+// The pool holds at most TRANSFORM_BLOCK_SIZE * TRANSFORM_MAX_BLOCKS transforms.
+#define TRANSFORM_MAX_BLOCKS 1024
+// One dirty bit per transform, packed into 64 bit words.
+#define TRANSFORM_DIRTY_WORDS (TRANSFORM_BLOCK_SIZE / 64)
+// The smallest amount of dirty words worth handing to a worker.
+#define TRANSFORM_MIN_WORD_BATCH 16
+
+/// <summary>
+/// A block of transforms stored as one array per attribute, so the batched
+/// update streams through positions, orientations and scales back to back.
+/// </summary>
+struct TransformBlock
+{
+	Vector3 Positions[TRANSFORM_BLOCK_SIZE];
+	// The orientation as a quaternion.  This is what the matrices are built from.
+	Vector4 Orientations[TRANSFORM_BLOCK_SIZE];
+	// The orientation as pitch, yaw and roll, only kept around for editing.
+	Vector3 Rotations[TRANSFORM_BLOCK_SIZE];
+	Vector3 Scales[TRANSFORM_BLOCK_SIZE];
+	// The rotated axes, cached alongside the matrices.
+	Vector3 Rights[TRANSFORM_BLOCK_SIZE];
+	Vector3 Ups[TRANSFORM_BLOCK_SIZE];
+	Vector3 Forwards[TRANSFORM_BLOCK_SIZE];
+	Matrix4 Worlds[TRANSFORM_BLOCK_SIZE];
+	Matrix4 WorldInvTras[TRANSFORM_BLOCK_SIZE];
+	// Where every transform sits in the hierarchy, or -1 when it has no parent or children.
+	int32_t HierarchyIndices[TRANSFORM_BLOCK_SIZE];
+	// Bumped whenever a transform's world matrix changes, so anything caching it knows to refresh.
+	uint32_t Generations[TRANSFORM_BLOCK_SIZE];
+	std::atomic<uint64_t> Dirty[TRANSFORM_DIRTY_WORDS];
+	// The euler angles were edited, so the quaternion and axes have to be rebuilt from them.
+	std::atomic<uint64_t> EulerDirty[TRANSFORM_DIRTY_WORDS];
+};
+
+/// <summary>
+/// Where a single transform lives inside of the pool.
+/// </summary>
+struct TransformSlot
+{
+	TransformBlock* Block = nullptr;
+	unsigned int Index = 0;
+};
+
+/// <summary>
+/// A transform that has a parent or children.  Nodes are stored depth-first, so every
+/// parent comes before its children and a subtree is the SubtreeSize nodes starting at its root.
+/// </summary>
+struct TransformNode
+{
+	TransformSlot Slot;
+	// The parent's slot, with no block for roots.
+	TransformSlot ParentSlot;
+	int Parent = -1;
+	unsigned int SubtreeSize = 1;
+
+	// The position, rotation or scale changed.
+	bool LocalDirty = false;
+	// The node was moved around the hierarchy.
+	bool WorldDirty = false;
+	// Something further down the subtree needs updating.
+	bool ChildDirty = false;
+
+	Matrix4 Local;
+	Matrix4 LocalInvTra;
+};
+
+/// <summary>
+/// Owns the data of every Transform in the simulation.  Transforms only mark themselves
+/// dirty when changed, and Update recomputes the matrices of every dirty transform
+/// once a frame, four at a time and split across the worker threads.
+/// Parented transforms then have their world matrices resolved in one depth-first sweep.
+/// Anything touching the hierarchy has to happen on the main thread.
+/// </summary>
+class TransformPool
+{
+private:
+	static TransformPool* m_pInstance;
+
+	std::unique_ptr<TransformBlock> m_lBlocks[TRANSFORM_MAX_BLOCKS];
+	std::atomic<unsigned int> m_uBlockCount{ 0 };
+	unsigned int m_uNextIndex = 0;
+	std::vector<TransformSlot> m_lFreeSlots;
+	// Slots freed since the last update.  They can still be in the hierarchy, which only the main thread may touch.
+	std::vector<TransformSlot> m_lPendingFrees;
+	std::mutex m_Mutex;
+
+	std::vector<TransformNode> m_lHierarchy;
+
+public:
+	/// <summary>
+	/// Gets the single instance of the TransformPool.
+	/// </summary>
+	static TransformPool* GetInstance(void);
+
+	/// <summary>
+	/// Frees every block of the pool.  Transforms that are destroyed afterwards
+	/// simply do not hand their slot back.
+	/// </summary>
+	static void Release(void);
+
+	/// <summary>
+	/// Hands out a slot set to the identity transform.  Safe to call from any thread.
+	/// </summary>
+	TransformSlot Allocate(void);
+
+	/// <summary>
+	/// Gives a slot back to the pool.  Safe to call from any thread, and does nothing once the pool is released.
+	/// The slot is taken out of the hierarchy and can be handed out again from the next Update on.
+	/// </summary>
+	static void Free(const TransformSlot& a_Slot);
+
+	/// <summary>
+	/// Recomputes the world and world inverse transpose matrices of every dirty transform.
+	/// Called once a frame, on the main thread, before anything is drawn.
+	/// </summary>
+	void Update(void);
+
+	/// <summary>
+	/// Gets how many transforms are currently in use.
+	/// </summary>
+	unsigned int GetCount(void);
+
+	/// <summary>
+	/// Attaches a transform and its children to a new parent, after the parent's existing children.
+	/// </summary>
+	/// <param name="a_pParent">The new parent, or nullptr to make the transform a root again.</param>
+	void SetParent(const TransformSlot& a_Child, const TransformSlot* a_pParent);
+
+	/// <summary>
+	/// Checks whether a transform is attached to a parent.
+	/// </summary>
+	static bool HasParent(const TransformSlot& a_Slot);
+
+	/// <summary>
+	/// Flags a transform's matrices as out of date.
+	/// </summary>
+	/// <param name="a_bEulerChanged">Whether the euler angles were edited, so the orientation has to follow them.</param>
+	static void MarkDirty(const TransformSlot& a_Slot, bool a_bEulerChanged = false);
+
+	/// <summary>
+	/// Gets a transform's change generation.  It only ever increases, and stays the same for as long as the world matrix does.
+	/// </summary>
+	static uint32_t GetGeneration(const TransformSlot& a_Slot);
+
+	/// <summary>
+	/// Checks whether a transform's euler angles were edited since its orientation was last rebuilt.
+	/// </summary>
+	static bool IsEulerDirty(const TransformSlot& a_Slot);
+
+	/// <summary>
+	/// Recomputes a single transform's matrices right away if they are out of date.
+	/// Only reads when they are not, so up to date transforms can be resolved from any thread.
+	/// </summary>
+	static void Resolve(const TransformSlot& a_Slot);
+
+	/// <summary>
+	/// Rebuilds a single transform's orientation and axes from its euler angles if they were edited.
+	/// Leaves the matrices to the next update.
+	/// </summary>
+	static void ResolveOrientation(const TransformSlot& a_Slot);
+
+	/// <summary>
+	/// Sets a transform's orientation, updating its axes and euler angles to match.
+	/// </summary>
+	static void SetOrientation(const TransformSlot& a_Slot, const Vector4& a_v4Orientation);
+
+	/// <summary>
+	/// Recomputes the matrices of up to four transforms of the same block at once.
+	/// </summary>
+	/// <param name="a_pIndices">The slot indices inside of the block.</param>
+	/// <param name="a_uCount">How many indices there are, between 1 and 4.</param>
+	/// <param name="a_uEulerMask">One bit per index whose orientation is rebuilt from its euler angles first.</param>
+	static void CalculateBatch(
+		TransformBlock* a_pBlock,
+		const unsigned int* a_pIndices,
+		unsigned int a_uCount,
+		unsigned int a_uEulerMask);
+
+private:
+	TransformPool(void);
+	~TransformPool(void);
+
+	// Removing the copy constructor and operator.
+	TransformPool(const TransformPool&) = delete;
+	TransformPool& operator=(const TransformPool&) = delete;
+
+	/// <summary>
+	/// Resets a slot to the identity transform.
+	/// </summary>
+	static void Reset(const TransformSlot& a_Slot);
+
+	/// <summary>
+	/// Caches the rows of a rotation matrix as a transform's right, up and forward axes.
+	/// </summary>
+	static void StoreAxes(const TransformSlot& a_Slot, const XMMatrix& a_Rotation);
+
+	/// <summary>
+	/// Gets a transform's node, adding it to the end of the hierarchy as a root if it is not in there yet.
+	/// </summary>
+	unsigned int GetNode(const TransformSlot& a_Slot);
+
+	/// <summary>
+	/// Takes a freed transform out of the hierarchy.  Its children become roots.
+	/// </summary>
+	void RemoveNode(const TransformSlot& a_Slot);
+
+	/// <summary>
+	/// Recomputes every node's index, parent index and subtree size after nodes moved around.
+	/// </summary>
+	void IndexHierarchy(void);
+
+	/// <summary>
+	/// Marks a node and its ancestors as having something dirty below them.
+	/// </summary>
+	void FlagAncestors(int a_nNode);
+
+	/// <summary>
+	/// Sweeps the hierarchy once, parents before children, recomputing the world matrices of every
+	/// changed subtree.  Subtrees without any changes are skipped over entirely.
+	/// </summary>
+	void UpdateHierarchy(void);
+};
+
+#endif //__TRANSFORMPOOL_H_
@@ -0,0 +1,305 @@
+#include "TriangleBVH.h"
+#include "VertexPacker.h"
+
+#include <cstring>
+#include <algorithm>
+
+using namespace DirectX;
+
+// Triangles whose edges are this close to parallel with the ray are treated as missed.
+#define TRIANGLE_PARALLEL_EPSILON 1e-12f
+
+namespace
+{
+	unsigned int ReadIndex(const unsigned char* a_pIndices, unsigned int a_uStride, unsigned int a_uIndex)
+	{
+		if (a_uStride == sizeof(uint16_t))
+		{
+			uint16_t uIndex;
+			std::memcpy(&uIndex, a_pIndices + a_uIndex * sizeof(uint16_t), sizeof(uint16_t));
+			return uIndex;
+		}
+
+		uint32_t uIndex;
+		std::memcpy(&uIndex, a_pIndices + a_uIndex * sizeof(uint32_t), sizeof(uint32_t));
+		return uIndex;
+	}
+
+	/// <summary>
+	/// Every vertex format starts with its full precision position.
+	/// </summary>
+	Vector3 ReadPosition(const unsigned char* a_pVertices, unsigned int a_uStride, unsigned int a_uVertex)
+	{
+		Vector3 v3Position;
+		std::memcpy(&v3Position, a_pVertices + a_uVertex * a_uStride, sizeof(Vector3));
+		return v3Position;
+	}
+}
+
+std::shared_ptr<TriangleBVH> TriangleBVH::Create(
+	VertexFormat a_Format,
+	const void* a_pVertices,
+	unsigned int a_uVertexCount,
+	const void* a_pIndices,
+	unsigned int a_uIndexCount,
+	const MeshLod* a_pLods,
+	unsigned int a_uLodCount)
+{
+	const unsigned char* pVertices = static_cast<const unsigned char*>(a_pVertices);
+	const unsigned char* pIndices = static_cast<const unsigned char*>(a_pIndices);
+	unsigned int uVertexStride = VertexPacker::GetVertexStride(a_Format);
+	unsigned int uIndexStride = VertexPacker::GetIndexStride(a_uVertexCount);
+	unsigned int uFirstIndex = a_uLodCount > 0 ? a_pLods[0].IndexOffset : 0;
+	unsigned int uTriangleCount = (a_uLodCount > 0 ? a_pLods[0].IndexCount : a_uIndexCount) / 3;
+
+	// Gathering every triangle's corners and box, the boxes are all the hierarchy is built from.
+	std::vector<Vector3> lCorners(uTriangleCount * 3);
+	std::vector<CullBounds> lBounds(uTriangleCount);
+	for (unsigned int t = 0; t < uTriangleCount; t++)
+	{
+		Vector3 v3Min = Vector3(FLT_MAX, FLT_MAX, FLT_MAX);
+		Vector3 v3Max = Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (unsigned int c = 0; c < 3; c++)
+		{
+			Vector3 v3Position = ReadPosition(pVertices, uVertexStride, ReadIndex(pIndices, uIndexStride, uFirstIndex + t * 3 + c));
+			lCorners[t * 3 + c] = v3Position;
+			FrustumCuller::Merge(v3Min, v3Max, v3Position, v3Position);
+		}
+
+		lBounds[t].Center = Vector3((v3Min.x + v3Max.x) * 0.5f, (v3Min.y + v3Max.y) * 0.5f, (v3Min.z + v3Max.z) * 0.5f);
+		lBounds[t].Extents = Vector3((v3Max.x - v3Min.x) * 0.5f, (v3Max.y - v3Min.y) * 0.5f, (v3Max.z - v3Min.z) * 0.5f);
+	}
+
+	SceneBVH builder;
+	builder.Build(lBounds.data(), uTriangleCount);
+
+	std::shared_ptr<TriangleBVH> pResult = std::make_shared<TriangleBVH>();
+	pResult->m_lNodes = builder.GetNodes();
+	pResult->m_lTriangles = builder.GetObjects();
+
+	// Laying the triangles out in leaf order.  The padding reads as degenerate triangles, which never hit.
+	unsigned int uPadded = (uTriangleCount + 3) & ~3u;
+	for (unsigned int a = 0; a < 3; a++)
+	{
+		pResult->m_lCorners[a].assign(uPadded + 4, 0.0f);
+		pResult->m_lEdges1[a].assign(uPadded + 4, 0.0f);
+		pResult->m_lEdges2[a].assign(uPadded + 4, 0.0f);
+	}
+
+	for (unsigned int i = 0; i < uTriangleCount; i++)
+	{
+		const Vector3* pTriangle = &lCorners[pResult->m_lTriangles[i] * 3];
+		const float lCorner[3] = { pTriangle[0].x, pTriangle[0].y, pTriangle[0].z };
+		const float lSecond[3] = { pTriangle[1].x, pTriangle[1].y, pTriangle[1].z };
+		const float lThird[3] = { pTriangle[2].x, pTriangle[2].y, pTriangle[2].z };
+		for (unsigned int a = 0; a < 3; a++)
+		{
+			pResult->m_lCorners[a][i] = lCorner[a];
+			pResult->m_lEdges1[a][i] = lSecond[a] - lCorner[a];
+			pResult->m_lEdges2[a][i] = lThird[a] - lCorner[a];
+		}
+	}
+
+	return pResult;
+}
+
+std::shared_ptr<TriangleBVH> TriangleBVH::Create(const PackedMesh& a_Mesh)
+{
+	return Create(
+		a_Mesh.Format,
+		a_Mesh.GetVertexData(),
+		a_Mesh.VertexCount,
+		a_Mesh.GetIndexData(),
+		a_Mesh.IndexCount,
+		a_Mesh.Lods.data(),
+		(unsigned int)a_Mesh.Lods.size());
+}
+
+unsigned int TriangleBVH::GetTriangleCount(void) const
+{
+	return (unsigned int)m_lTriangles.size();
+}
+
+bool TriangleBVH::Raycast(
+	const Vector3& a_v3Origin,
+	const Vector3& a_v3Direction,
+	RayHit& a_Hit,
+	bool a_bAnyHit) const
+{
+	float fEnter = 0.0f;
+	float fMaxDistance = a_Hit.Distance;
+	XMVector vOrigin = XMLoadFloat3(&a_v3Origin);
+	XMVector vInverseDirection = SceneBVH::GetInverseDirection(a_v3Direction);
+	if (m_lNodes.empty() || !SceneBVH::IntersectRay(m_lNodes[0].Min, m_lNodes[0].Max, vOrigin, vInverseDirection, fMaxDistance, fEnter))
+	{
+		return false;
+	}
+
+	// Every coordinate of the ray splatted across the four lanes of a triangle packet.
+	const XMVector lOrigin[3] = { XMVectorSplatX(vOrigin), XMVectorSplatY(vOrigin), XMVectorSplatZ(vOrigin) };
+	XMVector vDirection = XMLoadFloat3(&a_v3Direction);
+	const XMVector lDirection[3] = { XMVectorSplatX(vDirection), XMVectorSplatY(vDirection), XMVectorSplatZ(vDirection) };
+
+	int nBest = -1;
+	std::vector<std::pair<float, unsigned int>> lStack(1, std::make_pair(fEnter, 0u));
+	while (!lStack.empty())
+	{
+		std::pair<float, unsigned int> entry = lStack.back();
+		lStack.pop_back();
+		if (entry.first > fMaxDistance)
+		{
+			continue;
+		}
+
+		const SceneBVHNode& node = m_lNodes[entry.second];
+		if (node.Count == 0)
+		{
+			// Closer children are visited first, so hits found early cut off whatever lies behind them.
+			const SceneBVHNode& left = m_lNodes[node.LeftFirst];
+			const SceneBVHNode& right = m_lNodes[node.LeftFirst + 1];
+			float fLeft = 0.0f;
+			float fRight = 0.0f;
+			bool bLeft = SceneBVH::IntersectRay(left.Min, left.Max, vOrigin, vInverseDirection, fMaxDistance, fLeft);
+			bool bRight = SceneBVH::IntersectRay(right.Min, right.Max, vOrigin, vInverseDirection, fMaxDistance, fRight);
+			if (bLeft && bRight)
+			{
+				bool bLeftFirst = fLeft <= fRight;
+				lStack.push_back(bLeftFirst ? std::make_pair(fRight, node.LeftFirst + 1) : std::make_pair(fLeft, node.LeftFirst));
+				lStack.push_back(bLeftFirst ? std::make_pair(fLeft, node.LeftFirst) : std::make_pair(fRight, node.LeftFirst + 1));
+			}
+			else if (bLeft)
+			{
+				lStack.push_back(std::make_pair(fLeft, node.LeftFirst));
+			}
+			else if (bRight)
+			{
+				lStack.push_back(std::make_pair(fRight, node.LeftFirst + 1));
+			}
+			continue;
+		}
+
+		for (unsigned int i = node.LeftFirst; i < node.LeftFirst + node.Count; i += 4)
+		{
+			float fDistance = 0.0f;
+			int nLane = IntersectPacket(i, std::min(4u, node.LeftFirst + node.Count - i), lOrigin, lDirection, fMaxDistance, fDistance);
+			if (nLane < 0)
+			{
+				continue;
+			}
+
+			fMaxDistance = fDistance;
+			nBest = (int)i + nLane;
+			if (a_bAnyHit)
+			{
+				lStack.clear();
+				break;
+			}
+		}
+	}
+
+	if (nBest < 0)
+	{
+		return false;
+	}
+
+	// The face normal, from the cross product of the edges.
+	const Vector3 v3Edge1 = Vector3(m_lEdges1[0][nBest], m_lEdges1[1][nBest], m_lEdges1[2][nBest]);
+	const Vector3 v3Edge2 = Vector3(m_lEdges2[0][nBest], m_lEdges2[1][nBest], m_lEdges2[2][nBest]);
+	XMStoreFloat3(&a_Hit.Normal, XMVector3Cross(XMLoadFloat3(&v3Edge1), XMLoadFloat3(&v3Edge2)));
+	a_Hit.Distance = fMaxDistance;
+	a_Hit.Triangle = m_lTriangles[nBest];
+	return true;
+}
+
+void TriangleBVH::ToObjectSpace(
+	const Ray& a_Ray,
+	const XMMatrix& a_m4InverseWorld,
+	Vector3& a_v3Origin,
+	Vector3& a_v3Direction)
+{
+	XMStoreFloat3(&a_v3Origin, XMVector3TransformCoord(XMLoadFloat3(&a_Ray.Origin), a_m4InverseWorld));
+	XMStoreFloat3(&a_v3Direction, XMVector3TransformNormal(XMLoadFloat3(&a_Ray.Direction), a_m4InverseWorld));
+}
+
+void TriangleBVH::ToWorldSpace(const Ray& a_Ray, const XMMatrix& a_m4InverseWorld, RayHit& a_Hit)
+{
+	XMVector vDirection = XMLoadFloat3(&a_Ray.Direction);
+	XMStoreFloat3(&a_Hit.Position, XMLoadFloat3(&a_Ray.Origin) + vDirection * XMVectorReplicate(a_Hit.Distance));
+
+	// Normals move with the inverse transpose, and are flipped to face whoever cast the ray.
+	XMVector vNormal = XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&a_Hit.Normal), XMMatrixTranspose(a_m4InverseWorld)));
+	if (XMVectorGetX(XMVector3Dot(vNormal, vDirection)) > 0.0f)
+	{
+		vNormal = -vNormal;
+	}
+	XMStoreFloat3(&a_Hit.Normal, vNormal);
+	a_Hit.Hit = true;
+}
+
+int TriangleBVH::IntersectPacket(
+	unsigned int a_uFirst,
+	unsigned int a_uCount,
+	const XMVector* a_pOrigin,
+	const XMVector* a_pDirection,
+	float a_fMaxDistance,
+	float& a_fDistance) const
+{
+	XMVector lCorner[3];
+	XMVector lEdge1[3];
+	XMVector lEdge2[3];
+	for (unsigned int a = 0; a < 3; a++)
+	{
+		lCorner[a] = XMLoadFloat4(reinterpret_cast<const Vector4*>(&m_lCorners[a][a_uFirst]));
+		lEdge1[a] = XMLoadFloat4(reinterpret_cast<const Vector4*>(&m_lEdges1[a][a_uFirst]));
+		lEdge2[a] = XMLoadFloat4(reinterpret_cast<const Vector4*>(&m_lEdges2[a][a_uFirst]));
+	}
+
+	// Moller-Trumbore, four triangles at a time.  The determinant is the volume spanned by the
+	// ray and both edges, and the barycentrics and distance are ratios of volumes to it.
+	XMVector lCross[3] =
+	{
+		a_pDirection[1] * lEdge2[2] - a_pDirection[2] * lEdge2[1],
+		a_pDirection[2] * lEdge2[0] - a_pDirection[0] * lEdge2[2],
+		a_pDirection[0] * lEdge2[1] - a_pDirection[1] * lEdge2[0]
+	};
+	XMVector vDeterminant = lEdge1[0] * lCross[0] + lEdge1[1] * lCross[1] + lEdge1[2] * lCross[2];
+	XMVector vInverseDeterminant = XMVectorReciprocal(vDeterminant);
+
+	XMVector lOffset[3] = { a_pOrigin[0] - lCorner[0], a_pOrigin[1] - lCorner[1], a_pOrigin[2] - lCorner[2] };
+	XMVector vU = (lOffset[0] * lCross[0] + lOffset[1] * lCross[1] + lOffset[2] * lCross[2]) * vInverseDeterminant;
+
+	XMVector lOffsetCross[3] =
+	{
+		lOffset[1] * lEdge1[2] - lOffset[2] * lEdge1[1],
+		lOffset[2] * lEdge1[0] - lOffset[0] * lEdge1[2],
+		lOffset[0] * lEdge1[1] - lOffset[1] * lEdge1[0]
+	};
+	XMVector vV = (a_pDirection[0] * lOffsetCross[0] + a_pDirection[1] * lOffsetCross[1] + a_pDirection[2] * lOffsetCross[2]) * vInverseDeterminant;
+	XMVector vT = (lEdge2[0] * lOffsetCross[0] + lEdge2[1] * lOffsetCross[1] + lEdge2[2] * lOffsetCross[2]) * vInverseDeterminant;
+
+	// Degenerate and parallel triangles produce infinities and NaNs, which every comparison below rejects.
+	XMVector vZero = XMVectorZero();
+	XMVector vHit = XMVectorGreater(XMVectorAbs(vDeterminant), XMVectorReplicate(TRIANGLE_PARALLEL_EPSILON));
+	vHit = XMVectorAndInt(vHit, XMVectorGreaterOrEqual(vU, vZero));
+	vHit = XMVectorAndInt(vHit, XMVectorGreaterOrEqual(vV, vZero));
+	vHit = XMVectorAndInt(vHit, XMVectorLessOrEqual(vU + vV, XMVectorReplicate(1.0f)));
+	vHit = XMVectorAndInt(vHit, XMVectorGreaterOrEqual(vT, vZero));
+	vHit = XMVectorAndInt(vHit, XMVectorLess(vT, XMVectorReplicate(a_fMaxDistance)));
+	vHit = XMVectorAndInt(vHit, XMVectorLess(XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f), XMVectorReplicate((float)a_uCount)));
+
+	Vector4 v4Distances;
+	XMStoreFloat4(&v4Distances, XMVectorSelect(XMVectorReplicate(FLT_MAX), vT, vHit));
+	const float lDistances[4] = { v4Distances.x, v4Distances.y, v4Distances.z, v4Distances.w };
+
+	int nLane = -1;
+	a_fDistance = a_fMaxDistance;
+	for (int l = 0; l < 4; l++)
+	{
+		if (lDistances[l] < a_fDistance)
+		{
+			a_fDistance = lDistances[l];
+			nLane = l;
+		}
+	}
+	return nLane;
+}
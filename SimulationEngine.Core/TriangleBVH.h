@@ -0,0 +1,100 @@
+#ifndef __TRIANGLEBVH_H_
+#define __TRIANGLEBVH_H_
+
+#include <memory>
+#include <vector>
+
+#include "Ray.h"
+#include "Vectors.h"
+#include "SceneBVH.h"
+#include "VertexFormat.h"
+
+/// <summary>
+/// A bounding volume hierarchy over the triangles of a single mesh, in object space, for ray casts on the CPU.
+/// Built with the same surface area heuristic as the SceneBVH and never changed afterwards,
+/// so any amount of threads can cast against it at once.
+/// Triangles are kept as one array per coordinate in leaf order, so leaves are tested four triangles at a time.
+/// </summary>
+class TriangleBVH
+{
+private:
+	std::vector<SceneBVHNode> m_lNodes;
+	// The original index of every triangle, in the order the leaves point into.
+	std::vector<unsigned int> m_lTriangles;
+
+	// The first corner and both edges leaving it, padded to a multiple of four triangles.
+	std::vector<float> m_lCorners[3];
+	std::vector<float> m_lEdges1[3];
+	std::vector<float> m_lEdges2[3];
+
+public:
+	/// <summary>
+	/// Builds the hierarchy over the full resolution LOD of packed vertices and indices.
+	/// Does not touch the device, so it is safe to call from worker threads.
+	/// </summary>
+	/// <param name="a_pLods">The mesh's LODs, the whole index buffer is used when there are none.</param>
+	static std::shared_ptr<TriangleBVH> Create(
+		VertexFormat a_Format,
+		const void* a_pVertices,
+		unsigned int a_uVertexCount,
+		const void* a_pIndices,
+		unsigned int a_uIndexCount,
+		const MeshLod* a_pLods,
+		unsigned int a_uLodCount);
+
+	/// <summary>
+	/// Builds the hierarchy over the full resolution LOD of a packed mesh.
+	/// </summary>
+	static std::shared_ptr<TriangleBVH> Create(const PackedMesh& a_Mesh);
+
+	/// <summary>
+	/// Gets how many triangles the hierarchy holds.
+	/// </summary>
+	unsigned int GetTriangleCount(void) const;
+
+	/// <summary>
+	/// Casts an object space ray against every triangle, from both sides.
+	/// </summary>
+	/// <param name="a_v3Direction">Does not have to be normalized, distances are in multiples of its length.</param>
+	/// <param name="a_Hit">Its distance is the furthest a hit counts.  Only the distance, triangle and
+	/// object space normal are filled in, and only when a closer hit was found.</param>
+	/// <param name="a_bAnyHit">Stops at the first hit instead of looking for the closest one.</param>
+	/// <returns>Whether a closer hit was found.</returns>
+	bool Raycast(
+		const Vector3& a_v3Origin,
+		const Vector3& a_v3Direction,
+		RayHit& a_Hit,
+		bool a_bAnyHit = false) const;
+
+	/// <summary>
+	/// Moves a world space ray into the object space of a world matrix.  The direction is not
+	/// renormalized, so distances along it stay in world units and hits need no converting back.
+	/// </summary>
+	static void ToObjectSpace(
+		const Ray& a_Ray,
+		const XMMatrix& a_m4InverseWorld,
+		Vector3& a_v3Origin,
+		Vector3& a_v3Direction);
+
+	/// <summary>
+	/// Fills in the world space position and normal of a hit found with ToObjectSpace.
+	/// </summary>
+	static void ToWorldSpace(const Ray& a_Ray, const XMMatrix& a_m4InverseWorld, RayHit& a_Hit);
+
+private:
+	/// <summary>
+	/// Tests up to four triangles of a leaf at once.
+	/// </summary>
+	/// <param name="a_uFirst">Where the four triangles start in the coordinate arrays.</param>
+	/// <param name="a_uCount">How many of the four are real, between 1 and 4.</param>
+	/// <returns>The lane of the closest hit before a_fMaxDistance, or -1.</returns>
+	int IntersectPacket(
+		unsigned int a_uFirst,
+		unsigned int a_uCount,
+		const XMVector* a_pOrigin,
+		const XMVector* a_pDirection,
+		float a_fMaxDistance,
+		float& a_fDistance) const;
+};
+
+#endif //__TRIANGLEBVH_H_
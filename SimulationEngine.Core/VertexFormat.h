@@ -0,0 +1,109 @@
+#ifndef __VERTEXFORMAT_H_
+#define __VERTEXFORMAT_H_
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "Vectors.h"
+#include "MappedFile.h"
+
+// The amount of entries in VertexFormat.
+#define VERTEX_FORMAT_COUNT 4
+
+/// <summary>
+/// The layouts a mesh's vertices can be stored in on the GPU.  Picked per mesh at import.
+/// </summary>
+enum class VertexFormat : uint32_t
+{
+	// Vertex: full precision floats everywhere.
+	Standard,
+	// CompactVertex: octahedral normals/tangents and half precision UVs.
+	Compact,
+	// SkinnedVertex: full precision with float weights and int joint indices.
+	Skinned,
+	// CompactSkinnedVertex: compact with unorm8 weights and uint8 joint indices.
+	CompactSkinned
+};
+
+/// <summary>
+/// A Vertex squeezed down to 24 bytes from 44.  Positions stay full precision, the normal and
+/// tangent are octahedral encoded into two snorm16s each and the UV is stored as two halves.
+/// </summary>
+struct CompactVertex
+{
+	Vector3 Position;
+	int16_t Normal[2];
+	int16_t Tangent[2];
+	uint16_t UV[2];
+};
+
+/// <summary>
+/// A SkinnedVertex squeezed down to 32 bytes from 72.
+/// </summary>
+struct CompactSkinnedVertex : CompactVertex
+{
+	uint8_t JointWeights[4];
+	uint8_t JointIndices[4];
+};
+
+/// <summary>
+/// One level of detail of a mesh: a range of its index buffer drawn with the shared vertices.
+/// </summary>
+struct MeshLod
+{
+	uint32_t IndexOffset = 0;
+	uint32_t IndexCount = 0;
+	// How far the simplified surface strays from the full resolution one, in object space.
+	float Error = 0.0f;
+};
+
+/// <summary>
+/// Vertices and indices already converted into the layout they are uploaded in.
+/// Indices are 16 bit whenever the vertex count allows it.
+/// The data is either owned or points into a memory-mapped package.
+/// </summary>
+struct PackedMesh
+{
+	VertexFormat Format = VertexFormat::Standard;
+	unsigned int VertexCount = 0;
+	unsigned int IndexCount = 0;
+
+	// Filled in when the mesh was packed in memory.
+	std::vector<unsigned char> Vertices;
+	std::vector<unsigned char> Indices;
+
+	// Filled in when the mesh was loaded from a package.
+	std::shared_ptr<MappedFile> Mapping;
+	const unsigned char* MappedVertices = nullptr;
+	const unsigned char* MappedIndices = nullptr;
+
+	// Packing fills in a single LOD covering every index.
+	std::vector<MeshLod> Lods;
+
+	// A sphere around every vertex, used to pick the LOD.
+	Vector3 BoundsCenter = Vector3(0.0f, 0.0f, 0.0f);
+	float BoundsRadius = 0.0f;
+
+	// The box around every vertex, used for culling.
+	Vector3 BoundsMin = Vector3(0.0f, 0.0f, 0.0f);
+	Vector3 BoundsMax = Vector3(0.0f, 0.0f, 0.0f);
+
+	/// <summary>
+	/// Gets the first byte of the packed vertices.
+	/// </summary>
+	const unsigned char* GetVertexData(void) const
+	{
+		return Mapping != nullptr ? MappedVertices : Vertices.data();
+	}
+
+	/// <summary>
+	/// Gets the first byte of the packed indices.
+	/// </summary>
+	const unsigned char* GetIndexData(void) const
+	{
+		return Mapping != nullptr ? MappedIndices : Indices.data();
+	}
+};
+
+#endif //__VERTEXFORMAT_H_
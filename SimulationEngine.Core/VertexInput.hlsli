@@ -9,4 +9,47 @@ struct VertexShaderInput
     float3 tangent : TANGENT;
 };
 
-#endif //__VERTEXINPUT_H_
\ No newline at end of file
+#ifdef COMPACT_VERTEX
+
+// The CompactVertex layout: normals and tangents arrive octahedral encoded
+// and the UVs arrive as halves, which the input assembler already widens.
+struct RawVertexShaderInput
+{
+    float3 position : POSITION;
+    float2 normal : NORMAL;
+    float2 tangent : TANGENT;
+    float2 uv : UV;
+};
+
+// Unfolds a direction that was folded onto an octahedron by VertexPacker::EncodeOctahedral.
+float3 DecodeOctahedral(float2 encoded)
+{
+    float3 direction = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    float fold = saturate(-direction.z);
+    direction.xy += direction.xy >= 0.0f ? -fold : fold;
+    return normalize(direction);
+}
+
+VertexShaderInput DecodeVertexInput(RawVertexShaderInput raw)
+{
+    VertexShaderInput input;
+    input.position = raw.position;
+    input.normal = DecodeOctahedral(raw.normal);
+    input.uv = raw.uv;
+    input.tangent = DecodeOctahedral(raw.tangent);
+    return input;
+}
+
+#else
+
+// The full precision Vertex layout needs no decoding.
+#define RawVertexShaderInput VertexShaderInput
+
+VertexShaderInput DecodeVertexInput(VertexShaderInput raw)
+{
+    return raw;
+}
+
+#endif //COMPACT_VERTEX
+
+#endif //__VERTEXINPUT_H_
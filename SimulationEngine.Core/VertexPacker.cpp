@@ -0,0 +1,339 @@
+#include "VertexPacker.h"
+
+#include <stdexcept>
+#include <cstring>
+#include <cmath>
+
+namespace
+{
+	/// <summary>
+	/// Quantizes a value in [-1, 1] the way the GPU reads DXGI_FORMAT_R16G16_SNORM back.
+	/// </summary>
+	int16_t ToSnorm16(float a_fValue)
+	{
+		float fClamped = a_fValue < -1.0f ? -1.0f : (a_fValue > 1.0f ? 1.0f : a_fValue);
+		return (int16_t)std::lround(fClamped * 32767.0f);
+	}
+
+	/// <summary>
+	/// Quantizes the skinning weights to unorm8s while keeping their sum intact,
+	/// so the rounding never makes a vertex gain or lose weight overall.
+	/// </summary>
+	void PackJointWeights(const SkinnedVertex& a_Vertex, uint8_t* a_pResult)
+	{
+		// The fourth weight is whatever the first three leave over.
+		float lWeights[MAX_JOINT_INFLUENCES] = {
+			a_Vertex.JointWeights.x,
+			a_Vertex.JointWeights.y,
+			a_Vertex.JointWeights.z,
+			1.0f - a_Vertex.JointWeights.x - a_Vertex.JointWeights.y - a_Vertex.JointWeights.z };
+
+		float fTotal = 0.0f;
+		int dTotal = 0;
+		unsigned int uLargest = 0;
+		for (unsigned int i = 0; i < MAX_JOINT_INFLUENCES; i++)
+		{
+			// Unused joints never get any weight.
+			float fWeight = a_Vertex.JointIndices[i] < 0 ? 0.0f : lWeights[i];
+			fWeight = fWeight < 0.0f ? 0.0f : (fWeight > 1.0f ? 1.0f : fWeight);
+
+			a_pResult[i] = (uint8_t)std::lround(fWeight * 255.0f);
+			fTotal += fWeight;
+			dTotal += a_pResult[i];
+			if (a_pResult[i] > a_pResult[uLargest])
+			{
+				uLargest = i;
+			}
+		}
+
+		// Handing the rounding error to the largest weight, where it matters the least.
+		long dTarget = std::lround((fTotal > 1.0f ? 1.0f : fTotal) * 255.0f);
+		int dCorrected = (int)a_pResult[uLargest] + (int)(dTarget - dTotal);
+		if (dTotal > 0 && dCorrected >= 0 && dCorrected <= 255)
+		{
+			a_pResult[uLargest] = (uint8_t)dCorrected;
+		}
+	}
+}
+
+VertexFormat VertexPacker::ChooseFormat(const Vertex* a_pVertices, unsigned int a_uVertexCount)
+{
+	for (unsigned int i = 0; i < a_uVertexCount; i++)
+	{
+		const Vector2& v2UV = a_pVertices[i].UV;
+		if (std::fabs(v2UV.x) > COMPACT_UV_LIMIT || std::fabs(v2UV.y) > COMPACT_UV_LIMIT)
+		{
+			return VertexFormat::Standard;
+		}
+	}
+
+	return VertexFormat::Compact;
+}
+
+VertexFormat VertexPacker::ChooseFormat(const SkinnedVertex* a_pVertices, unsigned int a_uVertexCount)
+{
+	for (unsigned int i = 0; i < a_uVertexCount; i++)
+	{
+		const Vector2& v2UV = a_pVertices[i].UV;
+		if (std::fabs(v2UV.x) > COMPACT_UV_LIMIT || std::fabs(v2UV.y) > COMPACT_UV_LIMIT)
+		{
+			return VertexFormat::Skinned;
+		}
+
+		for (unsigned int j = 0; j < MAX_JOINT_INFLUENCES; j++)
+		{
+			if (a_pVertices[i].JointIndices[j] > COMPACT_JOINT_LIMIT)
+			{
+				return VertexFormat::Skinned;
+			}
+		}
+	}
+
+	return VertexFormat::CompactSkinned;
+}
+
+void VertexPacker::Pack(
+	const Vertex* a_pVertices,
+	unsigned int a_uVertexCount,
+	const unsigned int* a_pIndices,
+	unsigned int a_uIndexCount,
+	VertexFormat a_Format,
+	PackedMesh& a_Result)
+{
+	if (a_Format != VertexFormat::Standard && a_Format != VertexFormat::Compact)
+	{
+		throw std::invalid_argument("Error packing mesh: Unskinned vertices can not be packed into a skinned format.");
+	}
+
+	a_Result.Format = a_Format;
+	a_Result.VertexCount = a_uVertexCount;
+	a_Result.Vertices.resize((size_t)a_uVertexCount * GetVertexStride(a_Format));
+
+	if (a_Format == VertexFormat::Standard)
+	{
+		std::memcpy(a_Result.Vertices.data(), a_pVertices, a_Result.Vertices.size());
+	}
+	else
+	{
+		CompactVertex* pCompact = reinterpret_cast<CompactVertex*>(a_Result.Vertices.data());
+		for (unsigned int i = 0; i < a_uVertexCount; i++)
+		{
+			PackCompact(a_pVertices[i], pCompact[i]);
+		}
+	}
+
+	PackIndices(a_pIndices, a_uIndexCount, a_Result);
+	PackBounds(a_pVertices, a_uVertexCount, a_Result);
+}
+
+void VertexPacker::Pack(
+	const SkinnedVertex* a_pVertices,
+	unsigned int a_uVertexCount,
+	const unsigned int* a_pIndices,
+	unsigned int a_uIndexCount,
+	VertexFormat a_Format,
+	PackedMesh& a_Result)
+{
+	if (a_Format != VertexFormat::Skinned && a_Format != VertexFormat::CompactSkinned)
+	{
+		throw std::invalid_argument("Error packing mesh: Skinned vertices can only be packed into a skinned format.");
+	}
+
+	a_Result.Format = a_Format;
+	a_Result.VertexCount = a_uVertexCount;
+	a_Result.Vertices.resize((size_t)a_uVertexCount * GetVertexStride(a_Format));
+
+	if (a_Format == VertexFormat::Skinned)
+	{
+		std::memcpy(a_Result.Vertices.data(), a_pVertices, a_Result.Vertices.size());
+	}
+	else
+	{
+		CompactSkinnedVertex* pCompact = reinterpret_cast<CompactSkinnedVertex*>(a_Result.Vertices.data());
+		for (unsigned int i = 0; i < a_uVertexCount; i++)
+		{
+			PackCompact(a_pVertices[i], pCompact[i]);
+			PackJointWeights(a_pVertices[i], pCompact[i].JointWeights);
+
+			// Unused joints point at the root, their weight is zero anyway.
+			for (unsigned int j = 0; j < MAX_JOINT_INFLUENCES; j++)
+			{
+				int dJoint = a_pVertices[i].JointIndices[j];
+				pCompact[i].JointIndices[j] = dJoint < 0 ? 0 : (uint8_t)dJoint;
+			}
+		}
+	}
+
+	PackIndices(a_pIndices, a_uIndexCount, a_Result);
+	PackBounds(a_pVertices, a_uVertexCount, a_Result);
+}
+
+unsigned int VertexPacker::GetVertexStride(VertexFormat a_Format)
+{
+	switch (a_Format)
+	{
+	case VertexFormat::Compact: return sizeof(CompactVertex);
+	case VertexFormat::Skinned: return sizeof(SkinnedVertex);
+	case VertexFormat::CompactSkinned: return sizeof(CompactSkinnedVertex);
+	default: return sizeof(Vertex);
+	}
+}
+
+unsigned int VertexPacker::GetIndexStride(unsigned int a_uVertexCount)
+{
+	// Every index of a mesh this small fits into 16 bits.
+	return a_uVertexCount <= 0x10000 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+bool VertexPacker::IsCompact(VertexFormat a_Format)
+{
+	return a_Format == VertexFormat::Compact || a_Format == VertexFormat::CompactSkinned;
+}
+
+uint16_t VertexPacker::FloatToHalf(float a_fValue)
+{
+	uint32_t uBits = 0;
+	std::memcpy(&uBits, &a_fValue, sizeof(uBits));
+
+	uint32_t uSign = (uBits >> 16) & 0x8000;
+	uint32_t uExponent = (uBits >> 23) & 0xFF;
+	uint32_t uMantissa = uBits & 0x7FFFFF;
+
+	// Infinity stays infinity and NaN stays NaN.
+	if (uExponent == 0xFF)
+	{
+		return (uint16_t)(uSign | 0x7C00 | (uMantissa != 0 ? 0x200 : 0));
+	}
+
+	int dExponent = (int)uExponent - 127 + 15;
+	if (dExponent >= 31)
+	{
+		return (uint16_t)(uSign | 0x7C00);
+	}
+
+	// Too small for a normal half, so it becomes a denormal or zero.
+	if (dExponent <= 0)
+	{
+		if (dExponent < -10)
+		{
+			return (uint16_t)uSign;
+		}
+
+		uMantissa |= 0x800000;
+		uint32_t uShift = (uint32_t)(14 - dExponent);
+		uint32_t uHalf = uMantissa >> uShift;
+		uint32_t uRest = uMantissa & ((1u << uShift) - 1);
+		uint32_t uMiddle = 1u << (uShift - 1);
+		if (uRest > uMiddle || (uRest == uMiddle && (uHalf & 1)))
+		{
+			uHalf++;
+		}
+		return (uint16_t)(uSign | uHalf);
+	}
+
+	// Rounding to nearest even.  A carry out of the mantissa correctly bumps the exponent.
+	uint32_t uHalf = ((uint32_t)dExponent << 10) | (uMantissa >> 13);
+	uint32_t uRest = uMantissa & 0x1FFF;
+	if (uRest > 0x1000 || (uRest == 0x1000 && (uHalf & 1)))
+	{
+		uHalf++;
+	}
+	return (uint16_t)(uSign | uHalf);
+}
+
+void VertexPacker::EncodeOctahedral(const Vector3& a_v3Direction, int16_t* a_pResult)
+{
+	float fLength = std::fabs(a_v3Direction.x) + std::fabs(a_v3Direction.y) + std::fabs(a_v3Direction.z);
+	if (fLength <= 0.0f)
+	{
+		a_pResult[0] = 0;
+		a_pResult[1] = 0;
+		return;
+	}
+
+	// Projecting onto the octahedron |x| + |y| + |z| = 1.
+	float fX = a_v3Direction.x / fLength;
+	float fY = a_v3Direction.y / fLength;
+
+	// Folding the lower half over the diagonals so everything lands in the [-1, 1] square.
+	if (a_v3Direction.z < 0.0f)
+	{
+		float fFoldedX = (1.0f - std::fabs(fY)) * (fX >= 0.0f ? 1.0f : -1.0f);
+		float fFoldedY = (1.0f - std::fabs(fX)) * (fY >= 0.0f ? 1.0f : -1.0f);
+		fX = fFoldedX;
+		fY = fFoldedY;
+	}
+
+	a_pResult[0] = ToSnorm16(fX);
+	a_pResult[1] = ToSnorm16(fY);
+}
+
+void VertexPacker::PackCompact(const Vertex& a_Vertex, CompactVertex& a_Result)
+{
+	a_Result.Position = a_Vertex.Position;
+	EncodeOctahedral(a_Vertex.Normal, a_Result.Normal);
+	EncodeOctahedral(a_Vertex.Tangent, a_Result.Tangent);
+	a_Result.UV[0] = FloatToHalf(a_Vertex.UV.x);
+	a_Result.UV[1] = FloatToHalf(a_Vertex.UV.y);
+}
+
+template <typename V>
+void VertexPacker::PackBounds(const V* a_pVertices, unsigned int a_uVertexCount, PackedMesh& a_Result)
+{
+	a_Result.Lods.assign(1, MeshLod());
+	a_Result.Lods[0].IndexCount = a_Result.IndexCount;
+
+	if (a_uVertexCount == 0)
+	{
+		a_Result.BoundsCenter = Vector3(0.0f, 0.0f, 0.0f);
+		a_Result.BoundsRadius = 0.0f;
+		a_Result.BoundsMin = Vector3(0.0f, 0.0f, 0.0f);
+		a_Result.BoundsMax = Vector3(0.0f, 0.0f, 0.0f);
+		return;
+	}
+
+	// Centering the sphere on the box around the vertices.
+	Vector3 v3Min = a_pVertices[0].Position;
+	Vector3 v3Max = a_pVertices[0].Position;
+	for (unsigned int i = 1; i < a_uVertexCount; i++)
+	{
+		const Vector3& v3Position = a_pVertices[i].Position;
+		v3Min = Vector3(std::fmin(v3Min.x, v3Position.x), std::fmin(v3Min.y, v3Position.y), std::fmin(v3Min.z, v3Position.z));
+		v3Max = Vector3(std::fmax(v3Max.x, v3Position.x), std::fmax(v3Max.y, v3Position.y), std::fmax(v3Max.z, v3Position.z));
+	}
+	Vector3 v3Center((v3Min.x + v3Max.x) * 0.5f, (v3Min.y + v3Max.y) * 0.5f, (v3Min.z + v3Max.z) * 0.5f);
+
+	float fRadiusSquared = 0.0f;
+	for (unsigned int i = 0; i < a_uVertexCount; i++)
+	{
+		const Vector3& v3Position = a_pVertices[i].Position;
+		float fX = v3Position.x - v3Center.x;
+		float fY = v3Position.y - v3Center.y;
+		float fZ = v3Position.z - v3Center.z;
+		fRadiusSquared = std::fmax(fRadiusSquared, fX * fX + fY * fY + fZ * fZ);
+	}
+
+	a_Result.BoundsCenter = v3Center;
+	a_Result.BoundsRadius = std::sqrt(fRadiusSquared);
+	a_Result.BoundsMin = v3Min;
+	a_Result.BoundsMax = v3Max;
+}
+
+void VertexPacker::PackIndices(const unsigned int* a_pIndices, unsigned int a_uIndexCount, PackedMesh& a_Result)
+{
+	unsigned int uStride = GetIndexStride(a_Result.VertexCount);
+	a_Result.IndexCount = a_uIndexCount;
+	a_Result.Indices.resize((size_t)a_uIndexCount * uStride);
+
+	if (uStride == sizeof(uint32_t))
+	{
+		std::memcpy(a_Result.Indices.data(), a_pIndices, a_Result.Indices.size());
+		return;
+	}
+
+	uint16_t* pShort = reinterpret_cast<uint16_t*>(a_Result.Indices.data());
+	for (unsigned int i = 0; i < a_uIndexCount; i++)
+	{
+		pShort[i] = (uint16_t)a_pIndices[i];
+	}
+}
@@ -0,0 +1,102 @@
+#ifndef __VERTEXPACKER_H_
+#define __VERTEXPACKER_H_
+
+#include <cstdint>
+
+#include "VertexFormat.h"
+#include "Vertex.h"
+#include "SkinnedVertex.h"
+
+// Meshes whose UVs stray further than this from the origin stay full precision,
+// since past it half floats can no longer address single texels of large textures.
+#define COMPACT_UV_LIMIT 2.0f
+
+// The largest joint index that still fits into a compact vertex.
+#define COMPACT_JOINT_LIMIT 255
+
+/// <summary>
+/// Converts full precision vertices and indices into the layouts that are uploaded to the GPU.
+/// Nothing in here touches the device, so it can run on the workers.
+/// </summary>
+class VertexPacker
+{
+public:
+	/// <summary>
+	/// Picks Compact unless the mesh has data that would visibly suffer from it.
+	/// </summary>
+	static VertexFormat ChooseFormat(const Vertex* a_pVertices, unsigned int a_uVertexCount);
+
+	/// <summary>
+	/// Picks CompactSkinned unless the mesh has data that would visibly suffer from it.
+	/// </summary>
+	static VertexFormat ChooseFormat(const SkinnedVertex* a_pVertices, unsigned int a_uVertexCount);
+
+	/// <summary>
+	/// Packs a mesh into the Standard or Compact format.
+	/// The indices may hold several LODs, which are then set on the result afterwards.
+	/// </summary>
+	static void Pack(
+		const Vertex* a_pVertices,
+		unsigned int a_uVertexCount,
+		const unsigned int* a_pIndices,
+		unsigned int a_uIndexCount,
+		VertexFormat a_Format,
+		PackedMesh& a_Result);
+
+	/// <summary>
+	/// Packs a mesh into the Skinned or CompactSkinned format.
+	/// The indices may hold several LODs, which are then set on the result afterwards.
+	/// </summary>
+	static void Pack(
+		const SkinnedVertex* a_pVertices,
+		unsigned int a_uVertexCount,
+		const unsigned int* a_pIndices,
+		unsigned int a_uIndexCount,
+		VertexFormat a_Format,
+		PackedMesh& a_Result);
+
+	/// <summary>
+	/// Gets the size in bytes of a single vertex of the passed in format.
+	/// </summary>
+	static unsigned int GetVertexStride(VertexFormat a_Format);
+
+	/// <summary>
+	/// Gets the size in bytes of a single index of a mesh with the passed in amount of vertices.
+	/// </summary>
+	static unsigned int GetIndexStride(unsigned int a_uVertexCount);
+
+	/// <summary>
+	/// Gets whether or not a format is one of the compact ones.
+	/// </summary>
+	static bool IsCompact(VertexFormat a_Format);
+
+	/// <summary>
+	/// Converts a float to half precision, rounding to the nearest value.
+	/// </summary>
+	static uint16_t FloatToHalf(float a_fValue);
+
+	/// <summary>
+	/// Folds a direction onto an octahedron and stores where it lands as two snorm16s.
+	/// Zero length directions come back out as +Z.
+	/// </summary>
+	static void EncodeOctahedral(const Vector3& a_v3Direction, int16_t* a_pResult);
+
+private:
+	/// <summary>
+	/// Packs the attributes shared by both compact formats.
+	/// </summary>
+	static void PackCompact(const Vertex& a_Vertex, CompactVertex& a_Result);
+
+	/// <summary>
+	/// Fills in the single LOD covering every index and the sphere around the vertices.
+	/// </summary>
+	template <typename V>
+	static void PackBounds(const V* a_pVertices, unsigned int a_uVertexCount, PackedMesh& a_Result);
+
+	/// <summary>
+	/// Writes the indices out at the stride the vertex count allows.
+	/// </summary>
+	static void PackIndices(const unsigned int* a_pIndices, unsigned int a_uIndexCount, PackedMesh& a_Result);
+};
+
+#endif //__VERTEXPACKER_H_
@@ -0,0 +1,49 @@
+#ifndef __RECORDINGBACKEND_H_
+#define __RECORDINGBACKEND_H_
+
+#include "RenderQueue.h"
+
+#include <string>
+#include <vector>
+
+/// <summary>
+/// A render backend that draws nothing, only writing down every call it gets in order.
+/// </summary>
+struct RecordingBackend
+{
+	std::vector<std::string> Calls;
+	// Whether DrawInstanced is filled in, without it every run is drawn one object at a time.
+	bool Instancing = false;
+
+	/// <summary>
+	/// Makes a backend that appends to Calls.  The recorder has to outlive it.
+	/// </summary>
+	RenderBackend Make(void)
+	{
+		RenderBackend backend;
+		backend.BindShader = [this](uint32_t a_uShader) { Calls.push_back("shader " + std::to_string(a_uShader)); };
+		backend.BindMaterial = [this](uint32_t a_uMaterial) { Calls.push_back("material " + std::to_string(a_uMaterial)); };
+		backend.BindMesh = [this](uint32_t a_uMesh) { Calls.push_back("mesh " + std::to_string(a_uMesh)); };
+		backend.BindObject = [this](uint32_t a_uObject) { Calls.push_back("object " + std::to_string(a_uObject)); };
+		backend.Draw = [this](uint32_t a_uMesh, uint32_t a_uLod)
+		{
+			Calls.push_back("draw " + std::to_string(a_uMesh) + " " + std::to_string(a_uLod));
+		};
+		if (Instancing)
+		{
+			backend.DrawInstanced = [this](uint32_t a_uMesh, uint32_t a_uLod, const DrawItem* a_pItems, uint32_t a_uCount)
+			{
+				std::string sCall = "instanced " + std::to_string(a_uMesh) + " " + std::to_string(a_uLod) + " x" + std::to_string(a_uCount);
+				for (uint32_t i = 0; i < a_uCount; i++)
+				{
+					sCall += " " + std::to_string(a_pItems[i].Object);
+				}
+				Calls.push_back(sCall);
+				return true;
+			};
+		}
+		return backend;
+	}
+};
+
+#endif //__RECORDINGBACKEND_H_
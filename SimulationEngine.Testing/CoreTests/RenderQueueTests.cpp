@@ -0,0 +1,218 @@
+#include "RecordingBackend.h"
+#include "TestHarness.h"
+
+int g_iFailures = 0;
+
+namespace
+{
+	void SortsOpaqueByStateThenFrontToBack(void)
+	{
+		RenderQueue queue;
+		queue.Submit(RenderLayer::Opaque, 1, 0, 0, 0, 0, 5.0f);
+		queue.Submit(RenderLayer::Opaque, 0, 1, 0, 1, 0, 1.0f);
+		queue.Submit(RenderLayer::Opaque, 0, 0, 1, 2, 0, 1.0f);
+		queue.Submit(RenderLayer::Opaque, 0, 0, 0, 3, 0, 9.0f);
+		queue.Submit(RenderLayer::Opaque, 0, 0, 0, 4, 0, 2.0f);
+		queue.Sort();
+
+		const std::vector<DrawItem>& lItems = queue.GetItems();
+		CHECK(lItems.size() == 5);
+		CHECK(lItems[0].Object == 4);
+		CHECK(lItems[1].Object == 3);
+		CHECK(lItems[2].Object == 2);
+		CHECK(lItems[3].Object == 1);
+		CHECK(lItems[4].Object == 0);
+	}
+
+	void SortsTranslucentBackToFrontAfterOpaque(void)
+	{
+		RenderQueue queue;
+		queue.Submit(RenderLayer::Translucent, 0, 0, 0, 0, 0, 1.0f);
+		queue.Submit(RenderLayer::Opaque, 9, 9, 9, 1, 0, 100.0f);
+		queue.Submit(RenderLayer::Translucent, 5, 5, 5, 2, 0, 10.0f);
+		queue.Submit(RenderLayer::Translucent, 0, 0, 0, 3, 0, 4.0f);
+		queue.Sort();
+
+		const std::vector<DrawItem>& lItems = queue.GetItems();
+		CHECK(lItems[0].Object == 1);
+		CHECK(lItems[1].Object == 2);
+		CHECK(lItems[2].Object == 3);
+		CHECK(lItems[3].Object == 0);
+		CHECK(RenderQueue::GetLayer(lItems[0].Key) == RenderLayer::Opaque);
+		CHECK(RenderQueue::GetLayer(lItems[3].Key) == RenderLayer::Translucent);
+	}
+
+	void KeepsSubmissionOrderForEqualKeys(void)
+	{
+		RenderQueue queue;
+		for (uint32_t i = 0; i < 100; i++)
+		{
+			queue.Submit(RenderLayer::Opaque, i % 2, 0, 0, i, 0, 1.0f);
+		}
+		queue.Sort();
+
+		const std::vector<DrawItem>& lItems = queue.GetItems();
+		for (uint32_t i = 0; i < 50; i++)
+		{
+			CHECK(lItems[i].Object == i * 2);
+			CHECK(lItems[50 + i].Object == i * 2 + 1);
+		}
+	}
+
+	void KeyRoundTripsItsIds(void)
+	{
+		uint64_t uOpaque = RenderQueue::MakeKey(RenderLayer::Opaque, 200, 40000, 1234, 3.0f);
+		CHECK(RenderQueue::GetShader(uOpaque) == 200);
+		CHECK(RenderQueue::GetMaterial(uOpaque) == 40000);
+		CHECK(RenderQueue::GetMesh(uOpaque) == 1234);
+
+		uint64_t uTranslucent = RenderQueue::MakeKey(RenderLayer::Translucent, 7, 8, 9, 3.0f);
+		CHECK(RenderQueue::GetShader(uTranslucent) == 7);
+		CHECK(RenderQueue::GetMaterial(uTranslucent) == 8);
+		CHECK(RenderQueue::GetMesh(uTranslucent) == 9);
+	}
+
+	void OnlyBindsChangedState(void)
+	{
+		// Two shaders, three materials and four meshes, submitted as badly ordered as possible.
+		RenderQueue queue;
+		uint32_t uObject = 0;
+		for (uint32_t uMesh = 0; uMesh < 4; uMesh++)
+		{
+			for (uint32_t uMaterial = 0; uMaterial < 3; uMaterial++)
+			{
+				for (uint32_t uShader = 0; uShader < 2; uShader++)
+				{
+					queue.Submit(RenderLayer::Opaque, uShader, uMaterial, uMesh, uObject++, 0, 1.0f);
+				}
+			}
+		}
+		queue.Sort();
+
+		RecordingBackend recorder;
+		queue.Execute(recorder.Make());
+		RenderStats stats = queue.GetStats();
+		CHECK(stats.Draws == 24);
+		CHECK(stats.InstancedDraws == 0);
+		CHECK(stats.ShaderSwitches == 2);
+		CHECK(stats.MaterialSwitches == 6);
+		// Every material change also lands on a different mesh than the one bound.
+		CHECK(stats.MeshSwitches == 24);
+		CHECK(stats.ObjectSwitches == 24);
+		CHECK(stats.Unsorted == 0);
+		CHECK(recorder.Calls.size() == 2 + 6 + 24 + 24 + 24);
+		CHECK(recorder.Calls[0] == "shader 0");
+		CHECK(recorder.Calls[1] == "material 0");
+		CHECK(recorder.Calls[2] == "mesh 0");
+	}
+
+	void RebindsMeshAfterShaderSwitch(void)
+	{
+		RenderQueue queue;
+		queue.Submit(RenderLayer::Opaque, 0, 0, 3, 0, 0, 1.0f);
+		queue.Submit(RenderLayer::Opaque, 1, 0, 3, 1, 0, 1.0f);
+		queue.Sort();
+
+		RecordingBackend recorder;
+		queue.Execute(recorder.Make());
+		CHECK(queue.GetStats().ShaderSwitches == 2);
+		CHECK(queue.GetStats().MaterialSwitches == 1);
+		CHECK(queue.GetStats().MeshSwitches == 2);
+
+		std::vector<std::string> lExpected = {
+			"shader 0", "material 0", "mesh 3", "object 0", "draw 3 0",
+			"shader 1", "mesh 3", "object 1", "draw 3 0" };
+		CHECK(recorder.Calls == lExpected);
+	}
+
+	void InstancesRunsOfTheSameState(void)
+	{
+		RenderQueue queue;
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			queue.Submit(RenderLayer::Opaque, 0, 0, 0, i, 0, (float)(i + 1));
+		}
+		// A different LOD breaks the run.
+		queue.Submit(RenderLayer::Opaque, 0, 0, 0, 4, 1, 10.0f);
+		queue.Sort();
+
+		RecordingBackend recorder;
+		recorder.Instancing = true;
+		queue.Execute(recorder.Make());
+		RenderStats stats = queue.GetStats();
+		CHECK(stats.Draws == 2);
+		CHECK(stats.InstancedDraws == 1);
+		CHECK(stats.Instances == 4);
+		CHECK(stats.ObjectSwitches == 1);
+
+		std::vector<std::string> lExpected = {
+			"shader 0", "material 0", "mesh 0", "instanced 0 0 x4 0 1 2 3", "object 4", "draw 0 1" };
+		CHECK(recorder.Calls == lExpected);
+
+		// Without instancing the same run is drawn one object at a time.
+		RecordingBackend single;
+		queue.Execute(single.Make());
+		CHECK(queue.GetStats().Draws == 5);
+		CHECK(queue.GetStats().InstancedDraws == 0);
+		CHECK(queue.GetStats().ObjectSwitches == 5);
+	}
+
+	void AcceptsIdsPastTheKey(void)
+	{
+		// More shaders, materials and meshes than the key has room for, which a busy frame can reach.
+		RenderQueue queue;
+		queue.Submit(RenderLayer::Opaque, 300, 70000, 70000, 0, 0, 1.0f);
+		queue.Submit(RenderLayer::Opaque, 300, 70000, 70001, 1, 0, 2.0f);
+		queue.Submit(RenderLayer::Opaque, 1, 1, 1, 2, 0, 3.0f);
+		queue.Submit(RenderLayer::Opaque, 300, 70000, 70000, 3, 0, 4.0f);
+		queue.Sort();
+
+		// Ids that fit still come first, the rest share the largest key value and go front to back.
+		const std::vector<DrawItem>& lItems = queue.GetItems();
+		CHECK(lItems[0].Object == 2);
+		CHECK(lItems[1].Object == 0);
+		CHECK(lItems[2].Object == 1);
+		CHECK(lItems[3].Object == 3);
+		CHECK(RenderQueue::GetShader(lItems[1].Key) == (1u << RENDER_KEY_SHADER_BITS) - 1);
+
+		// The real ids are bound, and the clamped keys are not mistaken for one instanced run.
+		RecordingBackend recorder;
+		recorder.Instancing = true;
+		queue.Execute(recorder.Make());
+		RenderStats stats = queue.GetStats();
+		CHECK(stats.Draws == 4);
+		CHECK(stats.InstancedDraws == 0);
+		CHECK(stats.ShaderSwitches == 2);
+		CHECK(stats.MaterialSwitches == 2);
+		CHECK(stats.MeshSwitches == 4);
+		CHECK(stats.Unsorted == 3);
+
+		std::vector<std::string> lExpected = {
+			"shader 1", "material 1", "mesh 1", "object 2", "draw 1 0",
+			"shader 300", "material 70000", "mesh 70000", "object 0", "draw 70000 0",
+			"mesh 70001", "object 1", "draw 70001 0",
+			"mesh 70000", "object 3", "draw 70000 0" };
+		CHECK(recorder.Calls == lExpected);
+	}
+}
+
+int main()
+{
+	RUN_TEST(SortsOpaqueByStateThenFrontToBack);
+	RUN_TEST(SortsTranslucentBackToFrontAfterOpaque);
+	RUN_TEST(KeepsSubmissionOrderForEqualKeys);
+	RUN_TEST(KeyRoundTripsItsIds);
+	RUN_TEST(OnlyBindsChangedState);
+	RUN_TEST(RebindsMeshAfterShaderSwitch);
+	RUN_TEST(InstancesRunsOfTheSameState);
+	RUN_TEST(AcceptsIdsPastTheKey);
+
+	if (g_iFailures > 0)
+	{
+		std::cerr << g_iFailures << " check(s) failed" << std::endl;
+		return 1;
+	}
+
+	std::cout << "All checks passed" << std::endl;
+	return 0;
+}
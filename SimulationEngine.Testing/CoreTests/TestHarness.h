@@ -0,0 +1,32 @@
+#ifndef __TESTHARNESS_H_
+#define __TESTHARNESS_H_
+
+#include <iostream>
+
+// How many checks have failed so far, main returns it so a failing run shows up in the exit code.
+extern int g_iFailures;
+
+/// <summary>
+/// Reports a failing condition along with where it was checked, and keeps going.
+/// </summary>
+#define CHECK(a_bCondition) \
+	do \
+	{ \
+		if (!(a_bCondition)) \
+		{ \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #a_bCondition ") failed" << std::endl; \
+			g_iFailures++; \
+		} \
+	} while (0)
+
+/// <summary>
+/// Runs a test function, printing its name first so failures can be told apart.
+/// </summary>
+#define RUN_TEST(a_Function) \
+	do \
+	{ \
+		std::cout << #a_Function << std::endl; \
+		a_Function(); \
+	} while (0)
+
+#endif //__TESTHARNESS_H_
@@ -0,0 +1,458 @@
+#include "TextureCooker.h"
+#include "ThreadPool.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <sys/stat.h>
+#include <utime.h>
+
+int g_iFailures = 0;
+
+namespace
+{
+	const size_t DDS_HEADER_SIZE = 148;
+
+	/// <summary>
+	/// Reads a little endian word out of a byte buffer.
+	/// </summary>
+	uint32_t ReadWord(const unsigned char* a_pData, size_t a_uOffset)
+	{
+		uint32_t uWord;
+		std::memcpy(&uWord, a_pData + a_uOffset, sizeof(uint32_t));
+		return uWord;
+	}
+
+	/// <summary>
+	/// Expands a 565 color into 8 bit RGB, the way the hardware does.
+	/// </summary>
+	void Unpack565(uint16_t a_uColor, int a_lResult[3])
+	{
+		int r = (a_uColor >> 11) & 31;
+		int g = (a_uColor >> 5) & 63;
+		int b = a_uColor & 31;
+		a_lResult[0] = (r << 3) | (r >> 2);
+		a_lResult[1] = (g << 2) | (g >> 4);
+		a_lResult[2] = (b << 3) | (b >> 2);
+	}
+
+	/// <summary>
+	/// Decodes a BC1 block in the 4 color mode, the only one the cooker writes.
+	/// </summary>
+	void DecodeBC1(const unsigned char* a_pBlock, unsigned char* a_pPixels)
+	{
+		uint16_t uColor0;
+		uint16_t uColor1;
+		std::memcpy(&uColor0, a_pBlock, 2);
+		std::memcpy(&uColor1, a_pBlock + 2, 2);
+		uint32_t uBits = ReadWord(a_pBlock, 4);
+
+		int lPalette[4][3];
+		Unpack565(uColor0, lPalette[0]);
+		Unpack565(uColor1, lPalette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			lPalette[2][c] = (2 * lPalette[0][c] + lPalette[1][c]) / 3;
+			lPalette[3][c] = (lPalette[0][c] + 2 * lPalette[1][c]) / 3;
+		}
+
+		for (int i = 0; i < 16; i++)
+		{
+			const int* pColor = lPalette[(uBits >> (i * 2)) & 3];
+			a_pPixels[i * 4 + 0] = (unsigned char)pColor[0];
+			a_pPixels[i * 4 + 1] = (unsigned char)pColor[1];
+			a_pPixels[i * 4 + 2] = (unsigned char)pColor[2];
+			a_pPixels[i * 4 + 3] = 255;
+		}
+	}
+
+	/// <summary>
+	/// Decodes a BC4 block into one channel of the pixels.
+	/// </summary>
+	void DecodeBC4(const unsigned char* a_pBlock, int a_uChannel, unsigned char* a_pPixels)
+	{
+		int lPalette[8] = { a_pBlock[0], a_pBlock[1] };
+		for (int i = 2; i < 8; i++)
+		{
+			lPalette[i] = lPalette[0] > lPalette[1] ?
+				((8 - i) * lPalette[0] + (i - 1) * lPalette[1]) / 7 :
+				(i < 6 ? ((6 - i) * lPalette[0] + (i - 1) * lPalette[1]) / 5 : (i == 6 ? 0 : 255));
+		}
+
+		uint64_t uBits = 0;
+		for (int i = 0; i < 6; i++)
+		{
+			uBits |= (uint64_t)a_pBlock[2 + i] << (i * 8);
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			a_pPixels[i * 4 + a_uChannel] = (unsigned char)lPalette[(uBits >> (i * 3)) & 7];
+		}
+	}
+
+	/// <summary>
+	/// Reads the bits of a BC7 block from the lowest one up.
+	/// </summary>
+	struct BlockReader
+	{
+		const unsigned char* Data;
+		int Position = 0;
+
+		int Read(int a_iBits)
+		{
+			int iValue = 0;
+			for (int i = 0; i < a_iBits; i++, Position++)
+			{
+				iValue |= ((Data[Position >> 3] >> (Position & 7)) & 1) << i;
+			}
+			return iValue;
+		}
+	};
+
+	/// <summary>
+	/// Decodes a BC7 block in mode 6, the only one the cooker writes.
+	/// </summary>
+	/// <returns>False if the block is in any other mode.</returns>
+	bool DecodeBC7(const unsigned char* a_pBlock, unsigned char* a_pPixels)
+	{
+		const int WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		BlockReader reader{ a_pBlock };
+		if (reader.Read(7) != 1 << 6)
+		{
+			return false;
+		}
+
+		int lEndpoints[2][4];
+		for (int c = 0; c < 4; c++)
+		{
+			lEndpoints[0][c] = reader.Read(7);
+			lEndpoints[1][c] = reader.Read(7);
+		}
+		int dPBit0 = reader.Read(1);
+		int dPBit1 = reader.Read(1);
+		for (int c = 0; c < 4; c++)
+		{
+			lEndpoints[0][c] = (lEndpoints[0][c] << 1) | dPBit0;
+			lEndpoints[1][c] = (lEndpoints[1][c] << 1) | dPBit1;
+		}
+
+		for (int i = 0; i < 16; i++)
+		{
+			int w = WEIGHTS[reader.Read(i == 0 ? 3 : 4)];
+			for (int c = 0; c < 4; c++)
+			{
+				a_pPixels[i * 4 + c] = (unsigned char)(((64 - w) * lEndpoints[0][c] + w * lEndpoints[1][c] + 32) >> 6);
+			}
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Makes a 4x4 block with a smooth gradient between two colors, which every format should hold well.
+	/// </summary>
+	void MakeGradient(const unsigned char a_lFrom[4], const unsigned char a_lTo[4], unsigned char* a_pPixels)
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			int t = (i & 3) + (i >> 2);
+			for (int c = 0; c < 4; c++)
+			{
+				a_pPixels[i * 4 + c] = (unsigned char)(a_lFrom[c] + (a_lTo[c] - a_lFrom[c]) * t / 6);
+			}
+		}
+	}
+
+	/// <summary>
+	/// Gets the largest difference between two blocks over the passed in channels.
+	/// </summary>
+	int MaxError(const unsigned char* a_pFirst, const unsigned char* a_pSecond, int a_iFirstChannel, int a_iChannels)
+	{
+		int dError = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = a_iFirstChannel; c < a_iFirstChannel + a_iChannels; c++)
+			{
+				dError = std::max(dError, std::abs(a_pFirst[i * 4 + c] - a_pSecond[i * 4 + c]));
+			}
+		}
+		return dError;
+	}
+
+	/// <summary>
+	/// Makes an image with a different gradient in every channel.
+	/// </summary>
+	ImageData MakeImage(unsigned int a_uWidth, unsigned int a_uHeight, bool a_bOpaque)
+	{
+		ImageData image;
+		image.Width = a_uWidth;
+		image.Height = a_uHeight;
+		image.Pixels.resize((size_t)a_uWidth * a_uHeight * 4);
+		for (unsigned int y = 0; y < a_uHeight; y++)
+		{
+			for (unsigned int x = 0; x < a_uWidth; x++)
+			{
+				unsigned char* pPixel = &image.Pixels[((size_t)y * a_uWidth + x) * 4];
+				pPixel[0] = (unsigned char)(x * 255 / a_uWidth);
+				pPixel[1] = (unsigned char)(y * 255 / a_uHeight);
+				pPixel[2] = (unsigned char)((x + y) * 127 / (a_uWidth + a_uHeight));
+				pPixel[3] = a_bOpaque ? 255 : (unsigned char)(255 - x * 255 / a_uWidth);
+			}
+		}
+		return image;
+	}
+
+	/// <summary>
+	/// Reads a whole file into memory.
+	/// </summary>
+	std::vector<unsigned char> ReadFile(const std::string& a_sFile)
+	{
+		std::ifstream file(a_sFile, std::ios::binary);
+		return std::vector<unsigned char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	/// <summary>
+	/// Writes a stand-in source file and sets its write time, so the cache sees exactly the stamp it is meant to.
+	/// </summary>
+	void WriteSource(const std::string& a_sFile, const std::string& a_sContents, time_t a_WriteTime)
+	{
+		std::ofstream file(a_sFile, std::ios::binary | std::ios::trunc);
+		file << a_sContents;
+		file.close();
+
+		utimbuf times;
+		times.actime = a_WriteTime;
+		times.modtime = a_WriteTime;
+		utime(a_sFile.c_str(), &times);
+	}
+
+	void ChoosesFormatByUsage(void)
+	{
+		TextureCookOptions options;
+		ImageData opaque = MakeImage(8, 8, true);
+		ImageData translucent = MakeImage(8, 8, false);
+
+		CHECK(TextureCooker::ChooseFormat(opaque, options) == TextureFormat::BC7);
+		options.Fast = true;
+		CHECK(TextureCooker::ChooseFormat(opaque, options) == TextureFormat::BC1);
+		CHECK(TextureCooker::ChooseFormat(translucent, options) == TextureFormat::BC3);
+		options.Usage = TextureUsage::Normal;
+		CHECK(TextureCooker::ChooseFormat(opaque, options) == TextureFormat::BC5);
+		options.Usage = TextureUsage::Roughness;
+		CHECK(TextureCooker::ChooseFormat(opaque, options) == TextureFormat::BC4);
+		options.Usage = TextureUsage::Metal;
+		CHECK(TextureCooker::ChooseFormat(opaque, options) == TextureFormat::BC4);
+
+		// Only whole blocks can be compressed.
+		CHECK(TextureCooker::ChooseFormat(MakeImage(6, 8, true), options) == TextureFormat::RGBA8);
+	}
+
+	void RoundTripsBC1(void)
+	{
+		unsigned char lBlock[64];
+		unsigned char lDecoded[64];
+		unsigned char lEncoded[8];
+
+		// Colors that 565 holds exactly come back exactly.
+		const unsigned char RED[4] = { 255, 0, 0, 255 };
+		MakeGradient(RED, RED, lBlock);
+		TextureCooker::EncodeBlock(TextureFormat::BC1, lBlock, lEncoded);
+		DecodeBC1(lEncoded, lDecoded);
+		CHECK(MaxError(lBlock, lDecoded, 0, 4) == 0);
+
+		const unsigned char FROM[4] = { 20, 60, 200, 255 };
+		const unsigned char TO[4] = { 220, 180, 40, 255 };
+		MakeGradient(FROM, TO, lBlock);
+		TextureCooker::EncodeBlock(TextureFormat::BC1, lBlock, lEncoded);
+		DecodeBC1(lEncoded, lDecoded);
+		// Four colors spread over the widest channel's range of 200, plus the 565 rounding.
+		CHECK(MaxError(lBlock, lDecoded, 0, 3) <= 200 / 6 + 4);
+
+		// The 4 color mode is the one without transparency.
+		uint16_t uColor0;
+		uint16_t uColor1;
+		std::memcpy(&uColor0, lEncoded, 2);
+		std::memcpy(&uColor1, lEncoded + 2, 2);
+		CHECK(uColor0 > uColor1);
+	}
+
+	void RoundTripsBC4(void)
+	{
+		unsigned char lBlock[64];
+		unsigned char lDecoded[64] = {};
+		unsigned char lEncoded[8];
+
+		const unsigned char FROM[4] = { 10, 0, 0, 255 };
+		const unsigned char TO[4] = { 240, 0, 0, 255 };
+		MakeGradient(FROM, TO, lBlock);
+		TextureCooker::EncodeBlock(TextureFormat::BC4, lBlock, lEncoded);
+		DecodeBC4(lEncoded, 0, lDecoded);
+
+		// Eight evenly spaced values over the range, so nothing is further than half a step away.
+		CHECK(lEncoded[0] > lEncoded[1]);
+		CHECK(MaxError(lBlock, lDecoded, 0, 1) <= (240 - 10) / 14 + 1);
+
+		const unsigned char FLAT[4] = { 77, 0, 0, 255 };
+		MakeGradient(FLAT, FLAT, lBlock);
+		TextureCooker::EncodeBlock(TextureFormat::BC4, lBlock, lEncoded);
+		DecodeBC4(lEncoded, 0, lDecoded);
+		CHECK(MaxError(lBlock, lDecoded, 0, 1) == 0);
+	}
+
+	void RoundTripsBC7(void)
+	{
+		unsigned char lBlock[64];
+		unsigned char lDecoded[64];
+		unsigned char lEncoded[16];
+
+		const unsigned char FROM[4] = { 20, 60, 200, 255 };
+		const unsigned char TO[4] = { 220, 180, 40, 64 };
+		MakeGradient(FROM, TO, lBlock);
+		TextureCooker::EncodeBlock(TextureFormat::BC7, lBlock, lEncoded);
+		CHECK(DecodeBC7(lEncoded, lDecoded));
+		CHECK(MaxError(lBlock, lDecoded, 0, 4) <= 8);
+
+		const unsigned char FLAT[4] = { 128, 64, 32, 255 };
+		MakeGradient(FLAT, FLAT, lBlock);
+		TextureCooker::EncodeBlock(TextureFormat::BC7, lBlock, lEncoded);
+		CHECK(DecodeBC7(lEncoded, lDecoded));
+		CHECK(MaxError(lBlock, lDecoded, 0, 4) <= 1);
+	}
+
+	void LaysOutEveryMip(void)
+	{
+		ImageData image = MakeImage(64, 32, true);
+		TextureCookOptions options;
+		CookedTexture texture;
+		CHECK(TextureCooker::Cook(image, options, texture));
+		CHECK(texture.Format == TextureFormat::BC7);
+		CHECK(texture.Width == 64);
+		CHECK(texture.Height == 32);
+
+		// 64x32 down to 1x1.
+		CHECK(texture.Mips.size() == 7);
+		size_t uOffset = 0;
+		for (size_t i = 0; i < texture.Mips.size(); i++)
+		{
+			const CookedMip& mip = texture.Mips[i];
+			uint32_t uBlocksWide = std::max(1u, (mip.Width + 3) / 4);
+			uint32_t uBlocksHigh = std::max(1u, (mip.Height + 3) / 4);
+			CHECK(mip.Width == std::max(1u, 64u >> i));
+			CHECK(mip.Height == std::max(1u, 32u >> i));
+			CHECK(mip.RowPitch == uBlocksWide * 16);
+			CHECK(mip.Size == (size_t)uBlocksWide * uBlocksHigh * 16);
+			CHECK(mip.Offset == uOffset);
+			uOffset += mip.Size;
+		}
+		CHECK(texture.Data.size() == uOffset);
+
+		// The top mip decodes back into the image.
+		unsigned char lDecoded[64];
+		unsigned char lSource[64];
+		CHECK(DecodeBC7(texture.GetMipData(0), lDecoded));
+		for (int i = 0; i < 16; i++)
+		{
+			std::memcpy(&lSource[i * 4], &image.Pixels[((i >> 2) * 64 + (i & 3)) * 4], 4);
+		}
+		CHECK(MaxError(lSource, lDecoded, 0, 4) <= 8);
+	}
+
+	void WritesAStandardDDS(void)
+	{
+		const std::string sSource = "TextureCookerTests.source";
+		WriteSource(sSource, "pretend this is a png", 1000000);
+
+		TextureCookOptions options;
+		options.Usage = TextureUsage::Roughness;
+		CookedTexture texture;
+		CHECK(TextureCooker::Cook(MakeImage(16, 8, true), options, texture));
+		CHECK(TextureCooker::WriteCache(sSource, options, texture));
+
+		std::vector<unsigned char> lFile = ReadFile(sSource + TEXTURE_CACHE_EXTENSION);
+		CHECK(lFile.size() == DDS_HEADER_SIZE + texture.Data.size());
+		if (lFile.size() < DDS_HEADER_SIZE)
+		{
+			return;
+		}
+
+		const unsigned char* pFile = lFile.data();
+		CHECK(std::memcmp(pFile, "DDS ", 4) == 0);
+		CHECK(ReadWord(pFile, 4) == 124);
+		CHECK(ReadWord(pFile, 12) == 8);
+		CHECK(ReadWord(pFile, 16) == 16);
+		CHECK(ReadWord(pFile, 28) == texture.Mips.size());
+		// The pixel format is 32 bytes and points at the DX10 extension.
+		CHECK(ReadWord(pFile, 76) == 32);
+		CHECK(std::memcmp(pFile + 84, "DX10", 4) == 0);
+		CHECK(ReadWord(pFile, 128) == (uint32_t)TextureFormat::BC4);
+		// A 2D texture array of one.
+		CHECK(ReadWord(pFile, 132) == 3);
+		CHECK(ReadWord(pFile, 140) == 1);
+		CHECK(std::memcmp(pFile + DDS_HEADER_SIZE, texture.Data.data(), texture.Data.size()) == 0);
+
+		std::remove((sSource + TEXTURE_CACHE_EXTENSION).c_str());
+		std::remove(sSource.c_str());
+	}
+
+	void RejectsStaleCaches(void)
+	{
+		const std::string sSource = "TextureCookerTests.stale";
+		WriteSource(sSource, "first contents", 1000000);
+
+		TextureCookOptions options;
+		CookedTexture texture;
+		CHECK(TextureCooker::Cook(MakeImage(8, 8, true), options, texture));
+		CHECK(TextureCooker::WriteCache(sSource, options, texture));
+
+		CookedTexture loaded;
+		CHECK(TextureCooker::LoadCache(sSource, options, loaded));
+		CHECK(loaded.Format == texture.Format);
+		CHECK(loaded.Mips.size() == texture.Mips.size());
+		CHECK(std::memcmp(loaded.GetMipData(0), texture.Data.data(), texture.Data.size()) == 0);
+
+		// Other options are cooked separately.
+		TextureCookOptions fast;
+		fast.Fast = true;
+		CHECK(!TextureCooker::LoadCache(sSource, fast, loaded));
+
+		// Touched but identical, which only the hash can tell.
+		WriteSource(sSource, "first contents", 2000000);
+		CHECK(TextureCooker::LoadCache(sSource, options, loaded));
+
+		// Same size, different bytes.
+		WriteSource(sSource, "other contents", 3000000);
+		CHECK(!TextureCooker::LoadCache(sSource, options, loaded));
+
+		// A different size is caught without hashing.
+		WriteSource(sSource, "longer contents", 1000000);
+		CHECK(!TextureCooker::LoadCache(sSource, options, loaded));
+
+		loaded = CookedTexture();
+		std::remove((sSource + TEXTURE_CACHE_EXTENSION).c_str());
+		std::remove(sSource.c_str());
+	}
+}
+
+int main()
+{
+	RUN_TEST(ChoosesFormatByUsage);
+	RUN_TEST(RoundTripsBC1);
+	RUN_TEST(RoundTripsBC4);
+	RUN_TEST(RoundTripsBC7);
+	RUN_TEST(LaysOutEveryMip);
+	RUN_TEST(WritesAStandardDDS);
+	RUN_TEST(RejectsStaleCaches);
+	ThreadPool::Release();
+
+	if (g_iFailures > 0)
+	{
+		std::cerr << g_iFailures << " check(s) failed" << std::endl;
+		return 1;
+	}
+
+	std::cout << "All checks passed" << std::endl;
+	return 0;
+}